@@ -5,6 +5,7 @@
 
 #include "config.h"
 
+#include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -15,70 +16,164 @@
 #include "atom.h"
 #include "bench.h"
 #include "darray.h"
+#include "src/keysym.h"
+#include "utils.h"
 
 #define BENCHMARK_ITERATIONS 100
+/*
+ * A keymap compilation interns the same identifiers many times: key names in
+ * each section, keysym names in symbols and compat files, etc.
+ */
+#define VOCABULARY_LOOKUPS 10
 
-int
-main(void)
+typedef darray(char *) word_list;
+
+static void
+free_words(word_list *words)
 {
-    int ret = EXIT_SUCCESS;
-    FILE *file;
-    char wordbuf[1024];
-    darray(char *) words;
     char **worditer;
-    struct atom_table *table;
-    xkb_atom_t atom;
-    const char *text;
-    struct bench bench;
-    char *elapsed;
+    darray_foreach(worditer, *words) {
+        free(*worditer);
+    }
+    darray_free(*words);
+}
 
-    darray_init(words);
-    file = fopen("/usr/share/dict/words", "rb");
+static bool
+append_word(word_list *words, const char *word)
+{
+    char * const copy = strdup(word);
+    if (!copy)
+        return false;
+    darray_append(*words, copy);
+    return true;
+}
+
+/* Returns false if the dictionary is not available */
+static bool
+load_dictionary(word_list *words)
+{
+    char wordbuf[1024];
+    FILE * const file = fopen("/usr/share/dict/words", "rb");
     if (file == NULL) {
         perror("/usr/share/dict/words");
-        return -1;
+        return false;
     }
     while (fgets(wordbuf, sizeof(wordbuf), file)) {
         size_t len = strlen(wordbuf);
         if (len > 0 && wordbuf[len - 1] == '\n')
             wordbuf[len - 1] = '\0';
-        char *word = strdup(wordbuf);
-        if (!word) {
+        if (!append_word(words, wordbuf)) {
             fclose(file);
-            ret = EXIT_FAILURE;
-            goto out;
+            return false;
         }
-        darray_append(words, word);
     }
     fclose(file);
+    return true;
+}
+
+/* Identifiers, key names and keysym names of a typical keymap */
+static bool
+load_keymap_vocabulary(word_list *words)
+{
+    static const char * const identifiers[] = {
+        "Shift", "Lock", "Control", "Mod1", "Mod2", "Mod3", "Mod4", "Mod5",
+        "Alt", "Meta", "Super", "Hyper", "NumLock", "LevelThree", "LevelFive",
+        "ScrollLock", "ONE_LEVEL", "TWO_LEVEL", "ALPHABETIC", "KEYPAD",
+        "FOUR_LEVEL", "FOUR_LEVEL_ALPHABETIC", "FOUR_LEVEL_SEMIALPHABETIC",
+        "EIGHT_LEVEL", "PC_CONTROL_LEVEL2", "CTRL+ALT", "SetMods", "LatchMods",
+        "LockMods", "SetGroup", "LatchGroup", "LockGroup", "NoAction",
+        "Terminate", "SwitchScreen", "modifiers", "mods", "group",
+        "clearLocks", "latchToLock", "affect", "useModMapMods", "virtualMods",
+        "repeat", "allowExplicit", "whichModState", "indicator",
+        "Caps Lock", "Num Lock", "Scroll Lock", "Compose", "Kana",
+    };
+    static const char * const rows[] = { "AE", "AD", "AC", "AB" };
+    char name[64];
+
+    for (size_t k = 0; k < ARRAY_SIZE(identifiers); k++) {
+        if (!append_word(words, identifiers[k]))
+            return false;
+    }
+
+    for (size_t r = 0; r < ARRAY_SIZE(rows); r++) {
+        for (int k = 1; k <= 12; k++) {
+            snprintf(name, sizeof(name), "%s%02d", rows[r], k);
+            if (!append_word(words, name))
+                return false;
+        }
+    }
+    for (int k = 1; k <= 24; k++) {
+        snprintf(name, sizeof(name), "FK%02d", k);
+        if (!append_word(words, name))
+            return false;
+    }
+    for (int k = 120; k <= 255; k++) {
+        snprintf(name, sizeof(name), "I%03d", k);
+        if (!append_word(words, name))
+            return false;
+    }
+
+    struct xkb_keysym_iterator *iter = xkb_keysym_iterator_new(true);
+    bool ok = true;
+    while (ok && xkb_keysym_iterator_next(iter)) {
+        if (xkb_keysym_iterator_get_name(iter, name, sizeof(name)) > 0)
+            ok = append_word(words, name);
+    }
+    /* NOLINTNEXTLINE(clang-analyzer-deadcode.DeadStores) */
+    iter = xkb_keysym_iterator_unref(iter);
+    return ok;
+}
+
+static void
+bench_words(const char *label, const word_list *words, unsigned int lookups)
+{
+    struct bench bench;
+    char * const *worditer;
 
     bench_start(&bench);
     for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
-        table = atom_table_new();
+        struct atom_table * const table = atom_table_new();
         assert(table);
 
-        darray_foreach(worditer, words) {
-            atom = atom_intern(table, *worditer, strlen(*worditer) - 1, true);
-            assert(atom != XKB_ATOM_NONE);
+        for (unsigned int l = 0; l <= lookups; l++) {
+            darray_foreach(worditer, *words) {
+                const xkb_atom_t atom =
+                    atom_intern(table, *worditer, strlen(*worditer), true);
+                assert(atom != XKB_ATOM_NONE);
 
-            text = atom_text(table, atom);
-            assert(text != NULL);
+                const char * const text = atom_text(table, atom);
+                assert(text != NULL);
+                (void) text;
+            }
         }
 
         atom_table_free(table);
     }
     bench_stop(&bench);
 
-    elapsed = bench_elapsed_str(&bench);
-    fprintf(stderr, "%d iterations in %ss\n",
-            BENCHMARK_ITERATIONS, elapsed);
+    char * const elapsed = bench_elapsed_str(&bench);
+    fprintf(stderr, "%s: %d iterations of %u words (%u lookups) in %ss\n",
+            label, BENCHMARK_ITERATIONS, darray_size(*words), lookups,
+            elapsed);
     free(elapsed);
+}
 
-out:
-    darray_foreach(worditer, words) {
-        free(*worditer);
+int
+main(void)
+{
+    int ret = EXIT_SUCCESS;
+    word_list words = darray_new();
+
+    if (load_dictionary(&words))
+        bench_words("dictionary", &words, 0);
+    free_words(&words);
+
+    if (load_keymap_vocabulary(&words)) {
+        bench_words("keymap vocabulary", &words, VOCABULARY_LOOKUPS);
+    } else {
+        ret = EXIT_FAILURE;
     }
-    darray_free(words);
+    free_words(&words);
 
     return ret;
 }
@@ -13,6 +13,9 @@
 
 #include "utils.h"
 #include "keymap-formats.h"
+#ifdef KEYMAP_DUMP
+#include "xkbcomp/xkbcomp-priv.h"
+#endif
 
 #include "bench.h"
 
@@ -51,6 +54,12 @@ usage(FILE *fp, char **argv)
            "    Force serializing explicit values\n"
            " --keymap\n"
            "    Load the corresponding XKB file, ignore RMLVO options.\n"
+#ifndef KEYMAP_DUMP
+           " --from-rmlvo\n"
+           "    Benchmark the compilation from RMLVO, i.e. including the\n"
+           "    resolution and merging of the KcCGST files, instead of the\n"
+           "    parsing of the resulting keymap.\n"
+#endif
            " --rules <rules>\n"
            "    The XKB ruleset (default: '%s')\n"
            " --model <model>\n"
@@ -106,6 +115,9 @@ main(int argc, char **argv)
 #endif
     enum xkb_keymap_serialize_flags serialize_flags = XKB_KEYMAP_SERIALIZE_NO_FLAGS;
     bool explicit_iterations = false;
+#ifndef KEYMAP_DUMP
+    bool from_rmlvo = false;
+#endif
     int ret = 0;
     char *keymap_path = NULL;
     struct xkb_rule_names rmlvo = {
@@ -127,6 +139,7 @@ main(int argc, char **argv)
         OPT_KEYMAP_KEEP_UNUSED,
         OPT_KEYMAP_EXPLICIT_VALUES,
         OPT_KEYMAP,
+        OPT_FROM_RMLVO,
         OPT_RULES,
         OPT_MODEL,
         OPT_LAYOUT,
@@ -146,6 +159,9 @@ main(int argc, char **argv)
         {"keep-unused",      no_argument,            0, OPT_KEYMAP_KEEP_UNUSED},
         {"explicit-values",  no_argument,            0, OPT_KEYMAP_EXPLICIT_VALUES},
         {"keymap",           required_argument,      0, OPT_KEYMAP},
+#ifndef KEYMAP_DUMP
+        {"from-rmlvo",       no_argument,            0, OPT_FROM_RMLVO},
+#endif
         {"rules",            required_argument,      0, OPT_RULES},
         {"model",            required_argument,      0, OPT_MODEL},
         {"layout",           required_argument,      0, OPT_LAYOUT},
@@ -197,6 +213,11 @@ main(int argc, char **argv)
         case OPT_KEYMAP:
             keymap_path = optarg;
             break;
+#ifndef KEYMAP_DUMP
+        case OPT_FROM_RMLVO:
+            from_rmlvo = true;
+            break;
+#endif
         case OPT_RULES:
             rmlvo.rules = optarg;
             break;
@@ -252,6 +273,14 @@ main(int argc, char **argv)
         rmlvo.variant = DEFAULT_XKB_VARIANT;
     }
 
+#ifndef KEYMAP_DUMP
+    if (from_rmlvo && keymap_path) {
+        fprintf(stderr, "ERROR: --from-rmlvo and --keymap are exclusive\n");
+        usage(stderr, argv);
+        exit(EXIT_INVALID_USAGE);
+    }
+#endif
+
     context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
     if (!context)
         exit(1);
@@ -284,7 +313,7 @@ main(int argc, char **argv)
             ret = EXIT_FAILURE;
             goto keymap_error;
         }
-    } else {
+    } else if (!from_rmlvo) {
         /*
          * Serialize from RMLVO
          *
@@ -304,6 +333,25 @@ main(int argc, char **argv)
     xkb_keymap_unref(keymap);
 #endif
 
+#ifdef KEYMAP_DUMP
+    /*
+     * Call the serializer directly: xkb_keymap_get_as_string2() memoizes its
+     * result, so it would only measure a copy.
+     */
+    if (keymap_output_format == XKB_KEYMAP_USE_ORIGINAL_FORMAT)
+        keymap_output_format = keymap_input_format;
+    char *dump = text_v1_keymap_get_as_string(keymap, keymap_output_format,
+                                              serialize_flags);
+    if (!dump) {
+        fprintf(stderr, "ERROR: Cannot serialize keymap.\n");
+        xkb_keymap_unref(keymap);
+        ret = EXIT_FAILURE;
+        goto keymap_error;
+    }
+    const size_t dump_size = strlen(dump);
+    free(dump);
+#endif
+
     /* Suspend stdout and stderr outputs */
     fflush(stdout);
     int stdout_old = dup(STDOUT_FILENO);
@@ -329,15 +377,19 @@ main(int argc, char **argv)
         bench_start2(&bench);
         for (unsigned int i = 0; i < max_iterations; i++) {
 #ifdef KEYMAP_DUMP
-            char *s = xkb_keymap_get_as_string2(keymap, keymap_output_format,
-                                                serialize_flags);
+            char *s = text_v1_keymap_get_as_string(keymap, keymap_output_format,
+                                                   serialize_flags);
             assert(s);
             free(s);
 #else
-            keymap = xkb_keymap_new_from_buffer(
-                context, keymap_str, keymap_str_length,
-                keymap_input_format, XKB_KEYMAP_COMPILE_NO_FLAGS
-            );
+            keymap = (from_rmlvo)
+                ? xkb_keymap_new_from_names2(context, &rmlvo,
+                                             keymap_input_format,
+                                             XKB_KEYMAP_COMPILE_NO_FLAGS)
+                : xkb_keymap_new_from_buffer(
+                    context, keymap_str, keymap_str_length,
+                    keymap_input_format, XKB_KEYMAP_COMPILE_NO_FLAGS
+                );
             assert(keymap);
             xkb_keymap_unref(keymap);
 #endif
@@ -351,17 +403,21 @@ main(int argc, char **argv)
         bench_start2(&bench);
 #ifdef KEYMAP_DUMP
         BENCH(stdev, max_iterations, elapsed, est,
-            char *s = xkb_keymap_get_as_string2(keymap, keymap_output_format,
-                                                serialize_flags);
+            char *s = text_v1_keymap_get_as_string(keymap, keymap_output_format,
+                                                   serialize_flags);
             assert(s);
             free(s);
         );
 #else
         BENCH(stdev, max_iterations, elapsed, est,
-            keymap = xkb_keymap_new_from_buffer(
-                context, keymap_str, keymap_str_length,
-                keymap_input_format, XKB_KEYMAP_COMPILE_NO_FLAGS
-            );
+            keymap = (from_rmlvo)
+                ? xkb_keymap_new_from_names2(context, &rmlvo,
+                                             keymap_input_format,
+                                             XKB_KEYMAP_COMPILE_NO_FLAGS)
+                : xkb_keymap_new_from_buffer(
+                    context, keymap_str, keymap_str_length,
+                    keymap_input_format, XKB_KEYMAP_COMPILE_NO_FLAGS
+                );
             assert(keymap);
             xkb_keymap_unref(keymap);
         );
@@ -406,6 +462,13 @@ main(int argc, char **argv)
                 total_elapsed.seconds, total_elapsed.nanoseconds / 1000);
     }
 
+#ifdef KEYMAP_DUMP
+    /* Throughput of the serialization, in bytes per second */
+    fprintf(stderr, "throughput: %.1f MiB/s (%zu bytes per keymap)\n",
+            (double) dump_size * 1e9 / (double) est.elapsed / (1024 * 1024),
+            dump_size);
+#endif
+
 keymap_error:
     xkb_context_unref(context);
     return ret;
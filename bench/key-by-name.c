@@ -0,0 +1,81 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "test/test.h"
+#include "bench.h"
+#include "keymap.h"
+#include "utils.h"
+
+#define BENCHMARK_ITERATIONS 20000
+
+/* Key names and aliases, as resolved e.g. by remote desktop backends */
+static const char *names[] = {
+    "ESC", "AE01", "AE02", "AE03", "TAB", "AD01", "AD02", "AD03", "CAPS",
+    "AC01", "AC02", "AC03", "LFSH", "AB01", "AB02", "AB03", "SPCE", "RTRN",
+    "BKSP", "LEFT", "RGHT", "UP", "DOWN", "FK01", "FK12", "KP1", "KPEN",
+    /* Aliases */
+    "MENU", "LatQ", "LatA", "LatZ", "ALGR", "LMTA", "KPPT", "I255",
+    /* Unknown */
+    "XXXX",
+};
+
+static void
+bench_lookup(struct xkb_keymap *keymap, const char *label)
+{
+    struct bench bench;
+    struct bench_time elapsed;
+    volatile unsigned long acc = 0;
+
+    bench_start2(&bench);
+    for (unsigned int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        for (size_t k = 0; k < ARRAY_SIZE(names); k++)
+            acc += xkb_keymap_key_by_name(keymap, names[k]);
+    }
+    bench_stop2(&bench);
+
+    bench_elapsed(&bench, &elapsed);
+    const long long lookups = (long long) BENCHMARK_ITERATIONS
+                            * ARRAY_SIZE(names);
+    char * const elapsed_str = bench_elapsed_str(&bench);
+    fprintf(stderr, "%s: average=%lldns per lookup; %lld lookups in %ss\n",
+            label, bench_time_elapsed_nanoseconds(&elapsed) / lookups,
+            lookups, elapsed_str);
+    free(elapsed_str);
+}
+
+int
+main(void)
+{
+    struct xkb_context *ctx = test_get_context(CONTEXT_NO_FLAG);
+    assert(ctx);
+
+    struct xkb_keymap *keymap =
+        test_compile_rules(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev",
+                           "pc104", "us", NULL, NULL);
+    assert(keymap);
+    assert(keymap->key_name_index);
+
+    /* Disable the index temporarily, to get the linear search */
+    struct key_name_entry * const index = keymap->key_name_index;
+    xkb_keycode_t expected[ARRAY_SIZE(names)];
+    keymap->key_name_index = NULL;
+    for (size_t k = 0; k < ARRAY_SIZE(names); k++)
+        expected[k] = xkb_keymap_key_by_name(keymap, names[k]);
+    bench_lookup(keymap, "linear");
+    keymap->key_name_index = index;
+
+    for (size_t k = 0; k < ARRAY_SIZE(names); k++)
+        assert(xkb_keymap_key_by_name(keymap, names[k]) == expected[k]);
+    bench_lookup(keymap, "index");
+
+    xkb_keymap_unref(keymap);
+    xkb_context_unref(ctx);
+    return EXIT_SUCCESS;
+}
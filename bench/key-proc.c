@@ -5,6 +5,8 @@
 
 #include "config.h"
 
+#include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
@@ -12,6 +14,7 @@
 #include "test/test.h"
 #include "tools/tools-common.h"
 #include "bench.h"
+#include "darray.h"
 #include "utils.h"
 
 #define BENCHMARK_ITERATIONS 3000000
@@ -75,6 +78,165 @@ bench_modern_api(struct xkb_machine *sm,
     }
 }
 
+/*
+ * Resolve the level of every key for random modifiers and layouts, in order
+ * to exercise the key types with several modifiers, e.g. the ones of Neo.
+ */
+#define BENCHMARK_LEVEL_ITERATIONS (BENCHMARK_ITERATIONS / 100)
+
+NOINLINE static unsigned long
+bench_level_resolution(struct xkb_state *state)
+{
+    struct xkb_keymap * const keymap = xkb_state_get_keymap(state);
+    const xkb_keycode_t min = xkb_keymap_min_keycode(keymap);
+    const xkb_keycode_t max = xkb_keymap_max_keycode(keymap);
+    const xkb_layout_index_t num_layouts = xkb_keymap_num_layouts(keymap);
+    volatile unsigned long acc_level = 0;
+    unsigned long lookups = 0;
+
+    for (size_t i = 0; i < BENCHMARK_LEVEL_ITERATIONS; i++) {
+        /* Any combination of the real modifiers */
+        const xkb_mod_mask_t mods = (xkb_mod_mask_t) rand() & 0xff;
+        const xkb_layout_index_t layout =
+            (xkb_layout_index_t) rand() % num_layouts;
+        xkb_state_update_mask(state, mods, 0, 0, 0, 0, layout);
+
+        for (xkb_keycode_t kc = min; kc <= max; kc++) {
+            const xkb_layout_index_t key_layout =
+                xkb_state_key_get_layout(state, kc);
+            if (key_layout == XKB_LAYOUT_INVALID)
+                continue;
+            acc_level += xkb_state_key_get_level(state, kc, key_layout);
+            lookups++;
+        }
+    }
+
+    return lookups;
+}
+
+static void
+report_level_resolution(struct xkb_keymap *keymap, const char *label)
+{
+    struct xkb_state * const state = xkb_state_new(keymap);
+    assert(state);
+
+    struct bench bench;
+    bench_start2(&bench);
+    const unsigned long lookups = bench_level_resolution(state);
+    bench_stop2(&bench);
+
+    xkb_state_unref(state);
+
+    struct bench_time elapsed;
+    bench_elapsed(&bench, &elapsed);
+    char * const elapsed_str = bench_elapsed_str(&bench);
+    fprintf(stdout, "Level resolution (%s): average=%lldns per key, "
+            "%lu keys in %ss\n", label,
+            (long long) bench_time_elapsed_nanoseconds(&elapsed) /
+            (long long) lookups, lookups, elapsed_str);
+    free(elapsed_str);
+}
+
+/*
+ * Keymap whose keys all use a type with the 8 real modifiers and an entry for
+ * most of their combinations, so that scanning the entries is costly.
+ */
+#define MANY_ENTRIES_TYPE_ENTRIES 200
+
+static struct xkb_keymap *
+new_many_entries_keymap(struct xkb_context *ctx)
+{
+    static const char * const mods[] = {
+        "Shift", "Lock", "Control", "Mod1", "Mod2", "Mod3", "Mod4", "Mod5"
+    };
+    darray_char text = darray_new();
+    char buf[128];
+
+    darray_append_lit(text, "xkb_keymap {\n  xkb_keycodes {\n");
+    for (xkb_keycode_t kc = 9; kc < 256; kc++) {
+        snprintf(buf, sizeof(buf), "    <K%03"PRIu32"> = %"PRIu32";\n",
+                 kc, kc);
+        darray_append_string(text, buf);
+    }
+    darray_append_lit(text,
+        "  };\n"
+        "  xkb_types {\n"
+        "    type \"MANY_ENTRIES\" {\n"
+        "      modifiers = Shift+Lock+Control+Mod1+Mod2+Mod3+Mod4+Mod5;\n");
+    for (xkb_mod_mask_t mask = 1; mask <= MANY_ENTRIES_TYPE_ENTRIES; mask++) {
+        darray_append_lit(text, "      map[");
+        const char *sep = "";
+        for (size_t m = 0; m < ARRAY_SIZE(mods); m++) {
+            if (mask & (UINT32_C(1) << m)) {
+                darray_append_string(text, sep);
+                darray_append_string(text, mods[m]);
+                sep = "+";
+            }
+        }
+        snprintf(buf, sizeof(buf), "] = Level%"PRIu32";\n", mask % 8 + 1);
+        darray_append_string(text, buf);
+    }
+    darray_append_lit(text,
+        "    };\n"
+        "  };\n"
+        "  xkb_compat {};\n"
+        "  xkb_symbols {\n");
+    for (xkb_keycode_t kc = 9; kc < 256; kc++) {
+        snprintf(buf, sizeof(buf),
+                 "    key <K%03"PRIu32"> { type = \"MANY_ENTRIES\", "
+                 "[a, b, c, d, e, f, g, h] };\n", kc);
+        darray_append_string(text, buf);
+    }
+    darray_append_lit(text, "  };\n};\n");
+
+    struct xkb_keymap * const keymap =
+        xkb_keymap_new_from_buffer(ctx, text.item, text.size,
+                                   XKB_KEYMAP_FORMAT_TEXT_V1,
+                                   XKB_KEYMAP_COMPILE_NO_FLAGS);
+    darray_free(text);
+    return keymap;
+}
+
+#define BENCHMARK_BATCH_SIZE 32
+
+NOINLINE static void
+bench_modern_api_batched(struct xkb_machine *sm,
+                         struct xkb_events *events,
+                         struct xkb_state *state)
+{
+    bool keys[256] = { 0 };
+    struct xkb_key_input inputs[BENCHMARK_BATCH_SIZE];
+    volatile unsigned long acc_ret = 0;
+    volatile unsigned long acc_changed = 0;
+    volatile unsigned long acc_keysym  = 0;
+    const struct xkb_event *event;
+
+    static_assert(BENCHMARK_ITERATIONS % BENCHMARK_BATCH_SIZE == 0, "");
+    for (size_t i = 0; i < BENCHMARK_ITERATIONS; i += BENCHMARK_BATCH_SIZE) {
+        for (size_t k = 0; k < BENCHMARK_BATCH_SIZE; k++) {
+            const xkb_keycode_t keycode = (rand() % (255 - 9)) + 9;
+            inputs[k].keycode = keycode;
+            inputs[k].direction = (keys[keycode]) ? XKB_KEY_UP : XKB_KEY_DOWN;
+            keys[keycode] = !keys[keycode];
+        }
+        const int ret = xkb_machine_process_keys(sm, BENCHMARK_BATCH_SIZE,
+                                                 inputs, events, NULL);
+        acc_ret += (unsigned long)ret;
+
+        enum xkb_state_component changed = 0;
+        while ((event = xkb_events_next(events))) {
+            changed |= xkb_state_update_event(state, event);
+            if (xkb_event_get_type(event) == XKB_EVENT_TYPE_KEY_UP) {
+                const xkb_keysym_t keysym = xkb_state_key_get_one_sym(
+                    state, xkb_event_get_keycode(event)
+                );
+                acc_keysym += (unsigned long)keysym;
+            }
+        }
+        acc_changed += (unsigned long)changed;
+    }
+}
+
 int
 main(void)
 {
@@ -162,7 +324,48 @@ main(void)
             average, BENCHMARK_ITERATIONS, elapsed_str);
     free(elapsed_str);
 
+    /*
+     * Full server state machine API, batched
+     */
+
+    builder = xkb_machine_builder_new(keymap, XKB_MACHINE_BUILDER_NO_FLAGS);
+    assert(builder);
+    sm = xkb_machine_new(builder);
+    assert(sm);
+    xkb_machine_builder_destroy(builder);
+    events = xkb_events_new_batch(ctx, XKB_EVENTS_NO_FLAGS);
+    assert(events);
+    state = xkb_state_new(keymap);
+    assert(state);
+
+    bench_start2(&bench);
+    bench_modern_api_batched(sm, events, state);
+    bench_stop2(&bench);
+
+    xkb_state_unref(state);
+    xkb_events_destroy(events);
+    xkb_machine_unref(sm);
+
+    bench_elapsed(&bench, &elapsed);
+    average = (bench_time_elapsed_nanoseconds(&elapsed)) / BENCHMARK_ITERATIONS;
+    elapsed_str = bench_elapsed_str(&bench);
+    fprintf(stdout, "Modern server API (batches of %d): average=%ldns, "
+            "%d iterations in %ss\n", BENCHMARK_BATCH_SIZE,
+            average, BENCHMARK_ITERATIONS, elapsed_str);
+    free(elapsed_str);
+
+    /*
+     * Level resolution
+     */
+
+    report_level_resolution(keymap, "keymap");
     xkb_keymap_unref(keymap);
+
+    keymap = new_many_entries_keymap(ctx);
+    assert(keymap);
+    report_level_resolution(keymap, "type with many entries");
+    xkb_keymap_unref(keymap);
+
     xkb_context_unref(ctx);
 
     return EXIT_SUCCESS;
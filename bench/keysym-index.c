@@ -0,0 +1,149 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "test/test.h"
+#include "bench.h"
+#include "utils.h"
+
+#define BENCHMARK_ITERATIONS 20000
+
+/* Text to type: ASCII and some Cyrillic, to use both layouts */
+static const uint32_t text[] = {
+    'T', 'h', 'e', ' ', 'q', 'u', 'i', 'c', 'k', ' ', 'b', 'r', 'o', 'w', 'n',
+    ' ', 'f', 'o', 'x', ' ', 'j', 'u', 'm', 'p', 's', ' ', 'o', 'v', 'e', 'r',
+    ' ', 't', 'h', 'e', ' ', 'l', 'a', 'z', 'y', ' ', 'd', 'o', 'g', '!', '?',
+    '1', '2', '3', '(', ')', '{', '}', '@', '#', '$', '%', '^', '&', '*', '~',
+    0x0421, 0x044A, 0x0435, 0x0448, 0x044C, ' ', 0x0436, 0x0435, 0x0020,
+    0x0435, 0x0449, 0x0451, 0x044F, ',', '.', ';', ':', '"', '\'', '/', '\\',
+};
+
+/**
+ * Find the first position of a code point, by scanning the keymap.
+ * Positions are ordered by layout, then level, then keycode, as in the index.
+ */
+NOINLINE static bool
+lookup_scan(struct xkb_keymap *keymap, uint32_t cp, xkb_keycode_t *kc_out,
+            xkb_mod_mask_t *mask_out)
+{
+    bool found = false;
+    xkb_layout_index_t best_layout = XKB_LAYOUT_INVALID;
+    xkb_level_index_t best_level = XKB_LEVEL_INVALID;
+    const xkb_keycode_t min_keycode = xkb_keymap_min_keycode(keymap);
+    const xkb_keycode_t max_keycode = xkb_keymap_max_keycode(keymap);
+    for (xkb_keycode_t kc = min_keycode; kc <= max_keycode; kc++) {
+        const xkb_layout_index_t num_layouts =
+            xkb_keymap_num_layouts_for_key(keymap, kc);
+        for (xkb_layout_index_t layout = 0; layout < num_layouts; layout++) {
+            const xkb_level_index_t num_levels =
+                xkb_keymap_num_levels_for_key(keymap, kc, layout);
+            for (xkb_level_index_t level = 0; level < num_levels; level++) {
+                if (found && (layout > best_layout ||
+                              (layout == best_layout && level >= best_level)))
+                    break;
+                const xkb_keysym_t *syms;
+                if (xkb_keymap_key_get_syms_by_level(keymap, kc, layout, level,
+                                                     &syms) != 1 ||
+                    xkb_keysym_to_utf32(syms[0]) != cp)
+                    continue;
+                xkb_mod_mask_t masks[16];
+                const size_t num_masks = xkb_keymap_key_get_mods_for_level(
+                    keymap, kc, layout, level, masks, ARRAY_SIZE(masks)
+                );
+                if (!num_masks)
+                    continue;
+                xkb_mod_mask_t mask = masks[0];
+                for (size_t m = 1; m < num_masks; m++)
+                    mask = MIN(mask, masks[m]);
+                found = true;
+                best_layout = layout;
+                best_level = level;
+                *kc_out = kc;
+                *mask_out = mask;
+            }
+        }
+    }
+    return found;
+}
+
+/** Find the first position of a code point, using the keysym index */
+NOINLINE static bool
+lookup_index(struct xkb_keymap *keymap, uint32_t cp, xkb_keycode_t *kc_out,
+             xkb_mod_mask_t *mask_out)
+{
+    struct xkb_keymap_keysym_iterator * const iter =
+        xkb_keymap_keysym_iterator_new_from_utf32(keymap, cp);
+    xkb_layout_index_t layout;
+    xkb_level_index_t level;
+    const bool found = xkb_keymap_keysym_iterator_next(iter, kc_out, &layout,
+                                                       &level, mask_out);
+    xkb_keymap_keysym_iterator_destroy(iter);
+    return found;
+}
+
+typedef bool (*lookup_func)(struct xkb_keymap *keymap, uint32_t cp,
+                            xkb_keycode_t *kc_out, xkb_mod_mask_t *mask_out);
+
+static void
+bench_lookup(struct xkb_keymap *keymap, const char *name, lookup_func lookup,
+             unsigned int iterations)
+{
+    struct bench bench;
+    struct bench_time elapsed;
+    volatile unsigned long acc = 0;
+
+    bench_start2(&bench);
+    for (unsigned int i = 0; i < iterations; i++) {
+        for (size_t c = 0; c < ARRAY_SIZE(text); c++) {
+            xkb_keycode_t kc = XKB_KEYCODE_INVALID;
+            xkb_mod_mask_t mask = 0;
+            if (lookup(keymap, text[c], &kc, &mask))
+                acc += kc + mask;
+        }
+    }
+    bench_stop2(&bench);
+
+    bench_elapsed(&bench, &elapsed);
+    const long long lookups = (long long) iterations * ARRAY_SIZE(text);
+    char * const elapsed_str = bench_elapsed_str(&bench);
+    fprintf(stderr, "%s: average=%lldns per lookup; %lld lookups in %ss\n",
+            name, bench_time_elapsed_nanoseconds(&elapsed) / lookups, lookups,
+            elapsed_str);
+    free(elapsed_str);
+}
+
+int
+main(void)
+{
+    struct xkb_context *ctx = test_get_context(CONTEXT_NO_FLAG);
+    assert(ctx);
+
+    struct xkb_keymap *keymap =
+        test_compile_rules(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev",
+                           "pc104", "us,ru", NULL, NULL);
+    assert(keymap);
+
+    xkb_enable_quiet_logging(ctx);
+
+    /* Both lookups must agree */
+    for (size_t c = 0; c < ARRAY_SIZE(text); c++) {
+        xkb_keycode_t kc1 = XKB_KEYCODE_INVALID, kc2 = XKB_KEYCODE_INVALID;
+        xkb_mod_mask_t mask1 = 0, mask2 = 0;
+        const bool found1 = lookup_scan(keymap, text[c], &kc1, &mask1);
+        const bool found2 = lookup_index(keymap, text[c], &kc2, &mask2);
+        assert(found1 == found2 && kc1 == kc2 && mask1 == mask2);
+    }
+
+    bench_lookup(keymap, "scan", lookup_scan, BENCHMARK_ITERATIONS / 100);
+    bench_lookup(keymap, "index", lookup_index, BENCHMARK_ITERATIONS);
+
+    xkb_keymap_unref(keymap);
+    xkb_context_unref(ctx);
+    return EXIT_SUCCESS;
+}
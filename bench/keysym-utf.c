@@ -0,0 +1,202 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "test/test.h"
+#include "bench.h"
+#include "darray.h"
+#include "keysym.h"
+#include "utf8.h"
+#include "utf8-decoding.h"
+#include "utils.h"
+
+#define BENCHMARK_ITERATIONS 2000
+
+/* Unicode blocks of various scripts, for the synthetic corpus */
+static const struct { uint32_t first; uint32_t last; } blocks[] = {
+    { 0x0020, 0x007e }, /* Basic Latin */
+    { 0x00a0, 0x017f }, /* Latin-1 Supplement, Latin Extended-A */
+    { 0x0370, 0x03ff }, /* Greek */
+    { 0x0400, 0x04ff }, /* Cyrillic */
+    { 0x05d0, 0x05ea }, /* Hebrew */
+    { 0x0600, 0x06ff }, /* Arabic */
+    { 0x0e01, 0x0e5b }, /* Thai */
+    { 0x1e00, 0x1eff }, /* Latin Extended Additional (Vietnamese) */
+    { 0x2000, 0x22ff }, /* Punctuation, symbols, mathematical operators */
+    { 0x30a0, 0x30ff }, /* Katakana */
+    { 0x3131, 0x318e }, /* Hangul Compatibility Jamo */
+    { 0x4e00, 0x4fff }, /* CJK Unified Ideographs (part) */
+    { 0x1f600, 0x1f64f }, /* Emoticons */
+};
+
+static char *
+synthetic_corpus(size_t *length)
+{
+    darray_char text = darray_new();
+    char buffer[XKB_KEYSYM_UTF8_MAX_SIZE];
+    for (size_t b = 0; b < ARRAY_SIZE(blocks); b++) {
+        for (uint32_t cp = blocks[b].first; cp <= blocks[b].last; cp++) {
+            const int count = utf32_to_utf8(cp, buffer);
+            assert(count > 1);
+            darray_append_items(text, buffer, (darray_size_t) count - 1);
+        }
+    }
+    *length = darray_size(text);
+    darray_append(text, '\0');
+    char *ret;
+    darray_steal(text, &ret, NULL);
+    return ret;
+}
+
+#define CHUNK_SIZE 4096
+
+static void
+print_result(const char *corpus, const char *name, const struct bench *bench,
+             long long count)
+{
+    struct bench_time elapsed;
+    bench_elapsed(bench, &elapsed);
+    char * const elapsed_str = bench_elapsed_str(bench);
+    fprintf(stderr,
+            "%s: %s: average=%lldns per character; "
+            "%lld characters in %ss\n",
+            corpus, name, bench_time_elapsed_nanoseconds(&elapsed) / count,
+            count, elapsed_str);
+    free(elapsed_str);
+}
+
+/* Convert the corpus to keysyms, skipping invalid UTF-8 sequences */
+static xkb_keysym_t *
+corpus_to_keysyms(const char *text, size_t length, size_t *count_out)
+{
+    xkb_keysym_t * const keysyms = calloc(length, sizeof(*keysyms));
+    assert(keysyms);
+    size_t count = 0;
+    size_t k = 0;
+    while (k < length) {
+        size_t offset = 0;
+        count += xkb_utf8_to_keysyms(&text[k], length - k, &keysyms[count],
+                                     length - count, &offset);
+        /* Skip invalid byte */
+        k += offset + 1;
+    }
+    *count_out = count;
+    return keysyms;
+}
+
+static void
+bench_corpus(const char *corpus, const char *text, size_t length,
+             unsigned int iterations)
+{
+    struct bench bench;
+    volatile unsigned long acc = 0;
+    long long count = 0;
+
+    /* UTF-8 to keysyms: one code point at a time */
+    bench_start2(&bench);
+    for (unsigned int i = 0; i < iterations; i++) {
+        size_t k = 0;
+        while (k < length) {
+            size_t size = 0;
+            const uint32_t cp = utf8_next_code_point(&text[k], length - k,
+                                                     &size);
+            if (cp == INVALID_UTF8_CODE_POINT || size == 0) {
+                /* Skip invalid byte */
+                k++;
+                continue;
+            }
+            acc += xkb_utf8_to_keysym(&text[k], size);
+            k += size;
+            count++;
+        }
+    }
+    bench_stop2(&bench);
+    print_result(corpus, "xkb_utf8_to_keysym", &bench, count);
+
+    /* UTF-8 to keysyms: batch */
+    xkb_keysym_t keysyms[CHUNK_SIZE];
+    count = 0;
+    bench_start2(&bench);
+    for (unsigned int i = 0; i < iterations; i++) {
+        size_t k = 0;
+        while (k < length) {
+            size_t offset = 0;
+            const size_t n = xkb_utf8_to_keysyms(&text[k], length - k, keysyms,
+                                                 ARRAY_SIZE(keysyms), &offset);
+            acc += keysyms[0];
+            count += (long long) n;
+            k += offset;
+            if (n < ARRAY_SIZE(keysyms) && k < length) {
+                /* Skip invalid byte */
+                k++;
+            }
+        }
+    }
+    bench_stop2(&bench);
+    print_result(corpus, "xkb_utf8_to_keysyms", &bench, count);
+
+    size_t keysyms_count = 0;
+    xkb_keysym_t * const all_keysyms =
+        corpus_to_keysyms(text, length, &keysyms_count);
+
+    /* Keysyms to UTF-8: one keysym at a time */
+    char buffer[4 * CHUNK_SIZE + 1];
+    count = 0;
+    bench_start2(&bench);
+    for (unsigned int i = 0; i < iterations; i++) {
+        for (size_t k = 0; k < keysyms_count; k++) {
+            acc += (unsigned long)
+                xkb_keysym_to_utf8(all_keysyms[k], buffer, sizeof(buffer));
+        }
+        count += (long long) keysyms_count;
+    }
+    bench_stop2(&bench);
+    print_result(corpus, "xkb_keysym_to_utf8", &bench, count);
+
+    /* Keysyms to UTF-8: batch */
+    count = 0;
+    bench_start2(&bench);
+    for (unsigned int i = 0; i < iterations; i++) {
+        size_t k = 0;
+        while (k < keysyms_count) {
+            size_t index = 0;
+            acc += xkb_keysyms_to_utf8(&all_keysyms[k],
+                                       MIN(keysyms_count - k, CHUNK_SIZE),
+                                       buffer, sizeof(buffer), &index);
+            /* Skip keysyms without Unicode representation (none here) */
+            k += MAX(index, (size_t) 1);
+        }
+        count += (long long) keysyms_count;
+    }
+    bench_stop2(&bench);
+    print_result(corpus, "xkb_keysyms_to_utf8", &bench, count);
+
+    free(all_keysyms);
+}
+
+int
+main(void)
+{
+    /* Real-world corpus: the Compose file has characters of many scripts */
+    char *compose = test_read_file("locale/en_US.UTF-8/Compose");
+    assert(compose);
+    bench_corpus("Compose", compose, strlen(compose),
+                 BENCHMARK_ITERATIONS / 100);
+    free(compose);
+
+    size_t length = 0;
+    char *synthetic = synthetic_corpus(&length);
+    assert(synthetic);
+    bench_corpus("Unicode blocks", synthetic, length, BENCHMARK_ITERATIONS);
+    free(synthetic);
+
+    return EXIT_SUCCESS;
+}
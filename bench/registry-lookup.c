@@ -0,0 +1,152 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "xkbcommon/xkbregistry.h"
+#include "test/test.h"
+#include "bench.h"
+#include "utils.h"
+
+#define BENCHMARK_ITERATIONS 2000
+
+/* Layouts, as selected e.g. by an onboarding UI */
+static const struct {
+    const char *layout;
+    const char *variant;
+} layouts[] = {
+    {"us", NULL}, {"us", "intl"}, {"us", "dvorak"}, {"de", NULL},
+    {"de", "neo"}, {"fr", NULL}, {"fr", "bepo"}, {"ru", NULL},
+    {"ara", NULL}, {"ch", "fr"}, {"ca", "multix"}, {"cz", NULL},
+    /* Unknown */
+    {"xx", NULL},
+};
+
+/* Languages, as resolved e.g. from the locale */
+static const char *languages[] = { "eng", "fra", "deu", "rus", "ara", "xxx" };
+
+static struct rxkb_layout *
+scan_layout(struct rxkb_context *ctx, const char *name, const char *variant)
+{
+    for (struct rxkb_layout *l = rxkb_layout_first(ctx); l;
+         l = rxkb_layout_next(l)) {
+        if (streq(rxkb_layout_get_name(l), name) &&
+            streq_null(rxkb_layout_get_variant(l), variant))
+            return l;
+    }
+    return NULL;
+}
+
+static unsigned int
+scan_language(struct rxkb_context *ctx, const char *code)
+{
+    unsigned int count = 0;
+    for (struct rxkb_layout *l = rxkb_layout_first(ctx); l;
+         l = rxkb_layout_next(l)) {
+        for (struct rxkb_iso639_code *iso = rxkb_layout_get_iso639_first(l);
+             iso; iso = rxkb_iso639_code_next(iso)) {
+            if (streq(rxkb_iso639_code_get_code(iso), code)) {
+                count++;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+static unsigned int
+find_language(struct rxkb_context *ctx, const char *code)
+{
+    unsigned int count = 0;
+    for (struct rxkb_layout *l = rxkb_layout_first_by_iso639(ctx, code); l;
+         l = rxkb_layout_next_by_iso639(l, code))
+        count++;
+    return count;
+}
+
+static void
+report(struct bench *bench, const char *label, long long lookups)
+{
+    struct bench_time elapsed;
+    bench_elapsed(bench, &elapsed);
+    char * const elapsed_str = bench_elapsed_str(bench);
+    fprintf(stderr, "%s: average=%lldns per lookup; %lld lookups in %ss\n",
+            label, bench_time_elapsed_nanoseconds(&elapsed) / lookups,
+            lookups, elapsed_str);
+    free(elapsed_str);
+}
+
+int
+main(void)
+{
+    struct rxkb_context * const ctx =
+        rxkb_context_new(RXKB_CONTEXT_NO_DEFAULT_INCLUDES |
+                         RXKB_CONTEXT_LOAD_EXOTIC_RULES);
+    assert(ctx);
+    char * const include_path = test_get_path("");
+    assert(include_path);
+    assert(rxkb_context_include_path_append(ctx, include_path));
+    free(include_path);
+    assert(rxkb_context_parse(ctx, "evdev"));
+
+    for (size_t k = 0; k < ARRAY_SIZE(layouts); k++) {
+        assert(rxkb_layout_find(ctx, layouts[k].layout, layouts[k].variant) ==
+               scan_layout(ctx, layouts[k].layout, layouts[k].variant));
+    }
+    for (size_t k = 0; k < ARRAY_SIZE(languages); k++)
+        assert(find_language(ctx, languages[k]) ==
+               scan_language(ctx, languages[k]));
+
+    struct bench bench;
+    volatile uintptr_t acc = 0;
+    long long lookups = (long long) BENCHMARK_ITERATIONS * ARRAY_SIZE(layouts);
+
+    bench_start2(&bench);
+    for (unsigned int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        for (size_t k = 0; k < ARRAY_SIZE(layouts); k++) {
+            const struct rxkb_layout *const l =
+                scan_layout(ctx, layouts[k].layout, layouts[k].variant);
+            acc += (uintptr_t) l;
+        }
+    }
+    bench_stop2(&bench);
+    report(&bench, "layout: linear", lookups);
+
+    bench_start2(&bench);
+    for (unsigned int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        for (size_t k = 0; k < ARRAY_SIZE(layouts); k++) {
+            const struct rxkb_layout *const l =
+                rxkb_layout_find(ctx, layouts[k].layout, layouts[k].variant);
+            acc += (uintptr_t) l;
+        }
+    }
+    bench_stop2(&bench);
+    report(&bench, "layout: index", lookups);
+
+    lookups = (long long) BENCHMARK_ITERATIONS * ARRAY_SIZE(languages);
+
+    bench_start2(&bench);
+    for (unsigned int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        for (size_t k = 0; k < ARRAY_SIZE(languages); k++)
+            acc += scan_language(ctx, languages[k]);
+    }
+    bench_stop2(&bench);
+    report(&bench, "language: linear", lookups);
+
+    bench_start2(&bench);
+    for (unsigned int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        for (size_t k = 0; k < ARRAY_SIZE(languages); k++)
+            acc += find_language(ctx, languages[k]);
+    }
+    bench_stop2(&bench);
+    report(&bench, "language: index", lookups);
+
+    rxkb_context_unref(ctx);
+    return EXIT_SUCCESS;
+}
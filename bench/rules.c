@@ -16,6 +16,35 @@
 const unsigned int DEFAULT_ITERATIONS = 20000;
 const double       DEFAULT_STDEV = 0.05;
 
+static struct xkb_context *
+new_context(void)
+{
+    struct xkb_context * const context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    if (!context)
+        exit(EXIT_FAILURE);
+    xkb_enable_quiet_logging(context);
+    return context;
+}
+
+static void
+resolve(struct xkb_context *context, const struct xkb_rule_names *rmlvo,
+        bool cold)
+{
+    /* A new context has no parsed rules files */
+    struct xkb_context * const ctx = (cold) ? new_context() : context;
+    struct xkb_component_names kccgst;
+
+    assert(xkb_components_from_rules_names(ctx, rmlvo, &kccgst, NULL));
+    free(kccgst.keycodes);
+    free(kccgst.types);
+    free(kccgst.compatibility);
+    free(kccgst.symbols);
+    free(kccgst.geometry);
+
+    if (cold)
+        xkb_context_unref(ctx);
+}
+
 static void
 usage(char **argv)
 {
@@ -31,6 +60,10 @@ usage(char **argv)
            " --stdev\n"
            "    Minimal relative standard deviation (percentage) to reach.\n"
            "    (default: %f)\n"
+           " --cold\n"
+           "    Use a new context for each iteration, so that the rules files\n"
+           "    are parsed and indexed each time. By default the context is\n"
+           "    reused, so only the lookup of the parsed rules is measured.\n"
            "Note: --iter and --stdev are mutually exclusive.\n"
            "\n"
            "XKB-specific options:\n"
@@ -69,6 +102,7 @@ main(int argc, char *argv[])
     };
     unsigned int max_iterations = DEFAULT_ITERATIONS;
     double stdev = DEFAULT_STDEV;
+    bool cold = false;
 
     enum options {
         OPT_RULES,
@@ -78,6 +112,7 @@ main(int argc, char *argv[])
         OPT_OPTION,
         OPT_ITERATIONS,
         OPT_STDEV,
+        OPT_COLD,
     };
 
     static struct option opts[] = {
@@ -89,6 +124,7 @@ main(int argc, char *argv[])
         {"options",          required_argument,      0, OPT_OPTION},
         {"iter",             required_argument,      0, OPT_ITERATIONS},
         {"stdev",            required_argument,      0, OPT_STDEV},
+        {"cold",             no_argument,            0, OPT_COLD},
         {0, 0, 0, 0},
     };
 
@@ -142,6 +178,9 @@ main(int argc, char *argv[])
                 stdev = DEFAULT_STDEV;
             max_iterations = 0;
             break;
+        case OPT_COLD:
+            cold = true;
+            break;
         default:
             usage(argv);
             exit(EXIT_INVALID_USAGE);
@@ -158,25 +197,13 @@ main(int argc, char *argv[])
         rmlvo.variant = DEFAULT_XKB_VARIANT;
     }
 
-    struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-    if (!context)
-        exit(EXIT_FAILURE);
-
-    xkb_enable_quiet_logging(context);
+    struct xkb_context * const context = new_context();
 
     if (explicit_iterations) {
         stdev = 0;
         bench_start2(&bench);
-        for (unsigned int i = 0; i < max_iterations; i++) {
-            struct xkb_component_names kccgst;
-
-            assert(xkb_components_from_rules_names(context, &rmlvo, &kccgst, NULL));
-            free(kccgst.keycodes);
-            free(kccgst.types);
-            free(kccgst.compatibility);
-            free(kccgst.symbols);
-            free(kccgst.geometry);
-        }
+        for (unsigned int i = 0; i < max_iterations; i++)
+            resolve(context, &rmlvo, cold);
         bench_stop2(&bench);
 
         bench_elapsed(&bench, &elapsed);
@@ -185,14 +212,7 @@ main(int argc, char *argv[])
     } else {
         bench_start2(&bench);
         BENCH(stdev, max_iterations, elapsed, est,
-            struct xkb_component_names kccgst;
-
-            assert(xkb_components_from_rules_names(context, &rmlvo, &kccgst, NULL));
-            free(kccgst.keycodes);
-            free(kccgst.types);
-            free(kccgst.compatibility);
-            free(kccgst.symbols);
-            free(kccgst.geometry);
+            resolve(context, &rmlvo, cold);
         );
         bench_stop2(&bench);
     }
@@ -200,6 +200,11 @@ enum xkb_compose_format {
  * to `en_US.UTF-8`, if missing locale detection is supported by the C standard
  * library in use.
  *
+ * Since 1.14.0, if the `XKB_COMPOSE_CACHE_DIR` environment variable is set to
+ * a directory, the compiled table is stored in a binary cache file in this
+ * directory and subsequent calls load it directly, as long as the Compose file
+ * and its includes are unchanged.
+ *
  * @param context
  *     The library context in which to create the compose table.
  * @param locale
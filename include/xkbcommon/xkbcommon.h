@@ -868,6 +868,73 @@ xkb_keysym_to_utf32(xkb_keysym_t keysym);
 XKB_EXPORT xkb_keysym_t
 xkb_utf32_to_keysym(uint32_t codepoint);
 
+/**
+ * Convert a UTF-8 encoded string to keysyms.
+ *
+ * This is equivalent to calling `xkb_utf8_to_keysym()` for each codepoint
+ * of the string, but much faster for long strings.
+ *
+ * @param[in]  buffer      The UTF-8 string to convert. It does not need to
+ * be `NULL`-terminated.
+ * @param[in]  size        Size of @p buffer, in bytes.
+ * @param[out] keysyms     An array to write the keysyms into.
+ * @param[in]  max_keysyms Capacity of @p keysyms.
+ * @param[out] offset      If not `NULL`, set to the number of bytes of
+ * @p buffer that were converted.
+ *
+ * @returns The number of keysyms written to @p keysyms.
+ *
+ * The conversion stops at the first invalid UTF-8 sequence or codepoint
+ * without keysym (i.e. U+0000 NULL), or when @p keysyms is full.  Since a
+ * codepoint is encoded with at least one byte, an array of @p size keysyms
+ * is always large enough; in that case, the conversion succeeded if and only
+ * if @p offset is set to @p size, otherwise it points to the invalid
+ * sequence.
+ *
+ * @sa `xkb_utf8_to_keysym()`
+ * @sa `xkb_keysyms_to_utf8()`
+ * @since 1.14.0
+ */
+XKB_EXPORT size_t
+xkb_utf8_to_keysyms(const char *buffer, size_t size,
+                    xkb_keysym_t *keysyms, size_t max_keysyms,
+                    size_t *offset);
+
+/**
+ * Convert keysyms to a UTF-8 encoded string.
+ *
+ * This is equivalent to calling `xkb_keysym_to_utf8()` for each keysym and
+ * concatenating the results, but much faster for long strings.
+ *
+ * @param[in]  keysyms The keysyms to convert.
+ * @param[in]  count   Number of keysyms in @p keysyms.
+ * @param[out] buffer  A buffer to write the `NULL`-terminated UTF-8 string
+ * into.
+ * @param[in]  size    Capacity of @p buffer, in bytes.
+ * @param[out] index   If not `NULL`, set to the number of keysyms that were
+ * converted.
+ *
+ * @returns The number of bytes written to @p buffer, *excluding* the
+ * terminating `NULL` byte.  If @p size is 0, nothing is written.
+ *
+ * The conversion stops at the first keysym that does not have a Unicode
+ * representation, or when there is no room left in @p buffer for the next
+ * character and the terminating `NULL` byte.  Since a keysym is encoded with
+ * at most 4 bytes, a buffer of `4 * count + 1` bytes is always large enough;
+ * in that case, the conversion succeeded if and only if @p index is set to
+ * @p count, otherwise it is the index of the first keysym without a Unicode
+ * representation.
+ *
+ * This function does not perform any @ref keysym-transformations.
+ *
+ * @sa `xkb_keysym_to_utf8()`
+ * @sa `xkb_utf8_to_keysyms()`
+ * @since 1.14.0
+ */
+XKB_EXPORT size_t
+xkb_keysyms_to_utf8(const xkb_keysym_t *keysyms, size_t count,
+                    char *buffer, size_t size, size_t *index);
+
 /**
  * Convert a keysym to its *uppercase* form.
  *
@@ -1127,6 +1194,37 @@ xkb_context_num_include_paths(struct xkb_context *context);
 XKB_EXPORT const char *
 xkb_context_include_path_get(struct xkb_context *context, unsigned int index);
 
+/**
+ * Set the directory of the compiled keymap cache of the context.
+ *
+ * When set, keymaps created with `xkb_keymap_new_from_names2()` (and
+ * `xkb_keymap_new_from_names()`) are stored in a binary form in this
+ * directory, keyed by the resolved RMLVO names, the keymap format, the
+ * compilation flags and the include paths. Subsequent compilations of the
+ * same RMLVO load the keymap from the cache instead, as long as none of the
+ * files used to compile it has changed.
+ *
+ * The directory is created if missing, but not its parents. Cache files are
+ * not portable and should be considered disposable.
+ *
+ * The cache is disabled by default.
+ *
+ * @note Loading a keymap from the cache does not reproduce the log messages
+ * of its compilation.
+ *
+ * @param context The context in which to enable the cache.
+ * @param path    The path of the cache directory, or `NULL` to disable the
+ *                cache.
+ *
+ * @returns `true` on success, or `false` on error.
+ *
+ * @memberof xkb_context
+ * @since 1.14.0
+ */
+XKB_EXPORT bool
+xkb_context_set_keymap_cache_dir(struct xkb_context *context,
+                                 const char *path);
+
 /** @} */
 
 /**
@@ -1620,6 +1718,46 @@ xkb_keymap_get_as_string2(struct xkb_keymap *keymap,
                           enum xkb_keymap_format format,
                           enum xkb_keymap_serialize_flags flags);
 
+/**
+ * Get the compiled keymap as a read-only file.
+ *
+ * This is intended for Wayland compositors, which send the keymap to their
+ * clients as a file descriptor: see <code>[wl_keyboard::keymap]</code>.
+ *
+ * The file contains the same string as `xkb_keymap_get_as_string2()`,
+ * including its terminating `NULL` byte. It is created once per format and
+ * serialization flags and sealed, so that it cannot be modified or resized by
+ * any process it is shared with. Each call returns a new read-only file
+ * descriptor referring to the same file, with its own file offset starting
+ * at the beginning of the file.
+ *
+ * @note On platforms without `/proc/self/fd`, the descriptors are duplicates
+ * sharing a single file offset. Consumers should then use `mmap()` or
+ * `pread()` rather than `read()`, as Wayland clients usually do.
+ *
+ * @param[in]  keymap The keymap to get as a file.
+ * @param[in]  format The keymap format to use, see
+ * `xkb_keymap_get_as_string2()`.
+ * @param[in]  flags  Optional flags to control the serialization, or 0.
+ * @param[out] size   The size of the file, in bytes.
+ *
+ * @returns A file descriptor with the close-on-exec flag set, that should be
+ * closed by the caller, or -1 if unsuccessful or if sealed files are not
+ * supported on the platform.
+ *
+ * @since 1.14.0
+ *
+ * @sa `xkb_keymap_get_as_string2()`
+ * @memberof xkb_keymap
+ *
+ * [wl_keyboard::keymap]: https://wayland.freedesktop.org/docs/html/apa.html#protocol-spec-wl_keyboard-event-keymap
+ */
+XKB_EXPORT int
+xkb_keymap_get_as_fd(struct xkb_keymap *keymap,
+                     enum xkb_keymap_format format,
+                     enum xkb_keymap_serialize_flags flags,
+                     size_t *size);
+
 /** @} */
 
 /**
@@ -2068,6 +2206,124 @@ xkb_keymap_key_get_syms_by_level(struct xkb_keymap *keymap,
                                  xkb_level_index_t level,
                                  const xkb_keysym_t **syms_out);
 
+/**
+ * @struct xkb_keymap_keysym_iterator
+ * Iterator over the positions in a keymap that produce a given keysym.
+ *
+ * A *position* is a tuple (keycode, layout, level, modifier mask): pressing
+ * the key with the given keycode while the layout is active and the modifiers
+ * of the mask are set produces the shift level, which has the keysym.
+ *
+ * @sa `xkb_keymap_keysym_iterator_new()`
+ * @sa `xkb_keymap_keysym_iterator_new_from_utf32()`
+ * @sa `xkb_keymap_keysym_iterator_destroy()`
+ * @since 1.14.0
+ */
+struct xkb_keymap_keysym_iterator;
+
+/**
+ * Create a new iterator over the positions in a keymap that produce a keysym.
+ *
+ * This API is useful for inverse key transformation, e.g. to inject text with
+ * a virtual keyboard. It is equivalent to scanning all the keys, layouts and
+ * levels with `xkb_keymap_key_get_syms_by_level()` and then getting their
+ * modifiers with `xkb_keymap_key_get_mods_for_level()`, but it uses an index
+ * that is built by the first call on a keymap and then shared by all later
+ * calls.
+ *
+ * Only the levels with exactly one keysym are considered.
+ *
+ * Intended use:
+ *
+ * ```c
+ * struct xkb_keymap_keysym_iterator *iter =
+ *     xkb_keymap_keysym_iterator_new(keymap, XKB_KEY_a);
+ * xkb_keycode_t kc;
+ * xkb_layout_index_t layout;
+ * xkb_level_index_t level;
+ * xkb_mod_mask_t mask;
+ * while (xkb_keymap_keysym_iterator_next(iter, &kc, &layout, &level, &mask)) {
+ *     // ...
+ * }
+ * xkb_keymap_keysym_iterator_destroy(iter);
+ * ```
+ *
+ * @param[in] keymap The keymap to search.
+ * @param[in] keysym The keysym to search for.
+ *
+ * @returns A new iterator, or `NULL` on failure.
+ *
+ * @sa `xkb_keymap_keysym_iterator_next()`
+ * @sa `xkb_keymap_keysym_iterator_new_from_utf32()`
+ * @since 1.14.0
+ * @memberof xkb_keymap_keysym_iterator
+ */
+XKB_EXPORT struct xkb_keymap_keysym_iterator *
+xkb_keymap_keysym_iterator_new(struct xkb_keymap *keymap, xkb_keysym_t keysym);
+
+/**
+ * Create a new iterator over the positions in a keymap that produce a
+ * Unicode code point.
+ *
+ * Same as `xkb_keymap_keysym_iterator_new()`, but matches all the keysyms
+ * whose conversion with `xkb_keysym_to_utf32()` is the given code point,
+ * e.g. both `XKB_KEY_KP_1` and `XKB_KEY_1` for U+0031 “1”.
+ *
+ * @param[in] keymap    The keymap to search.
+ * @param[in] codepoint The Unicode code point to search for. It must not be 0.
+ *
+ * @returns A new iterator, or `NULL` on failure.
+ *
+ * @sa `xkb_keymap_keysym_iterator_new()`
+ * @since 1.14.0
+ * @memberof xkb_keymap_keysym_iterator
+ */
+XKB_EXPORT struct xkb_keymap_keysym_iterator *
+xkb_keymap_keysym_iterator_new_from_utf32(struct xkb_keymap *keymap,
+                                          uint32_t codepoint);
+
+/**
+ * Free a keysym iterator.
+ *
+ * @param[in] iter The iterator to free. If it is `NULL`, do nothing.
+ *
+ * @sa `xkb_keymap_keysym_iterator_new()`
+ * @since 1.14.0
+ * @memberof xkb_keymap_keysym_iterator
+ */
+XKB_EXPORT void
+xkb_keymap_keysym_iterator_destroy(struct xkb_keymap_keysym_iterator *iter);
+
+/**
+ * Get the next position from a keysym iterator.
+ *
+ * The positions are sorted by layout, then by level, then by keycode and
+ * finally by modifier mask, so that the first position is usually the
+ * simplest way to type the keysym.
+ *
+ * The modifier masks are the ones returned by
+ * `xkb_keymap_key_get_mods_for_level()`: a level may be reached with multiple
+ * masks, in which case there is one position per mask.
+ *
+ * @param[in,out] iter     The iterator to use.
+ * @param[out]    keycode  The keycode of the key.
+ * @param[out]    layout   The layout of the key.
+ * @param[out]    level    The shift level in the layout.
+ * @param[out]    mask     The modifier mask that selects the level.
+ *
+ * @returns `true` if a position was written to the output parameters,
+ * otherwise `false` in case there are no more positions.
+ *
+ * @since 1.14.0
+ * @memberof xkb_keymap_keysym_iterator
+ */
+XKB_EXPORT bool
+xkb_keymap_keysym_iterator_next(struct xkb_keymap_keysym_iterator *iter,
+                                xkb_keycode_t *keycode,
+                                xkb_layout_index_t *layout,
+                                xkb_level_index_t *level,
+                                xkb_mod_mask_t *mask);
+
 /**
  * Determine whether a key should repeat or not.
  *
@@ -2587,9 +2843,14 @@ xkb_event_serialize_layout(const struct xkb_event *event,
  * sequentially via `xkb_events_next()`. The collection is reset on each
  * `process_*` call.
  *
+ * Alternatively, an `xkb_events` *queue* accumulates the events of successive
+ * `process_*` calls in a bounded ring, so that the events can be produced and
+ * consumed on two different threads.
+ *
  * @since 1.14.0
  *
  * @sa `xkb_events_new_batch()`
+ * @sa `xkb_events_new_queue()`
  * @sa `xkb_events_next()`
  * @sa `xkb_events_destroy()`
  * @sa `xkb_machine::xkb_machine_process_key()`
@@ -2610,7 +2871,26 @@ enum xkb_events_flags {
      *
      * @since 1.14.0
      */
-    XKB_EVENTS_NO_FLAGS = 0
+    XKB_EVENTS_NO_FLAGS = 0,
+    /**
+     * Queue overflow policy: drop the events of a `process_*` call if they do
+     * not fit in the queue.
+     *
+     * The net state change of the dropped events is not lost: it is merged
+     * into a single `::XKB_EVENT_TYPE_COMPONENTS_CHANGE` event, published
+     * before the next events that fit. Only the key events are lost;
+     * their count is available via `xkb_events_get_dropped()`.
+     *
+     * If not set, the events that do not fit are kept by the producer and
+     * published as soon as there is room, by the next `process_*` calls or by
+     * `xkb_events_flush()`. No event is lost, at the cost of an unbounded
+     * producer-side backlog.
+     *
+     * Only valid for `xkb_events_new_queue()`.
+     *
+     * @since 1.14.0
+     */
+    XKB_EVENTS_QUEUE_DROP_ON_OVERFLOW = (1 << 0)
 };
 
 /**
@@ -2632,6 +2912,42 @@ enum xkb_events_flags {
 XKB_EXPORT struct xkb_events *
 xkb_events_new_batch(struct xkb_context *context, enum xkb_events_flags flags);
 
+/**
+ * Create a new [event](@ref xkb_event) queue.
+ *
+ * A queue is a bounded single-producer/single-consumer lock-free ring of
+ * events. It can be used in place of a batch as the output of the
+ * `xkb_machine` `process_*` functions, but it is *not* reset by them: the
+ * events of each call are appended to the queue.
+ *
+ * The *producer* thread calls the `process_*` functions and
+ * `xkb_events_flush()`, while the *consumer* thread calls `xkb_events_next()`.
+ * No other synchronization is required. The event returned by
+ * `xkb_events_next()` remains valid until the next call to `xkb_events_next()`.
+ *
+ * The events of a `process_*` call are published at once, at the end of the
+ * call. The overflow policy is set with `::XKB_EVENTS_QUEUE_DROP_ON_OVERFLOW`.
+ *
+ * @param[in] context  The context in which to create the queue.
+ * @param[in] capacity The maximum number of events in the queue. It is rounded
+ *                     up to the next power of 2.
+ * @param[in] flags    Optional flags for the queue, or 0.
+ *
+ * @returns A new event queue, or `NULL` on failure, e.g. if the platform does
+ * not support atomic operations.
+ *
+ * @since 1.14.0
+ *
+ * @sa `xkb_events_destroy()`
+ * @sa `xkb_events_next()`
+ * @sa `xkb_events_flush()`
+ *
+ * @memberof xkb_events
+ */
+XKB_EXPORT struct xkb_events *
+xkb_events_new_queue(struct xkb_context *context, size_t capacity,
+                     enum xkb_events_flags flags);
+
 /**
  * Free an event collection.
  *
@@ -2662,6 +2978,45 @@ xkb_events_destroy(struct xkb_events *events);
 XKB_EXPORT const struct xkb_event *
 xkb_events_next(struct xkb_events *events);
 
+/**
+ * Publish the pending events of an event queue.
+ *
+ * Events that did not fit in the queue when they were produced are published
+ * as soon as there is room. This function must be called from the producer
+ * thread.
+ *
+ * @param[in] events The event queue.
+ *
+ * @returns The number of events that are still pending. Always 0 for a batch.
+ *
+ * @since 1.14.0
+ *
+ * @sa `xkb_events_new_queue()`
+ *
+ * @memberof xkb_events
+ */
+XKB_EXPORT size_t
+xkb_events_flush(struct xkb_events *events);
+
+/**
+ * Get the number of events dropped by an event queue.
+ *
+ * This function may be called from any thread.
+ *
+ * @param[in] events The event queue.
+ *
+ * @returns The number of events dropped since the creation of the queue,
+ * if using `::XKB_EVENTS_QUEUE_DROP_ON_OVERFLOW`, otherwise 0.
+ *
+ * @since 1.14.0
+ *
+ * @sa `xkb_events_new_queue()`
+ *
+ * @memberof xkb_events
+ */
+XKB_EXPORT size_t
+xkb_events_get_dropped(struct xkb_events *events);
+
 /**
  * @struct xkb_machine_builder
  * Opaque builder object to configure an `xkb_machine`.
@@ -3076,6 +3431,66 @@ xkb_machine_process_key(struct xkb_machine *machine,
                         xkb_keycode_t key, enum xkb_key_direction direction,
                         struct xkb_events *events);
 
+/**
+ * @struct xkb_key_input
+ * A key event input: a pair ([keycode], [direction]).
+ *
+ * Used to process several key events at once with
+ * `xkb_machine::xkb_machine_process_keys()`.
+ *
+ * @since 1.14.0
+ *
+ * [keycode]: @ref xkb_keycode_t
+ * [direction]: @ref xkb_key_direction
+ */
+struct xkb_key_input {
+    /** The keycode of the key being operated */
+    xkb_keycode_t keycode;
+    /** The direction of the key operation */
+    enum xkb_key_direction direction;
+};
+
+/**
+ * Process a sequence of key events through the XKB [state machine], and
+ * collect all the resulting [keyboard events] into a single [event batch].
+ *
+ * This is equivalent to calling `xkb_machine_process_key()` for each input in
+ * order, but without resetting the batch between the inputs: each input
+ * appends its own *frame* of events. It is intended to amortize the per-call
+ * overhead when replaying buffered inputs, e.g. an evdev frame containing
+ * several key events.
+ *
+ * @param[in,out] machine  The XKB [state machine] object.
+ * @param[in]     count    The number of inputs in `keys`.
+ * @param[in]     keys     The key events to process, in order.
+ * @param[out]    events   The event batch to collect events into. It will be
+ *                         reset before collecting.
+ * @param[out]    offsets  Optional array of `count` elements. If not `NULL`,
+ *                         `offsets[i]` is set to the index in the batch of
+ *                         the first event produced by `keys[i]`. For a
+ *                         queue, indexes are relative to the first event
+ *                         produced by the call. The events of
+ *                         `keys[i]` span up to `offsets[i + 1]` (excluded) or
+ *                         to the end of the batch for the last input. An input
+ *                         may produce no event, e.g. an unknown key.
+ *
+ * @returns `::XKB_SUCCESS` on success, otherwise an error code.
+ *
+ * @since 1.14.0
+ *
+ * @sa `xkb_machine_process_key()`
+ *
+ * @memberof xkb_machine
+ *
+ * [state machine]: @ref xkb_machine
+ * [keyboard events]: @ref xkb_event
+ * [event batch]: @ref xkb_events
+ */
+XKB_EXPORT enum xkb_error_code
+xkb_machine_process_keys(struct xkb_machine *machine,
+                         size_t count, const struct xkb_key_input *keys,
+                         struct xkb_events *events, size_t *offsets);
+
 /**
  * @struct xkb_state_components_update
  * Latched and locked state components for an out-of-band state update.
@@ -230,6 +230,36 @@ rxkb_context_set_log_fn(struct rxkb_context *ctx,
                                        enum rxkb_log_level level,
                                        const char *format, va_list args));
 
+/**
+ * Set the directory of the registry cache of the context.
+ *
+ * When set, `rxkb_context_parse()` stores the parsed registry in a binary form
+ * in this directory, keyed by the ruleset, the context flags and the include
+ * paths. Subsequent parsings of the same ruleset load the registry from the
+ * cache instead of the XML files, as long as none of the rules files has been
+ * created, modified or removed. The objects loaded from the cache share a
+ * single memory mapping of the cache file.
+ *
+ * The directory is created if missing, but not its parents. Cache files are
+ * not portable and should be considered disposable.
+ *
+ * The cache is disabled by default. The environment variable
+ * `RXKB_CACHE_DIR`, if set at the time the context was created, enables it.
+ *
+ * This function must be called before `rxkb_context_parse()`.
+ *
+ * @note Loading the registry from the cache does not reproduce the log
+ * messages of the parsing.
+ *
+ * @param ctx  The xkb registry context
+ * @param path The path of the cache directory, or `NULL` to disable the cache.
+ *
+ * @return `true` on success or `false` on failure
+ *
+ * @since 1.14.0
+ */
+RXKB_EXPORT bool
+rxkb_context_set_cache_dir(struct rxkb_context *ctx, const char *path);
 
 /**
  * Parse the given ruleset. This can only be called once per context and once
@@ -404,6 +434,25 @@ rxkb_model_first(struct rxkb_context *ctx);
 RXKB_EXPORT struct rxkb_model *
 rxkb_model_next(struct rxkb_model *m);
 
+/**
+ * Return the model with the given name.
+ *
+ * The lookup uses an index that is built by the first lookup on the context,
+ * so it is much faster than iterating over the models.
+ *
+ * The refcount of the returned model is not increased. Use `rxkb_model_ref()`
+ * if you need to keep this struct outside the immediate scope.
+ *
+ * @param ctx  The xkb registry context, which must have been parsed
+ * @param name The name of the model, e.g. `pc105`
+ *
+ * @return The model or `NULL` if there is no such model
+ *
+ * @since 1.14.0
+ */
+RXKB_EXPORT struct rxkb_model *
+rxkb_model_find(struct rxkb_context *ctx, const char *name);
+
 /**
  * Increase the refcount of the argument by one.
  *
@@ -474,6 +523,28 @@ rxkb_layout_first(struct rxkb_context *ctx);
 RXKB_EXPORT struct rxkb_layout *
 rxkb_layout_next(struct rxkb_layout *l);
 
+/**
+ * Return the layout with the given name and variant.
+ *
+ * The lookup uses an index that is built by the first lookup on the context,
+ * so it is much faster than iterating over the layouts.
+ *
+ * The refcount of the returned layout is not increased. Use `rxkb_layout_ref()`
+ * if you need to keep this struct outside the immediate scope.
+ *
+ * @param ctx     The xkb registry context, which must have been parsed
+ * @param name    The name of the layout, e.g. `us`
+ * @param variant The name of the variant, e.g. `intl`, or `NULL` or an empty
+ *                string for the layout itself
+ *
+ * @return The layout or `NULL` if there is no such layout
+ *
+ * @since 1.14.0
+ */
+RXKB_EXPORT struct rxkb_layout *
+rxkb_layout_find(struct rxkb_context *ctx, const char *name,
+                 const char *variant);
+
 /**
  * Increase the refcount of the argument by one.
  *
@@ -558,6 +629,24 @@ rxkb_option_group_first(struct rxkb_context *ctx);
 RXKB_EXPORT struct rxkb_option_group *
 rxkb_option_group_next(struct rxkb_option_group *g);
 
+/**
+ * Return the option group with the given name.
+ *
+ * The refcount of the returned option group is not increased. Use
+ * `rxkb_option_group_ref()` if you need to keep this struct outside the
+ * immediate scope.
+ *
+ * @param ctx  The xkb registry context, which must have been parsed
+ * @param name The name of the option group, e.g. `grp`
+ *
+ * @return The option group or `NULL` if there is no such option group
+ *
+ * @sa `rxkb_model_find()`
+ * @since 1.14.0
+ */
+RXKB_EXPORT struct rxkb_option_group *
+rxkb_option_group_find(struct rxkb_context *ctx, const char *name);
+
 /**
  * Increase the refcount of the argument by one.
  *
@@ -629,6 +718,26 @@ rxkb_option_first(struct rxkb_option_group *group);
 RXKB_EXPORT struct rxkb_option *
 rxkb_option_next(struct rxkb_option *o);
 
+/**
+ * Return the option with the given name, in any option group.
+ *
+ * If multiple groups have an option with this name, the option of the first
+ * group is returned.
+ *
+ * The refcount of the returned option is not increased. Use `rxkb_option_ref()`
+ * if you need to keep this struct outside the immediate scope.
+ *
+ * @param ctx  The xkb registry context, which must have been parsed
+ * @param name The name of the option, e.g. `grp:alt_shift_toggle`
+ *
+ * @return The option or `NULL` if there is no such option
+ *
+ * @sa `rxkb_model_find()`
+ * @since 1.14.0
+ */
+RXKB_EXPORT struct rxkb_option *
+rxkb_option_find(struct rxkb_context *ctx, const char *name);
+
 /**
  * Increase the refcount of the argument by one.
  *
@@ -733,6 +842,45 @@ rxkb_layout_get_iso639_first(struct rxkb_layout *layout);
 RXKB_EXPORT struct rxkb_iso639_code *
 rxkb_iso639_code_next(struct rxkb_iso639_code *iso639);
 
+/**
+ * Return the first layout with the given ISO 639-3 code. Use this to start
+ * iterating over the layouts for a language, followed by calls to
+ * `rxkb_layout_next_by_iso639()`. The layouts are in the same order as with
+ * `rxkb_layout_first()`.
+ *
+ * The lookup uses an index that is built by the first lookup on the context.
+ * The code is compared case-insensitively.
+ *
+ * The refcount of the returned layout is not increased. Use `rxkb_layout_ref()`
+ * if you need to keep this struct outside the immediate scope.
+ *
+ * @param ctx  The xkb registry context, which must have been parsed
+ * @param code The ISO 639-3 code, e.g. `fra`
+ *
+ * @return The first layout for this language or `NULL` if there is none
+ *
+ * @since 1.14.0
+ */
+RXKB_EXPORT struct rxkb_layout *
+rxkb_layout_first_by_iso639(struct rxkb_context *ctx, const char *code);
+
+/**
+ * Return the next layout with the given ISO 639-3 code.
+ *
+ * The refcount of the returned layout is not increased. Use `rxkb_layout_ref()`
+ * if you need to keep this struct outside the immediate scope.
+ *
+ * @param layout The previous layout, as returned by
+ *               `rxkb_layout_first_by_iso639()` or this function
+ * @param code   The ISO 639-3 code, e.g. `fra`
+ *
+ * @return The next layout for this language or `NULL` at the end of the list
+ *
+ * @since 1.14.0
+ */
+RXKB_EXPORT struct rxkb_layout *
+rxkb_layout_next_by_iso639(struct rxkb_layout *layout, const char *code);
+
 /**
  * Increase the refcount of the argument by one.
  *
@@ -783,6 +931,37 @@ rxkb_layout_get_iso3166_first(struct rxkb_layout *layout);
 RXKB_EXPORT struct rxkb_iso3166_code *
 rxkb_iso3166_code_next(struct rxkb_iso3166_code *iso3166);
 
+/**
+ * Return the first layout with the given ISO 3166 Alpha 2 code. Use this to
+ * start iterating over the layouts for a country, followed by calls to
+ * `rxkb_layout_next_by_iso3166()`.
+ *
+ * @param ctx  The xkb registry context, which must have been parsed
+ * @param code The ISO 3166 Alpha 2 code, e.g. `FR`
+ *
+ * @return The first layout for this country or `NULL` if there is none
+ *
+ * @sa `rxkb_layout_first_by_iso639()`
+ * @since 1.14.0
+ */
+RXKB_EXPORT struct rxkb_layout *
+rxkb_layout_first_by_iso3166(struct rxkb_context *ctx, const char *code);
+
+/**
+ * Return the next layout with the given ISO 3166 Alpha 2 code.
+ *
+ * @param layout The previous layout, as returned by
+ *               `rxkb_layout_first_by_iso3166()` or this function
+ * @param code   The ISO 3166 Alpha 2 code, e.g. `FR`
+ *
+ * @return The next layout for this country or `NULL` at the end of the list
+ *
+ * @sa `rxkb_layout_next_by_iso639()`
+ * @since 1.14.0
+ */
+RXKB_EXPORT struct rxkb_layout *
+rxkb_layout_next_by_iso3166(struct rxkb_layout *layout, const char *code);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -1,7 +1,7 @@
 #!/usr/bin/env python3
 
 """
-Generate headers related to keysyms bounds
+Generate headers related to keysyms bounds and Unicode conversions
 """
 
 import argparse
@@ -18,6 +18,10 @@ KEYSYM_PATTERN = re.compile(
     r"^#define\s+XKB_KEY_(?P<name>\w+)\s+(?P<value>0x[0-9a-fA-F]+)\s"
 )
 MAX_AMBIGUOUS_NAMES = 3
+CODEPAIR_PATTERN = re.compile(
+    r"^\s*\{\s*(?P<keysym>0x[0-9a-fA-F]+),\s*(?P<deprecated>true|false),"
+    r"\s*(?P<ucs>0x[0-9a-fA-F]+)\s*\},"
+)
 
 KeysymsBounds: TypeAlias = dict[str, int | str]
 KeysymsCaseFoldedNames: TypeAlias = dict[str, list[str]]
@@ -90,6 +94,58 @@ def load_keysyms(path: Path) -> tuple[KeysymsBounds, KeysymsCaseFoldedNames]:
     )
 
 
+def load_ucs_to_keysym(path: Path) -> dict[str, Any]:
+    """
+    Compute a two-level lookup table for the Unicode to keysym conversion,
+    from the `keysymtab` table in keysym-utf.c.
+    """
+    mapping: dict[int, int] = {}
+    with path.open("rt", encoding="utf-8") as fd:
+        for line in fd:
+            if m := CODEPAIR_PATTERN.match(line):
+                # Do not use deprecated keysyms
+                if m.group("deprecated") == "true":
+                    continue
+                ucs = int(m.group("ucs"), 16)
+                keysym = int(m.group("keysym"), 16)
+                # The blocks of the table are stored as uint16_t
+                if keysym > 0xFFFF:
+                    raise ValueError(
+                        f"Keysym 0x{keysym:x} does not fit in the 16 bits "
+                        f"entries of the Unicode to keysym table"
+                    )
+                # Keep the first keysym, i.e. with the lowest value
+                if ucs not in mapping:
+                    mapping[ucs] = keysym
+    max_ucs = max(mapping)
+
+    # Split the code points in blocks of 2^shift entries and deduplicate the
+    # blocks. Choose the block size which minimizes the size of the tables.
+    best: dict[str, Any] | None = None
+    for shift in range(2, 10):
+        blocks: dict[tuple[int, ...], int] = {}
+        index: list[int] = []
+        for hi in range((max_ucs >> shift) + 1):
+            block = tuple(
+                mapping.get((hi << shift) + lo, 0) for lo in range(1 << shift)
+            )
+            index.append(blocks.setdefault(block, len(blocks)))
+        if len(blocks) > 0x100:
+            continue
+        size = len(index) + len(blocks) * (1 << shift) * 2
+        if best is None or size < best["size"]:
+            best = {
+                "shift": shift,
+                "index": index,
+                "blocks": list(blocks),
+                "size": size,
+            }
+    assert best is not None
+    best["max_ucs"] = max_ucs
+    best["count"] = len(mapping)
+    return best
+
+
 def generate(
     env: jinja2.Environment,
     data: dict[str, Any],
@@ -131,6 +187,7 @@ jinja_env = jinja2.Environment(
 )
 
 jinja_env.filters["keysym"] = lambda ks: f"0x{ks:0>8x}"
+jinja_env.filters["hex"] = lambda n, width=4: f"0x{n:0>{width}x}"
 
 # Load keysyms
 keysyms_bounds, keysyms_ambiguous_case_insensitive_names = load_keysyms(
@@ -159,3 +216,13 @@ generate(
     args.root,
     Path("test/keysym.h"),
 )
+
+generate(
+    jinja_env,
+    dict(
+        ucs_to_keysym=load_ucs_to_keysym(args.root / "src/keysym-utf.c"),
+        script=SCRIPT.relative_to(ROOT),
+    ),
+    args.root,
+    Path("src/keysym-utf.h"),
+)
@@ -19,6 +19,7 @@
 #include "atom.h"
 #include "darray.h"
 #include "utils.h"
+#include "utils-arena.h"
 
 /* FNV-1a (http://www.isthe.com/chongo/tech/comp/fnv/). */
 static inline uint32_t
@@ -38,11 +39,23 @@ hash_buf(const char *string, size_t len)
  * The atom table is an insert-only linear probing hash table
  * mapping strings to atoms. Another array maps the atoms to
  * strings. The atom value is the position in the strings array.
+ *
+ * Each entry caches the hash and the length of its string, so that the index
+ * can be resized without hashing the strings again and most mismatches are
+ * detected without reading the string. The strings themselves are copied in
+ * an arena: they are never freed individually and their addresses are stable.
  */
+struct atom_entry {
+    const char *string;
+    uint32_t hash;
+    uint32_t len;
+};
+
 struct atom_table {
     xkb_atom_t *index;
     size_t index_size;
-    darray(char *) strings;
+    darray(struct atom_entry) entries;
+    struct arena strings;
 };
 
 struct atom_table *
@@ -52,10 +65,16 @@ atom_table_new(void)
     if (!table)
         return NULL;
 
-    darray_init(table->strings);
-    darray_append(table->strings, NULL);
+    darray_init(table->entries);
+    darray_append(table->entries, (struct atom_entry) { .string = NULL });
+    table->strings = (struct arena) ARENA_INIT;
     table->index_size = 4;
     table->index = calloc(table->index_size, sizeof(*table->index));
+    if (!table->index) {
+        darray_free(table->entries);
+        free(table);
+        return NULL;
+    }
 
     return table;
 }
@@ -66,10 +85,8 @@ atom_table_free(struct atom_table *table)
     if (!table)
         return;
 
-    char **string;
-    darray_foreach(string, table->strings)
-        free(*string);
-    darray_free(table->strings);
+    darray_free(table->entries);
+    arena_release(&table->strings);
     free(table->index);
     free(table);
 }
@@ -77,59 +94,69 @@ atom_table_free(struct atom_table *table)
 darray_size_t
 atom_table_size(struct atom_table *table)
 {
-    return darray_size(table->strings);
+    return darray_size(table->entries);
 }
 
 const char *
 atom_text(struct atom_table *table, xkb_atom_t atom)
 {
-    assert(atom < darray_size(table->strings));
-    return darray_item(table->strings, atom);
+    assert(atom < darray_size(table->entries));
+    return darray_item(table->entries, atom).string;
+}
+
+static bool
+atom_table_grow(struct atom_table *table)
+{
+    const size_t index_size = table->index_size * 2;
+    xkb_atom_t * const index = calloc(index_size, sizeof(*index));
+    if (!index)
+        return false;
+
+    const size_t mask = index_size - 1;
+    for (darray_size_t j = 1; j < darray_size(table->entries); j++) {
+        size_t index_pos = darray_item(table->entries, j).hash & mask;
+        /* There is always an empty slot, since the table is never full */
+        while (index_pos == 0 || index[index_pos] != XKB_ATOM_NONE)
+            index_pos = (index_pos + 1) & mask;
+        index[index_pos] = j;
+    }
+
+    free(table->index);
+    table->index = index;
+    table->index_size = index_size;
+    return true;
 }
 
 xkb_atom_t
 atom_intern(struct atom_table *table, const char *string, size_t len, bool add)
 {
+    if (len > UINT32_MAX)
+        return XKB_ATOM_NONE;
+
     /* len(string) > 0.8 * index_size */
-    if (darray_size(table->strings) > (table->index_size / 5) * 4) {
-        table->index_size *= 2;
-        xkb_atom_t *tmp = realloc(table->index,
-                                  table->index_size * sizeof(*table->index));
-        if (!tmp)
-            return XKB_ATOM_NONE;
-        table->index = tmp;
-        memset(table->index, 0, table->index_size * sizeof(*table->index));
-        for (darray_size_t j = 1; j < darray_size(table->strings); j++) {
-            const char *s = darray_item(table->strings, j);
-            uint32_t hash = hash_buf(s, strlen(s));
-            for (size_t i = 0; i < table->index_size; i++) {
-                size_t index_pos = (hash + i) & (table->index_size - 1);
-                if (index_pos == 0)
-                    continue;
-
-                xkb_atom_t atom = table->index[index_pos];
-                if (atom == XKB_ATOM_NONE) {
-                    table->index[index_pos] = j;
-                    break;
-                }
-            }
-        }
-    }
+    if (darray_size(table->entries) > (table->index_size / 5) * 4 &&
+        !atom_table_grow(table))
+        return XKB_ATOM_NONE;
 
-    uint32_t hash = hash_buf(string, len);
+    const uint32_t hash = hash_buf(string, len);
+    const size_t mask = table->index_size - 1;
     for (size_t i = 0; i < table->index_size; i++) {
-        size_t index_pos = (hash + i) & (table->index_size - 1);
+        size_t index_pos = (hash + i) & mask;
         if (index_pos == 0)
             continue;
 
         xkb_atom_t existing_atom = table->index[index_pos];
         if (existing_atom == XKB_ATOM_NONE) {
             if (add) {
-                xkb_atom_t new_atom = darray_size(table->strings);
-                char *s = strndup(string, len);
+                xkb_atom_t new_atom = darray_size(table->entries);
+                char *s = arena_strndup(&table->strings, string, len);
                 if (!s)
                     return XKB_ATOM_NONE;
-                darray_append(table->strings, s);
+                darray_append(table->entries, (struct atom_entry) {
+                    .string = s,
+                    .hash = hash,
+                    .len = (uint32_t) len,
+                });
                 table->index[index_pos] = new_atom;
                 return new_atom;
             } else {
@@ -137,8 +164,10 @@ atom_intern(struct atom_table *table, const char *string, size_t len, bool add)
             }
         }
 
-        const char *existing_value = darray_item(table->strings, existing_atom);
-        if (strncmp(existing_value, string, len) == 0 && existing_value[len] == '\0')
+        const struct atom_entry * const existing =
+            &darray_item(table->entries, existing_atom);
+        if (existing->hash == hash && existing->len == len &&
+            memcmp(existing->string, string, len) == 0)
             return existing_atom;
     }
 
@@ -0,0 +1,302 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "cache-file.h"
+#include "utils.h"
+
+/*
+ * File layout:
+ *
+ *     header
+ *     key:     char[key_size]           (NUL-terminated)
+ *     deps:    num_deps × (dep + path)  (each record 8-bytes aligned)
+ *     payload: char[payload_size]       (8-bytes aligned)
+ */
+
+#define CACHE_FILE_MAGIC "XKBCACH"
+#define CACHE_FILE_VERSION 2
+#define CACHE_FILE_BYTE_ORDER UINT32_C(0x01020304)
+
+struct cache_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t key_size;
+    uint32_t num_deps;
+    uint64_t deps_size;
+    uint64_t payload_offset;
+    uint64_t payload_size;
+};
+
+/** Value of `cache_file_dep::stamp.size` for files that do not exist */
+#define CACHE_FILE_DEP_MISSING INT64_C(-1)
+
+struct cache_file_dep {
+    struct file_stamp stamp;
+    /* Including the terminating NUL */
+    uint32_t path_size;
+    uint32_t _pad;
+};
+
+static_assert(sizeof(struct cache_file_header) % CACHE_FILE_ALIGN == 0,
+              "Unaligned header");
+static_assert(sizeof(struct cache_file_dep) % CACHE_FILE_ALIGN == 0,
+              "Unaligned dependency");
+
+/* FNV-1a 64 bits (http://www.isthe.com/chongo/tech/comp/fnv/). */
+static uint64_t
+hash_key(const char *key)
+{
+    uint64_t hash = UINT64_C(14695981039346656037);
+    for (; *key; key++) {
+        hash ^= (uint8_t) *key;
+        hash *= UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+char *
+cache_file_get_path(const char *dir, const char *key, const char *ext)
+{
+    if (isempty(dir))
+        return NULL;
+    return asprintf_safe("%s/%016" PRIx64 ".%s", dir, hash_key(key), ext);
+}
+
+static void
+stat_dep(const char *path, struct cache_file_dep *dep)
+{
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        file_stamp_from_stat(&dep->stamp, &st);
+    } else {
+        dep->stamp = (struct file_stamp) { .size = CACHE_FILE_DEP_MISSING };
+    }
+    dep->path_size = (uint32_t) strlen(path) + 1;
+    dep->_pad = 0;
+}
+
+enum cache_file_status
+cache_file_load(const char *path, const char *key, struct cache_file *file)
+{
+    char *string = NULL;
+    size_t size = 0;
+
+    FILE * const fp = fopen(path, "rb");
+    if (!fp)
+        return CACHE_FILE_NOT_FOUND;
+    const bool mapped = map_file(fp, &string, &size);
+    fclose(fp);
+    if (!mapped)
+        return CACHE_FILE_NOT_FOUND;
+
+    struct cache_file_header header;
+    if (size < sizeof(header))
+        goto invalid;
+    memcpy(&header, string, sizeof(header));
+
+    if (memcmp(header.magic, CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC)) != 0 ||
+        header.version != CACHE_FILE_VERSION ||
+        header.byte_order != CACHE_FILE_BYTE_ORDER)
+        goto invalid;
+
+    /* Check sections bounds */
+    size_t offset = sizeof(header);
+    if (header.key_size > size - offset ||
+        strlen(key) + 1 != header.key_size ||
+        memcmp(string + offset, key, header.key_size) != 0)
+        goto invalid;
+    offset = cache_file_align(offset + header.key_size);
+
+    if (offset > size || header.deps_size > size - offset)
+        goto invalid;
+    const size_t deps_end = offset + (size_t) header.deps_size;
+
+    if (header.payload_offset < deps_end ||
+        header.payload_offset % CACHE_FILE_ALIGN != 0 ||
+        header.payload_offset > size ||
+        header.payload_size > size - header.payload_offset)
+        goto invalid;
+
+    /* Check that the dependencies are up-to-date */
+    for (uint32_t d = 0; d < header.num_deps; d++) {
+        struct cache_file_dep dep, current;
+        if (sizeof(dep) > deps_end - offset)
+            goto invalid;
+        memcpy(&dep, string + offset, sizeof(dep));
+        offset += sizeof(dep);
+        if (dep.path_size == 0 || dep.path_size > deps_end - offset ||
+            string[offset + dep.path_size - 1] != '\0')
+            goto invalid;
+        const char * const dep_path = string + offset;
+        stat_dep(dep_path, &current);
+        if (!file_stamp_eq(&current.stamp, &dep.stamp)) {
+            unmap_file(string, size);
+            return CACHE_FILE_OUTDATED;
+        }
+        offset = cache_file_align(offset + dep.path_size);
+    }
+
+    file->map = string;
+    file->map_size = size;
+    file->payload = string + header.payload_offset;
+    file->payload_size = (size_t) header.payload_size;
+    return CACHE_FILE_LOADED;
+
+invalid:
+    unmap_file(string, size);
+    return CACHE_FILE_INVALID;
+}
+
+void
+cache_file_unload(struct cache_file *file)
+{
+    if (file->map)
+        unmap_file(file->map, file->map_size);
+    file->map = NULL;
+    file->map_size = 0;
+    file->payload = NULL;
+    file->payload_size = 0;
+}
+
+#if HAVE_MKOSTEMP
+static bool
+write_padded(FILE *file, const void *data, size_t size)
+{
+    static const char padding[CACHE_FILE_ALIGN] = { 0 };
+    const size_t padding_size = cache_file_align(size) - size;
+    return fwrite(data, 1, size, file) == size &&
+           fwrite(padding, 1, padding_size, file) == padding_size;
+}
+
+static bool
+write_cache_file(FILE *file, const char *key,
+                 const char * const *deps, size_t num_deps,
+                 const struct cache_chunk *chunks, size_t num_chunks)
+{
+    if (num_deps > UINT32_MAX)
+        return false;
+
+    struct cache_file_dep * const deps_stats =
+        calloc(num_deps + 1, sizeof(*deps_stats));
+    if (!deps_stats)
+        return false;
+
+    uint64_t deps_size = 0;
+    for (size_t d = 0; d < num_deps; d++) {
+        stat_dep(deps[d], &deps_stats[d]);
+        deps_size += sizeof(deps_stats[d]) +
+                     cache_file_align(deps_stats[d].path_size);
+    }
+
+    /* Chunks are padded, but the payload size excludes the final padding */
+    uint64_t payload_size = 0;
+    for (size_t c = 0; c < num_chunks; c++) {
+        payload_size = cache_file_align(payload_size);
+        payload_size += chunks[c].size;
+    }
+
+    struct cache_file_header header = {
+        .magic = CACHE_FILE_MAGIC,
+        .version = CACHE_FILE_VERSION,
+        .byte_order = CACHE_FILE_BYTE_ORDER,
+        .key_size = (uint32_t) strlen(key) + 1,
+        .num_deps = (uint32_t) num_deps,
+        .deps_size = deps_size,
+        .payload_size = payload_size,
+    };
+    header.payload_offset = cache_file_align(sizeof(header)) +
+                            cache_file_align(header.key_size) +
+                            deps_size;
+
+    bool ok = write_padded(file, &header, sizeof(header)) &&
+              write_padded(file, key, header.key_size);
+    for (size_t d = 0; ok && d < num_deps; d++) {
+        ok = write_padded(file, &deps_stats[d], sizeof(deps_stats[d])) &&
+             write_padded(file, deps[d], deps_stats[d].path_size);
+    }
+    for (size_t c = 0; ok && c < num_chunks; c++)
+        ok = write_padded(file, chunks[c].data, chunks[c].size);
+
+    free(deps_stats);
+    return ok;
+}
+#endif
+
+bool
+cache_file_store(const char *path, const char *key,
+                 const char * const *deps, size_t num_deps,
+                 const struct cache_chunk *chunks, size_t num_chunks)
+{
+#if HAVE_MKOSTEMP
+    int saved_errno;
+    char * const tmp_path = asprintf_safe("%s.XXXXXX", path);
+    if (!tmp_path)
+        return false;
+
+    /* Write to a temporary file, then replace the cache file atomically */
+    int fd = mkostemp(tmp_path, O_CLOEXEC);
+    if (fd < 0 && errno == ENOENT) {
+        /* Create the cache directory, if missing, then retry */
+        char * const dir = strdup(path);
+        char * const sep = (dir) ? strrchr(dir, '/') : NULL;
+        if (sep) {
+            *sep = '\0';
+            if (mkdir(dir, 0700) == 0 || errno == EEXIST) {
+                /* The template may have been modified by the failed call */
+                memcpy(tmp_path + strlen(tmp_path) - 6, "XXXXXX", 6);
+                fd = mkostemp(tmp_path, O_CLOEXEC);
+            }
+        }
+        free(dir);
+    }
+    if (fd < 0)
+        goto err;
+
+    FILE * const file = fdopen(fd, "wb");
+    if (!file) {
+        close(fd);
+        unlink(tmp_path);
+        goto err;
+    }
+
+    const bool ok = write_cache_file(file, key, deps, num_deps,
+                                     chunks, num_chunks);
+    if (fclose(file) != 0 || !ok || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        goto err;
+    }
+
+    free(tmp_path);
+    return true;
+
+err:
+    saved_errno = errno;
+    free(tmp_path);
+    errno = saved_errno;
+    return false;
+#else
+    (void) path;
+    (void) key;
+    (void) deps;
+    (void) num_deps;
+    (void) chunks;
+    (void) num_chunks;
+    errno = ENOTSUP;
+    return false;
+#endif
+}
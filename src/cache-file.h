@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Cache files of compiled data
+ *
+ * A cache file is made of:
+ * - a header;
+ * - a key: a string describing everything the compiled data depends on,
+ *   apart from the contents of the files it was compiled from;
+ * - the dependencies: the files the data was compiled from, with their
+ *   modification time (including nanoseconds where available), size and
+ *   inode. Files that were looked up but did not exist
+ *   are recorded too, so that creating them invalidates the cache;
+ * - the payload: the compiled data, in an arbitrary format.
+ *
+ * The files are written atomically and are intended to be memory-mapped.
+ * They use the host byte order and are not meant to be portable.
+ *
+ * This module does not log: it is shared with libxkbregistry, which has its
+ * own logging. The callers are responsible for reporting failures.
+ */
+
+/** A chunk of payload to write; chunks are 8-bytes aligned in the file */
+struct cache_chunk {
+    const void *data;
+    size_t size;
+};
+
+/** A loaded cache file */
+struct cache_file {
+    char *map;
+    size_t map_size;
+    /* 8-bytes aligned */
+    const char *payload;
+    size_t payload_size;
+};
+
+/** Alignment of the chunks in the payload */
+#define CACHE_FILE_ALIGN 8
+
+static inline size_t
+cache_file_align(size_t size)
+{
+    return (size + CACHE_FILE_ALIGN - 1) & ~(size_t) (CACHE_FILE_ALIGN - 1);
+}
+
+/**
+ * Get the path of the cache file in the directory `dir` for the given key,
+ * using the file extension `ext`.
+ */
+char *
+cache_file_get_path(const char *dir, const char *key, const char *ext);
+
+enum cache_file_status {
+    /** The file was loaded */
+    CACHE_FILE_LOADED,
+    /** The file does not exist or could not be read */
+    CACHE_FILE_NOT_FOUND,
+    /** The file is corrupted or does not match the key */
+    CACHE_FILE_INVALID,
+    /** One of the dependencies changed since the file was stored */
+    CACHE_FILE_OUTDATED,
+};
+
+/**
+ * Load a cache file, if it matches the given key and its dependencies are
+ * up-to-date.
+ *
+ * @returns `CACHE_FILE_LOADED` on success, in which case the file must be
+ * released with `cache_file_unload()`.
+ */
+enum cache_file_status
+cache_file_load(const char *path, const char *key, struct cache_file *file);
+
+void
+cache_file_unload(struct cache_file *file);
+
+/**
+ * Store a cache file, creating its directory if missing.
+ *
+ * @returns true on success, false otherwise and sets `errno`.
+ */
+bool
+cache_file_store(const char *path, const char *key,
+                 const char * const *deps, size_t num_deps,
+                 const struct cache_chunk *chunks, size_t num_chunks);
@@ -0,0 +1,213 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "cache-file.h"
+#include "context.h"
+#include "darray.h"
+#include "messages-codes.h"
+#include "utils.h"
+#include "cache.h"
+#include "paths.h"
+#include "table.h"
+
+/*
+ * Cache file payload (see cache-file.h):
+ *
+ *     header
+ *     nodes: struct compose_node[num_nodes] (8-bytes aligned)
+ *     utf8:  char[utf8_size]
+ *
+ * The key identifies the table: the Compose file path, the locale and the
+ * environment used to resolve the includes. The dependencies are the Compose
+ * file and all its includes.
+ */
+
+#define COMPOSE_CACHE_VERSION 1
+#define COMPOSE_CACHE_EXTENSION "xkbcompose"
+
+struct compose_cache_header {
+    uint32_t node_size;
+    uint32_t num_nodes;
+    uint32_t utf8_size;
+    uint32_t _pad;
+};
+
+static_assert(sizeof(struct compose_cache_header) % CACHE_FILE_ALIGN == 0,
+              "Unaligned header");
+static_assert(CACHE_FILE_ALIGN % _Alignof(struct compose_node) == 0,
+              "Unaligned nodes");
+
+static inline const char *
+safe_env(struct xkb_context *ctx, const char *name)
+{
+    const char * const value = xkb_context_getenv(ctx, name);
+    return value ? value : "";
+}
+
+/**
+ * Build the cache key: everything that may change the result of the
+ * compilation of the Compose file, apart from the files contents.
+ */
+static char *
+get_cache_key(const struct xkb_compose_table *table, const char *path)
+{
+    return asprintf_safe("compose %d\n%d\n%d\n%s\n%s\n%s\n%s\n",
+                         COMPOSE_CACHE_VERSION,
+                         table->format, table->flags, path, table->locale,
+                         safe_env(table->ctx, "HOME"),
+                         get_xlocaledir_path(table->ctx));
+}
+
+/** Check that the nodes form a valid tree, so that traversals are safe */
+static bool
+check_nodes(const struct compose_node *nodes, uint32_t num_nodes,
+            const char *utf8, uint32_t utf8_size)
+{
+    if (num_nodes == 0 || num_nodes > MAX_COMPOSE_NODES ||
+        utf8_size == 0 || utf8[utf8_size - 1] != '\0' ||
+        !nodes[0].is_leaf)
+        return false;
+
+    for (uint32_t i = 0; i < num_nodes; i++) {
+        const struct compose_node * const node = &nodes[i];
+        if (node->lokid >= num_nodes || node->hikid >= num_nodes)
+            return false;
+        if (node->is_leaf) {
+            if (node->leaf.utf8 >= utf8_size)
+                return false;
+        } else if (node->internal.eqkid >= num_nodes) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+compose_cache_load(struct xkb_compose_table *table, const char *path)
+{
+    bool ok = false;
+    struct cache_file file = { 0 };
+
+    char * const key = get_cache_key(table, path);
+    char * const cache_path = (key)
+        ? cache_file_get_path(get_compose_cache_dir_path(table->ctx), key,
+                              COMPOSE_CACHE_EXTENSION)
+        : NULL;
+    if (!cache_path)
+        goto out;
+    switch (cache_file_load(cache_path, key, &file)) {
+    case CACHE_FILE_LOADED:
+        break;
+    case CACHE_FILE_INVALID:
+        goto invalid;
+    case CACHE_FILE_OUTDATED:
+        log_dbg(table->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "Compose cache file %s is outdated\n", cache_path);
+        goto out;
+    default:
+        goto out;
+    }
+
+    struct compose_cache_header header;
+    if (file.payload_size < sizeof(header))
+        goto invalid;
+    memcpy(&header, file.payload, sizeof(header));
+
+    const size_t nodes_size =
+        (size_t) header.num_nodes * sizeof(struct compose_node);
+    if (header.node_size != sizeof(struct compose_node) ||
+        header.num_nodes > (file.payload_size - sizeof(header)) /
+                           sizeof(struct compose_node) ||
+        header.utf8_size > file.payload_size - sizeof(header) -
+                           cache_file_align(nodes_size))
+        goto invalid;
+
+    const struct compose_node * const nodes =
+        (const struct compose_node *) (file.payload + sizeof(header));
+    const char * const utf8 =
+        file.payload + sizeof(header) + cache_file_align(nodes_size);
+    if (!check_nodes(nodes, header.num_nodes, utf8, header.utf8_size))
+        goto invalid;
+
+    /* Use the mapping directly: the table is immutable */
+    darray_free(table->nodes);
+    darray_free(table->utf8);
+    table->nodes.item = (struct compose_node *) nodes;
+    table->nodes.size = table->nodes.alloc = header.num_nodes;
+    table->utf8.item = (char *) utf8;
+    table->utf8.size = table->utf8.alloc = header.utf8_size;
+    table->cache_map = file.map;
+    table->cache_map_size = file.map_size;
+    file.map = NULL;
+
+    log_dbg(table->ctx, XKB_LOG_MESSAGE_NO_ID,
+            "Loaded Compose table for %s from cache %s\n", path, cache_path);
+    ok = true;
+    goto out;
+
+invalid:
+    log_dbg(table->ctx, XKB_LOG_MESSAGE_NO_ID,
+            "Invalid Compose cache file: %s\n", cache_path);
+out:
+    cache_file_unload(&file);
+    free(cache_path);
+    free(key);
+    return ok;
+}
+
+void
+compose_cache_store(const struct xkb_compose_table *table, const char *path,
+                    const darray_string *includes)
+{
+    char * const key = get_cache_key(table, path);
+    char * const cache_path = (key)
+        ? cache_file_get_path(get_compose_cache_dir_path(table->ctx), key,
+                              COMPOSE_CACHE_EXTENSION)
+        : NULL;
+    /* Dependencies: Compose file + includes */
+    const char ** const deps =
+        calloc(1 + darray_size(*includes), sizeof(*deps));
+    if (!cache_path || !deps)
+        goto out;
+
+    deps[0] = path;
+    for (darray_size_t i = 0; i < darray_size(*includes); i++)
+        deps[i + 1] = darray_item(*includes, i);
+
+    const struct compose_cache_header header = {
+        .node_size = sizeof(struct compose_node),
+        .num_nodes = darray_size(table->nodes),
+        .utf8_size = darray_size(table->utf8),
+    };
+    const struct cache_chunk chunks[] = {
+        { &header, sizeof(header) },
+        { table->nodes.item, sizeof(struct compose_node) * header.num_nodes },
+        { table->utf8.item, header.utf8_size },
+    };
+
+    if (cache_file_store(cache_path, key, deps, 1 + darray_size(*includes),
+                         chunks, ARRAY_SIZE(chunks))) {
+        log_dbg(table->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "Stored Compose table for %s in cache %s\n", path, cache_path);
+    } else {
+        log_dbg(table->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "Could not write Compose cache file %s: %s\n",
+                cache_path, strerror(errno));
+    }
+
+out:
+    free(deps);
+    free(cache_path);
+    free(key);
+}
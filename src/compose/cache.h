@@ -0,0 +1,41 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "config.h"
+
+#include <stdbool.h>
+
+#include "darray.h"
+#include "table.h"
+
+/*
+ * Binary cache of compiled Compose tables
+ *
+ * The cache stores the ternary search tree and the UTF-8 pool of a compiled
+ * table, together with the modification time and size of the Compose file and
+ * all its includes. It is enabled by setting the `XKB_COMPOSE_CACHE_DIR`
+ * environment variable to a writable directory.
+ *
+ * Tables loaded from the cache use the memory mapping of the cache file
+ * directly: their nodes and UTF-8 pool are read-only.
+ */
+
+/**
+ * Try to load the table compiled from the Compose file at `path`.
+ *
+ * @returns true on cache hit, false otherwise. On failure the table is left
+ * untouched.
+ */
+bool
+compose_cache_load(struct xkb_compose_table *table, const char *path);
+
+/**
+ * Store the table compiled from the Compose file at `path` and the given
+ * included files. Failure is not an error.
+ */
+void
+compose_cache_store(const struct xkb_compose_table *table, const char *path,
+                    const darray_string *includes);
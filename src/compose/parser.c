@@ -537,6 +537,17 @@ do_include(struct xkb_compose_table *table, struct scanner *s,
         goto err_file;
     }
 
+    /* Record the dependency, e.g. for the Compose cache */
+    darray_string * const includes = s->priv;
+    if (includes) {
+        char * const include = strdup(path);
+        if (!include) {
+            ok = false;
+            goto err_unmap;
+        }
+        darray_append(*includes, include);
+    }
+
     scanner_init(&new_s, table->ctx, string, size, path, s->priv);
 
     ok = parse(table, &new_s, include_depth + 1);
@@ -785,12 +796,12 @@ finished:
     return true;
 }
 
-bool
-parse_string(struct xkb_compose_table *table, const char *string, size_t len,
-             const char *file_name)
+static bool
+parse_buffer(struct xkb_compose_table *table, const char *string, size_t len,
+             const char *file_name, darray_string *includes)
 {
     struct scanner s;
-    scanner_init(&s, table->ctx, string, len, file_name, NULL);
+    scanner_init(&s, table->ctx, string, len, file_name, includes);
     if (!parse(table, &s, 0))
         return false;
     /* Maybe the allocator can use the excess space. */
@@ -800,7 +811,15 @@ parse_string(struct xkb_compose_table *table, const char *string, size_t len,
 }
 
 bool
-parse_file(struct xkb_compose_table *table, FILE *file, const char *file_name)
+parse_string(struct xkb_compose_table *table, const char *string, size_t len,
+             const char *file_name)
+{
+    return parse_buffer(table, string, len, file_name, NULL);
+}
+
+bool
+parse_file(struct xkb_compose_table *table, FILE *file, const char *file_name,
+           darray_string *includes)
 {
     bool ok;
     char *string;
@@ -814,7 +833,7 @@ parse_file(struct xkb_compose_table *table, FILE *file, const char *file_name)
         return false;
     }
 
-    ok = parse_string(table, string, size, file_name);
+    ok = parse_buffer(table, string, size, file_name, includes);
     unmap_file(string, size);
     return ok;
 }
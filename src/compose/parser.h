@@ -13,6 +13,7 @@
 #include "xkbcommon/xkbcommon.h"
 #include "xkbcommon/xkbcommon-compose.h"
 
+#include "src/darray.h"
 #include "src/utils.h"
 
 XKB_EXPORT_PRIVATE char *
@@ -23,6 +24,10 @@ parse_string(struct xkb_compose_table *table,
              const char *string, size_t len,
              const char *file_name);
 
+/**
+ * Parse a Compose file. If `includes` is not NULL, the paths of the included
+ * files are appended to it; the caller owns them.
+ */
 bool
 parse_file(struct xkb_compose_table *table,
-           FILE *file, const char *file_name);
+           FILE *file, const char *file_name, darray_string *includes);
@@ -136,6 +136,12 @@ get_xcomposefile_path(struct xkb_context *ctx)
     return strdup_safe(xkb_context_getenv(ctx, "XCOMPOSEFILE"));
 }
 
+const char *
+get_compose_cache_dir_path(struct xkb_context *ctx)
+{
+    return xkb_context_getenv(ctx, "XKB_COMPOSE_CACHE_DIR");
+}
+
 char *
 get_xdg_xcompose_file_path(struct xkb_context *ctx)
 {
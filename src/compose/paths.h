@@ -18,6 +18,9 @@ get_xlocaledir_path(struct xkb_context *ctx);
 char *
 get_xcomposefile_path(struct xkb_context *ctx);
 
+const char *
+get_compose_cache_dir_path(struct xkb_context *ctx);
+
 char *
 get_xdg_xcompose_file_path(struct xkb_context *ctx);
 
@@ -14,6 +14,7 @@
 #include "table.h"
 #include "parser.h"
 #include "paths.h"
+#include "cache.h"
 
 static struct xkb_compose_table *
 xkb_compose_table_new(struct xkb_context *ctx, const char *func,
@@ -87,8 +88,12 @@ xkb_compose_table_unref(struct xkb_compose_table *table)
     if (!table || --table->refcnt > 0)
         return;
     free(table->locale);
-    darray_free(table->nodes);
-    darray_free(table->utf8);
+    if (table->cache_map) {
+        unmap_file(table->cache_map, table->cache_map_size);
+    } else {
+        darray_free(table->nodes);
+        darray_free(table->utf8);
+    }
     xkb_context_unref(table->ctx);
     free(table);
 }
@@ -105,7 +110,7 @@ xkb_compose_table_new_from_file(struct xkb_context *ctx,
     if (!table)
         return NULL;
 
-    if (!parse_file(table, file, "(unknown file)")) {
+    if (!parse_file(table, file, "(unknown file)", NULL)) {
         xkb_compose_table_unref(table);
         return NULL;
     }
@@ -176,8 +181,23 @@ xkb_compose_table_new_from_locale(struct xkb_context *ctx,
 
 found_path:
     {} /* Label followed by a declaration is a C23 extension */
-    const bool ok = parse_file(table, file, path);
+    const bool use_cache = !isempty(get_compose_cache_dir_path(ctx));
+    if (use_cache && compose_cache_load(table, path)) {
+        fclose(file);
+        free(path);
+        return table;
+    }
+
+    darray_string includes = darray_new();
+    const bool ok = parse_file(table, file, path,
+                               (use_cache ? &includes : NULL));
     fclose(file);
+    if (ok && use_cache)
+        compose_cache_store(table, path, &includes);
+    char **include;
+    darray_foreach(include, includes)
+        free(*include);
+    darray_free(includes);
     if (!ok) {
         free(path);
         xkb_compose_table_unref(table);
@@ -100,6 +100,10 @@ struct xkb_compose_table {
 
     darray_char utf8;
     darray(struct compose_node) nodes;
+
+    /* Memory mapping of the cache file backing `utf8` and `nodes`, if any */
+    char *cache_map;
+    size_t cache_map_size;
 };
 
 struct xkb_compose_table_entry {
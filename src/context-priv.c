@@ -52,6 +52,14 @@ xkb_context_init_includes(struct xkb_context *ctx)
     return true;
 }
 
+void
+xkb_context_track_file(struct xkb_context *ctx, const char *path)
+{
+    /* NULL entries denote allocation failures */
+    if (ctx->tracked_files)
+        darray_append(*ctx->tracked_files, strdup(path));
+}
+
 darray_size_t
 xkb_context_num_failed_include_paths(struct xkb_context *ctx)
 {
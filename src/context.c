@@ -416,6 +416,11 @@ xkb_context_unref(struct xkb_context *ctx)
         return;
 
     free(ctx->x11_atom_cache);
+    free(ctx->keymap_cache_dir);
+    if (ctx->file_index)
+        ctx->file_index_free(ctx->file_index);
+    if (ctx->rules_index)
+        ctx->rules_index_free(ctx->rules_index);
     xkb_context_include_path_clear(ctx);
     atom_table_free(ctx->atom_table);
     free(ctx);
@@ -604,3 +609,20 @@ xkb_context_set_user_data(struct xkb_context *ctx, void *user_data)
 {
     ctx->user_data = user_data;
 }
+
+bool
+xkb_context_set_keymap_cache_dir(struct xkb_context *ctx, const char *path)
+{
+    char *dir = NULL;
+    if (path) {
+        dir = strdup(path);
+        if (!dir) {
+            log_err(ctx, XKB_ERROR_ALLOCATION_ERROR,
+                    "Could not set keymap cache directory: %s\n", path);
+            return false;
+        }
+    }
+    free(ctx->keymap_cache_dir);
+    ctx->keymap_cache_dir = dir;
+    return true;
+}
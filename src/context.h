@@ -38,6 +38,22 @@ struct xkb_context {
     /* Used and allocated by xkbcommon-x11, free()d with the context. */
     void *x11_atom_cache;
 
+    /* Directory of the compiled keymap cache, if enabled */
+    char *keymap_cache_dir;
+    /*
+     * Files looked up during the compilation of a keymap; only recorded when
+     * not NULL, e.g. for the keymap cache.
+     */
+    darray_string *tracked_files;
+
+    /* Index of the sections of the XKB files, see xkbcomp/file-index.h */
+    struct xkb_file_index *file_index;
+    /* Set along with the index, so that the context does not depend on it */
+    void (*file_index_free)(struct xkb_file_index *index);
+    /* Parsed rules files, see xkbcomp/rules.c */
+    struct xkb_rules_index *rules_index;
+    void (*rules_index_free)(struct xkb_rules_index *index);
+
     /* Buffer for the *Text() functions. */
     char text_buffer[2048];
     size_t text_next;
@@ -53,6 +69,10 @@ xkb_context_getenv(struct xkb_context *ctx, const char *name);
 darray_size_t
 xkb_context_num_failed_include_paths(struct xkb_context *ctx);
 
+/** Record a file looked up during a keymap compilation, if tracking files */
+void
+xkb_context_track_file(struct xkb_context *ctx, const char *path);
+
 bool
 xkb_context_init_includes(struct xkb_context *ctx);
 
@@ -144,6 +144,7 @@ enum xkb_enumerations_values {
     ,
     XKB_EVENTS_FLAGS_VALUES
         = XKB_EVENTS_NO_FLAGS
+        | XKB_EVENTS_QUEUE_DROP_ON_OVERFLOW
     ,
     XKB_MACHINE_BUILDER_FLAGS_VALUES
         = XKB_MACHINE_BUILDER_NO_FLAGS
@@ -305,6 +306,7 @@ static const uint32_t xkb_keyboard_control_flags_values[] = {
 #ifdef ENABLE_PRIVATE_APIS
 static const uint32_t xkb_events_flags_values[] = {
     XKB_EVENTS_NO_FLAGS,
+    XKB_EVENTS_QUEUE_DROP_ON_OVERFLOW,
 };
 #endif
 
@@ -0,0 +1,811 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "atom.h"
+#include "cache-file.h"
+#include "context.h"
+#include "darray.h"
+#include "keymap.h"
+#include "keymap-cache.h"
+#include "messages-codes.h"
+#include "utils.h"
+#include "utils-numbers.h"
+
+/*
+ * Binary form of a keymap
+ *
+ * The keymap structures are mostly stored verbatim, with their pointers
+ * cleared and replaced by the serialization of the data they point to:
+ *
+ *     header
+ *     section names
+ *     modifiers: name + struct xkb_mod
+ *     LEDs:      name + struct xkb_led
+ *     types:     name + struct xkb_key_type + level names + entries
+ *     interprets: struct xkb_sym_interpret + actions (if more than 1)
+ *     keys:      name + struct xkb_key + overlays + groups
+ *                groups: type index + struct xkb_group + levels
+ *                levels: struct xkb_level + keysyms and actions (if more than 1)
+ *     key aliases
+ *     group names
+ *
+ * Atoms are stored as strings and interned on loading. Strings are prefixed
+ * by their length.
+ *
+ * Since the structures are stored verbatim, the cache key includes their
+ * sizes and the library version. The data is nevertheless validated when
+ * loaded, so that it cannot result in out-of-bounds accesses.
+ */
+
+#define KEYMAP_CACHE_VERSION 1
+#define KEYMAP_CACHE_EXTENSION "xkbkeymap"
+
+/** Length of a NULL string or of `XKB_ATOM_NONE` */
+#define NULL_STRING_LENGTH UINT32_MAX
+/** Index of a NULL key or type */
+#define NULL_INDEX UINT32_MAX
+
+struct keymap_cache_header {
+    uint32_t num_leds;
+    uint32_t num_mods;
+    uint32_t explicit_vmods;
+    uint32_t canonical_state_mask;
+    uint32_t min_key_code;
+    uint32_t max_key_code;
+    uint32_t num_keys;
+    uint32_t num_keys_low;
+    uint32_t num_types;
+    uint32_t num_sym_interprets;
+    uint32_t num_key_aliases;
+    uint32_t redirect_key_auto;
+    uint32_t num_groups;
+    uint32_t num_group_names;
+};
+
+static inline const char *
+safe_string(const char *string)
+{
+    return string ? string : "";
+}
+
+/**
+ * Build the cache key: everything that may change the result of the
+ * compilation of the keymap, apart from the files contents.
+ */
+static char *
+get_cache_key(struct xkb_keymap *keymap, const struct xkb_rule_names *rmlvo)
+{
+    struct xkb_context * const ctx = keymap->ctx;
+    darray_char key = darray_new();
+
+    /* Structures layout */
+    char * const header = asprintf_safe(
+        "keymap %d %s %zu %zu %zu %zu %zu %zu %zu %zu %zu\n"
+        "%d\n%d\n%s\n%s\n%s\n%s\n%s\n%s\n",
+        KEYMAP_CACHE_VERSION, LIBXKBCOMMON_VERSION,
+        sizeof(struct xkb_key), sizeof(struct xkb_group),
+        sizeof(struct xkb_level), sizeof(union xkb_action),
+        sizeof(struct xkb_key_type), sizeof(struct xkb_key_type_entry),
+        sizeof(struct xkb_sym_interpret), sizeof(struct xkb_led),
+        sizeof(struct xkb_mod),
+        keymap->format, keymap->flags,
+        safe_string(rmlvo->rules), safe_string(rmlvo->model),
+        safe_string(rmlvo->layout), safe_string(rmlvo->variant),
+        safe_string(rmlvo->options),
+        safe_string(xkb_context_getenv(ctx, "HOME")));
+    if (!header)
+        return NULL;
+    darray_append_string(key, header);
+    free(header);
+
+    /* Include paths */
+    const unsigned int num_includes = xkb_context_num_include_paths(ctx);
+    for (unsigned int i = 0; i < num_includes; i++) {
+        darray_append_string(key, xkb_context_include_path_get(ctx, i));
+        darray_append(key, '\n');
+    }
+
+    darray_append(key, '\0');
+    char *string = NULL;
+    darray_steal(key, &string, NULL);
+    return string;
+}
+
+/***====================================================================***/
+
+struct writer {
+    struct xkb_context *ctx;
+    darray_char buf;
+};
+
+static void
+write_bytes(struct writer *w, const void *data, size_t size)
+{
+    darray_append_items(w->buf, (const char *) data, (darray_size_t) size);
+}
+
+#define write_value(w, value) write_bytes((w), &(value), sizeof(value))
+
+static void
+write_uint32(struct writer *w, uint32_t value)
+{
+    write_value(w, value);
+}
+
+static void
+write_string(struct writer *w, const char *string)
+{
+    if (!string) {
+        write_uint32(w, NULL_STRING_LENGTH);
+        return;
+    }
+    const uint32_t length = (uint32_t) strlen(string);
+    write_uint32(w, length);
+    write_bytes(w, string, length);
+}
+
+static void
+write_atom(struct writer *w, xkb_atom_t atom)
+{
+    write_string(w, (atom == XKB_ATOM_NONE)
+                        ? NULL
+                        : xkb_atom_text(w->ctx, atom));
+}
+
+static void
+write_key_type(struct writer *w, const struct xkb_key_type *type)
+{
+    write_atom(w, type->name);
+    struct xkb_key_type copy = *type;
+    copy.name = XKB_ATOM_NONE;
+    copy.level_names = NULL;
+    copy.entries = NULL;
+    copy.entries_lut = NULL;
+    write_value(w, copy);
+    for (xkb_level_index_t l = 0; l < type->num_level_names; l++)
+        write_atom(w, type->level_names[l]);
+    write_bytes(w, type->entries, type->num_entries * sizeof(*type->entries));
+}
+
+static void
+write_interpret(struct writer *w, const struct xkb_sym_interpret *interp)
+{
+    struct xkb_sym_interpret copy = *interp;
+    if (interp->num_actions > 1)
+        copy.a.actions = NULL;
+    write_value(w, copy);
+    if (interp->num_actions > 1) {
+        write_bytes(w, interp->a.actions,
+                    interp->num_actions * sizeof(*interp->a.actions));
+    }
+}
+
+static void
+write_key(struct writer *w, const struct xkb_keymap *keymap,
+          const struct xkb_key *key)
+{
+    write_atom(w, key->name);
+    struct xkb_key copy = *key;
+    copy.name = XKB_ATOM_NONE;
+    copy.groups = NULL;
+    if (key->overlays_inline)
+        copy.overlay_key = NULL;
+    else
+        copy.overlays_keys = NULL;
+    write_value(w, copy);
+
+    /* Overlays */
+    const uint32_t num_overlays = (key->overlays_inline)
+        ? 1
+        : (key->overlays_keys ? popcount32(key->overlays) : 0);
+    const struct xkb_key * const *overlays_keys = (key->overlays_inline)
+        ? &key->overlay_key
+        : key->overlays_keys;
+    write_uint32(w, num_overlays);
+    for (uint32_t o = 0; o < num_overlays; o++) {
+        write_uint32(w, (overlays_keys[o])
+                            ? (uint32_t) (overlays_keys[o] - keymap->keys)
+                            : NULL_INDEX);
+    }
+
+    /* Groups */
+    for (xkb_layout_index_t g = 0; g < key->num_groups; g++) {
+        const struct xkb_group * const group = &key->groups[g];
+        write_uint32(w, (uint32_t) (group->type - keymap->types));
+        struct xkb_group group_copy = *group;
+        group_copy.type = NULL;
+        group_copy.levels = NULL;
+        write_value(w, group_copy);
+        for (xkb_level_index_t l = 0; l < group->type->num_levels; l++) {
+            const struct xkb_level * const level = &group->levels[l];
+            struct xkb_level level_copy = *level;
+            if (level->num_syms > 1)
+                level_copy.s.syms = NULL;
+            if (level->num_actions > 1)
+                level_copy.a.actions = NULL;
+            write_value(w, level_copy);
+            if (level->num_syms > 1) {
+                write_bytes(w, level->s.syms,
+                            XkbLevelSymsCount(level) * sizeof(*level->s.syms));
+            }
+            if (level->num_actions > 1) {
+                write_bytes(w, level->a.actions,
+                            level->num_actions * sizeof(*level->a.actions));
+            }
+        }
+    }
+}
+
+static void
+write_keymap(struct writer *w, const struct xkb_keymap *keymap)
+{
+    const struct keymap_cache_header header = {
+        .num_leds = keymap->num_leds,
+        .num_mods = keymap->mods.num_mods,
+        .explicit_vmods = keymap->mods.explicit_vmods,
+        .canonical_state_mask = keymap->canonical_state_mask,
+        .min_key_code = keymap->min_key_code,
+        .max_key_code = keymap->max_key_code,
+        .num_keys = keymap->num_keys,
+        .num_keys_low = keymap->num_keys_low,
+        .num_types = keymap->num_types,
+        .num_sym_interprets = keymap->num_sym_interprets,
+        .num_key_aliases = keymap->num_key_aliases,
+        .redirect_key_auto = keymap->redirect_key_auto,
+        .num_groups = keymap->num_groups,
+        .num_group_names = keymap->num_group_names,
+    };
+    write_value(w, header);
+
+    write_string(w, keymap->keycodes_section_name);
+    write_string(w, keymap->types_section_name);
+    write_string(w, keymap->compat_section_name);
+    write_string(w, keymap->symbols_section_name);
+
+    for (xkb_mod_index_t m = 0; m < keymap->mods.num_mods; m++) {
+        write_atom(w, keymap->mods.mods[m].name);
+        struct xkb_mod copy = keymap->mods.mods[m];
+        copy.name = XKB_ATOM_NONE;
+        write_value(w, copy);
+    }
+
+    for (xkb_led_index_t l = 0; l < keymap->num_leds; l++) {
+        write_atom(w, keymap->leds[l].name);
+        struct xkb_led copy = keymap->leds[l];
+        copy.name = XKB_ATOM_NONE;
+        write_value(w, copy);
+    }
+
+    for (darray_size_t t = 0; t < keymap->num_types; t++)
+        write_key_type(w, &keymap->types[t]);
+
+    for (darray_size_t i = 0; i < keymap->num_sym_interprets; i++)
+        write_interpret(w, &keymap->sym_interprets[i]);
+
+    for (xkb_keycode_t k = 0; k < keymap->num_keys; k++)
+        write_key(w, keymap, &keymap->keys[k]);
+
+    for (darray_size_t a = 0; a < keymap->num_key_aliases; a++) {
+        write_atom(w, keymap->key_aliases[a].real);
+        write_atom(w, keymap->key_aliases[a].alias);
+    }
+
+    for (xkb_layout_index_t g = 0; g < keymap->num_group_names; g++)
+        write_atom(w, keymap->group_names[g]);
+}
+
+/***====================================================================***/
+
+struct reader {
+    struct xkb_context *ctx;
+    const char *data;
+    size_t size;
+    size_t pos;
+};
+
+static bool
+read_bytes(struct reader *r, void *out, size_t size)
+{
+    if (size > r->size - r->pos)
+        return false;
+    memcpy(out, r->data + r->pos, size);
+    r->pos += size;
+    return true;
+}
+
+#define read_value(r, value) read_bytes((r), (value), sizeof(*(value)))
+
+/** Allocate and read an array of `count` items of `size` bytes */
+static bool
+read_array(struct reader *r, void **out, size_t count, size_t size)
+{
+    *out = NULL;
+    if (count == 0)
+        return true;
+    if (count > (r->size - r->pos) / size)
+        return false;
+    *out = malloc(count * size);
+    if (!*out)
+        return false;
+    return read_bytes(r, *out, count * size);
+}
+
+static bool
+read_string_view(struct reader *r, const char **string, uint32_t *length)
+{
+    if (!read_value(r, length))
+        return false;
+    if (*length == NULL_STRING_LENGTH) {
+        *string = NULL;
+        return true;
+    }
+    if (*length > r->size - r->pos)
+        return false;
+    *string = r->data + r->pos;
+    r->pos += *length;
+    return true;
+}
+
+static bool
+read_string(struct reader *r, char **out)
+{
+    const char *string;
+    uint32_t length;
+    if (!read_string_view(r, &string, &length))
+        return false;
+    if (!string) {
+        *out = NULL;
+        return true;
+    }
+    *out = strndup(string, length);
+    return *out != NULL;
+}
+
+static bool
+read_atom(struct reader *r, xkb_atom_t *atom)
+{
+    const char *string;
+    uint32_t length;
+    if (!read_string_view(r, &string, &length))
+        return false;
+    if (!string) {
+        *atom = XKB_ATOM_NONE;
+        return true;
+    }
+    *atom = xkb_atom_intern(r->ctx, string, length);
+    return *atom != XKB_ATOM_NONE;
+}
+
+static bool
+read_key_type(struct reader *r, struct xkb_key_type *type)
+{
+    xkb_atom_t name;
+    struct xkb_key_type copy;
+    if (!read_atom(r, &name) || !read_value(r, &copy))
+        return false;
+
+    if (copy.num_levels == 0 || copy.num_levels > XKB_LEVEL_MAX_IMPL ||
+        copy.num_level_names > XKB_LEVEL_MAX_IMPL)
+        return false;
+
+    /* Keep the type consistent at any point, so that it can be freed */
+    type->name = name;
+    type->mods = copy.mods;
+    type->required = copy.required;
+    type->num_levels = copy.num_levels;
+
+    if (copy.num_level_names > 0) {
+        type->level_names = calloc(copy.num_level_names,
+                                   sizeof(*type->level_names));
+        if (!type->level_names)
+            return false;
+        type->num_level_names = copy.num_level_names;
+        for (xkb_level_index_t l = 0; l < type->num_level_names; l++) {
+            if (!read_atom(r, &type->level_names[l]))
+                return false;
+        }
+    }
+
+    if (!read_array(r, (void **) &type->entries, copy.num_entries,
+                    sizeof(*type->entries)))
+        return false;
+    type->num_entries = copy.num_entries;
+    for (darray_size_t e = 0; e < type->num_entries; e++) {
+        if (type->entries[e].level >= type->num_levels)
+            return false;
+    }
+
+    return XkbKeyTypeUpdateEntriesLUT(type);
+}
+
+static bool
+read_interpret(struct reader *r, struct xkb_sym_interpret *interp)
+{
+    struct xkb_sym_interpret copy;
+    if (!read_value(r, &copy))
+        return false;
+    if (copy.num_actions > 1) {
+        union xkb_action *actions;
+        if (!read_array(r, (void **) &actions, copy.num_actions,
+                        sizeof(*actions)))
+            return false;
+        copy.a.actions = actions;
+    }
+    *interp = copy;
+    return true;
+}
+
+static bool
+read_level(struct reader *r, struct xkb_level *level)
+{
+    struct xkb_level copy;
+    if (!read_value(r, &copy))
+        return false;
+
+    if (copy.num_syms > 1) {
+        xkb_keysym_t *syms;
+        if (!read_array(r, (void **) &syms, XkbLevelSymsCount(&copy),
+                        sizeof(*syms)))
+            return false;
+        copy.s.syms = syms;
+    }
+
+    if (copy.num_actions > 1) {
+        union xkb_action *actions;
+        if (!read_array(r, (void **) &actions, copy.num_actions,
+                        sizeof(*actions))) {
+            if (copy.num_syms > 1)
+                free(copy.s.syms);
+            return false;
+        }
+        copy.a.actions = actions;
+    }
+
+    *level = copy;
+    return true;
+}
+
+static bool
+read_key(struct reader *r, struct xkb_keymap *keymap, struct xkb_key *key)
+{
+    xkb_atom_t name;
+    struct xkb_key copy;
+    if (!read_atom(r, &name) || !read_value(r, &copy))
+        return false;
+
+    /* Clear pointers before committing the key, so that it can be freed */
+    const xkb_layout_index_t num_groups = copy.num_groups;
+    copy.name = name;
+    copy.num_groups = 0;
+    copy.groups = NULL;
+    if (copy.overlays_inline)
+        copy.overlay_key = NULL;
+    else
+        copy.overlays_keys = NULL;
+    *key = copy;
+
+    if (num_groups > keymap->num_groups ||
+        (key->out_of_range_group_policy == XKB_LAYOUT_OUT_OF_RANGE_REDIRECT &&
+         num_groups > 0 && key->out_of_range_group_number >= num_groups))
+        return false;
+
+    /* Overlays */
+    uint32_t num_overlays;
+    if (!read_value(r, &num_overlays))
+        return false;
+    if (key->overlays_inline) {
+        if (num_overlays != 1)
+            return false;
+    } else if (num_overlays != 0 && num_overlays != popcount32(key->overlays)) {
+        return false;
+    } else if (num_overlays > 0) {
+        key->overlays_keys = calloc(num_overlays, sizeof(*key->overlays_keys));
+        if (!key->overlays_keys)
+            return false;
+    }
+    for (uint32_t o = 0; o < num_overlays; o++) {
+        uint32_t index;
+        if (!read_value(r, &index))
+            return false;
+        if (index != NULL_INDEX && index >= keymap->num_keys)
+            return false;
+        const struct xkb_key * const overlay_key =
+            (index == NULL_INDEX) ? NULL : &keymap->keys[index];
+        if (key->overlays_inline)
+            key->overlay_key = overlay_key;
+        else
+            key->overlays_keys[o] = overlay_key;
+    }
+
+    /* Groups */
+    if (num_groups == 0)
+        return true;
+    key->groups = calloc(num_groups, sizeof(*key->groups));
+    if (!key->groups)
+        return false;
+    key->num_groups = num_groups;
+    for (xkb_layout_index_t g = 0; g < num_groups; g++) {
+        struct xkb_group * const group = &key->groups[g];
+        uint32_t type_index;
+        struct xkb_group group_copy;
+        if (!read_value(r, &type_index) || !read_value(r, &group_copy) ||
+            type_index >= keymap->num_types)
+            return false;
+
+        group_copy.type = &keymap->types[type_index];
+        group_copy.levels = calloc(group_copy.type->num_levels,
+                                   sizeof(*group_copy.levels));
+        if (!group_copy.levels)
+            return false;
+        *group = group_copy;
+
+        for (xkb_level_index_t l = 0; l < group->type->num_levels; l++) {
+            if (!read_level(r, &group->levels[l]))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static bool
+read_keymap(struct reader *r, struct xkb_keymap *keymap)
+{
+    struct keymap_cache_header header;
+    if (!read_value(r, &header))
+        return false;
+
+    if (header.num_leds > XKB_MAX_LEDS ||
+        header.num_mods < _XKB_MOD_INDEX_NUM_ENTRIES ||
+        header.num_mods > XKB_MAX_MODS ||
+        header.num_groups > XKB_MAX_GROUPS ||
+        header.min_key_code > header.max_key_code ||
+        header.max_key_code > XKB_KEYCODE_MAX ||
+        header.num_keys_low > header.num_keys ||
+        header.num_keys_low > XKB_KEYCODE_MAX_CONTIGUOUS + 1 ||
+        (header.num_keys_low > 0 &&
+         header.min_key_code >= header.num_keys_low))
+        return false;
+
+    keymap->num_leds = header.num_leds;
+    keymap->mods.num_mods = header.num_mods;
+    keymap->mods.explicit_vmods = header.explicit_vmods;
+    keymap->canonical_state_mask = header.canonical_state_mask;
+    keymap->redirect_key_auto = header.redirect_key_auto;
+    keymap->num_groups = header.num_groups;
+
+    if (!read_string(r, &keymap->keycodes_section_name) ||
+        !read_string(r, &keymap->types_section_name) ||
+        !read_string(r, &keymap->compat_section_name) ||
+        !read_string(r, &keymap->symbols_section_name))
+        return false;
+
+    for (xkb_mod_index_t m = 0; m < keymap->mods.num_mods; m++) {
+        xkb_atom_t name;
+        if (!read_atom(r, &name) || !read_value(r, &keymap->mods.mods[m]))
+            return false;
+        keymap->mods.mods[m].name = name;
+    }
+
+    for (xkb_led_index_t l = 0; l < keymap->num_leds; l++) {
+        xkb_atom_t name;
+        if (!read_atom(r, &name) || !read_value(r, &keymap->leds[l]))
+            return false;
+        keymap->leds[l].name = name;
+    }
+
+    /* Check the counts before allocating: each item takes at least 1 byte */
+    if (header.num_types > r->size - r->pos ||
+        header.num_sym_interprets > r->size - r->pos ||
+        header.num_keys > r->size - r->pos ||
+        header.num_key_aliases > r->size - r->pos)
+        return false;
+
+    /* Types */
+    if (header.num_types > 0) {
+        keymap->types = calloc(header.num_types, sizeof(*keymap->types));
+        if (!keymap->types)
+            return false;
+        keymap->num_types = header.num_types;
+        for (darray_size_t t = 0; t < keymap->num_types; t++) {
+            if (!read_key_type(r, &keymap->types[t]))
+                return false;
+        }
+    }
+
+    /* Interprets */
+    if (header.num_sym_interprets > 0) {
+        keymap->sym_interprets = calloc(header.num_sym_interprets,
+                                        sizeof(*keymap->sym_interprets));
+        if (!keymap->sym_interprets)
+            return false;
+        keymap->num_sym_interprets = header.num_sym_interprets;
+        for (darray_size_t i = 0; i < keymap->num_sym_interprets; i++) {
+            if (!read_interpret(r, &keymap->sym_interprets[i]))
+                return false;
+        }
+    }
+
+    /* Keys */
+    if (header.num_keys > 0) {
+        keymap->keys = calloc(header.num_keys, sizeof(*keymap->keys));
+        if (!keymap->keys)
+            return false;
+        keymap->min_key_code = header.min_key_code;
+        keymap->max_key_code = header.max_key_code;
+        keymap->num_keys = header.num_keys;
+        keymap->num_keys_low = header.num_keys_low;
+        xkb_keycode_t previous = XKB_KEYCODE_MAX_CONTIGUOUS;
+        for (xkb_keycode_t k = 0; k < keymap->num_keys; k++) {
+            struct xkb_key * const key = &keymap->keys[k];
+            if (!read_key(r, keymap, key))
+                return false;
+            /* Check the keys order, required by XkbKey() */
+            if (k >= keymap->num_keys_low) {
+                if (key->keycode <= previous ||
+                    key->keycode > keymap->max_key_code)
+                    return false;
+                previous = key->keycode;
+            } else if (k >= keymap->min_key_code && key->keycode != k) {
+                return false;
+            }
+        }
+    }
+
+    /* Key aliases */
+    if (header.num_key_aliases > 0) {
+        keymap->key_aliases = calloc(header.num_key_aliases,
+                                     sizeof(*keymap->key_aliases));
+        if (!keymap->key_aliases)
+            return false;
+        keymap->num_key_aliases = header.num_key_aliases;
+        for (darray_size_t a = 0; a < keymap->num_key_aliases; a++) {
+            if (!read_atom(r, &keymap->key_aliases[a].real) ||
+                !read_atom(r, &keymap->key_aliases[a].alias))
+                return false;
+        }
+    }
+
+    /* Group names */
+    if (header.num_group_names > 0) {
+        if (header.num_group_names > XKB_MAX_GROUPS)
+            return false;
+        keymap->group_names = calloc(header.num_group_names,
+                                     sizeof(*keymap->group_names));
+        if (!keymap->group_names)
+            return false;
+        keymap->num_group_names = header.num_group_names;
+        for (xkb_layout_index_t g = 0; g < keymap->num_group_names; g++) {
+            if (!read_atom(r, &keymap->group_names[g]))
+                return false;
+        }
+    }
+
+    return r->pos == r->size;
+}
+
+/***====================================================================***/
+
+bool
+keymap_cache_load(struct xkb_keymap *keymap, const struct xkb_rule_names *rmlvo)
+{
+    bool ok = false;
+    struct cache_file file = { 0 };
+
+    char * const key = get_cache_key(keymap, rmlvo);
+    char * const cache_path = (key)
+        ? cache_file_get_path(keymap->ctx->keymap_cache_dir, key,
+                              KEYMAP_CACHE_EXTENSION)
+        : NULL;
+    if (!cache_path)
+        goto out;
+    switch (cache_file_load(cache_path, key, &file)) {
+    case CACHE_FILE_LOADED:
+        break;
+    case CACHE_FILE_INVALID:
+        log_dbg(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "Invalid keymap cache file: %s\n", cache_path);
+        goto out;
+    case CACHE_FILE_OUTDATED:
+        log_dbg(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "Keymap cache file %s is outdated\n", cache_path);
+        goto out;
+    default:
+        goto out;
+    }
+
+    struct reader reader = {
+        .ctx = keymap->ctx,
+        .data = file.payload,
+        .size = file.payload_size,
+        .pos = 0,
+    };
+    ok = read_keymap(&reader, keymap);
+    if (ok) {
+        keymap_freeze(keymap);
+        log_dbg(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "Loaded keymap from cache %s\n", cache_path);
+    } else {
+        log_dbg(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "Invalid keymap cache file: %s\n", cache_path);
+    }
+
+out:
+    cache_file_unload(&file);
+    free(cache_path);
+    free(key);
+    return ok;
+}
+
+static int
+compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+void
+keymap_cache_store(struct xkb_keymap *keymap,
+                   const struct xkb_rule_names *rmlvo,
+                   const darray_string *tracked_files)
+{
+    /* Sort and deduplicate the dependencies */
+    const darray_size_t num_files = darray_size(*tracked_files);
+    const char ** const deps = calloc(num_files + 1, sizeof(*deps));
+    if (!deps)
+        return;
+    for (darray_size_t f = 0; f < num_files; f++) {
+        deps[f] = darray_item(*tracked_files, f);
+        if (!deps[f]) {
+            /* Failed to record a dependency */
+            free(deps);
+            return;
+        }
+    }
+    qsort(deps, num_files, sizeof(*deps), compare_paths);
+    size_t num_deps = 0;
+    for (darray_size_t f = 0; f < num_files; f++) {
+        if (num_deps == 0 || strcmp(deps[num_deps - 1], deps[f]) != 0)
+            deps[num_deps++] = deps[f];
+    }
+
+    struct writer writer = { .ctx = keymap->ctx, .buf = darray_new() };
+    char * const key = get_cache_key(keymap, rmlvo);
+    char * const cache_path = (key)
+        ? cache_file_get_path(keymap->ctx->keymap_cache_dir, key,
+                              KEYMAP_CACHE_EXTENSION)
+        : NULL;
+    if (!cache_path)
+        goto out;
+
+    write_keymap(&writer, keymap);
+    const struct cache_chunk chunk = {
+        .data = darray_items(writer.buf),
+        .size = darray_size(writer.buf),
+    };
+    if (!chunk.data)
+        goto out;
+    if (cache_file_store(cache_path, key, deps, num_deps, &chunk, 1)) {
+        log_dbg(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "Stored keymap in cache %s\n", cache_path);
+    } else {
+        log_dbg(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "Could not write keymap cache file %s: %s\n",
+                cache_path, strerror(errno));
+    }
+
+out:
+    darray_free(writer.buf);
+    free(cache_path);
+    free(key);
+    free(deps);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "config.h"
+
+#include <stdbool.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "darray.h"
+#include "keymap.h"
+
+/*
+ * Cache of compiled keymaps
+ *
+ * Keymaps compiled from RMLVO names are stored in a binary form in the cache
+ * directory of the context (see `xkb_context_set_keymap_cache_dir()`), keyed
+ * by the resolved RMLVO names, the keymap format, the compilation flags and
+ * the include paths. The dependencies of a cache entry are all the files
+ * looked up during the compilation, whether they exist or not.
+ */
+
+/**
+ * Try to load the keymap compiled from the given resolved RMLVO names.
+ *
+ * `keymap` must be newly created with `xkb_keymap_new()`.
+ *
+ * @returns true on cache hit. On failure, the keymap may be partially filled
+ * and must be discarded.
+ */
+bool
+keymap_cache_load(struct xkb_keymap *keymap,
+                  const struct xkb_rule_names *rmlvo);
+
+/**
+ * Store the keymap compiled from the given resolved RMLVO names, using the
+ * files tracked during its compilation as dependencies.
+ * Failure is not an error.
+ */
+void
+keymap_cache_store(struct xkb_keymap *keymap,
+                   const struct xkb_rule_names *rmlvo,
+                   const darray_string *tracked_files);
@@ -9,7 +9,9 @@
 #include "config.h"
 
 #include <assert.h>
+#include <stdalign.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "xkbcommon/xkbcommon.h"
@@ -17,6 +19,7 @@
 #include "features/enums.h"
 #include "keymap.h"
 #include "messages-codes.h"
+#include "utils-numbers.h"
 
 static void
 update_builtin_keymap_fields(struct xkb_keymap *keymap)
@@ -114,6 +117,42 @@ XkbModNameToIndex(const struct xkb_mod_set *mods, xkb_atom_t name,
     return XKB_MOD_INVALID;
 }
 
+/**
+ * (Re)build the entries lookup table of a key type.
+ *
+ * Must be called once the effective masks of the type and its entries are
+ * resolved.
+ */
+bool
+XkbKeyTypeUpdateEntriesLUT(struct xkb_key_type *type)
+{
+    free(type->entries_lut);
+    type->entries_lut = NULL;
+
+    if (popcount32(type->mods.mask) > XKB_KEY_TYPE_LUT_MAX_MODS ||
+        type->num_entries >= UINT8_MAX) {
+        /* Fallback to linear scan */
+        return true;
+    }
+
+    uint8_t * const lut = calloc(UINT32_C(1) << popcount32(type->mods.mask),
+                                 sizeof(*lut));
+    if (!lut)
+        return false;
+
+    /* Iterate in reverse order, so that the first matching entry wins */
+    for (darray_size_t e = type->num_entries; e > 0; e--) {
+        const struct xkb_key_type_entry * const entry = &type->entries[e - 1];
+        /* Entries with modifiers not in the type can never match */
+        if (!entry_is_active(entry) || (entry->mods.mask & ~type->mods.mask))
+            continue;
+        lut[pext32(entry->mods.mask, type->mods.mask)] = (uint8_t) e;
+    }
+
+    type->entries_lut = lut;
+    return true;
+}
+
 bool
 XkbLevelsSameSyms(const struct xkb_level *a, const struct xkb_level *b)
 {
@@ -287,3 +326,210 @@ err:
     *actions = NULL;
     return 0;
 }
+
+/** Round up `offset` to the alignment of `type` */
+#define align_offset(offset, type) \
+    (((offset) + alignof(type) - 1) & ~(alignof(type) - 1))
+
+/**
+ * Relocate the groups, levels, keysyms and actions of all the keys into a
+ * single allocation, laid out in keycode order.
+ *
+ * The keys are no longer modified once the keymap is built, while their data
+ * is scattered across thousands of small allocations. Packing it reduces the
+ * allocator overhead and improves the locality of the lookups, which follow
+ * the key → group → level → keysyms/actions chain.
+ *
+ * On allocation failure, the keymap is left unchanged.
+ */
+static void
+pack_key_data(struct xkb_keymap *keymap)
+{
+    if (!keymap->keys || keymap->key_data)
+        return;
+
+    size_t num_groups = 0;
+    size_t num_levels = 0;
+    size_t num_syms = 0;
+    size_t num_actions = 0;
+    struct xkb_key *key;
+    xkb_keys_foreach(key, keymap) {
+        num_groups += key->num_groups;
+        for (xkb_layout_index_t g = 0; g < key->num_groups; g++) {
+            const struct xkb_group * const group = &key->groups[g];
+            num_levels += group->type->num_levels;
+            for (xkb_level_index_t l = 0; l < group->type->num_levels; l++) {
+                const struct xkb_level * const level = &group->levels[l];
+                if (level->num_syms > 1)
+                    num_syms += XkbLevelSymsCount(level);
+                if (level->num_actions > 1)
+                    num_actions += level->num_actions;
+            }
+        }
+    }
+
+    if (num_groups == 0)
+        return;
+
+    /* Sections are sorted by decreasing alignment requirements */
+    const size_t levels_offset =
+        align_offset(num_groups * sizeof(struct xkb_group), struct xkb_level);
+    const size_t actions_offset =
+        align_offset(levels_offset + num_levels * sizeof(struct xkb_level),
+                     union xkb_action);
+    const size_t syms_offset =
+        align_offset(actions_offset + num_actions * sizeof(union xkb_action),
+                     xkb_keysym_t);
+    const size_t size = syms_offset + num_syms * sizeof(xkb_keysym_t);
+
+    unsigned char * const data = malloc(size);
+    if (!data)
+        return;
+
+    struct xkb_group *groups = (struct xkb_group *) data;
+    struct xkb_level *levels = (struct xkb_level *) (data + levels_offset);
+    union xkb_action *actions = (union xkb_action *) (data + actions_offset);
+    xkb_keysym_t *syms = (xkb_keysym_t *) (data + syms_offset);
+
+    xkb_keys_foreach(key, keymap) {
+        if (key->num_groups == 0) {
+            free(key->groups);
+            key->groups = NULL;
+            continue;
+        }
+
+        struct xkb_group * const key_groups = groups;
+        for (xkb_layout_index_t g = 0; g < key->num_groups; g++) {
+            const struct xkb_group * const group = &key->groups[g];
+            *groups = *group;
+            groups->levels = levels;
+            for (xkb_level_index_t l = 0; l < group->type->num_levels; l++) {
+                const struct xkb_level * const level = &group->levels[l];
+                *levels = *level;
+                if (level->num_syms > 1) {
+                    const size_t count = XkbLevelSymsCount(level);
+                    memcpy(syms, level->s.syms, count * sizeof(*syms));
+                    free(level->s.syms);
+                    levels->s.syms = syms;
+                    syms += count;
+                }
+                if (level->num_actions > 1) {
+                    memcpy(actions, level->a.actions,
+                           level->num_actions * sizeof(*actions));
+                    free(level->a.actions);
+                    levels->a.actions = actions;
+                    actions += level->num_actions;
+                }
+                levels++;
+            }
+            free(group->levels);
+            groups++;
+        }
+        free(key->groups);
+        key->groups = key_groups;
+    }
+
+    keymap->key_data = data;
+}
+
+/**
+ * Insert a key name or alias in the key name index.
+ *
+ * If @p replace is false, an existing entry is kept: the first of keys with
+ * duplicate names wins, as with the linear search.
+ */
+static void
+key_name_index_insert(struct xkb_keymap *keymap, xkb_atom_t name,
+                      xkb_keycode_t keycode, bool replace)
+{
+    const darray_size_t mask = keymap->key_name_index_mask;
+    darray_size_t slot = key_name_index_slot(name, mask);
+    while (keymap->key_name_index[slot].name != XKB_ATOM_NONE &&
+           keymap->key_name_index[slot].name != name)
+        slot = (slot + 1) & mask;
+    if (keymap->key_name_index[slot].name == name && !replace)
+        return;
+    keymap->key_name_index[slot] = (struct key_name_entry) {
+        .name = name,
+        .keycode = keycode,
+    };
+}
+
+/**
+ * Build the key name → keycode hash table used by `xkb_keymap_key_by_name()`.
+ *
+ * Aliases are resolved here, so that a lookup is a single probe sequence.
+ * On allocation failure, the lookups fall back to linear searches.
+ */
+void
+keymap_build_key_name_index(struct xkb_keymap *keymap)
+{
+    if (keymap->key_name_index)
+        return;
+
+    darray_size_t count = keymap->num_key_aliases;
+    const struct xkb_key *key;
+    xkb_keys_foreach(key, keymap) {
+        if (key->name != XKB_ATOM_NONE)
+            count++;
+    }
+    if (count == 0)
+        return;
+
+    /* Load factor ≤ 0.5, so that probe sequences remain short */
+    darray_size_t size = 16;
+    while (size < 2 * count)
+        size *= 2;
+
+    keymap->key_name_index = calloc(size, sizeof(*keymap->key_name_index));
+    if (!keymap->key_name_index)
+        return;
+    keymap->key_name_index_mask = size - 1;
+
+    xkb_keys_foreach(key, keymap) {
+        if (key->name != XKB_ATOM_NONE)
+            key_name_index_insert(keymap, key->name, key->keycode, false);
+    }
+
+    /* Aliases take precedence over the key names */
+    for (darray_size_t i = 0; i < keymap->num_key_aliases; i++) {
+        const struct xkb_key_alias * const alias = &keymap->key_aliases[i];
+        /* The real key was inserted above */
+        const xkb_keycode_t keycode =
+            key_name_index_lookup(keymap, alias->real);
+        if (keycode != XKB_KEYCODE_INVALID)
+            key_name_index_insert(keymap, alias->alias, keycode, true);
+    }
+}
+
+/** Compute the union of the state components observed by the LEDs */
+static void
+build_led_dependencies(struct xkb_keymap *keymap)
+{
+    struct led_dependencies deps = { .built = true };
+    const struct xkb_led *led;
+    xkb_leds_foreach(led, keymap) {
+        if (led->which_mods & XKB_STATE_MODS_EFFECTIVE)
+            deps.mods_effective |= led->mods.mask;
+        if (led->which_mods & XKB_STATE_MODS_DEPRESSED)
+            deps.mods_depressed |= led->mods.mask;
+        if (led->which_mods & XKB_STATE_MODS_LATCHED)
+            deps.mods_latched |= led->mods.mask;
+        if (led->which_mods & XKB_STATE_MODS_LOCKED)
+            deps.mods_locked |= led->mods.mask;
+        deps.groups |= led->which_groups;
+        deps.ctrls |= led->ctrls;
+    }
+    keymap->led_deps = deps;
+}
+
+/**
+ * Finalize a keymap once it is built: its keys are not modified anymore.
+ */
+void
+keymap_freeze(struct xkb_keymap *keymap)
+{
+    build_led_dependencies(keymap);
+    keymap_build_key_name_index(keymap);
+    pack_key_data(keymap);
+}
@@ -14,12 +14,21 @@
 #include "config.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#if HAVE_MEMFD_CREATE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include "xkbcommon/xkbcommon.h"
 #include "atom.h"
 #include "features/enums.h"
 #include "keymap.h"
+#include "keymap-cache.h"
 #include "messages-codes.h"
 #include "text.h"
 
@@ -57,7 +66,7 @@ xkb_keymap_unref(struct xkb_keymap *keymap)
     if (keymap->keys) {
         struct xkb_key *key;
         xkb_keys_foreach(key, keymap) {
-            if (key->groups) {
+            if (key->groups && !keymap->key_data) {
                 for (xkb_layout_index_t i = 0; i < key->num_groups; i++) {
                     if (key->groups[i].levels) {
                         for (xkb_level_index_t j = 0;
@@ -75,9 +84,12 @@ xkb_keymap_unref(struct xkb_keymap *keymap)
         }
         free(keymap->keys);
     }
+    /* Groups, levels, keysyms and actions of a frozen keymap */
+    free(keymap->key_data);
     if (keymap->types) {
         for (darray_size_t i = 0; i < keymap->num_types; i++) {
             free(keymap->types[i].entries);
+            free(keymap->types[i].entries_lut);
             free(keymap->types[i].level_names);
         }
         free(keymap->types);
@@ -92,6 +104,18 @@ xkb_keymap_unref(struct xkb_keymap *keymap)
     free(keymap->symbols_section_name);
     free(keymap->types_section_name);
     free(keymap->compat_section_name);
+    struct keymap_serialization *serialization;
+    darray_foreach(serialization, keymap->serializations) {
+        free(serialization->string);
+#if HAVE_MEMFD_CREATE
+        if (serialization->fd >= 0)
+            close(serialization->fd);
+#endif
+    }
+    darray_free(keymap->serializations);
+    free(keymap->key_name_index);
+    darray_free(keymap->keysym_index.keysyms);
+    darray_free(keymap->keysym_index.utf32);
     xkb_context_unref(keymap->ctx);
     free(keymap);
 }
@@ -157,7 +181,38 @@ xkb_keymap_new_from_names2(struct xkb_context *ctx,
         rmlvo = *rmlvo_in;
     xkb_context_sanitize_rule_names(ctx, &rmlvo);
 
-    if (!ops->keymap_new_from_names(keymap, &rmlvo)) {
+    if (!ctx->keymap_cache_dir) {
+        if (!ops->keymap_new_from_names(keymap, &rmlvo)) {
+            xkb_keymap_unref(keymap);
+            return NULL;
+        }
+        return keymap;
+    }
+
+    /* Keymap cache */
+    if (keymap_cache_load(keymap, &rmlvo))
+        return keymap;
+
+    /* Cache miss: discard the partially loaded keymap and compile */
+    xkb_keymap_unref(keymap);
+    keymap = xkb_keymap_new(ctx, __func__, format, flags);
+    if (!keymap)
+        return NULL;
+
+    darray_string tracked_files = darray_new();
+    ctx->tracked_files = &tracked_files;
+    const bool ok = ops->keymap_new_from_names(keymap, &rmlvo);
+    ctx->tracked_files = NULL;
+
+    if (ok)
+        keymap_cache_store(keymap, &rmlvo, &tracked_files);
+
+    char **path;
+    darray_foreach(path, tracked_files)
+        free(*path);
+    darray_free(tracked_files);
+
+    if (!ok) {
         xkb_keymap_unref(keymap);
         return NULL;
     }
@@ -251,33 +306,160 @@ xkb_keymap_new_from_file(struct xkb_context *ctx,
     return keymap;
 }
 
-char *
-xkb_keymap_get_as_string2(struct xkb_keymap *keymap,
-                          enum xkb_keymap_format format,
-                          enum xkb_keymap_serialize_flags flags)
+/**
+ * Get the memoized serialization of a keymap, serializing it on first use.
+ *
+ * The result is owned by the keymap.
+ */
+static struct keymap_serialization *
+keymap_get_serialization(struct xkb_keymap *keymap, const char *func,
+                         enum xkb_keymap_format format,
+                         enum xkb_keymap_serialize_flags flags)
 {
     static const enum xkb_keymap_serialize_flags XKB_KEYMAP_SERIALIZE_FLAGS
         = (enum xkb_keymap_serialize_flags) XKB_KEYMAP_SERIALIZE_FLAGS_VALUES;
 
     if (flags & ~XKB_KEYMAP_SERIALIZE_FLAGS) {
-        log_err_func(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
-                     "unrecognized serialization flags: %#x\n",
-                     (flags & ~XKB_KEYMAP_SERIALIZE_FLAGS));
+        log_err(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "%s: unrecognized serialization flags: %#x\n",
+                func, (flags & ~XKB_KEYMAP_SERIALIZE_FLAGS));
         return NULL;
     }
 
     if (format == XKB_KEYMAP_USE_ORIGINAL_FORMAT)
         format = keymap->format;
 
+    struct keymap_serialization *serialization;
+    darray_foreach(serialization, keymap->serializations) {
+        if (serialization->format == format && serialization->flags == flags)
+            return serialization;
+    }
+
     const struct xkb_keymap_format_ops * const ops =
         get_keymap_format_ops(format);
     if (!ops || !ops->keymap_get_as_string) {
-        log_err_func(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
-                     "unsupported keymap format: %d\n", format);
+        log_err(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "%s: unsupported keymap format: %d\n", func, format);
         return NULL;
     }
 
-    return ops->keymap_get_as_string(keymap, format, flags);
+    char * const string = ops->keymap_get_as_string(keymap, format, flags);
+    if (!string)
+        return NULL;
+
+    darray_append(keymap->serializations, (struct keymap_serialization) {
+        .format = format,
+        .flags = flags,
+        .size = strlen(string) + 1,
+        .string = string,
+        .fd = -1,
+    });
+    return &darray_item(keymap->serializations,
+                        darray_size(keymap->serializations) - 1);
+}
+
+char *
+xkb_keymap_get_as_string2(struct xkb_keymap *keymap,
+                          enum xkb_keymap_format format,
+                          enum xkb_keymap_serialize_flags flags)
+{
+    const struct keymap_serialization * const serialization =
+        keymap_get_serialization(keymap, __func__, format, flags);
+    if (!serialization)
+        return NULL;
+
+    return memdup(serialization->string, serialization->size, 1);
+}
+
+#if HAVE_MEMFD_CREATE
+/** Create a read-only file with the given content */
+static int
+create_sealed_file(const char *data, size_t size)
+{
+    const int fd = memfd_create("xkb-keymap", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0)
+        return -1;
+
+    /* Do not move the file offset, so that readers start at the beginning */
+    size_t written = 0;
+    while (written < size) {
+        const ssize_t count = pwrite(fd, data + written, size - written,
+                                     (off_t) written);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            goto error;
+        }
+        written += (size_t) count;
+    }
+
+    if (fcntl(fd, F_ADD_SEALS,
+              F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0)
+        goto error;
+
+    return fd;
+
+error:
+    close(fd);
+    return -1;
+}
+
+/**
+ * Open a new read-only description of the sealed file, so that the file
+ * offset is not shared with the other holders of the file.
+ *
+ * Falls back to duplicating the descriptor if procfs is not available.
+ */
+static int
+open_sealed_file(int fd)
+{
+    char path[sizeof("/proc/self/fd/") + 3 * sizeof(int)];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    int ret = open(path, O_RDONLY | O_CLOEXEC);
+    if (ret < 0 && errno != EINTR)
+        ret = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    return ret;
+}
+#endif
+
+int
+xkb_keymap_get_as_fd(struct xkb_keymap *keymap,
+                     enum xkb_keymap_format format,
+                     enum xkb_keymap_serialize_flags flags,
+                     size_t *size)
+{
+#if HAVE_MEMFD_CREATE
+    struct keymap_serialization * const serialization =
+        keymap_get_serialization(keymap, __func__, format, flags);
+    if (!serialization)
+        return -1;
+
+    if (serialization->fd < 0) {
+        serialization->fd = create_sealed_file(serialization->string,
+                                               serialization->size);
+        if (serialization->fd < 0) {
+            log_err_func(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                         "cannot create the keymap file: %s\n",
+                         strerror(errno));
+            return -1;
+        }
+    }
+
+    const int fd = open_sealed_file(serialization->fd);
+    if (fd < 0) {
+        log_err_func(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                     "cannot open the keymap file: %s\n",
+                     strerror(errno));
+        return -1;
+    }
+
+    *size = serialization->size;
+    return fd;
+#else
+    log_err_func1(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                  "sealed files are not supported on this platform\n");
+    return -1;
+#endif
 }
 
 char *
@@ -461,30 +643,12 @@ xkb_keymap_led_get_index(struct xkb_keymap *keymap, const char *name)
     return XKB_LED_INVALID;
 }
 
-size_t
-xkb_keymap_key_get_mods_for_level(struct xkb_keymap *keymap,
-                                  xkb_keycode_t kc,
-                                  xkb_layout_index_t layout,
-                                  xkb_level_index_t level,
-                                  xkb_mod_mask_t *masks_out,
-                                  size_t masks_size)
+/** Get the modifier masks that select a level of a key type */
+static size_t
+key_type_get_mods_for_level(const struct xkb_key_type *type,
+                            xkb_level_index_t level,
+                            xkb_mod_mask_t *masks_out, size_t masks_size)
 {
-    const struct xkb_key *key = XkbKey(keymap, kc);
-    if (!key)
-        return 0;
-
-    static_assert(XKB_MAX_GROUPS < INT32_MAX, "Max groups don't fit");
-    layout = XkbWrapGroupIntoRange((int32_t) layout, key->num_groups,
-                                   key->out_of_range_group_policy,
-                                   key->out_of_range_group_number);
-    if (layout == XKB_LAYOUT_INVALID)
-        return 0;
-
-    if (level >= XkbKeyNumLevels(key, layout))
-        return 0;
-
-    const struct xkb_key_type *type = key->groups[layout].type;
-
     size_t count = 0;
 
     /*
@@ -522,6 +686,32 @@ xkb_keymap_key_get_mods_for_level(struct xkb_keymap *keymap,
     return count;
 }
 
+size_t
+xkb_keymap_key_get_mods_for_level(struct xkb_keymap *keymap,
+                                  xkb_keycode_t kc,
+                                  xkb_layout_index_t layout,
+                                  xkb_level_index_t level,
+                                  xkb_mod_mask_t *masks_out,
+                                  size_t masks_size)
+{
+    const struct xkb_key *key = XkbKey(keymap, kc);
+    if (!key)
+        return 0;
+
+    static_assert(XKB_MAX_GROUPS < INT32_MAX, "Max groups don't fit");
+    layout = XkbWrapGroupIntoRange((int32_t) layout, key->num_groups,
+                                   key->out_of_range_group_policy,
+                                   key->out_of_range_group_number);
+    if (layout == XKB_LAYOUT_INVALID)
+        return 0;
+
+    if (level >= XkbKeyNumLevels(key, layout))
+        return 0;
+
+    return key_type_get_mods_for_level(key->groups[layout].type, level,
+                                       masks_out, masks_size);
+}
+
 struct xkb_level *
 xkb_keymap_key_get_level(struct xkb_keymap *keymap, const struct xkb_key *key,
                          xkb_layout_index_t layout, xkb_level_index_t level)
@@ -693,6 +883,171 @@ xkb_keymap_key_for_each(struct xkb_keymap *keymap, xkb_keymap_key_iter_t iter,
         iter(keymap, key->keycode, data);
 }
 
+static int
+keysym_position_compare(const void *a, const void *b)
+{
+    const struct keysym_position * const p1 = a;
+    const struct keysym_position * const p2 = b;
+    if (p1->value != p2->value)
+        return (p1->value < p2->value) ? -1 : 1;
+    if (p1->layout != p2->layout)
+        return (p1->layout < p2->layout) ? -1 : 1;
+    if (p1->level != p2->level)
+        return (p1->level < p2->level) ? -1 : 1;
+    if (p1->keycode != p2->keycode)
+        return (p1->keycode < p2->keycode) ? -1 : 1;
+    if (p1->mask != p2->mask)
+        return (p1->mask < p2->mask) ? -1 : 1;
+    return 0;
+}
+
+/** Build the keysym index of a keymap, if not done yet */
+static const struct keysym_index *
+keymap_get_keysym_index(struct xkb_keymap *keymap)
+{
+    struct keysym_index * const index = &keymap->keysym_index;
+    if (index->built)
+        return index;
+
+    darray(xkb_mod_mask_t) masks = darray_new();
+    const struct xkb_key *key;
+    xkb_keys_foreach(key, keymap) {
+        if (key->name == XKB_ATOM_NONE)
+            continue;
+        for (xkb_layout_index_t layout = 0; layout < key->num_groups; layout++) {
+            const struct xkb_group * const group = &key->groups[layout];
+            for (xkb_level_index_t level = 0;
+                 level < XkbKeyNumLevels(key, layout); level++) {
+                /* Only consider levels with exactly one keysym */
+                const struct xkb_level * const leveli = &group->levels[level];
+                if (leveli->num_syms != 1)
+                    continue;
+
+                /* At most one mask per entry, plus the implicit empty mask */
+                darray_resize(masks, group->type->num_entries + 1);
+                const size_t num_masks = key_type_get_mods_for_level(
+                    group->type, level, darray_items(masks), darray_size(masks)
+                );
+                const uint32_t cp = xkb_keysym_to_utf32(leveli->s.sym);
+                for (size_t m = 0; m < num_masks; m++) {
+                    struct keysym_position position = {
+                        .value = leveli->s.sym,
+                        .keycode = key->keycode,
+                        .layout = layout,
+                        .level = level,
+                        .mask = darray_item(masks, m),
+                    };
+                    darray_append(index->keysyms, position);
+                    if (cp) {
+                        position.value = cp;
+                        darray_append(index->utf32, position);
+                    }
+                }
+            }
+        }
+    }
+    darray_free(masks);
+
+    if (!darray_empty(index->keysyms))
+        qsort(darray_items(index->keysyms), darray_size(index->keysyms),
+              sizeof(*darray_items(index->keysyms)), keysym_position_compare);
+    if (!darray_empty(index->utf32))
+        qsort(darray_items(index->utf32), darray_size(index->utf32),
+              sizeof(*darray_items(index->utf32)), keysym_position_compare);
+
+    index->built = true;
+    return index;
+}
+
+struct xkb_keymap_keysym_iterator {
+    const struct keysym_position *next;
+    const struct keysym_position *end;
+    struct xkb_keymap *keymap;
+};
+
+static struct xkb_keymap_keysym_iterator *
+keysym_iterator_new(struct xkb_keymap *keymap,
+                    const struct keysym_position *positions, darray_size_t count,
+                    uint32_t value)
+{
+    struct xkb_keymap_keysym_iterator * const iter = calloc(1, sizeof(*iter));
+    if (!iter) {
+        log_err(keymap->ctx, XKB_ERROR_ALLOCATION_ERROR,
+                "Could not allocate a keymap keysym iterator.\n");
+        return NULL;
+    }
+
+    iter->keymap = xkb_keymap_ref(keymap);
+
+    /* Binary search of the first position with the value */
+    darray_size_t lower = 0;
+    darray_size_t upper = count;
+    while (lower < upper) {
+        const darray_size_t mid = lower + (upper - lower) / 2;
+        if (positions[mid].value < value)
+            lower = mid + 1;
+        else
+            upper = mid;
+    }
+    darray_size_t end = lower;
+    while (end < count && positions[end].value == value)
+        end++;
+
+    iter->next = positions + lower;
+    iter->end = positions + end;
+    return iter;
+}
+
+struct xkb_keymap_keysym_iterator *
+xkb_keymap_keysym_iterator_new(struct xkb_keymap *keymap, xkb_keysym_t keysym)
+{
+    const struct keysym_index * const index = keymap_get_keysym_index(keymap);
+    return keysym_iterator_new(keymap, darray_items(index->keysyms),
+                               darray_size(index->keysyms), keysym);
+}
+
+struct xkb_keymap_keysym_iterator *
+xkb_keymap_keysym_iterator_new_from_utf32(struct xkb_keymap *keymap,
+                                          uint32_t codepoint)
+{
+    if (!codepoint) {
+        log_err_func1(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                      "invalid code point: 0\n");
+        return NULL;
+    }
+    const struct keysym_index * const index = keymap_get_keysym_index(keymap);
+    return keysym_iterator_new(keymap, darray_items(index->utf32),
+                               darray_size(index->utf32), codepoint);
+}
+
+void
+xkb_keymap_keysym_iterator_destroy(struct xkb_keymap_keysym_iterator *iter)
+{
+    if (!iter)
+        return;
+
+    xkb_keymap_unref(iter->keymap);
+    free(iter);
+}
+
+bool
+xkb_keymap_keysym_iterator_next(struct xkb_keymap_keysym_iterator *iter,
+                                xkb_keycode_t *keycode,
+                                xkb_layout_index_t *layout,
+                                xkb_level_index_t *level,
+                                xkb_mod_mask_t *mask)
+{
+    if (iter->next >= iter->end)
+        return false;
+
+    *keycode = iter->next->keycode;
+    *layout = iter->next->layout;
+    *level = iter->next->level;
+    *mask = iter->next->mask;
+    iter->next++;
+    return true;
+}
+
 const char *
 xkb_keymap_key_get_name(struct xkb_keymap *keymap, xkb_keycode_t kc)
 {
@@ -711,14 +1066,17 @@ xkb_keymap_key_by_name(struct xkb_keymap *keymap, const char *name)
     xkb_atom_t atom;
 
     atom = xkb_atom_lookup(keymap->ctx, name);
-    if (atom) {
-        for (darray_size_t i = 0; i < keymap->num_key_aliases; i++)
-            if (keymap->key_aliases[i].alias == atom)
-                atom = keymap->key_aliases[i].real;
-    }
     if (!atom)
         return XKB_KEYCODE_INVALID;
 
+    if (keymap->key_name_index)
+        return key_name_index_lookup(keymap, atom);
+
+    /* No index: the keymap could not be frozen */
+    for (darray_size_t i = 0; i < keymap->num_key_aliases; i++)
+        if (keymap->key_aliases[i].alias == atom)
+            atom = keymap->key_aliases[i].real;
+
     xkb_keys_foreach(key, keymap) {
         if (key->name == atom)
             return key->keycode;
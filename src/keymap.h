@@ -383,6 +383,12 @@ struct xkb_key_type_entry {
     struct xkb_mods preserve;
 };
 
+/**
+ * Maximum count of modifiers of a key type for which we build an entries
+ * lookup table. This covers all the types of xkeyboard-config.
+ */
+#define XKB_KEY_TYPE_LUT_MAX_MODS 8
+
 struct xkb_key_type {
     xkb_atom_t name;
     struct xkb_mods mods;
@@ -392,6 +398,15 @@ struct xkb_key_type {
     xkb_atom_t *level_names ATTR_COUNTED_BY(num_level_names);
     darray_size_t num_entries;
     struct xkb_key_type_entry *entries ATTR_COUNTED_BY(num_entries);
+    /**
+     * Entries lookup table, indexed by the modifiers of the type compressed
+     * to the bits of `mods.mask` (see `pext32()`). Each value is the index of
+     * the first matching *active* entry + 1, or 0 if there is no such entry.
+     *
+     * NULL if the type has more than `XKB_KEY_TYPE_LUT_MAX_MODS` modifiers or
+     * too many entries: the entries are then scanned linearly.
+     */
+    uint8_t *entries_lut;
 };
 
 typedef uint16_t xkb_action_count_t;
@@ -430,6 +445,24 @@ struct xkb_led {
     enum xkb_action_controls ctrls;
 };
 
+/**
+ * Union of the state components observed by the LEDs of a keymap.
+ * Used to skip the LEDs update when none of their inputs changed.
+ */
+struct led_dependencies {
+    /** Observed modifiers, per modifier state component */
+    xkb_mod_mask_t mods_effective;
+    xkb_mod_mask_t mods_depressed;
+    xkb_mod_mask_t mods_latched;
+    xkb_mod_mask_t mods_locked;
+    /** Observed layout state components */
+    enum xkb_state_component groups;
+    /** Observed controls */
+    enum xkb_action_controls ctrls;
+    /** Whether the dependencies have been computed by `keymap_freeze()` */
+    bool built;
+};
+
 struct xkb_key_alias {
     xkb_atom_t real;
     xkb_atom_t alias;
@@ -664,6 +697,50 @@ typedef union {
     } alias;
 } KeycodeMatch;
 
+/** Entry of `xkb_keymap::key_name_index` */
+struct key_name_entry {
+    xkb_atom_t name;
+    xkb_keycode_t keycode;
+};
+
+/** Memoized serialization of a keymap */
+struct keymap_serialization {
+    enum xkb_keymap_format format;
+    enum xkb_keymap_serialize_flags flags;
+    /** Size of the string, including the terminating NUL byte */
+    size_t size;
+    char *string;
+    /** Sealed file with the string, created on demand; -1 if none */
+    int fd;
+};
+
+/**
+ * Position of a keysym in a keymap
+ *
+ * @sa `struct keysym_index`
+ */
+struct keysym_position {
+    /** Keysym or Unicode code point */
+    uint32_t value;
+    xkb_keycode_t keycode;
+    xkb_layout_index_t layout;
+    xkb_level_index_t level;
+    xkb_mod_mask_t mask;
+};
+
+/**
+ * Inverted index of the keysyms of a keymap, built on first use.
+ *
+ * Both arrays are sorted by value, then by layout, level, keycode and mask.
+ */
+struct keysym_index {
+    bool built;
+    /** Positions by keysym */
+    darray(struct keysym_position) keysyms;
+    /** Positions by code point, for keysyms with a Unicode mapping */
+    darray(struct keysym_position) utf32;
+};
+
 /** Common keyboard description structure */
 struct xkb_keymap {
     struct xkb_context *ctx;
@@ -674,6 +751,7 @@ struct xkb_keymap {
 
     xkb_led_index_t num_leds;
     struct xkb_led leds[XKB_MAX_LEDS];
+    struct led_dependencies led_deps;
 
     xkb_keycode_t min_key_code;
     xkb_keycode_t max_key_code;
@@ -690,6 +768,18 @@ struct xkb_keymap {
      */
     xkb_keycode_t num_keys_low;
     struct xkb_key *keys ATTR_COUNTED_BY(num_keys);
+    /**
+     * Contiguous storage of the groups, levels, keysyms and actions of the
+     * keys, set by `keymap_freeze()`. If NULL, they are allocated separately.
+     */
+    void *key_data;
+    /**
+     * Key name and alias → keycode hash table, with open addressing and
+     * linear probing, set by `keymap_freeze()`. Its size is a power of 2 and
+     * free slots have the name `XKB_ATOM_NONE`. If NULL, lookups are linear.
+     */
+    struct key_name_entry *key_name_index;
+    darray_size_t key_name_index_mask;
 
     union {
         /**
@@ -771,6 +861,15 @@ struct xkb_keymap {
     char *symbols_section_name;
     char *types_section_name;
     char *compat_section_name;
+
+    /**
+     * Serializations, memoized since keymaps are immutable and compositors
+     * send them to every client.
+     */
+    darray(struct keymap_serialization) serializations;
+
+    /** Keysym → positions index, for inverse key transformation */
+    struct keysym_index keysym_index;
 };
 
 enum {
@@ -880,6 +979,37 @@ XkbKey(struct xkb_keymap *keymap, xkb_keycode_t kc)
     }
 }
 
+/** Slot of a key name in `xkb_keymap::key_name_index` */
+static inline darray_size_t
+key_name_index_slot(xkb_atom_t name, darray_size_t mask)
+{
+    /*
+     * Key names are mostly consecutive atoms: multiplying by an odd constant
+     * is a bijection on the low bits that keeps them in distinct slots.
+     */
+    return (darray_size_t) (name * UINT32_C(0x9E3779B1)) & mask;
+}
+
+/** Build `xkb_keymap::key_name_index`; no-op if already built */
+XKB_EXPORT_PRIVATE void
+keymap_build_key_name_index(struct xkb_keymap *keymap);
+
+/** Get the keycode of a key name or alias, using `xkb_keymap::key_name_index` */
+static inline xkb_keycode_t
+key_name_index_lookup(const struct xkb_keymap *keymap, xkb_atom_t name)
+{
+    const darray_size_t mask = keymap->key_name_index_mask;
+    for (darray_size_t slot = key_name_index_slot(name, mask);;
+         slot = (slot + 1) & mask) {
+        const struct key_name_entry * const entry =
+            &keymap->key_name_index[slot];
+        if (entry->name == name)
+            return entry->keycode;
+        if (entry->name == XKB_ATOM_NONE)
+            return XKB_KEYCODE_INVALID;
+    }
+}
+
 static inline xkb_level_index_t
 XkbKeyNumLevels(const struct xkb_key *key, xkb_layout_index_t layout)
 {
@@ -899,6 +1029,9 @@ entry_is_active(const struct xkb_key_type_entry *entry)
     return entry->mods.mods == 0 || entry->mods.mask != 0;
 }
 
+bool
+XkbKeyTypeUpdateEntriesLUT(struct xkb_key_type *type);
+
 struct xkb_keymap *
 xkb_keymap_new(struct xkb_context *ctx, const char* func,
                enum xkb_keymap_format format,
@@ -911,6 +1044,13 @@ xkb_mod_index_t
 XkbModNameToIndex(const struct xkb_mod_set *mods, xkb_atom_t name,
                   enum mod_type type);
 
+/** Count of keysyms stored in `syms`, if num_syms > 1 */
+static inline size_t
+XkbLevelSymsCount(const struct xkb_level *level)
+{
+    return (size_t) level->num_syms * (level->has_upper ? 2 : 1);
+}
+
 bool
 XkbLevelsSameSyms(const struct xkb_level *a, const struct xkb_level *b);
 
@@ -926,6 +1066,9 @@ XkbWrapGroupIntoRange(int32_t group,
                       enum xkb_layout_out_of_range_policy out_of_range_group_policy,
                       xkb_layout_index_t out_of_range_group_number);
 
+void
+keymap_freeze(struct xkb_keymap *keymap);
+
 XKB_EXPORT_PRIVATE xkb_mod_mask_t
 mod_mask_get_effective(struct xkb_keymap *keymap, xkb_mod_mask_t mods);
 
@@ -9,6 +9,10 @@
  * keysym2ucs() maps a keysym onto a Unicode value using a binary search,
  * therefore keysymtab[] must remain SORTED by keysym value.
  *
+ * The inverse mapping, used by xkb_utf32_to_keysym(), is generated from
+ * keysymtab[] into keysym-utf.h by scripts/update-keysyms-derived-headers.py,
+ * which must be run after any modification of the table.
+ *
  * The keysym -> UTF-8 conversion will hopefully one day be provided
  * by Xlib via XmbLookupString() and should ideally not have to be
  * done in X applications. But we are not there yet.
@@ -43,6 +47,7 @@
 #include "utils.h"
 #include "utf8.h"
 #include "keysym.h"
+#include "keysym-utf.h"
 
 #define NO_KEYSYM_UNICODE_CONVERSION 0
 
@@ -932,12 +937,10 @@ xkb_utf32_to_keysym(uint32_t ucs)
     if (unlikely(ucs == 0 || is_surrogate(ucs) || ucs > 0x10ffff))
         return XKB_KEY_NoSymbol;
 
-    /* search main table */
-    for (size_t i = 0; i < ARRAY_SIZE(keysymtab); i++) {
-        /* Do not use deprecated keysyms */
-        if (keysymtab[i].ucs == ucs && !keysymtab[i].deprecated)
-            return keysymtab[i].keysym;
-    }
+    /* search main table, excluding deprecated keysyms */
+    const xkb_keysym_t keysym = ucs_to_keysym_lookup(ucs);
+    if (keysym != XKB_KEY_NoSymbol)
+        return keysym;
 
     /* Use direct encoding if everything else failed */
     return ucs | XKB_KEYSYM_UNICODE_OFFSET;
@@ -0,0 +1,476 @@
+/*
+ * NOTE: This file has been generated automatically by “scripts/update-keysyms-derived-headers.py”.
+ *       Do not edit manually!
+ */
+
+/*
+ * Derived from the `keysymtab` table in keysym-utf.c, which is in the
+ * public domain.
+ */
+#pragma once
+
+#include "config.h"
+
+#include <stdint.h>
+
+#include "xkbcommon/xkbcommon.h"
+
+/*
+ * Two-level lookup table for the conversion Unicode → keysym, i.e. the
+ * inverse of `keysymtab`. Deprecated keysyms are excluded and if several
+ * keysyms map to the same code point, the lowest one is used.
+ *
+ * The code points are split in blocks of 2^UCS_TO_KEYSYM_BLOCK_BITS entries;
+ * `ucs_to_keysym_index` maps the block of a code point to one of the
+ * deduplicated blocks of `ucs_to_keysym_blocks`. 0 means no keysym.
+ *
+ * Code points: 722, size: 3833 bytes.
+ */
+#define UCS_TO_KEYSYM_BLOCK_BITS 4
+#define UCS_TO_KEYSYM_MAX        0x318e
+
+static const uint8_t ucs_to_keysym_index[] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0a, 0x0b, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x00, 0x00, 0x00,
+    0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x00, 0x00, 0x00, 0x17, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x19, 0x00,
+    0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x26, 0x27, 0x28, 0x00, 0x29, 0x2a,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x2b, 0x2c, 0x2d, 0x2e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2f, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x30, 0x31, 0x32, 0x00, 0x00, 0x33, 0x00, 0x00, 0x00, 0x34, 0x00, 0x00, 0x00, 0x35, 0x00, 0x00,
+    0x36, 0x37, 0x38, 0x39, 0x3a, 0x00, 0x3b, 0x00, 0x3c, 0x00, 0x3d, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x3e, 0x3f, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x41, 0x42, 0x43, 0x00, 0x00, 0x00, 0x00,
+    0x44, 0x00, 0x45, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x46, 0x47, 0x48, 0x49, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x4b, 0x00, 0x00, 0x00,
+    0x4c, 0x00, 0x00, 0x00, 0x4d, 0x00, 0x4e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x4f, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x51, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x00, 0x00, 0x00, 0x59, 0x5a, 0x5b, 0x5c, 0x5d, 0x5e,
+};
+
+static const uint16_t ucs_to_keysym_blocks[][1 << UCS_TO_KEYSYM_BLOCK_BITS] = {
+    { /* 0x00 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x01 */
+        0x03c0, 0x03e0, 0x01c3, 0x01e3, 0x01a1, 0x01b1, 0x01c6, 0x01e6,
+        0x02c6, 0x02e6, 0x02c5, 0x02e5, 0x01c8, 0x01e8, 0x01cf, 0x01ef,
+    },
+    { /* 0x02 */
+        0x01d0, 0x01f0, 0x03aa, 0x03ba, 0x0000, 0x0000, 0x03cc, 0x03ec,
+        0x01ca, 0x01ea, 0x01cc, 0x01ec, 0x02d8, 0x02f8, 0x02ab, 0x02bb,
+    },
+    { /* 0x03 */
+        0x02d5, 0x02f5, 0x03ab, 0x03bb, 0x02a6, 0x02b6, 0x02a1, 0x02b1,
+        0x03a5, 0x03b5, 0x03cf, 0x03ef, 0x0000, 0x0000, 0x03c7, 0x03e7,
+    },
+    { /* 0x04 */
+        0x02a9, 0x02b9, 0x0000, 0x0000, 0x02ac, 0x02bc, 0x03d3, 0x03f3,
+        0x03a2, 0x01c5, 0x01e5, 0x03a6, 0x03b6, 0x01a5, 0x01b5, 0x0000,
+    },
+    { /* 0x05 */
+        0x0000, 0x01a3, 0x01b3, 0x01d1, 0x01f1, 0x03d1, 0x03f1, 0x01d2,
+        0x01f2, 0x0000, 0x03bd, 0x03bf, 0x03d2, 0x03f2, 0x0000, 0x0000,
+    },
+    { /* 0x06 */
+        0x01d5, 0x01f5, 0x13bc, 0x13bd, 0x01c0, 0x01e0, 0x03a3, 0x03b3,
+        0x01d8, 0x01f8, 0x01a6, 0x01b6, 0x02de, 0x02fe, 0x01aa, 0x01ba,
+    },
+    { /* 0x07 */
+        0x01a9, 0x01b9, 0x01de, 0x01fe, 0x01ab, 0x01bb, 0x03ac, 0x03bc,
+        0x03dd, 0x03fd, 0x03de, 0x03fe, 0x02dd, 0x02fd, 0x01d9, 0x01f9,
+    },
+    { /* 0x08 */
+        0x01db, 0x01fb, 0x03d9, 0x03f9, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x13be, 0x01ac, 0x01bc, 0x01af, 0x01bf, 0x01ae, 0x01be, 0x0000,
+    },
+    { /* 0x09 */
+        0x0000, 0x0000, 0x08f6, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x0a */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x01b7,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x0b */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x01a2, 0x01ff, 0x0000, 0x01b2, 0x0000, 0x01bd, 0x0000, 0x0000,
+    },
+    { /* 0x0c */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x07ae, 0x07a1, 0x0000,
+        0x07a2, 0x07a3, 0x07a4, 0x0000, 0x07a7, 0x0000, 0x07a8, 0x07ab,
+    },
+    { /* 0x0d */
+        0x07b6, 0x07c1, 0x07c2, 0x07c3, 0x07c4, 0x07c5, 0x07c6, 0x07c7,
+        0x07c8, 0x07c9, 0x07ca, 0x07cb, 0x07cc, 0x07cd, 0x07ce, 0x07cf,
+    },
+    { /* 0x0e */
+        0x07d0, 0x07d1, 0x0000, 0x07d2, 0x07d4, 0x07d5, 0x07d6, 0x07d7,
+        0x07d8, 0x07d9, 0x07a5, 0x07a9, 0x07b1, 0x07b2, 0x07b3, 0x07b4,
+    },
+    { /* 0x0f */
+        0x07ba, 0x07e1, 0x07e2, 0x07e3, 0x07e4, 0x07e5, 0x07e6, 0x07e7,
+        0x07e8, 0x07e9, 0x07ea, 0x07eb, 0x07ec, 0x07ed, 0x07ee, 0x07ef,
+    },
+    { /* 0x10 */
+        0x07f0, 0x07f1, 0x07f3, 0x07f2, 0x07f4, 0x07f5, 0x07f6, 0x07f7,
+        0x07f8, 0x07f9, 0x07b5, 0x07b9, 0x07b7, 0x07b8, 0x07bb, 0x0000,
+    },
+    { /* 0x11 */
+        0x0000, 0x06b3, 0x06b1, 0x06b2, 0x06b4, 0x06b5, 0x06b6, 0x06b7,
+        0x06b8, 0x06b9, 0x06ba, 0x06bb, 0x06bc, 0x0000, 0x06be, 0x06bf,
+    },
+    { /* 0x12 */
+        0x06e1, 0x06e2, 0x06f7, 0x06e7, 0x06e4, 0x06e5, 0x06f6, 0x06fa,
+        0x06e9, 0x06ea, 0x06eb, 0x06ec, 0x06ed, 0x06ee, 0x06ef, 0x06f0,
+    },
+    { /* 0x13 */
+        0x06f2, 0x06f3, 0x06f4, 0x06f5, 0x06e6, 0x06e8, 0x06e3, 0x06fe,
+        0x06fb, 0x06fd, 0x06ff, 0x06f9, 0x06f8, 0x06fc, 0x06e0, 0x06f1,
+    },
+    { /* 0x14 */
+        0x06c1, 0x06c2, 0x06d7, 0x06c7, 0x06c4, 0x06c5, 0x06d6, 0x06da,
+        0x06c9, 0x06ca, 0x06cb, 0x06cc, 0x06cd, 0x06ce, 0x06cf, 0x06d0,
+    },
+    { /* 0x15 */
+        0x06d2, 0x06d3, 0x06d4, 0x06d5, 0x06c6, 0x06c8, 0x06c3, 0x06de,
+        0x06db, 0x06dd, 0x06df, 0x06d9, 0x06d8, 0x06dc, 0x06c0, 0x06d1,
+    },
+    { /* 0x16 */
+        0x0000, 0x06a3, 0x06a1, 0x06a2, 0x06a4, 0x06a5, 0x06a6, 0x06a7,
+        0x06a8, 0x06a9, 0x06aa, 0x06ab, 0x06ac, 0x0000, 0x06ae, 0x06af,
+    },
+    { /* 0x17 */
+        0x06bd, 0x06ad, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x18 */
+        0x0ce0, 0x0ce1, 0x0ce2, 0x0ce3, 0x0ce4, 0x0ce5, 0x0ce6, 0x0ce7,
+        0x0ce8, 0x0ce9, 0x0cea, 0x0ceb, 0x0cec, 0x0ced, 0x0cee, 0x0cef,
+    },
+    { /* 0x19 */
+        0x0cf0, 0x0cf1, 0x0cf2, 0x0cf3, 0x0cf4, 0x0cf5, 0x0cf6, 0x0cf7,
+        0x0cf8, 0x0cf9, 0x0cfa, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x1a */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x05ac, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x1b */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x05bb, 0x0000, 0x0000, 0x0000, 0x05bf,
+    },
+    { /* 0x1c */
+        0x0000, 0x05c1, 0x05c2, 0x05c3, 0x05c4, 0x05c5, 0x05c6, 0x05c7,
+        0x05c8, 0x05c9, 0x05ca, 0x05cb, 0x05cc, 0x05cd, 0x05ce, 0x05cf,
+    },
+    { /* 0x1d */
+        0x05d0, 0x05d1, 0x05d2, 0x05d3, 0x05d4, 0x05d5, 0x05d6, 0x05d7,
+        0x05d8, 0x05d9, 0x05da, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x1e */
+        0x05e0, 0x05e1, 0x05e2, 0x05e3, 0x05e4, 0x05e5, 0x05e6, 0x05e7,
+        0x05e8, 0x05e9, 0x05ea, 0x05eb, 0x05ec, 0x05ed, 0x05ee, 0x05ef,
+    },
+    { /* 0x1f */
+        0x05f0, 0x05f1, 0x05f2, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x20 */
+        0x0000, 0x0da1, 0x0da2, 0x0da3, 0x0da4, 0x0da5, 0x0da6, 0x0da7,
+        0x0da8, 0x0da9, 0x0daa, 0x0dab, 0x0dac, 0x0dad, 0x0dae, 0x0daf,
+    },
+    { /* 0x21 */
+        0x0db0, 0x0db1, 0x0db2, 0x0db3, 0x0db4, 0x0db5, 0x0db6, 0x0db7,
+        0x0db8, 0x0db9, 0x0dba, 0x0dbb, 0x0dbc, 0x0dbd, 0x0dbe, 0x0dbf,
+    },
+    { /* 0x22 */
+        0x0dc0, 0x0dc1, 0x0dc2, 0x0dc3, 0x0dc4, 0x0dc5, 0x0dc6, 0x0dc7,
+        0x0dc8, 0x0dc9, 0x0dca, 0x0dcb, 0x0dcc, 0x0dcd, 0x0dce, 0x0dcf,
+    },
+    { /* 0x23 */
+        0x0dd0, 0x0dd1, 0x0dd2, 0x0dd3, 0x0dd4, 0x0dd5, 0x0dd6, 0x0dd7,
+        0x0dd8, 0x0dd9, 0x0dda, 0x0000, 0x0000, 0x0000, 0x0000, 0x0ddf,
+    },
+    { /* 0x24 */
+        0x0de0, 0x0de1, 0x0de2, 0x0de3, 0x0de4, 0x0de5, 0x0de6, 0x0de7,
+        0x0de8, 0x0de9, 0x0dea, 0x0deb, 0x0dec, 0x0ded, 0x0000, 0x0000,
+    },
+    { /* 0x25 */
+        0x0df0, 0x0df1, 0x0df2, 0x0df3, 0x0df4, 0x0df5, 0x0df6, 0x0df7,
+        0x0df8, 0x0df9, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x26 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0ed4, 0x0ed5, 0x0ed6, 0x0ed7, 0x0ed8, 0x0ed9, 0x0eda, 0x0edb,
+    },
+    { /* 0x27 */
+        0x0edc, 0x0edd, 0x0ede, 0x0edf, 0x0ee0, 0x0ee1, 0x0ee2, 0x0ee3,
+        0x0ee4, 0x0ee5, 0x0ee6, 0x0ee7, 0x0ee8, 0x0ee9, 0x0eea, 0x0eeb,
+    },
+    { /* 0x28 */
+        0x0eec, 0x0eed, 0x0eee, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x29 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0ef8, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x2a */
+        0x0ef9, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0efa, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x2b */
+        0x0000, 0x0000, 0x0aa2, 0x0aa1, 0x0aa3, 0x0aa4, 0x0000, 0x0aa5,
+        0x0aa6, 0x0aa7, 0x0aa8, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x2c */
+        0x0000, 0x0000, 0x0abb, 0x0aaa, 0x0aa9, 0x07af, 0x0000, 0x0cdf,
+        0x0ad0, 0x0ad1, 0x0afd, 0x0000, 0x0ad2, 0x0ad3, 0x0afe, 0x0000,
+    },
+    { /* 0x2d */
+        0x0af1, 0x0af2, 0x0000, 0x0000, 0x0000, 0x0aaf, 0x0aae, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x2e */
+        0x0ad5, 0x0000, 0x0ad6, 0x0ad7, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0afc, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x047e, 0x0000,
+    },
+    { /* 0x2f */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x20ac, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x30 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0ab8, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x31 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x06b0, 0x0afb,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0ad4, 0x0000,
+    },
+    { /* 0x32 */
+        0x0000, 0x0000, 0x0ac9, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x33 */
+        0x0000, 0x0000, 0x0000, 0x0ab0, 0x0ab1, 0x0ab2, 0x0ab3, 0x0ab4,
+        0x0ab5, 0x0ab6, 0x0ab7, 0x0ac3, 0x0ac4, 0x0ac5, 0x0ac6, 0x0000,
+    },
+    { /* 0x34 */
+        0x08fb, 0x08fc, 0x08fd, 0x08fe, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x35 */
+        0x0000, 0x0000, 0x08ce, 0x0000, 0x08cd, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x36 */
+        0x0000, 0x0000, 0x08ef, 0x0000, 0x0000, 0x0000, 0x0000, 0x08c5,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x37 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0bca, 0x0000, 0x08d6, 0x0000, 0x0000, 0x08c1, 0x08c2, 0x0000,
+    },
+    { /* 0x38 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x08de,
+        0x08df, 0x08dc, 0x08dd, 0x08bf, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x39 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x08c0, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x08c8, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x3a */
+        0x0000, 0x0000, 0x0000, 0x08c9, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x3b */
+        0x08bd, 0x08cf, 0x0000, 0x0000, 0x08bc, 0x08be, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x3c */
+        0x0000, 0x0000, 0x08da, 0x08db, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x3d */
+        0x0000, 0x0000, 0x0bfc, 0x0bdc, 0x0bc2, 0x0bce, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x3e */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0bd3, 0x0000, 0x0bc4, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x3f */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0afa, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x40 */
+        0x08a4, 0x08a5, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x41 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0bcc, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x08ab, 0x0000, 0x08ac, 0x08ad, 0x0000,
+    },
+    { /* 0x42 */
+        0x08ae, 0x08a7, 0x0000, 0x08a8, 0x08a9, 0x0000, 0x08aa, 0x0000,
+        0x08af, 0x0000, 0x0000, 0x0000, 0x08b0, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x43 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x08a1,
+        0x0000, 0x0000, 0x09ef, 0x09f0, 0x09f2, 0x09f3, 0x0000, 0x0000,
+    },
+    { /* 0x44 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x09e2, 0x09e5, 0x09e9, 0x09e3, 0x09e4, 0x0000, 0x0000,
+    },
+    { /* 0x45 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x09e8, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x46 */
+        0x09f1, 0x0000, 0x09f8, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x09ec, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x47 */
+        0x09eb, 0x0000, 0x0000, 0x0000, 0x09ed, 0x0000, 0x0000, 0x0000,
+        0x09ea, 0x0000, 0x0000, 0x0000, 0x09f4, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x48 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x09f5, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x09f7, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x49 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x09f6, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x09ee, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x4a */
+        0x0000, 0x0000, 0x09e1, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x4b */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x09e0, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0bcf, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x4c */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0af9, 0x0000,
+    },
+    { /* 0x4d */
+        0x0af8, 0x0000, 0x0af7, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x4e */
+        0x0000, 0x0000, 0x0000, 0x0aec, 0x0000, 0x0aee, 0x0aed, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0af6, 0x0000, 0x0af5,
+    },
+    { /* 0x4f */
+        0x0000, 0x0000, 0x0000, 0x0af3, 0x0000, 0x0000, 0x0000, 0x0af4,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0ad9, 0x0000, 0x0000,
+    },
+    { /* 0x50 */
+        0x0af0, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x51 */
+        0x0000, 0x04a4, 0x04a1, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x04a2, 0x04a3, 0x0000, 0x0000,
+    },
+    { /* 0x52 */
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x04de, 0x04df, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x53 */
+        0x0000, 0x04a7, 0x04b1, 0x04a8, 0x04b2, 0x04a9, 0x04b3, 0x04aa,
+        0x04b4, 0x04ab, 0x04b5, 0x04b6, 0x0000, 0x04b7, 0x0000, 0x04b8,
+    },
+    { /* 0x54 */
+        0x0000, 0x04b9, 0x0000, 0x04ba, 0x0000, 0x04bb, 0x0000, 0x04bc,
+        0x0000, 0x04bd, 0x0000, 0x04be, 0x0000, 0x04bf, 0x0000, 0x04c0,
+    },
+    { /* 0x55 */
+        0x0000, 0x04c1, 0x0000, 0x04af, 0x04c2, 0x0000, 0x04c3, 0x0000,
+        0x04c4, 0x0000, 0x04c5, 0x04c6, 0x04c7, 0x04c8, 0x04c9, 0x04ca,
+    },
+    { /* 0x56 */
+        0x0000, 0x0000, 0x04cb, 0x0000, 0x0000, 0x04cc, 0x0000, 0x0000,
+        0x04cd, 0x0000, 0x0000, 0x04ce, 0x0000, 0x0000, 0x04cf, 0x04d0,
+    },
+    { /* 0x57 */
+        0x04d1, 0x04d2, 0x04d3, 0x04ac, 0x04d4, 0x04ad, 0x04d5, 0x04ae,
+        0x04d6, 0x04d7, 0x04d8, 0x04d9, 0x04da, 0x04db, 0x0000, 0x04dc,
+    },
+    { /* 0x58 */
+        0x0000, 0x0000, 0x04a6, 0x04dd, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x04a5, 0x04b0, 0x0000, 0x0000, 0x0000,
+    },
+    { /* 0x59 */
+        0x0000, 0x0ea1, 0x0ea2, 0x0ea3, 0x0ea4, 0x0ea5, 0x0ea6, 0x0ea7,
+        0x0ea8, 0x0ea9, 0x0eaa, 0x0eab, 0x0eac, 0x0ead, 0x0eae, 0x0eaf,
+    },
+    { /* 0x5a */
+        0x0eb0, 0x0eb1, 0x0eb2, 0x0eb3, 0x0eb4, 0x0eb5, 0x0eb6, 0x0eb7,
+        0x0eb8, 0x0eb9, 0x0eba, 0x0ebb, 0x0ebc, 0x0ebd, 0x0ebe, 0x0ebf,
+    },
+    { /* 0x5b */
+        0x0ec0, 0x0ec1, 0x0ec2, 0x0ec3, 0x0ec4, 0x0ec5, 0x0ec6, 0x0ec7,
+        0x0ec8, 0x0ec9, 0x0eca, 0x0ecb, 0x0ecc, 0x0ecd, 0x0ece, 0x0ecf,
+    },
+    { /* 0x5c */
+        0x0ed0, 0x0ed1, 0x0ed2, 0x0ed3, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0eef, 0x0000, 0x0000,
+    },
+    { /* 0x5d */
+        0x0000, 0x0ef0, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0ef1, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0ef2,
+    },
+    { /* 0x5e */
+        0x0000, 0x0ef3, 0x0000, 0x0000, 0x0ef4, 0x0000, 0x0ef5, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0ef6, 0x0ef7, 0x0000,
+    },
+};
+
+static inline xkb_keysym_t
+ucs_to_keysym_lookup(uint32_t ucs)
+{
+    if (ucs > UCS_TO_KEYSYM_MAX)
+        return XKB_KEY_NoSymbol;
+    const uint8_t block = ucs_to_keysym_index[ucs >> UCS_TO_KEYSYM_BLOCK_BITS];
+    return ucs_to_keysym_blocks[block]
+                               [ucs & ((1u << UCS_TO_KEYSYM_BLOCK_BITS) - 1)];
+}
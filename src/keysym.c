@@ -16,6 +16,7 @@
 
 #include "xkbcommon/xkbcommon-keysyms.h"
 #include "xkbcommon/xkbcommon.h"
+#include "utf8.h"
 #include "utf8-decoding.h"
 #include "utils.h"
 #include "utils-numbers.h"
@@ -370,6 +371,116 @@ xkb_utf8_to_keysym(const char *buffer, size_t size)
         : xkb_utf32_to_keysym(codepoint);
 }
 
+/* Check whether all the bytes of a word are printable ASCII, i.e. in the
+ * range 0x20..0x7e, which maps 1:1 to keysyms. */
+static inline bool
+is_printable_ascii_word(uint64_t word)
+{
+    const uint64_t ones = UINT64_C(0x0101010101010101);
+    const uint64_t high = UINT64_C(0x8080808080808080);
+    /* If no byte has its high bit set, there is no carry between bytes and:
+     * - b <= 0x7e ⇔ b + 0x01 < 0x80;
+     * - b >= 0x20 ⇔ b + 0x60 >= 0x80. */
+    return ((word | (word + ones)) & high) == 0 &&
+           ((word + 0x60 * ones) & high) == high;
+}
+
+size_t
+xkb_utf8_to_keysyms(const char *buffer, size_t size,
+                    xkb_keysym_t *keysyms, size_t max_keysyms,
+                    size_t *offset)
+{
+    size_t k = 0;
+    size_t count = 0;
+
+    if (!buffer || !keysyms)
+        goto out;
+
+    while (k < size && count < max_keysyms) {
+        /* Fast path: process printable ASCII 8 bytes at a time */
+        uint64_t word;
+        while (size - k >= sizeof(word) && max_keysyms - count >= sizeof(word)) {
+            memcpy(&word, &buffer[k], sizeof(word));
+            if (!is_printable_ascii_word(word))
+                break;
+            for (size_t i = 0; i < sizeof(word); i++)
+                keysyms[count + i] = (unsigned char) buffer[k + i];
+            k += sizeof(word);
+            count += sizeof(word);
+        }
+        if (k >= size || count >= max_keysyms)
+            break;
+
+        /* Slow path: single code point */
+        size_t length = 0;
+        const uint32_t cp = utf8_next_code_point(&buffer[k], size - k, &length);
+        if (cp == INVALID_UTF8_CODE_POINT || length == 0)
+            break;
+        const xkb_keysym_t keysym = xkb_utf32_to_keysym(cp);
+        if (keysym == XKB_KEY_NoSymbol)
+            break;
+        keysyms[count++] = keysym;
+        k += length;
+    }
+
+out:
+    if (offset)
+        *offset = k;
+    return count;
+}
+
+size_t
+xkb_keysyms_to_utf8(const xkb_keysym_t *keysyms, size_t count,
+                    char *buffer, size_t size, size_t *index)
+{
+    size_t k = 0;
+    size_t length = 0;
+
+    if (!buffer || !size)
+        goto out;
+
+    /* Keep room for the terminating NULL byte */
+    const size_t capacity = size - 1;
+    while (k < count) {
+        /* Fast path: runs of printable ASCII keysyms, which map 1:1 */
+        const size_t end = k + MIN(count - k, capacity - length);
+        size_t run = k;
+        while (run < end && keysyms[run] >= 0x20 && keysyms[run] <= 0x7e)
+            run++;
+        for (; k < run; k++)
+            buffer[length++] = (char) keysyms[k];
+        if (k >= count)
+            break;
+
+        /* Slow path: single keysym */
+        const uint32_t cp = xkb_keysym_to_utf32(keysyms[k]);
+        if (cp == 0)
+            break;
+        int needed;
+        if (size - length >= XKB_KEYSYM_UTF8_MAX_SIZE) {
+            /* Enough room to write directly into the buffer */
+            needed = utf32_to_utf8(cp, &buffer[length]) - 1;
+            if (needed <= 0)
+                break;
+        } else {
+            char utf8[XKB_KEYSYM_UTF8_MAX_SIZE];
+            needed = utf32_to_utf8(cp, utf8) - 1;
+            if (needed <= 0 || (size_t) needed > capacity - length)
+                break;
+            memcpy(&buffer[length], utf8, (size_t) needed);
+        }
+        length += (size_t) needed;
+        k++;
+    }
+
+    buffer[length] = '\0';
+
+out:
+    if (index)
+        *index = k;
+    return length;
+}
+
 /*
  * Check whether a keysym with code "keysym" and name "name" is deprecated.
  * • If the keysym is not deprecated itself and has no deprecated names,
@@ -23,6 +23,7 @@
 #endif
 
 #include "xkbcommon/xkbregistry.h"
+#include "cache-file.h"
 #include "messages-codes.h"
 #include "darray.h"
 #include "utils.h"
@@ -30,16 +31,22 @@
 #include "util-mem.h"
 
 struct rxkb_object;
+struct rxkb_cache;
 
 /**
  * All our objects are refcounted and are linked to iterate through them.
  * Abstract those bits away into a shared parent class so we can generate
  * most of the functions through macros.
+ *
+ * Objects loaded from the registry cache are not allocated individually:
+ * they live in the arrays of the cache and their strings point to its
+ * mapping. Each of them holds a reference to the cache.
  */
 struct rxkb_object {
     struct rxkb_object *parent;
     uint32_t refcount;
     struct list link;
+    struct rxkb_cache *cache;
 };
 
 struct rxkb_iso639_code {
@@ -52,6 +59,40 @@ struct rxkb_iso3166_code {
     char *code;
 };
 
+/**
+ * Entry of the lookup indexes of a context: either the name of an object or an
+ * ISO code of a layout.
+ */
+struct rxkb_index_entry {
+    const char *key;
+    /* Variant of a layout, NULL otherwise */
+    const char *variant;
+    /* Position of the object (the layout for ISO codes) in its list */
+    uint32_t position;
+    void *object;
+};
+
+typedef darray(struct rxkb_index_entry) darray_index_entry;
+
+/**
+ * Indexes of the objects of a context, sorted by key, then variant (none
+ * first), then position. ISO codes are compared case-insensitively.
+ *
+ * They are built on the first lookup, once the context is parsed, since its
+ * content never changes afterwards.
+ */
+struct rxkb_index {
+    bool built;
+    darray_index_entry models;
+    darray_index_entry layouts;
+    darray_index_entry option_groups;
+    darray_index_entry options;
+    darray_index_entry iso639s;
+    darray_index_entry iso3166s;
+    /* Last entry returned by an ISO code lookup, to iterate without search */
+    const struct rxkb_index_entry *last_code;
+};
+
 enum context_state {
     CONTEXT_NEW,
     CONTEXT_PARSED,
@@ -70,7 +111,9 @@ struct rxkb_context {
     struct list option_groups;  /* list of struct rxkb_option_group */
 
     darray(char *) includes;
+    char *cache_dir;
 
+    struct rxkb_index index;
 
     ATTR_PRINTF(3, 0) void (*log_fn)(struct rxkb_context *ctx,
                                      enum rxkb_log_level level,
@@ -97,6 +140,8 @@ struct rxkb_layout {
     char *description;
     char *variant;
     enum rxkb_popularity popularity;
+    /* Position in the context list; set when building the indexes */
+    uint32_t position;
 
     struct list iso639s;  /* list of struct rxkb_iso639_code */
     struct list iso3166s; /* list of struct rxkb_iso3166_code */
@@ -126,6 +171,9 @@ static bool
 parse(struct rxkb_context *ctx, const char *path,
       enum rxkb_popularity popularity);
 
+static void
+rxkb_cache_unref(struct rxkb_cache *cache);
+
 ATTR_PRINTF(3, 4)
 static void
 rxkb_log(struct rxkb_context *ctx, enum rxkb_log_level level,
@@ -172,7 +220,10 @@ struct type_ * type_##_unref(struct type_ *object) { \
     if (--object->base.refcount == 0) {\
         type_##_destroy(object); \
         list_remove(&object->base.link);\
-        free(object); \
+        if (object->base.cache) \
+            rxkb_cache_unref(object->base.cache); \
+        else \
+            free(object); \
     } \
     return NULL;\
 }
@@ -231,7 +282,8 @@ rxkb_object_ref(struct rxkb_object *object)
 static void
 rxkb_iso639_code_destroy(struct rxkb_iso639_code *code)
 {
-    free(code->code);
+    if (!code->base.cache)
+        free(code->code);
 }
 
 struct rxkb_iso639_code *
@@ -268,7 +320,8 @@ DECLARE_GETTER_FOR_TYPE(rxkb_iso639_code, code);
 static void
 rxkb_iso3166_code_destroy(struct rxkb_iso3166_code *code)
 {
-    free(code->code);
+    if (!code->base.cache)
+        free(code->code);
 }
 
 struct rxkb_iso3166_code *
@@ -305,6 +358,8 @@ DECLARE_GETTER_FOR_TYPE(rxkb_iso3166_code, code);
 static void
 rxkb_option_destroy(struct rxkb_option *o)
 {
+    if (o->base.cache)
+        return;
     free(o->name);
     free(o->brief);
     free(o->description);
@@ -327,10 +382,12 @@ rxkb_layout_destroy(struct rxkb_layout *l)
     struct rxkb_iso639_code *iso639, *tmp_639;
     struct rxkb_iso3166_code *iso3166, *tmp_3166;
 
-    free(l->name);
-    free(l->brief);
-    free(l->description);
-    free(l->variant);
+    if (!l->base.cache) {
+        free(l->name);
+        free(l->brief);
+        free(l->description);
+        free(l->variant);
+    }
 
     list_for_each_safe(iso639, tmp_639, &l->iso639s, base.link) {
         rxkb_iso639_code_unref(iso639);
@@ -352,6 +409,8 @@ DECLARE_FIRST_NEXT_FOR_TYPE(rxkb_layout, rxkb_context, layouts);
 static void
 rxkb_model_destroy(struct rxkb_model *m)
 {
+    if (m->base.cache)
+        return;
     free(m->name);
     free(m->vendor);
     free(m->description);
@@ -370,8 +429,10 @@ rxkb_option_group_destroy(struct rxkb_option_group *og)
 {
     struct rxkb_option *o, *otmp;
 
-    free(og->name);
-    free(og->description);
+    if (!og->base.cache) {
+        free(og->name);
+        free(og->description);
+    }
 
     list_for_each_safe(o, otmp, &og->options, base.link) {
         rxkb_option_unref(o);
@@ -414,6 +475,14 @@ rxkb_context_destroy(struct rxkb_context *ctx)
     darray_foreach(path, ctx->includes)
         free(*path);
     darray_free(ctx->includes);
+    free(ctx->cache_dir);
+
+    darray_free(ctx->index.models);
+    darray_free(ctx->index.layouts);
+    darray_free(ctx->index.option_groups);
+    darray_free(ctx->index.options);
+    darray_free(ctx->index.iso639s);
+    darray_free(ctx->index.iso3166s);
 
     assert(darray_empty(ctx->includes));
 }
@@ -530,6 +599,12 @@ rxkb_context_new(enum rxkb_context_flags flags)
     list_init(&ctx->layouts);
     list_init(&ctx->option_groups);
 
+    env = rxkb_context_getenv(ctx, "RXKB_CACHE_DIR");
+    if (env && !rxkb_context_set_cache_dir(ctx, env)) {
+        rxkb_context_unref(ctx);
+        return NULL;
+    }
+
     if (!(flags & RXKB_CONTEXT_NO_DEFAULT_INCLUDES) &&
         !rxkb_context_include_path_append_default(ctx)) {
         log_err(ctx, XKB_ERROR_NO_VALID_DEFAULT_INCLUDE_PATH,
@@ -552,6 +627,29 @@ rxkb_context_set_log_fn(struct rxkb_context *ctx,
     ctx->log_fn = (log_fn ? log_fn : default_log_fn);
 }
 
+bool
+rxkb_context_set_cache_dir(struct rxkb_context *ctx, const char *path)
+{
+    if (ctx->context_state != CONTEXT_NEW) {
+        log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
+                "the cache directory can only be set on a new context\n");
+        return false;
+    }
+
+    char *dir = NULL;
+    if (path) {
+        dir = strdup(path);
+        if (!dir) {
+            log_err(ctx, XKB_ERROR_ALLOCATION_ERROR,
+                    "Could not set cache directory: %s\n", path);
+            return false;
+        }
+    }
+    free(ctx->cache_dir);
+    ctx->cache_dir = dir;
+    return true;
+}
+
 bool
 rxkb_context_include_path_append(struct rxkb_context *ctx, const char *path)
 {
@@ -830,6 +928,571 @@ rxkb_context_include_path_append_default(struct rxkb_context *ctx)
     return ret;
 }
 
+/***====================================================================***/
+
+/*
+ * Registry cache
+ *
+ * The parsed registry is stored in a cache file (see cache-file.h), with the
+ * following payload:
+ *
+ *     header
+ *     models:        struct registry_cache_model[num_models]
+ *     layouts:       struct registry_cache_layout[num_layouts]
+ *     iso639 codes:  uint32_t[num_iso639_codes]
+ *     iso3166 codes: uint32_t[num_iso3166_codes]
+ *     option groups: struct registry_cache_option_group[num_option_groups]
+ *     options:       struct registry_cache_option[num_options]
+ *     strings:       char[strings_size]
+ *
+ * Each section is 8-bytes aligned. Strings are offsets in the string pool, or
+ * REGISTRY_CACHE_NO_STRING. The ISO codes and the options are stored in the
+ * order of their layout, respectively of their option group.
+ *
+ * The key is made of the ruleset, the context flags and the include paths.
+ * The dependencies are all the rules files that were looked up, so that
+ * creating one of them also invalidates the cache.
+ *
+ * The objects loaded from the cache are allocated in arrays and their strings
+ * point to the memory mapping of the cache file.
+ */
+
+#define REGISTRY_CACHE_VERSION 1
+#define REGISTRY_CACHE_EXTENSION "xkbregistry"
+#define REGISTRY_CACHE_NO_STRING UINT32_MAX
+
+struct registry_cache_header {
+    uint32_t num_models;
+    uint32_t num_layouts;
+    uint32_t num_iso639_codes;
+    uint32_t num_iso3166_codes;
+    uint32_t num_option_groups;
+    uint32_t num_options;
+    uint32_t strings_size;
+    uint32_t _pad;
+};
+
+struct registry_cache_model {
+    uint32_t name;
+    uint32_t vendor;
+    uint32_t description;
+    uint32_t popularity;
+};
+
+struct registry_cache_layout {
+    uint32_t name;
+    uint32_t variant;
+    uint32_t brief;
+    uint32_t description;
+    uint32_t popularity;
+    uint32_t num_iso639_codes;
+    uint32_t num_iso3166_codes;
+    uint32_t _pad;
+};
+
+struct registry_cache_option_group {
+    uint32_t name;
+    uint32_t description;
+    uint32_t popularity;
+    uint32_t allow_multiple;
+    uint32_t num_options;
+    uint32_t _pad;
+};
+
+struct registry_cache_option {
+    uint32_t name;
+    uint32_t brief;
+    uint32_t description;
+    uint32_t popularity;
+    uint32_t layout_specific;
+    uint32_t _pad;
+};
+
+static_assert(sizeof(struct registry_cache_header) % CACHE_FILE_ALIGN == 0,
+              "Unaligned header");
+
+/** Registry loaded from a cache file */
+struct rxkb_cache {
+    /* One reference per object, plus one while loading */
+    uint32_t refcount;
+    struct cache_file file;
+    struct rxkb_model *models;
+    struct rxkb_layout *layouts;
+    struct rxkb_iso639_code *iso639_codes;
+    struct rxkb_iso3166_code *iso3166_codes;
+    struct rxkb_option_group *option_groups;
+    struct rxkb_option *options;
+};
+
+static void
+rxkb_cache_unref(struct rxkb_cache *cache)
+{
+    assert(cache->refcount >= 1);
+    if (--cache->refcount > 0)
+        return;
+    cache_file_unload(&cache->file);
+    free(cache->models);
+    free(cache->layouts);
+    free(cache->iso639_codes);
+    free(cache->iso3166_codes);
+    free(cache->option_groups);
+    free(cache->options);
+    free(cache);
+}
+
+static void
+rxkb_cache_object_init(struct rxkb_cache *cache, struct rxkb_object *object,
+                       struct rxkb_object *parent)
+{
+    rxkb_object_init(object, parent);
+    object->cache = cache;
+    cache->refcount++;
+}
+
+/**
+ * Build the cache key: everything that may change the parsed registry, apart
+ * from the rules files contents.
+ */
+static char *
+get_cache_key(struct rxkb_context *ctx, const char *ruleset)
+{
+    darray_char key = darray_new();
+
+    char * const header = asprintf_safe("registry %d %s\n%s\n%d\n",
+                                        REGISTRY_CACHE_VERSION,
+                                        LIBXKBCOMMON_VERSION, ruleset,
+                                        ctx->load_extra_rules_files);
+    if (!header)
+        return NULL;
+    darray_append_string(key, header);
+    free(header);
+
+    /* Include paths */
+    char **path;
+    darray_foreach(path, ctx->includes) {
+        darray_append_string(key, *path);
+        darray_append(key, '\n');
+    }
+
+    darray_append(key, '\0');
+    char *string = NULL;
+    darray_steal(key, &string, NULL);
+    return string;
+}
+
+/** Get all the rules files looked up by `rxkb_context_parse()` */
+static bool
+get_cache_deps(struct rxkb_context *ctx, const char *ruleset,
+               darray_string *deps)
+{
+    char **path;
+    darray_foreach(path, ctx->includes) {
+        char * const rules = asprintf_safe("%s/rules/%s.xml", *path, ruleset);
+        if (!rules)
+            return false;
+        darray_append(*deps, rules);
+
+        if (ctx->load_extra_rules_files) {
+            char * const extras = asprintf_safe("%s/rules/%s.extras.xml",
+                                                *path, ruleset);
+            if (!extras)
+                return false;
+            darray_append(*deps, extras);
+        }
+    }
+    return true;
+}
+
+static inline char *
+get_cache_path(struct rxkb_context *ctx, const char *key)
+{
+    return (key)
+        ? cache_file_get_path(ctx->cache_dir, key, REGISTRY_CACHE_EXTENSION)
+        : NULL;
+}
+
+/** Get the next section of the payload, if within bounds */
+static const void *
+get_section(const struct cache_file *file, size_t *offset,
+            uint32_t count, size_t item_size)
+{
+    if (*offset > file->payload_size ||
+        count > (file->payload_size - *offset) / item_size)
+        return NULL;
+    const void * const section = file->payload + *offset;
+    *offset = cache_file_align(*offset + count * item_size);
+    return section;
+}
+
+static inline bool
+check_string(uint32_t string, uint32_t strings_size, bool required)
+{
+    return (string == REGISTRY_CACHE_NO_STRING)
+        ? !required
+        : string < strings_size;
+}
+
+static inline bool
+check_popularity(uint32_t popularity)
+{
+    return popularity == RXKB_POPULARITY_STANDARD ||
+           popularity == RXKB_POPULARITY_EXOTIC;
+}
+
+static inline char *
+cache_string(const char *strings, uint32_t string)
+{
+    return (string == REGISTRY_CACHE_NO_STRING)
+        ? NULL
+        /* Read-only: the objects do not own their strings */
+        : (char *) strings + string;
+}
+
+/**
+ * Try to load the registry of the given ruleset from the cache.
+ *
+ * @returns true on cache hit, false otherwise. On failure the context is left
+ * untouched.
+ */
+static bool
+registry_cache_load(struct rxkb_context *ctx, const char *ruleset)
+{
+    bool ok = false;
+    struct cache_file file = { 0 };
+
+    char * const key = get_cache_key(ctx, ruleset);
+    char * const cache_path = get_cache_path(ctx, key);
+    if (!cache_path)
+        goto out;
+    switch (cache_file_load(cache_path, key, &file)) {
+    case CACHE_FILE_LOADED:
+        break;
+    case CACHE_FILE_INVALID:
+        goto invalid;
+    case CACHE_FILE_OUTDATED:
+        log_dbg(ctx, "Registry cache file %s is outdated\n", cache_path);
+        goto out;
+    default:
+        goto out;
+    }
+
+    struct registry_cache_header header;
+    if (file.payload_size < sizeof(header))
+        goto invalid;
+    memcpy(&header, file.payload, sizeof(header));
+
+    size_t offset = sizeof(header);
+    const struct registry_cache_model * const models =
+        get_section(&file, &offset, header.num_models, sizeof(*models));
+    const struct registry_cache_layout * const layouts =
+        get_section(&file, &offset, header.num_layouts, sizeof(*layouts));
+    const uint32_t * const iso639_codes =
+        get_section(&file, &offset, header.num_iso639_codes, sizeof(uint32_t));
+    const uint32_t * const iso3166_codes =
+        get_section(&file, &offset, header.num_iso3166_codes, sizeof(uint32_t));
+    const struct registry_cache_option_group * const option_groups =
+        get_section(&file, &offset, header.num_option_groups,
+                    sizeof(*option_groups));
+    const struct registry_cache_option * const options =
+        get_section(&file, &offset, header.num_options, sizeof(*options));
+    const char * const strings =
+        get_section(&file, &offset, header.strings_size, sizeof(char));
+    if (!models || !layouts || !iso639_codes || !iso3166_codes ||
+        !option_groups || !options || !strings ||
+        (header.strings_size > 0 && strings[header.strings_size - 1] != '\0'))
+        goto invalid;
+
+    /* Check the entries, so that the objects are valid */
+    const uint32_t strings_size = header.strings_size;
+    for (uint32_t i = 0; i < header.num_models; i++) {
+        if (!check_string(models[i].name, strings_size, true) ||
+            !check_string(models[i].vendor, strings_size, false) ||
+            !check_string(models[i].description, strings_size, false) ||
+            !check_popularity(models[i].popularity))
+            goto invalid;
+    }
+    uint64_t num_iso639_codes = 0;
+    uint64_t num_iso3166_codes = 0;
+    for (uint32_t i = 0; i < header.num_layouts; i++) {
+        if (!check_string(layouts[i].name, strings_size, true) ||
+            !check_string(layouts[i].variant, strings_size, false) ||
+            !check_string(layouts[i].brief, strings_size, false) ||
+            !check_string(layouts[i].description, strings_size, false) ||
+            !check_popularity(layouts[i].popularity))
+            goto invalid;
+        num_iso639_codes += layouts[i].num_iso639_codes;
+        num_iso3166_codes += layouts[i].num_iso3166_codes;
+    }
+    if (num_iso639_codes != header.num_iso639_codes ||
+        num_iso3166_codes != header.num_iso3166_codes)
+        goto invalid;
+    for (uint32_t i = 0; i < header.num_iso639_codes; i++) {
+        if (!check_string(iso639_codes[i], strings_size, true))
+            goto invalid;
+    }
+    for (uint32_t i = 0; i < header.num_iso3166_codes; i++) {
+        if (!check_string(iso3166_codes[i], strings_size, true))
+            goto invalid;
+    }
+    uint64_t num_options = 0;
+    for (uint32_t i = 0; i < header.num_option_groups; i++) {
+        if (!check_string(option_groups[i].name, strings_size, true) ||
+            !check_string(option_groups[i].description, strings_size, false) ||
+            !check_popularity(option_groups[i].popularity) ||
+            option_groups[i].allow_multiple > 1)
+            goto invalid;
+        num_options += option_groups[i].num_options;
+    }
+    if (num_options != header.num_options)
+        goto invalid;
+    for (uint32_t i = 0; i < header.num_options; i++) {
+        if (!check_string(options[i].name, strings_size, true) ||
+            !check_string(options[i].brief, strings_size, false) ||
+            !check_string(options[i].description, strings_size, false) ||
+            !check_popularity(options[i].popularity) ||
+            options[i].layout_specific > 1)
+            goto invalid;
+    }
+
+    /* Allocate all the objects at once */
+    struct rxkb_cache * const cache = calloc(1, sizeof(*cache));
+    if (!cache)
+        goto out;
+    cache->refcount = 1;
+    cache->models = calloc(header.num_models, sizeof(*cache->models));
+    cache->layouts = calloc(header.num_layouts, sizeof(*cache->layouts));
+    cache->iso639_codes = calloc(header.num_iso639_codes,
+                                 sizeof(*cache->iso639_codes));
+    cache->iso3166_codes = calloc(header.num_iso3166_codes,
+                                  sizeof(*cache->iso3166_codes));
+    cache->option_groups = calloc(header.num_option_groups,
+                                  sizeof(*cache->option_groups));
+    cache->options = calloc(header.num_options, sizeof(*cache->options));
+    if ((header.num_models && !cache->models) ||
+        (header.num_layouts && !cache->layouts) ||
+        (header.num_iso639_codes && !cache->iso639_codes) ||
+        (header.num_iso3166_codes && !cache->iso3166_codes) ||
+        (header.num_option_groups && !cache->option_groups) ||
+        (header.num_options && !cache->options)) {
+        rxkb_cache_unref(cache);
+        goto out;
+    }
+    cache->file = file;
+    file.map = NULL;
+
+    for (uint32_t i = 0; i < header.num_models; i++) {
+        struct rxkb_model * const m = &cache->models[i];
+        rxkb_cache_object_init(cache, &m->base, &ctx->base);
+        m->name = cache_string(strings, models[i].name);
+        m->vendor = cache_string(strings, models[i].vendor);
+        m->description = cache_string(strings, models[i].description);
+        m->popularity = models[i].popularity;
+        list_append(&ctx->models, &m->base.link);
+    }
+
+    uint32_t iso639 = 0;
+    uint32_t iso3166 = 0;
+    for (uint32_t i = 0; i < header.num_layouts; i++) {
+        struct rxkb_layout * const l = &cache->layouts[i];
+        rxkb_cache_object_init(cache, &l->base, &ctx->base);
+        list_init(&l->iso639s);
+        list_init(&l->iso3166s);
+        l->name = cache_string(strings, layouts[i].name);
+        l->variant = cache_string(strings, layouts[i].variant);
+        l->brief = cache_string(strings, layouts[i].brief);
+        l->description = cache_string(strings, layouts[i].description);
+        l->popularity = layouts[i].popularity;
+        for (uint32_t c = 0; c < layouts[i].num_iso639_codes; c++) {
+            struct rxkb_iso639_code * const code =
+                &cache->iso639_codes[iso639];
+            rxkb_cache_object_init(cache, &code->base, &l->base);
+            code->code = cache_string(strings, iso639_codes[iso639++]);
+            list_append(&l->iso639s, &code->base.link);
+        }
+        for (uint32_t c = 0; c < layouts[i].num_iso3166_codes; c++) {
+            struct rxkb_iso3166_code * const code =
+                &cache->iso3166_codes[iso3166];
+            rxkb_cache_object_init(cache, &code->base, &l->base);
+            code->code = cache_string(strings, iso3166_codes[iso3166++]);
+            list_append(&l->iso3166s, &code->base.link);
+        }
+        list_append(&ctx->layouts, &l->base.link);
+    }
+
+    uint32_t option = 0;
+    for (uint32_t i = 0; i < header.num_option_groups; i++) {
+        struct rxkb_option_group * const g = &cache->option_groups[i];
+        rxkb_cache_object_init(cache, &g->base, &ctx->base);
+        list_init(&g->options);
+        g->name = cache_string(strings, option_groups[i].name);
+        g->description = cache_string(strings, option_groups[i].description);
+        g->popularity = option_groups[i].popularity;
+        g->allow_multiple = option_groups[i].allow_multiple;
+        for (uint32_t o = 0; o < option_groups[i].num_options; o++) {
+            struct rxkb_option * const opt = &cache->options[option];
+            rxkb_cache_object_init(cache, &opt->base, &g->base);
+            opt->name = cache_string(strings, options[option].name);
+            opt->brief = cache_string(strings, options[option].brief);
+            opt->description =
+                cache_string(strings, options[option].description);
+            opt->popularity = options[option].popularity;
+            opt->layout_specific = options[option].layout_specific;
+            list_append(&g->options, &opt->base.link);
+            option++;
+        }
+        list_append(&ctx->option_groups, &g->base.link);
+    }
+
+    /* Drop the loading reference: the objects keep the cache alive */
+    rxkb_cache_unref(cache);
+
+    log_dbg(ctx, "Loaded registry from cache %s\n", cache_path);
+    ok = true;
+    goto out;
+
+invalid:
+    log_dbg(ctx, "Invalid registry cache file: %s\n", cache_path);
+out:
+    cache_file_unload(&file);
+    free(cache_path);
+    free(key);
+    return ok;
+}
+
+static uint32_t
+cache_add_string(darray_char *strings, const char *string)
+{
+    if (!string)
+        return REGISTRY_CACHE_NO_STRING;
+    const uint32_t offset = darray_size(*strings);
+    darray_append_string0(*strings, string);
+    return offset;
+}
+
+/** Store the parsed registry of the given ruleset. Failure is not an error. */
+static void
+registry_cache_store(struct rxkb_context *ctx, const char *ruleset)
+{
+    darray(struct registry_cache_model) models = darray_new();
+    darray(struct registry_cache_layout) layouts = darray_new();
+    darray(uint32_t) iso639_codes = darray_new();
+    darray(uint32_t) iso3166_codes = darray_new();
+    darray(struct registry_cache_option_group) option_groups = darray_new();
+    darray(struct registry_cache_option) options = darray_new();
+    darray_char strings = darray_new();
+    darray_string deps = darray_new();
+
+    char * const key = get_cache_key(ctx, ruleset);
+    char * const cache_path = get_cache_path(ctx, key);
+    if (!cache_path || !get_cache_deps(ctx, ruleset, &deps))
+        goto out;
+
+    struct rxkb_model *m;
+    list_for_each(m, &ctx->models, base.link) {
+        const struct registry_cache_model entry = {
+            .name = cache_add_string(&strings, m->name),
+            .vendor = cache_add_string(&strings, m->vendor),
+            .description = cache_add_string(&strings, m->description),
+            .popularity = m->popularity,
+        };
+        darray_append(models, entry);
+    }
+
+    struct rxkb_layout *l;
+    list_for_each(l, &ctx->layouts, base.link) {
+        struct registry_cache_layout entry = {
+            .name = cache_add_string(&strings, l->name),
+            .variant = cache_add_string(&strings, l->variant),
+            .brief = cache_add_string(&strings, l->brief),
+            .description = cache_add_string(&strings, l->description),
+            .popularity = l->popularity,
+        };
+        struct rxkb_iso639_code *iso639;
+        list_for_each(iso639, &l->iso639s, base.link) {
+            darray_append(iso639_codes,
+                          cache_add_string(&strings, iso639->code));
+            entry.num_iso639_codes++;
+        }
+        struct rxkb_iso3166_code *iso3166;
+        list_for_each(iso3166, &l->iso3166s, base.link) {
+            darray_append(iso3166_codes,
+                          cache_add_string(&strings, iso3166->code));
+            entry.num_iso3166_codes++;
+        }
+        darray_append(layouts, entry);
+    }
+
+    struct rxkb_option_group *g;
+    list_for_each(g, &ctx->option_groups, base.link) {
+        struct registry_cache_option_group entry = {
+            .name = cache_add_string(&strings, g->name),
+            .description = cache_add_string(&strings, g->description),
+            .popularity = g->popularity,
+            .allow_multiple = g->allow_multiple,
+        };
+        struct rxkb_option *o;
+        list_for_each(o, &g->options, base.link) {
+            const struct registry_cache_option option = {
+                .name = cache_add_string(&strings, o->name),
+                .brief = cache_add_string(&strings, o->brief),
+                .description = cache_add_string(&strings, o->description),
+                .popularity = o->popularity,
+                .layout_specific = o->layout_specific,
+            };
+            darray_append(options, option);
+            entry.num_options++;
+        }
+        darray_append(option_groups, entry);
+    }
+
+    const struct registry_cache_header header = {
+        .num_models = darray_size(models),
+        .num_layouts = darray_size(layouts),
+        .num_iso639_codes = darray_size(iso639_codes),
+        .num_iso3166_codes = darray_size(iso3166_codes),
+        .num_option_groups = darray_size(option_groups),
+        .num_options = darray_size(options),
+        .strings_size = darray_size(strings),
+    };
+    const struct cache_chunk chunks[] = {
+        { &header, sizeof(header) },
+        { darray_items(models), sizeof(*models.item) * header.num_models },
+        { darray_items(layouts), sizeof(*layouts.item) * header.num_layouts },
+        { darray_items(iso639_codes),
+          sizeof(*iso639_codes.item) * header.num_iso639_codes },
+        { darray_items(iso3166_codes),
+          sizeof(*iso3166_codes.item) * header.num_iso3166_codes },
+        { darray_items(option_groups),
+          sizeof(*option_groups.item) * header.num_option_groups },
+        { darray_items(options), sizeof(*options.item) * header.num_options },
+        { darray_items(strings), header.strings_size },
+    };
+
+    if (cache_file_store(cache_path, key,
+                         (const char * const *) darray_items(deps),
+                         darray_size(deps), chunks, ARRAY_SIZE(chunks))) {
+        log_dbg(ctx, "Stored registry in cache %s\n", cache_path);
+    } else {
+        log_dbg(ctx, "Could not write registry cache file %s: %s\n",
+                cache_path, strerror(errno));
+    }
+
+out:
+    darray_free(models);
+    darray_free(layouts);
+    darray_free(iso639_codes);
+    darray_free(iso3166_codes);
+    darray_free(option_groups);
+    darray_free(options);
+    darray_free(strings);
+    char **dep;
+    darray_foreach(dep, deps)
+        free(*dep);
+    darray_free(deps);
+    free(cache_path);
+    free(key);
+}
+
 bool
 rxkb_context_parse_default_ruleset(struct rxkb_context *ctx)
 {
@@ -848,6 +1511,11 @@ rxkb_context_parse(struct rxkb_context *ctx, const char *ruleset)
         return false;
     }
 
+    if (ctx->cache_dir && registry_cache_load(ctx, ruleset)) {
+        ctx->context_state = CONTEXT_PARSED;
+        return true;
+    }
+
     darray_foreach_reverse(path, ctx->includes) {
         char rules[PATH_MAX];
 
@@ -869,6 +1537,9 @@ rxkb_context_parse(struct rxkb_context *ctx, const char *ruleset)
 
     ctx->context_state = success ? CONTEXT_PARSED : CONTEXT_FAILED;
 
+    if (success && ctx->cache_dir)
+        registry_cache_store(ctx, ruleset);
+
     return success;
 }
 
@@ -885,6 +1556,244 @@ rxkb_context_get_user_data(struct rxkb_context *ctx)
     return ctx->userdata;
 }
 
+/***====================================================================***/
+
+static int
+compare_index_entries(const struct rxkb_index_entry *a,
+                      const struct rxkb_index_entry *b, bool ignore_case)
+{
+    int ret = (ignore_case) ? istrcmp(a->key, b->key) : strcmp(a->key, b->key);
+    if (ret != 0)
+        return ret;
+    if (a->variant != b->variant) {
+        if (!a->variant)
+            return -1;
+        if (!b->variant)
+            return 1;
+        ret = strcmp(a->variant, b->variant);
+        if (ret != 0)
+            return ret;
+    }
+    return (a->position > b->position) - (a->position < b->position);
+}
+
+static int
+compare_names(const void *a, const void *b)
+{
+    return compare_index_entries(a, b, false);
+}
+
+static int
+compare_codes(const void *a, const void *b)
+{
+    return compare_index_entries(a, b, true);
+}
+
+/** Get the first entry that is not less than the given key */
+static const struct rxkb_index_entry *
+index_lower_bound(const darray_index_entry *index,
+                  const struct rxkb_index_entry *key, bool ignore_case)
+{
+    darray_size_t lower = 0;
+    darray_size_t upper = darray_size(*index);
+    while (lower < upper) {
+        const darray_size_t mid = lower + (upper - lower) / 2;
+        if (compare_index_entries(&darray_item(*index, mid), key,
+                                  ignore_case) < 0)
+            lower = mid + 1;
+        else
+            upper = mid;
+    }
+    return (lower < darray_size(*index)) ? &darray_item(*index, lower) : NULL;
+}
+
+static void
+index_append(darray_index_entry *index, const char *key, const char *variant,
+             uint32_t position, void *object)
+{
+    const struct rxkb_index_entry entry = {
+        .key = key,
+        .variant = variant,
+        .position = position,
+        .object = object,
+    };
+    darray_append(*index, entry);
+}
+
+/** Sort an index of ISO codes and drop the duplicate codes of a layout */
+static void
+index_sort_codes(darray_index_entry *index)
+{
+    qsort(darray_items(*index), darray_size(*index),
+          sizeof(*darray_items(*index)), compare_codes);
+    darray_size_t size = 0;
+    for (darray_size_t e = 0; e < darray_size(*index); e++) {
+        const struct rxkb_index_entry * const entry = &darray_item(*index, e);
+        if (size > 0 &&
+            darray_item(*index, size - 1).position == entry->position &&
+            istreq(darray_item(*index, size - 1).key, entry->key))
+            continue;
+        darray_item(*index, size++) = *entry;
+    }
+    darray_resize(*index, size);
+}
+
+static bool
+rxkb_context_build_index(struct rxkb_context *ctx)
+{
+    struct rxkb_index * const index = &ctx->index;
+    if (index->built)
+        return true;
+    if (ctx->context_state != CONTEXT_PARSED)
+        return false;
+
+    uint32_t position = 0;
+    struct rxkb_model *m;
+    list_for_each(m, &ctx->models, base.link)
+        index_append(&index->models, m->name, NULL, position++, m);
+
+    position = 0;
+    struct rxkb_layout *l;
+    list_for_each(l, &ctx->layouts, base.link) {
+        l->position = position++;
+        index_append(&index->layouts, l->name, l->variant, l->position, l);
+
+        struct rxkb_iso639_code *iso639;
+        list_for_each(iso639, &l->iso639s, base.link)
+            index_append(&index->iso639s, iso639->code, NULL, l->position, l);
+        struct rxkb_iso3166_code *iso3166;
+        list_for_each(iso3166, &l->iso3166s, base.link)
+            index_append(&index->iso3166s, iso3166->code, NULL, l->position, l);
+    }
+
+    position = 0;
+    uint32_t option_position = 0;
+    struct rxkb_option_group *g;
+    list_for_each(g, &ctx->option_groups, base.link) {
+        index_append(&index->option_groups, g->name, NULL, position++, g);
+
+        struct rxkb_option *o;
+        list_for_each(o, &g->options, base.link)
+            index_append(&index->options, o->name, NULL, option_position++, o);
+    }
+
+    darray_index_entry * const names[] = {
+        &index->models, &index->layouts, &index->option_groups, &index->options
+    };
+    for (size_t i = 0; i < ARRAY_SIZE(names); i++) {
+        qsort(darray_items(*names[i]), darray_size(*names[i]),
+              sizeof(*darray_items(*names[i])), compare_names);
+    }
+    index_sort_codes(&index->iso639s);
+    index_sort_codes(&index->iso3166s);
+
+    index->built = true;
+    return true;
+}
+
+static void *
+index_find(struct rxkb_context *ctx, const darray_index_entry *index,
+           const char *name, const char *variant)
+{
+    if (!name || !rxkb_context_build_index(ctx))
+        return NULL;
+    const struct rxkb_index_entry key = { .key = name, .variant = variant };
+    const struct rxkb_index_entry * const entry =
+        index_lower_bound(index, &key, false);
+    if (!entry || !streq(entry->key, name) ||
+        !streq_null(entry->variant, variant))
+        return NULL;
+    return entry->object;
+}
+
+/** Get the first layout with the given ISO code, after the given layout */
+static struct rxkb_layout *
+index_find_layout_by_code(struct rxkb_context *ctx,
+                          const darray_index_entry *index,
+                          const char *code, const struct rxkb_layout *after)
+{
+    if (!code || !rxkb_context_build_index(ctx))
+        return NULL;
+
+    const struct rxkb_index_entry *entry;
+    const struct rxkb_index_entry * const last = ctx->index.last_code;
+    if (after && last && last->object == after &&
+        last >= darray_items(*index) &&
+        last < darray_items(*index) + darray_size(*index) &&
+        istreq(last->key, code)) {
+        /* Continue the previous iteration */
+        entry = (last + 1 < darray_items(*index) + darray_size(*index))
+            ? last + 1
+            : NULL;
+    } else {
+        const struct rxkb_index_entry key = {
+            .key = code,
+            .position = (after) ? after->position + 1 : 0,
+        };
+        entry = index_lower_bound(index, &key, true);
+    }
+
+    if (!entry || !istreq(entry->key, code))
+        return NULL;
+    ctx->index.last_code = entry;
+    return entry->object;
+}
+
+struct rxkb_model *
+rxkb_model_find(struct rxkb_context *ctx, const char *name)
+{
+    return index_find(ctx, &ctx->index.models, name, NULL);
+}
+
+struct rxkb_layout *
+rxkb_layout_find(struct rxkb_context *ctx, const char *name,
+                 const char *variant)
+{
+    if (variant && variant[0] == '\0')
+        variant = NULL;
+    return index_find(ctx, &ctx->index.layouts, name, variant);
+}
+
+struct rxkb_option_group *
+rxkb_option_group_find(struct rxkb_context *ctx, const char *name)
+{
+    return index_find(ctx, &ctx->index.option_groups, name, NULL);
+}
+
+struct rxkb_option *
+rxkb_option_find(struct rxkb_context *ctx, const char *name)
+{
+    return index_find(ctx, &ctx->index.options, name, NULL);
+}
+
+struct rxkb_layout *
+rxkb_layout_first_by_iso639(struct rxkb_context *ctx, const char *code)
+{
+    return index_find_layout_by_code(ctx, &ctx->index.iso639s, code, NULL);
+}
+
+struct rxkb_layout *
+rxkb_layout_next_by_iso639(struct rxkb_layout *layout, const char *code)
+{
+    struct rxkb_context * const ctx =
+        container_of(layout->base.parent, struct rxkb_context, base);
+    return index_find_layout_by_code(ctx, &ctx->index.iso639s, code, layout);
+}
+
+struct rxkb_layout *
+rxkb_layout_first_by_iso3166(struct rxkb_context *ctx, const char *code)
+{
+    return index_find_layout_by_code(ctx, &ctx->index.iso3166s, code, NULL);
+}
+
+struct rxkb_layout *
+rxkb_layout_next_by_iso3166(struct rxkb_layout *layout, const char *code)
+{
+    struct rxkb_context * const ctx =
+        container_of(layout->base.parent, struct rxkb_context, base);
+    return index_find_layout_by_code(ctx, &ctx->index.iso3166s, code, layout);
+}
+
 static inline bool
 is_node(xmlNode *node, const char *name)
 {
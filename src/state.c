@@ -27,6 +27,9 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#if HAVE_C11_ATOMICS
+#include <stdatomic.h>
+#endif
 
 #include "xkbcommon/xkbcommon.h"
 #include "xkbcommon/xkbcommon-errors.h"
@@ -54,19 +57,201 @@
  * it grows as needed but never shrinks. The `next` index is reset to 0
  * on each `process_*` call.
  *
- * @warning Not thread-safe. Must only be used from a single thread.
- * For multi-threaded use, we need a future `xkb_events_new_queue()` will
- * provide a thread-safe implementation (e.g. circular buffer).
+ * `xkb_machine_process_keys()` appends several *frames* (one per key) to the
+ * same queue; `frame` marks the start of the frame being processed, so that
+ * look-ups of previous events do not cross frame boundaries.
+ *
+ * A batch is not thread-safe: it must only be used from a single thread.
+ *
+ * A queue (`xkb_events_new_queue()`) additionally owns a bounded
+ * single-producer/single-consumer lock-free ring. `queue` is then used as
+ * a producer-side staging area, published to the ring at the end of each
+ * `process_*` call, while the consumer reads the ring via `xkb_events_next()`.
  */
 struct xkb_events {
     /**
      * Read cursor for `xkb_events_next()`. Reset to 0 on each `process_*` call.
      */
     darray_size_t next;
+    /** Index of the first event of the frame being processed */
+    darray_size_t frame;
     darray(struct xkb_event) queue;
     struct xkb_context *ctx;
+    /** Ring of published events, if created with `xkb_events_new_queue()` */
+    struct events_ring *ring;
 };
 
+#if HAVE_C11_ATOMICS
+/* Used to keep the fields written by each side on separate cache lines */
+#define EVENTS_RING_CACHE_LINE 64
+
+/**
+ * Bounded single-producer/single-consumer lock-free ring of events.
+ *
+ * `head` is only written by the producer and `tail` only by the consumer.
+ * The producer publishes slots with a release store of `head`; the consumer
+ * releases them with a release store of `tail`. The slot returned by
+ * `xkb_events_next()` remains valid until the next call, so it is only
+ * released then.
+ */
+struct events_ring {
+    /* Producer-written shared fields */
+    atomic_size_t head;
+    atomic_size_t dropped;
+    char producer_pad[EVENTS_RING_CACHE_LINE - 2 * sizeof(atomic_size_t)];
+
+    /* Consumer-written shared fields */
+    atomic_size_t tail;
+    /* Consumer-private: whether the slot at `tail` is held by the consumer */
+    bool held;
+    char consumer_pad[EVENTS_RING_CACHE_LINE - sizeof(atomic_size_t)
+                      - sizeof(bool)];
+
+    /* Producer-private fields */
+    enum xkb_events_flags flags;
+    /** Events that did not fit in the ring yet, if not dropping */
+    darray(struct xkb_event) backlog;
+    darray_size_t backlog_start;
+    /** Merged state of dropped events, if dropping */
+    struct xkb_event dropped_components;
+    bool has_dropped_components;
+
+    /* Immutable fields */
+    size_t mask;
+    struct xkb_event slots[];
+};
+#endif
+
+#if HAVE_C11_ATOMICS
+/** Number of free slots in the ring, from the producer point of view */
+static inline size_t
+events_ring_available(struct events_ring *ring, size_t head)
+{
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return ring->mask + 1 - (head - tail);
+}
+
+/** Write events to the ring starting at `head`, without publishing them */
+static inline size_t
+events_ring_write(struct events_ring *ring, size_t head,
+                  const struct xkb_event *items, size_t count)
+{
+    for (size_t k = 0; k < count; k++)
+        ring->slots[(head + k) & ring->mask] = items[k];
+    return head + count;
+}
+
+/** Publish as many backlog events as possible; returns the remaining count */
+static size_t
+events_ring_flush_backlog(struct events_ring *ring)
+{
+    const darray_size_t pending =
+        darray_size(ring->backlog) - ring->backlog_start;
+    if (!pending)
+        return 0;
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const size_t count = MIN((size_t) pending,
+                             events_ring_available(ring, head));
+    head = events_ring_write(ring, head,
+                             &darray_item(ring->backlog, ring->backlog_start),
+                             count);
+    atomic_store_explicit(&ring->head, head, memory_order_release);
+
+    ring->backlog_start += (darray_size_t) count;
+    if (ring->backlog_start == darray_size(ring->backlog)) {
+        darray_size(ring->backlog) = 0;
+        ring->backlog_start = 0;
+    }
+    return pending - count;
+}
+
+/** Merge the net state change of dropped events */
+static void
+events_ring_merge_dropped(struct events_ring *ring,
+                          const struct xkb_event *items, size_t count)
+{
+    for (size_t k = count; k > 0; k--) {
+        const struct xkb_event * const event = &items[k - 1];
+        if (event->type != XKB_EVENT_TYPE_COMPONENTS_CHANGE)
+            continue;
+        const enum xkb_state_component changed = (ring->has_dropped_components)
+            ? ring->dropped_components.components.changed
+            : 0;
+        ring->dropped_components = *event;
+        ring->dropped_components.components.changed |= changed;
+        ring->has_dropped_components = true;
+        break;
+    }
+}
+
+/**
+ * Publish the events of a `process_*` call to the ring.
+ *
+ * On overflow, the events are either appended to the backlog, to be published
+ * by later calls, or dropped altogether. In the latter case, only their net
+ * state change is kept, so that the consumer does not miss state updates.
+ */
+static void
+events_ring_commit(struct events_ring *ring,
+                   const struct xkb_event *items, size_t count)
+{
+    if (!(ring->flags & XKB_EVENTS_QUEUE_DROP_ON_OVERFLOW)) {
+        size_t published = 0;
+        if (events_ring_flush_backlog(ring) == 0) {
+            size_t head = atomic_load_explicit(&ring->head,
+                                               memory_order_relaxed);
+            published = MIN(count, events_ring_available(ring, head));
+            head = events_ring_write(ring, head, items, published);
+            atomic_store_explicit(&ring->head, head, memory_order_release);
+        }
+        if (published < count)
+            darray_append_items(ring->backlog, &items[published],
+                                (darray_size_t) (count - published));
+        return;
+    }
+
+    if (!count && !ring->has_dropped_components)
+        return;
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const size_t extra = (ring->has_dropped_components) ? 1 : 0;
+    if (count + extra > events_ring_available(ring, head)) {
+        atomic_fetch_add_explicit(&ring->dropped, count, memory_order_relaxed);
+        events_ring_merge_dropped(ring, items, count);
+        return;
+    }
+    if (extra) {
+        head = events_ring_write(ring, head, &ring->dropped_components, 1);
+        ring->has_dropped_components = false;
+    }
+    head = events_ring_write(ring, head, items, count);
+    atomic_store_explicit(&ring->head, head, memory_order_release);
+}
+#endif
+
+/** Reset the events before a `process_*` call */
+static inline void
+events_reset(struct xkb_events *events)
+{
+    darray_size(events->queue) = 0;
+    events->next = 0;
+    events->frame = 0;
+}
+
+/** Publish the events of a `process_*` call, if using a queue */
+static inline void
+events_commit(struct xkb_events *events)
+{
+#if HAVE_C11_ATOMICS
+    if (events->ring) {
+        events_ring_commit(events->ring, darray_items(events->queue),
+                           darray_size(events->queue));
+        darray_size(events->queue) = 0;
+    }
+#endif
+}
+
 struct xkb_server_state;
 
 struct xkb_filter {
@@ -115,6 +300,37 @@ struct out_of_range_group {
     xkb_layout_index_t redirect_group : XKB_LAYOUT_INDEX_T_MIN_WIDTH;
 };
 
+/**
+ * Resolved lookup of the last queried key
+ *
+ * Key queries such as `xkb_state_key_get_syms()`, `xkb_state_key_get_utf8()`
+ * and `xkb_state_key_get_consumed_mods()` are usually performed in a burst for
+ * the same key. They all need the key, its effective layout and the matching
+ * key type entry, so we resolve them once and reuse them for the next queries.
+ *
+ * The entry is keyed on the keycode and the effective modifiers and group, so
+ * it is implicitly invalidated by any change of the state components that
+ * could affect it, whatever the path used to update them.
+ */
+struct key_lookup_cache {
+    /** Keycode of the cached entry, or `XKB_KEYCODE_INVALID` if empty */
+    xkb_keycode_t keycode;
+    /** Effective modifiers used to resolve the entry */
+    xkb_mod_mask_t mods;
+    /** Effective group used to resolve the entry */
+    xkb_layout_index_t group;
+    /** Effective layout of the key, or `XKB_LAYOUT_INVALID` */
+    xkb_layout_index_t layout;
+    /** Effective level of the key, or `XKB_LEVEL_INVALID` */
+    xkb_level_index_t level;
+    /** The key, or NULL if the keycode is not in the keymap */
+    const struct xkb_key *key;
+    /** Matching key type entry, if any */
+    const struct xkb_key_type_entry *entry;
+    /** Effective key level, if any */
+    const struct xkb_level *leveli;
+};
+
 enum { XKB_STATE_MODE_INTERNAL_MIN_WIDTH = 4 /* 3 bits + sign */ };
 static_assert(_XKB_STATE_TYPE_NUM_ENTRIES <
               (1 << XKB_STATE_MODE_INTERNAL_MIN_WIDTH),
@@ -134,9 +350,14 @@ struct xkb_state {
      */
     struct state_components components;
     struct out_of_range_group out_of_range_group;
+    /** Components used by the last LEDs update */
+    struct state_components led_inputs;
+    bool led_inputs_valid;
 
     enum xkb_state_mode_internal mode : XKB_STATE_MODE_INTERNAL_MIN_WIDTH;
     int refcnt : (sizeof(int) * CHAR_BIT - XKB_STATE_MODE_INTERNAL_MIN_WIDTH);
+
+    struct key_lookup_cache key_cache;
 };
 
 /**
@@ -185,6 +406,11 @@ struct xkb_server_state {
 static const struct xkb_key_type_entry *
 get_entry_for_mods(const struct xkb_key_type *type, xkb_mod_mask_t mods)
 {
+    if (likely(type->entries_lut && !(mods & ~type->mods.mask))) {
+        const uint8_t e = type->entries_lut[pext32(mods, type->mods.mask)];
+        return (e) ? &type->entries[e - 1] : NULL;
+    }
+
     for (darray_size_t i = 0; i < type->num_entries; i++)
         if (entry_is_active(&type->entries[i]) &&
             type->entries[i].mods.mask == mods)
@@ -215,6 +441,57 @@ state_key_get_level(struct xkb_state *state, const struct xkb_key *key,
     return (entry) ? entry->level : 0;
 }
 
+static inline xkb_layout_index_t
+state_key_get_layout(struct xkb_state *state, const struct xkb_key *key)
+{
+    static_assert(XKB_MAX_GROUPS < INT32_MAX, "Max groups don't fit");
+    return XkbWrapGroupIntoRange((int32_t) state->components.group,
+                                 key->num_groups,
+                                 key->out_of_range_group_policy,
+                                 key->out_of_range_group_number);
+}
+
+/**
+ * Resolve the key, its effective layout and level for the current state.
+ *
+ * The result is cached in the state until the next query for a different key
+ * or until the effective modifiers or group change.
+ */
+static const struct key_lookup_cache *
+state_key_lookup(struct xkb_state *state, xkb_keycode_t kc)
+{
+    struct key_lookup_cache * const cache = &state->key_cache;
+
+    if (cache->keycode == kc &&
+        cache->mods == state->components.mods &&
+        cache->group == state->components.group)
+        return cache;
+
+    cache->keycode = kc;
+    cache->mods = state->components.mods;
+    cache->group = state->components.group;
+    cache->layout = XKB_LAYOUT_INVALID;
+    cache->level = XKB_LEVEL_INVALID;
+    cache->entry = NULL;
+    cache->leveli = NULL;
+
+    cache->key = XkbKey(state->keymap, kc);
+    if (!cache->key)
+        return cache;
+
+    cache->layout = state_key_get_layout(state, cache->key);
+    if (cache->layout == XKB_LAYOUT_INVALID)
+        return cache;
+
+    /* If we don't find an explicit match the default is 0. */
+    cache->entry = get_entry_for_key_state(state, cache->key, cache->layout);
+    cache->level = (cache->entry) ? cache->entry->level : 0;
+    if (cache->level < XkbKeyNumLevels(cache->key, cache->layout))
+        cache->leveli = &cache->key->groups[cache->layout].levels[cache->level];
+
+    return cache;
+}
+
 /**
  * Returns the level to use for the given key and state, or
  * XKB_LEVEL_INVALID.
@@ -223,21 +500,14 @@ xkb_level_index_t
 xkb_state_key_get_level(struct xkb_state *state, xkb_keycode_t kc,
                         xkb_layout_index_t layout)
 {
-    const struct xkb_key* const key = XkbKey(state->keymap, kc);
+    const struct key_lookup_cache* const lookup = state_key_lookup(state, kc);
 
-    return (key)
-        ? state_key_get_level(state, key, layout)
-        : XKB_LEVEL_INVALID;
-}
+    if (!lookup->key)
+        return XKB_LEVEL_INVALID;
 
-static inline xkb_layout_index_t
-state_key_get_layout(struct xkb_state *state, const struct xkb_key *key)
-{
-    static_assert(XKB_MAX_GROUPS < INT32_MAX, "Max groups don't fit");
-    return XkbWrapGroupIntoRange((int32_t) state->components.group,
-                                 key->num_groups,
-                                 key->out_of_range_group_policy,
-                                 key->out_of_range_group_number);
+    return (layout == lookup->layout)
+        ? lookup->level
+        : state_key_get_level(state, lookup->key, layout);
 }
 
 /**
@@ -247,12 +517,7 @@ state_key_get_layout(struct xkb_state *state, const struct xkb_key *key)
 xkb_layout_index_t
 xkb_state_key_get_layout(struct xkb_state *state, xkb_keycode_t kc)
 {
-    const struct xkb_key* const key = XkbKey(state->keymap, kc);
-
-    if (!key)
-        return XKB_LAYOUT_INVALID;
-
-    return state_key_get_layout(state, key);
+    return state_key_lookup(state, kc)->layout;
 }
 
 /* Empty action used for empty levels */
@@ -405,6 +670,37 @@ get_state_component_changes(const struct state_components *a,
     return mask;
 }
 
+/**
+ * Check whether the components the derived state is computed from differ.
+ *
+ * Effective modifiers, effective layout and LEDs are derived from the
+ * depressed, latched and locked components and from the controls.
+ */
+static inline bool
+state_components_sources_differ(const struct state_components *a,
+                                const struct state_components *b)
+{
+    return a->base_mods != b->base_mods ||
+           a->latched_mods != b->latched_mods ||
+           a->locked_mods != b->locked_mods ||
+           a->base_group != b->base_group ||
+           a->latched_group != b->latched_group ||
+           a->locked_group != b->locked_group ||
+           a->controls != b->controls;
+}
+
+/** Get the last components change event of the current frame, if any */
+static struct xkb_event *
+events_last_components_change(struct xkb_events *events)
+{
+    for (darray_size_t k = darray_size(events->queue); k > events->frame; k--) {
+        struct xkb_event * const event = &darray_item(events->queue, k - 1);
+        if (event->type == XKB_EVENT_TYPE_COMPONENTS_CHANGE)
+            return event;
+    }
+    return NULL;
+}
+
 static void
 xkb_filter_group_lock_new(struct xkb_server_state *state,
                           struct xkb_events *events,
@@ -1061,14 +1357,11 @@ append_redirect_key_events(struct xkb_state *state,
      * Reference state: find the last state update in the queue, otherwise
      * use the current state.
      */
-    struct xkb_event *event;
-    struct state_components last_components = state->components;
-    darray_foreach_reverse(event, events->queue) {
-        if (event->type == XKB_EVENT_TYPE_COMPONENTS_CHANGE) {
-            last_components = event->components.components;
-            break;
-        }
-    }
+    const struct xkb_event * const event =
+        events_last_components_change(events);
+    const struct state_components last_components = (event)
+        ? event->components.components
+        : state->components;
 
     if (mask) {
         struct state_components new = last_components;
@@ -1290,6 +1583,10 @@ xkb_state_init(struct xkb_state * restrict state,
     state->refcnt = 1;
     state->keymap = xkb_keymap_ref(keymap);
     state->out_of_range_group.policy = XKB_LAYOUT_OUT_OF_RANGE_WRAP;
+    /* Must match the result of a lookup of the invalid keycode */
+    state->key_cache.keycode = XKB_KEYCODE_INVALID;
+    state->key_cache.layout = XKB_LAYOUT_INVALID;
+    state->key_cache.level = XKB_LEVEL_INVALID;
 
     /* Ensure that derived state is correctly initialized */
     xkb_state_update_derived(state);
@@ -1414,77 +1711,139 @@ xkb_state_get_keymap(struct xkb_state *state)
     return state->keymap;
 }
 
+/** Evaluate whether a LED is active */
+static bool
+xkb_state_led_is_active(const struct xkb_state *state, const struct xkb_led *led)
+{
+    if (led->which_mods != 0 && led->mods.mask != 0) {
+        xkb_mod_mask_t mod_mask = 0;
+        if (led->which_mods & XKB_STATE_MODS_EFFECTIVE)
+            mod_mask |= state->components.mods;
+        if (led->which_mods & XKB_STATE_MODS_DEPRESSED)
+            mod_mask |= state->components.base_mods;
+        if (led->which_mods & XKB_STATE_MODS_LATCHED)
+            mod_mask |= state->components.latched_mods;
+        if (led->which_mods & XKB_STATE_MODS_LOCKED)
+            mod_mask |= state->components.locked_mods;
+
+        if (led->mods.mask & mod_mask)
+            return true;
+    }
+
+    if (led->which_groups != 0) {
+        if (likely(led->groups) != 0) {
+            xkb_layout_mask_t group_mask = 0;
+            /* Effective and locked groups have been brought into range */
+            assert(state->components.group < XKB_MAX_GROUPS);
+            assert(state->components.locked_group >= 0 &&
+                   state->components.locked_group < XKB_MAX_GROUPS);
+            /* Effective and locked groups are used as mask */
+            if (led->which_groups & XKB_STATE_LAYOUT_EFFECTIVE)
+                group_mask |= (UINT32_C(1) << state->components.group);
+            if (led->which_groups & XKB_STATE_LAYOUT_LOCKED)
+                group_mask |= (UINT32_C(1) << state->components.locked_group);
+            /* Base and latched groups only have to be non-zero */
+            if ((led->which_groups & XKB_STATE_LAYOUT_DEPRESSED) &&
+                state->components.base_group != 0)
+                group_mask |= led->groups;
+            if ((led->which_groups & XKB_STATE_LAYOUT_LATCHED) &&
+                state->components.latched_group != 0)
+                group_mask |= led->groups;
+
+            if (led->groups & group_mask)
+                return true;
+        } else {
+            /* Special case for Base and latched groups */
+            if (((led->which_groups & XKB_STATE_LAYOUT_DEPRESSED) &&
+                 state->components.base_group == 0) ||
+                ((led->which_groups & XKB_STATE_LAYOUT_LATCHED) &&
+                 state->components.latched_group == 0))
+                return true;
+        }
+    }
+
+    return !!(led->ctrls & state->components.controls);
+}
+
 /**
- * Update the LED state to match the rest of the xkb_state.
+ * Update the LEDs.
+ *
+ * Only the LEDs whose inputs changed since the last update are evaluated,
+ * using the inputs saved in `xkb_state::led_inputs` and the dependencies
+ * computed per keymap.
  */
 static void
 xkb_state_led_update_all(struct xkb_state *state)
 {
+    const struct led_dependencies * const deps = &state->keymap->led_deps;
+    const struct state_components * const prev = &state->led_inputs;
+    const struct state_components * const cur = &state->components;
     xkb_led_index_t idx;
     const struct xkb_led *led;
 
-    state->components.leds = 0;
-
-    xkb_leds_enumerate(idx, led, state->keymap) {
-
-        if (led->which_mods != 0 && led->mods.mask != 0) {
-            xkb_mod_mask_t mod_mask = 0;
-            if (led->which_mods & XKB_STATE_MODS_EFFECTIVE)
-                mod_mask |= state->components.mods;
-            if (led->which_mods & XKB_STATE_MODS_DEPRESSED)
-                mod_mask |= state->components.base_mods;
-            if (led->which_mods & XKB_STATE_MODS_LATCHED)
-                mod_mask |= state->components.latched_mods;
-            if (led->which_mods & XKB_STATE_MODS_LOCKED)
-                mod_mask |= state->components.locked_mods;
-
-            if (led->mods.mask & mod_mask) {
+    if (!deps->built || !state->led_inputs_valid) {
+        /* Full update */
+        state->components.leds = 0;
+        xkb_leds_enumerate(idx, led, state->keymap) {
+            if (xkb_state_led_is_active(state, led))
                 state->components.leds |= (UINT32_C(1) << idx);
-                continue;
-            }
         }
+        goto out;
+    }
 
-        if (led->which_groups != 0) {
-            if (likely(led->groups) != 0) {
-                xkb_layout_mask_t group_mask = 0;
-                /* Effective and locked groups have been brought into range */
-                assert(state->components.group < XKB_MAX_GROUPS);
-                assert(state->components.locked_group >= 0 &&
-                       state->components.locked_group < XKB_MAX_GROUPS);
-                /* Effective and locked groups are used as mask */
-                if (led->which_groups & XKB_STATE_LAYOUT_EFFECTIVE)
-                    group_mask |= (UINT32_C(1) << state->components.group);
-                if (led->which_groups & XKB_STATE_LAYOUT_LOCKED)
-                    group_mask |= (UINT32_C(1) << state->components.locked_group);
-                /* Base and latched groups only have to be non-zero */
-                if ((led->which_groups & XKB_STATE_LAYOUT_DEPRESSED) &&
-                    state->components.base_group != 0)
-                    group_mask |= led->groups;
-                if ((led->which_groups & XKB_STATE_LAYOUT_LATCHED) &&
-                    state->components.latched_group != 0)
-                    group_mask |= led->groups;
-
-                if (led->groups & group_mask) {
-                    state->components.leds |= (UINT32_C(1) << idx);
-                    continue;
-                }
-            } else {
-                /* Special case for Base and latched groups */
-                if (((led->which_groups & XKB_STATE_LAYOUT_DEPRESSED) &&
-                     state->components.base_group == 0) ||
-                    ((led->which_groups & XKB_STATE_LAYOUT_LATCHED) &&
-                     state->components.latched_group == 0)) {
-                    state->components.leds |= (UINT32_C(1) << idx);
-                    continue;
-                }
-            }
-        }
+    const xkb_mod_mask_t changed_mods_effective = prev->mods ^ cur->mods;
+    const xkb_mod_mask_t changed_mods_depressed =
+        prev->base_mods ^ cur->base_mods;
+    const xkb_mod_mask_t changed_mods_latched =
+        prev->latched_mods ^ cur->latched_mods;
+    const xkb_mod_mask_t changed_mods_locked =
+        prev->locked_mods ^ cur->locked_mods;
+    enum xkb_state_component changed_groups = 0;
+    if (prev->group != cur->group)
+        changed_groups |= XKB_STATE_LAYOUT_EFFECTIVE;
+    if (prev->base_group != cur->base_group)
+        changed_groups |= XKB_STATE_LAYOUT_DEPRESSED;
+    if (prev->latched_group != cur->latched_group)
+        changed_groups |= XKB_STATE_LAYOUT_LATCHED;
+    if (prev->locked_group != cur->locked_group)
+        changed_groups |= XKB_STATE_LAYOUT_LOCKED;
+    const enum xkb_action_controls changed_ctrls =
+        prev->controls ^ cur->controls;
+
+    /* Fast path: no observed input changed */
+    if (!(changed_mods_effective & deps->mods_effective) &&
+        !(changed_mods_depressed & deps->mods_depressed) &&
+        !(changed_mods_latched & deps->mods_latched) &&
+        !(changed_mods_locked & deps->mods_locked) &&
+        !(changed_groups & deps->groups) &&
+        !(changed_ctrls & deps->ctrls))
+        goto out;
 
-        if (led->ctrls & state->components.controls) {
-            state->components.leds |= (UINT32_C(1) << idx);
+    xkb_leds_enumerate(idx, led, state->keymap) {
+        xkb_mod_mask_t changed_mods = 0;
+        if (led->which_mods & XKB_STATE_MODS_EFFECTIVE)
+            changed_mods |= changed_mods_effective;
+        if (led->which_mods & XKB_STATE_MODS_DEPRESSED)
+            changed_mods |= changed_mods_depressed;
+        if (led->which_mods & XKB_STATE_MODS_LATCHED)
+            changed_mods |= changed_mods_latched;
+        if (led->which_mods & XKB_STATE_MODS_LOCKED)
+            changed_mods |= changed_mods_locked;
+        if (!(changed_mods & led->mods.mask) &&
+            !(changed_groups & led->which_groups) &&
+            !(changed_ctrls & led->ctrls))
             continue;
-        }
+
+        const xkb_led_mask_t bit = UINT32_C(1) << idx;
+        if (xkb_state_led_is_active(state, led))
+            state->components.leds |= bit;
+        else
+            state->components.leds &= ~bit;
     }
+
+out:
+    state->led_inputs = state->components;
+    state->led_inputs_valid = true;
 }
 
 /**
@@ -2062,21 +2421,7 @@ int
 xkb_state_key_get_syms(struct xkb_state *state, xkb_keycode_t kc,
                        const xkb_keysym_t **syms_out)
 {
-    const xkb_layout_index_t layout = xkb_state_key_get_layout(state, kc);
-    if (layout == XKB_LAYOUT_INVALID)
-        goto err;
-
-    const xkb_level_index_t level = xkb_state_key_get_level(state, kc, layout);
-    if (level == XKB_LEVEL_INVALID)
-        goto err;
-
-    const struct xkb_key* const key = XkbKey(state->keymap, kc);
-
-    if (!key)
-        goto err;
-
-    const struct xkb_level* const leveli =
-        xkb_keymap_key_get_level(state->keymap, key, layout, level);
+    const struct xkb_level* const leveli = state_key_lookup(state, kc)->leveli;
 
     if (!leveli)
         goto err;
@@ -2178,31 +2523,22 @@ xkb_state_key_get_one_sym(struct xkb_state *state, xkb_keycode_t kc)
 static xkb_keysym_t
 get_one_sym_for_string(struct xkb_state *state, xkb_keycode_t kc)
 {
-    const xkb_layout_index_t layout = xkb_state_key_get_layout(state, kc);
-    const xkb_layout_index_t num_layouts =
-        xkb_keymap_num_layouts_for_key(state->keymap, kc);
-    xkb_level_index_t level = xkb_state_key_get_level(state, kc, layout);
-    if (layout == XKB_LAYOUT_INVALID || num_layouts == 0 ||
-        level == XKB_LEVEL_INVALID)
+    const struct key_lookup_cache* const lookup = state_key_lookup(state, kc);
+    if (!lookup->leveli || lookup->leveli->num_syms != 1)
         return XKB_KEY_NoSymbol;
 
-    const xkb_keysym_t *syms = NULL;
-    int nsyms = xkb_keymap_key_get_syms_by_level(state->keymap, kc,
-                                                 layout, level, &syms);
-    if (nsyms != 1)
-        return XKB_KEY_NoSymbol;
-    xkb_keysym_t sym = syms[0];
+    xkb_keysym_t sym = lookup->leveli->s.sym;
 
     if (should_do_ctrl_transformation(state, kc) && sym > 127u) {
-        for (xkb_layout_index_t i = 0; i < num_layouts; i++) {
-            level = xkb_state_key_get_level(state, kc, i);
-            if (level == XKB_LEVEL_INVALID)
+        const struct xkb_key* const key = lookup->key;
+        for (xkb_layout_index_t i = 0; i < key->num_groups; i++) {
+            const xkb_level_index_t level = state_key_get_level(state, key, i);
+            if (level >= XkbKeyNumLevels(key, i))
                 continue;
 
-            nsyms = xkb_keymap_key_get_syms_by_level(state->keymap, kc,
-                                                     i, level, &syms);
-            if (nsyms == 1 && syms[0] <= 127u) {
-                sym = syms[0];
+            const struct xkb_level* const leveli = &key->groups[i].levels[level];
+            if (leveli->num_syms == 1 && leveli->s.sym <= 127u) {
+                sym = leveli->s.sym;
                 break;
             }
         }
@@ -2612,19 +2948,18 @@ xkb_state_led_name_is_active(struct xkb_state *state, const char *name)
  * - MyEnhancedXkbTranslateKeyCode(), a modification of the above, from GTK+.
  */
 static xkb_mod_mask_t
-key_get_consumed(struct xkb_state *state, const struct xkb_key *key,
+key_get_consumed(const struct key_lookup_cache *lookup,
                  enum xkb_consumed_mode mode)
 {
-    const xkb_layout_index_t group =
-        xkb_state_key_get_layout(state, key->keycode);
-    if (group == XKB_LAYOUT_INVALID)
+    const struct xkb_key* const key = lookup->key;
+    const xkb_layout_index_t group = lookup->layout;
+    if (!key || group == XKB_LAYOUT_INVALID)
         return 0;
 
     xkb_mod_mask_t preserve = 0;
     xkb_mod_mask_t consumed = 0;
 
-    const struct xkb_key_type_entry* const matching_entry =
-        get_entry_for_key_state(state, key, group);
+    const struct xkb_key_type_entry* const matching_entry = lookup->entry;
     if (matching_entry)
         preserve = matching_entry->preserve.mask;
 
@@ -2668,9 +3003,9 @@ xkb_state_mod_index_is_consumed2(struct xkb_state *state, xkb_keycode_t kc,
                                  xkb_mod_index_t idx,
                                  enum xkb_consumed_mode mode)
 {
-    const struct xkb_key* const key = XkbKey(state->keymap, kc);
+    const struct key_lookup_cache* const lookup = state_key_lookup(state, kc);
 
-    if (unlikely(!key || idx >= xkb_keymap_num_mods(state->keymap)))
+    if (unlikely(!lookup->key || idx >= xkb_keymap_num_mods(state->keymap)))
         return -1;
 
     const xkb_mod_mask_t mapping = state->keymap->mods.mods[idx].mapping;
@@ -2678,7 +3013,7 @@ xkb_state_mod_index_is_consumed2(struct xkb_state *state, xkb_keycode_t kc,
         /* Modifier not mapped */
         return 0;
     }
-    return (mapping & key_get_consumed(state, key, mode)) == mapping;
+    return (mapping & key_get_consumed(lookup, mode)) == mapping;
 }
 
 int
@@ -2693,13 +3028,13 @@ xkb_mod_mask_t
 xkb_state_mod_mask_remove_consumed(struct xkb_state *state, xkb_keycode_t kc,
                                    xkb_mod_mask_t mask)
 {
-    const struct xkb_key* const key = XkbKey(state->keymap, kc);
+    const struct key_lookup_cache* const lookup = state_key_lookup(state, kc);
 
-    if (!key)
+    if (!lookup->key)
         return 0;
 
     return resolve_to_canonical_mods(state->keymap, mask) &
-           ~key_get_consumed(state, key, XKB_CONSUMED_MODE_XKB);
+           ~key_get_consumed(lookup, XKB_CONSUMED_MODE_XKB);
 }
 
 xkb_mod_mask_t
@@ -2716,11 +3051,7 @@ xkb_state_key_get_consumed_mods2(struct xkb_state *state, xkb_keycode_t kc,
         return 0;
     }
 
-    const struct xkb_key* const key = XkbKey(state->keymap, kc);
-    if (!key)
-        return 0;
-
-    return key_get_consumed(state, key, mode);
+    return key_get_consumed(state_key_lookup(state, kc), mode);
 }
 
 xkb_mod_mask_t
@@ -3290,6 +3621,8 @@ xkb_machine_process_synthetic(struct xkb_machine *sm,
                               const struct xkb_state_update *update,
                               struct xkb_events *events)
 {
+    events_reset(events);
+
     /* Check ABI compatibility */
     enum xkb_error_code error =
         check_state_update_abi(sm->base.base.keymap->ctx, update);
@@ -3340,6 +3673,7 @@ xkb_machine_process_synthetic(struct xkb_machine *sm,
         });
     }
 
+    events_commit(events);
     return XKB_SUCCESS;
 }
 
@@ -3466,11 +3800,8 @@ undo_tweaks(const struct xkb_state *state,
             struct xkb_events *events)
 {
     /* Get last component event */
-    const struct xkb_event *event = NULL;
-    darray_foreach_reverse(event, events->queue) {
-        if (event->type == XKB_EVENT_TYPE_COMPONENTS_CHANGE)
-            break;
-    }
+    const struct xkb_event * const event =
+        events_last_components_change(events);
     if (!event)
         return;
 
@@ -3582,19 +3913,22 @@ process_overlayable_key(struct xkb_machine *sm,
     return key;
 }
 
-enum xkb_error_code
-xkb_machine_process_key(struct xkb_machine *sm,
-                        xkb_keycode_t kc, enum xkb_key_direction direction,
-                        struct xkb_events *events)
+/**
+ * Process a single key and append its events to the batch, as a new frame.
+ * The batch is *not* reset.
+ */
+static void
+machine_process_key_frame(struct xkb_machine *sm,
+                          xkb_keycode_t kc, enum xkb_key_direction direction,
+                          struct xkb_events *events)
 {
-    darray_size(events->queue) = 0;
-    events->next = 0;
+    events->frame = darray_size(events->queue);
 
     struct xkb_server_state * const state = &sm->base;
     const struct xkb_key * key = XkbKey(state->base.keymap, kc);
     /* Ignore unknown key and repeat state for non-repeating key */
     if (!key || (direction == XKB_KEY_REPEATED && !key->repeats))
-        return XKB_SUCCESS;
+        return;
 
     const struct state_components previous_components = state->base.components;
 
@@ -3634,11 +3968,18 @@ xkb_machine_process_key(struct xkb_machine *sm,
         }
     }
 
-    xkb_state_update_derived(&state->base);
+    /*
+     * Update the derived components only if needed: the tweaks modify them
+     * directly, otherwise they are up-to-date if their sources are unchanged.
+     */
+    if (remap_event >= 0 ||
+        state_components_sources_differ(&previous_components,
+                                        &state->base.components))
+        xkb_state_update_derived(&state->base);
 
     bool has_key_event = false;
-    const struct xkb_event *event;
-    darray_foreach(event, events->queue) {
+    for (darray_size_t k = events->frame; k < darray_size(events->queue); k++) {
+        const struct xkb_event * const event = &darray_item(events->queue, k);
         switch (event->type) {
         case XKB_EVENT_TYPE_KEY_DOWN:
         case XKB_EVENT_TYPE_KEY_REPEATED:
@@ -3685,6 +4026,33 @@ xkb_machine_process_key(struct xkb_machine *sm,
             }
         });
     }
+}
+
+enum xkb_error_code
+xkb_machine_process_key(struct xkb_machine *sm,
+                        xkb_keycode_t kc, enum xkb_key_direction direction,
+                        struct xkb_events *events)
+{
+    events_reset(events);
+    machine_process_key_frame(sm, kc, direction, events);
+    events_commit(events);
+    return XKB_SUCCESS;
+}
+
+enum xkb_error_code
+xkb_machine_process_keys(struct xkb_machine *sm,
+                         size_t count, const struct xkb_key_input *keys,
+                         struct xkb_events *events, size_t *offsets)
+{
+    events_reset(events);
+
+    for (size_t k = 0; k < count; k++) {
+        if (offsets)
+            offsets[k] = darray_size(events->queue);
+        machine_process_key_frame(sm, keys[k].keycode, keys[k].direction,
+                                  events);
+    }
+    events_commit(events);
     return XKB_SUCCESS;
 }
 
@@ -3712,19 +4080,134 @@ xkb_events_new_batch(struct xkb_context *context, enum xkb_events_flags flags)
     return events;
 }
 
+struct xkb_events *
+xkb_events_new_queue(struct xkb_context *context, size_t capacity,
+                     enum xkb_events_flags flags)
+{
+#if HAVE_C11_ATOMICS
+    static const enum xkb_events_flags XKB_EVENTS_QUEUE_FLAGS =
+        XKB_EVENTS_QUEUE_DROP_ON_OVERFLOW;
+    /* Arbitrary limit, way above any sensible use */
+    static const size_t XKB_EVENTS_QUEUE_MAX_CAPACITY = UINT32_C(1) << 20;
+
+    if (flags & ~XKB_EVENTS_QUEUE_FLAGS) {
+        log_err_func(context, XKB_LOG_MESSAGE_NO_ID,
+                     "unrecognized events queue flags: %#x\n",
+                     (flags & ~XKB_EVENTS_QUEUE_FLAGS));
+        return NULL;
+    }
+
+    if (capacity == 0 || capacity > XKB_EVENTS_QUEUE_MAX_CAPACITY) {
+        log_err_func(context, XKB_LOG_MESSAGE_NO_ID,
+                     "invalid events queue capacity: %zu; expected 1..%zu\n",
+                     capacity, XKB_EVENTS_QUEUE_MAX_CAPACITY);
+        return NULL;
+    }
+
+    /* Round up to a power of 2 */
+    size_t slots = 1;
+    while (slots < capacity)
+        slots <<= 1;
+
+    struct xkb_events * const events = xkb_events_new_batch(
+        context, XKB_EVENTS_NO_FLAGS
+    );
+    if (!events)
+        return NULL;
+
+    struct events_ring * const ring =
+        calloc(1, sizeof(*ring) + slots * sizeof(ring->slots[0]));
+    if (!ring) {
+        log_err(context, XKB_ERROR_ALLOCATION_ERROR,
+                "%s: cannot allocate state events queue\n", __func__);
+        xkb_events_destroy(events);
+        return NULL;
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->tail, 0);
+    ring->held = false;
+    ring->flags = flags;
+    darray_init(ring->backlog);
+    ring->backlog_start = 0;
+    ring->has_dropped_components = false;
+    ring->mask = slots - 1;
+
+    events->ring = ring;
+    return events;
+#else
+    log_err_func(context, XKB_LOG_MESSAGE_NO_ID,
+                 "events queues require C11 atomics, "
+                 "which are not available on this platform\n");
+    return NULL;
+#endif
+}
+
 void
 xkb_events_destroy(struct xkb_events *events)
 {
     if (events == NULL)
         return;
+#if HAVE_C11_ATOMICS
+    if (events->ring) {
+        darray_free(events->ring->backlog);
+        free(events->ring);
+    }
+#endif
     darray_free(events->queue);
     xkb_context_unref(events->ctx);
     free(events);
 }
 
+size_t
+xkb_events_flush(struct xkb_events *events)
+{
+#if HAVE_C11_ATOMICS
+    struct events_ring * const ring = events->ring;
+    if (!ring)
+        return 0;
+    if (ring->flags & XKB_EVENTS_QUEUE_DROP_ON_OVERFLOW) {
+        /* Try to publish the merged state of the dropped events */
+        events_ring_commit(ring, NULL, 0);
+        return (ring->has_dropped_components) ? 1 : 0;
+    }
+    return events_ring_flush_backlog(ring);
+#else
+    return 0;
+#endif
+}
+
+size_t
+xkb_events_get_dropped(struct xkb_events *events)
+{
+#if HAVE_C11_ATOMICS
+    if (events->ring)
+        return atomic_load_explicit(&events->ring->dropped,
+                                    memory_order_relaxed);
+#endif
+    return 0;
+}
+
 const struct xkb_event *
 xkb_events_next(struct xkb_events *events)
 {
+#if HAVE_C11_ATOMICS
+    struct events_ring * const ring = events->ring;
+    if (ring) {
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        if (ring->held) {
+            /* Release the slot returned by the previous call */
+            atomic_store_explicit(&ring->tail, ++tail, memory_order_release);
+            ring->held = false;
+        }
+        const size_t head = atomic_load_explicit(&ring->head,
+                                                 memory_order_acquire);
+        if (tail == head)
+            return NULL;
+        ring->held = true;
+        return &ring->slots[tail & ring->mask];
+    }
+#endif
     if (events->next < darray_size(events->queue)) {
         const darray_size_t index = events->next++;
         return &darray_item(events->queue, index);
@@ -3807,6 +4290,8 @@ xkb_state_update_event(struct xkb_state *base_state,
     if (event->type == XKB_EVENT_TYPE_COMPONENTS_CHANGE) {
         const struct state_components prev_components = state->base.components;
         state->base.components = event->components.components;
+        /* LEDs are set by the event */
+        state->base.led_inputs_valid = false;
         /*
          * Recompute the changes instead of using the event value, because we do
          * not know if the event’s queue and the state are synced.
@@ -0,0 +1,166 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils-arena.h"
+
+struct arena_chunk {
+    struct arena_chunk *next;
+    /** Capacity of the chunk, in bytes */
+    size_t size;
+    /** Bytes used */
+    size_t used;
+    max_align_t data[];
+};
+
+#define ARENA_ALIGNMENT alignof(max_align_t)
+/*
+ * Chunk sizes grow geometrically, so that small arenas remain small. They fit
+ * in a power of 2 allocation, including the chunk header.
+ */
+#define ARENA_CHUNK_MIN_SIZE (1024 - sizeof(struct arena_chunk))
+#define ARENA_CHUNK_MAX_SIZE (16384 - sizeof(struct arena_chunk))
+/* Larger allocations get a dedicated chunk */
+#define ARENA_LARGE_SIZE (ARENA_CHUNK_MAX_SIZE / 4)
+
+static inline unsigned char *
+chunk_data(struct arena_chunk *chunk)
+{
+    return (unsigned char *) chunk->data;
+}
+
+static struct arena_chunk *
+chunk_new(size_t size)
+{
+    if (size > SIZE_MAX - sizeof(struct arena_chunk))
+        return NULL;
+    struct arena_chunk * const chunk = malloc(sizeof(*chunk) + size);
+    if (!chunk)
+        return NULL;
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+void *
+arena_alloc(struct arena *arena, size_t size)
+{
+    if (size > SIZE_MAX - ARENA_ALIGNMENT)
+        return NULL;
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+    if (size == 0)
+        size = ARENA_ALIGNMENT;
+
+    struct arena_chunk *chunk = arena->chunks;
+    if (chunk && chunk->size - chunk->used >= size) {
+        /* Fast path */
+        void * const ptr = chunk_data(chunk) + chunk->used;
+        chunk->used += size;
+        return ptr;
+    }
+
+    if (size > ARENA_LARGE_SIZE && chunk) {
+        /* Dedicated chunk, inserted after the current one, so that the
+         * remaining space of the latter can still be used */
+        struct arena_chunk * const large = chunk_new(size);
+        if (!large)
+            return NULL;
+        large->used = size;
+        large->next = chunk->next;
+        chunk->next = large;
+        return chunk_data(large);
+    }
+
+    size_t chunk_size = ARENA_CHUNK_MIN_SIZE;
+    if (chunk) {
+        chunk_size = 2 * (chunk->size + sizeof(*chunk)) - sizeof(*chunk);
+        if (chunk_size > ARENA_CHUNK_MAX_SIZE)
+            chunk_size = ARENA_CHUNK_MAX_SIZE;
+    }
+    chunk = chunk_new(size > chunk_size ? size : chunk_size);
+    if (!chunk)
+        return NULL;
+    chunk->used = size;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    return chunk_data(chunk);
+}
+
+void *
+arena_calloc(struct arena *arena, size_t nmemb, size_t size)
+{
+    if (size && nmemb > SIZE_MAX / size)
+        return NULL;
+    void * const ptr = arena_alloc(arena, nmemb * size);
+    if (ptr)
+        memset(ptr, 0, nmemb * size);
+    return ptr;
+}
+
+void *
+arena_realloc(struct arena *arena, void *ptr, size_t old_size, size_t new_size)
+{
+    struct arena_chunk * const chunk = arena->chunks;
+    if (ptr && chunk && new_size <= SIZE_MAX - ARENA_ALIGNMENT) {
+        const size_t old_aligned =
+            (old_size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+        const size_t new_aligned =
+            (new_size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+        unsigned char * const data = chunk_data(chunk);
+        if ((unsigned char *) ptr + old_aligned == data + chunk->used &&
+            new_aligned <= chunk->size &&
+            chunk->used - old_aligned <= chunk->size - new_aligned) {
+            /* Last allocation of the current chunk: resize in place */
+            chunk->used = chunk->used - old_aligned + new_aligned;
+            return ptr;
+        }
+    }
+
+    if (new_size <= old_size)
+        return ptr;
+
+    void * const new = arena_alloc(arena, new_size);
+    if (new && old_size)
+        memcpy(new, ptr, old_size);
+    return new;
+}
+
+char *
+arena_strndup(struct arena *arena, const char *s, size_t len)
+{
+    if (len == SIZE_MAX)
+        return NULL;
+    char * const copy = arena_alloc(arena, len + 1);
+    if (!copy)
+        return NULL;
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char *
+arena_strdup(struct arena *arena, const char *s)
+{
+    return (s ? arena_strndup(arena, s, strlen(s)) : NULL);
+}
+
+void
+arena_release(struct arena *arena)
+{
+    struct arena_chunk *chunk = arena->chunks;
+    while (chunk) {
+        struct arena_chunk * const next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+}
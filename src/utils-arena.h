@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "config.h"
+
+#include <stddef.h>
+
+#include "utils.h"
+
+/*
+ * Bump allocator
+ *
+ * Memory is carved out of large chunks and can only be released all at once,
+ * with `arena_release()`. This is intended for data with a common lifetime and
+ * many small allocations, such as the AST of an XKB file: it saves a malloc and
+ * a free per node and the walk of the tree when it is freed.
+ *
+ * Allocations are aligned on `max_align_t`. A zero-initialized `struct arena`
+ * is a valid empty arena.
+ */
+
+struct arena_chunk;
+
+struct arena {
+    /** Current chunk, linked to the previous ones */
+    struct arena_chunk *chunks;
+};
+
+#define ARENA_INIT { .chunks = NULL }
+
+/** Allocate uninitialized memory; returns NULL on failure */
+XKB_EXPORT_PRIVATE void *
+arena_alloc(struct arena *arena, size_t size);
+
+/** Allocate zero-initialized memory; returns NULL on failure */
+XKB_EXPORT_PRIVATE void *
+arena_calloc(struct arena *arena, size_t nmemb, size_t size);
+
+/**
+ * Resize an allocation of the arena.
+ *
+ * The last allocation is resized in place if possible, otherwise the data is
+ * copied to a new allocation. `ptr` may be NULL if `old_size` is 0.
+ * On failure, returns NULL and `ptr` is left untouched.
+ */
+XKB_EXPORT_PRIVATE void *
+arena_realloc(struct arena *arena, void *ptr, size_t old_size, size_t new_size);
+
+/** Copy `len` bytes of `s` to a NUL-terminated string */
+XKB_EXPORT_PRIVATE char *
+arena_strndup(struct arena *arena, const char *s, size_t len);
+
+/** Copy a string; returns NULL if `s` is NULL or on failure */
+XKB_EXPORT_PRIVATE char *
+arena_strdup(struct arena *arena, const char *s);
+
+/** Release all the allocations of the arena and reset it */
+XKB_EXPORT_PRIVATE void
+arena_release(struct arena *arena);
@@ -149,3 +149,23 @@ next_pow2(unsigned int x)
 }
 
 #undef MAKE_PARSE_HEX_TO
+
+/**
+ * Parallel bits extract: gather the bits of `x` selected by `mask` into the
+ * contiguous low-order bits of the result.
+ */
+static inline uint32_t
+pext32(uint32_t x, uint32_t mask)
+{
+#if defined(__BMI2__) && (defined(__GNUC__) || defined(__clang__))
+    return __builtin_ia32_pext_si(x, mask);
+#else
+    uint32_t result = 0;
+    for (uint32_t bit = 1; mask; bit <<= 1) {
+        if (x & mask & -mask)
+            result |= bit;
+        mask &= mask - 1;
+    }
+    return result;
+#endif
+}
@@ -14,6 +14,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #if HAVE_UNISTD_H
 # include <unistd.h>
 #else
@@ -263,6 +265,43 @@ one_bit_set(uint32_t x)
 bool
 map_file(FILE *file, char **string_out, size_t *size_out);
 
+/**
+ * Metadata identifying a version of a file, used to detect modifications.
+ *
+ * The nanoseconds of the modification time catch quick rewrites of the same
+ * size, and the inode catches files replaced by renaming.
+ */
+struct file_stamp {
+    int64_t mtime;
+    int64_t mtime_nsec;
+    int64_t size;
+    uint64_t ino;
+    uint64_t dev;
+};
+
+static inline void
+file_stamp_from_stat(struct file_stamp *stamp, const struct stat *st)
+{
+    stamp->mtime = (int64_t) st->st_mtime;
+#if HAVE_STRUCT_STAT_ST_MTIM
+    stamp->mtime_nsec = (int64_t) st->st_mtim.tv_nsec;
+#elif HAVE_STRUCT_STAT_ST_MTIMESPEC
+    stamp->mtime_nsec = (int64_t) st->st_mtimespec.tv_nsec;
+#else
+    stamp->mtime_nsec = 0;
+#endif
+    stamp->size = (int64_t) st->st_size;
+    stamp->ino = (uint64_t) st->st_ino;
+    stamp->dev = (uint64_t) st->st_dev;
+}
+
+static inline bool
+file_stamp_eq(const struct file_stamp *a, const struct file_stamp *b)
+{
+    return a->mtime == b->mtime && a->mtime_nsec == b->mtime_nsec &&
+           a->size == b->size && a->ino == b->ino && a->dev == b->dev;
+}
+
 void
 unmap_file(char *string, size_t size);
 
@@ -438,6 +438,8 @@ get_types(struct xkb_keymap *keymap, xcb_connection_t *conn,
         /* Checked only when compiling a keymap from text */
         type->required = true;
 
+        FAIL_UNLESS(XkbKeyTypeUpdateEntriesLUT(type));
+
         xcb_xkb_key_type_next(&types_iter);
     }
 
@@ -1240,72 +1242,159 @@ fail:
     return false;
 }
 
-struct xkb_keymap *
-xkb_x11_keymap_new_from_device(struct xkb_context *ctx,
-                               xcb_connection_t *conn,
-                               int32_t device_id,
-                               enum xkb_keymap_compile_flags flags)
+/* Requests for the keymap of a single device */
+struct x11_keymap_request {
+    struct xkb_keymap *keymap;
+    xcb_xkb_get_map_cookie_t map_cookie;
+    xcb_xkb_get_indicator_map_cookie_t indicator_map_cookie;
+    xcb_xkb_get_compat_map_cookie_t compat_map_cookie;
+    xcb_xkb_get_names_cookie_t names_cookie;
+    xcb_xkb_get_controls_cookie_t controls_cookie;
+    bool failed;
+};
+
+static void
+send_keymap_requests(struct x11_keymap_request *request,
+                     xcb_connection_t *conn, int32_t device_id)
 {
-    if (device_id < 0 || device_id > 127) {
-        log_err_func(ctx, XKB_LOG_MESSAGE_NO_ID,
-                     "illegal device ID: %"PRId32"\n", device_id);
-        return NULL;
-    }
-
-    const enum xkb_keymap_format format = XKB_KEYMAP_FORMAT_TEXT_V1;
-    struct xkb_keymap * const keymap =
-        xkb_keymap_new(ctx, __func__, format, flags);
-    if (!keymap)
-        return NULL;
-
-    keymap->redirect_key_auto = XKB_KEYCODE_MAX; /* Invalid X11 keycode */
-
-    struct x11_atom_interner interner;
-    x11_atom_interner_init(&interner, ctx, conn);
-
-    /*
-     * Send all requests together so only one roundtrip is needed
-     * to get the replies.
-     */
-    xcb_xkb_get_map_cookie_t map_cookie =
+    request->map_cookie =
         xcb_xkb_get_map(conn, device_id, get_map_required_components,
                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
-    xcb_xkb_get_indicator_map_cookie_t indicator_map_cookie =
+    request->indicator_map_cookie =
         xcb_xkb_get_indicator_map(conn, device_id, ALL_INDICATORS_MASK);
-    xcb_xkb_get_compat_map_cookie_t compat_map_cookie =
+    request->compat_map_cookie =
         xcb_xkb_get_compat_map(conn, device_id, 0, true, 0, 0);
-    xcb_xkb_get_names_cookie_t names_cookie =
+    request->names_cookie =
         xcb_xkb_get_names(conn, device_id, get_names_wanted);
-    xcb_xkb_get_controls_cookie_t controls_cookie =
+    request->controls_cookie =
         xcb_xkb_get_controls(conn, device_id);
+}
+
+/*
+ * Process the replies of a device. The atoms are only resolved by the next
+ * interner round trip, so the keymap must be kept alive until then, even on
+ * failure.
+ */
+static bool
+get_keymap_replies(struct x11_keymap_request *request,
+                   struct x11_atom_interner *interner)
+{
+    struct xkb_keymap * const keymap = request->keymap;
+    xcb_connection_t * const conn = interner->conn;
 
-    if (!get_map(keymap, conn, map_cookie))
+    if (!get_map(keymap, conn, request->map_cookie))
         goto err_map;
-    if (!get_indicator_map(keymap, conn, indicator_map_cookie))
+    if (!get_indicator_map(keymap, conn, request->indicator_map_cookie))
         goto err_indicator_map;
-    if (!get_compat_map(keymap, conn, compat_map_cookie))
+    if (!get_compat_map(keymap, conn, request->compat_map_cookie))
         goto err_compat_map;
-    if (!get_names(keymap, &interner, names_cookie))
+    if (!get_names(keymap, interner, request->names_cookie))
         goto err_names;
-    if (!get_controls(keymap, conn, controls_cookie))
+    if (!get_controls(keymap, conn, request->controls_cookie))
         goto err_controls;
-    x11_atom_interner_round_trip(&interner);
-    if (interner.had_error)
-        goto err_interner;
 
-    return keymap;
+    return true;
 
 err_map:
-    xcb_discard_reply(conn, indicator_map_cookie.sequence);
+    xcb_discard_reply(conn, request->indicator_map_cookie.sequence);
 err_indicator_map:
-    xcb_discard_reply(conn, compat_map_cookie.sequence);
+    xcb_discard_reply(conn, request->compat_map_cookie.sequence);
 err_compat_map:
-    xcb_discard_reply(conn, names_cookie.sequence);
+    xcb_discard_reply(conn, request->names_cookie.sequence);
 err_names:
-    xcb_discard_reply(conn, controls_cookie.sequence);
+    xcb_discard_reply(conn, request->controls_cookie.sequence);
 err_controls:
+    return false;
+}
+
+size_t
+xkb_x11_keymap_new_from_devices(struct xkb_context *ctx,
+                                xcb_connection_t *conn,
+                                size_t count, const int32_t *device_ids,
+                                enum xkb_keymap_compile_flags flags,
+                                struct xkb_keymap **keymaps)
+{
+    if (count == 0)
+        return 0;
+
+    struct x11_keymap_request * const requests =
+        calloc(count, sizeof(*requests));
+    if (!requests) {
+        log_err(ctx, XKB_ERROR_ALLOCATION_ERROR,
+                "%s: cannot allocate keymap requests\n", __func__);
+        for (size_t d = 0; d < count; d++)
+            keymaps[d] = NULL;
+        return 0;
+    }
+
+    /*
+     * Send all requests of all devices together so only one roundtrip is
+     * needed to get the replies.
+     */
+    const enum xkb_keymap_format format = XKB_KEYMAP_FORMAT_TEXT_V1;
+    for (size_t d = 0; d < count; d++) {
+        if (device_ids[d] < 0 || device_ids[d] > 127) {
+            log_err_func(ctx, XKB_LOG_MESSAGE_NO_ID,
+                         "illegal device ID: %"PRId32"\n", device_ids[d]);
+            continue;
+        }
+
+        struct xkb_keymap * const keymap =
+            xkb_keymap_new(ctx, __func__, format, flags);
+        if (!keymap)
+            continue;
+        keymap->redirect_key_auto = XKB_KEYCODE_MAX; /* Invalid X11 keycode */
+
+        requests[d].keymap = keymap;
+        send_keymap_requests(&requests[d], conn, device_ids[d]);
+    }
+
+    /*
+     * The atoms of all the devices are resolved in a single round trip.
+     * Their errors are tracked per device, unless the allocation of the
+     * array fails: then any error fails all the devices.
+     */
+    bool * const atom_errors = calloc(count, sizeof(*atom_errors));
+    struct x11_atom_interner interner;
+    x11_atom_interner_init(&interner, ctx, conn);
+    interner.owner_errors = atom_errors;
+    for (size_t d = 0; d < count; d++) {
+        interner.owner = (darray_size_t) d;
+        if (requests[d].keymap)
+            requests[d].failed = !get_keymap_replies(&requests[d], &interner);
+    }
     x11_atom_interner_round_trip(&interner);
-err_interner:
-    xkb_keymap_unref(keymap);
-    return NULL;
+    x11_atom_interner_finish(&interner);
+
+    size_t created = 0;
+    for (size_t d = 0; d < count; d++) {
+        struct xkb_keymap * const keymap = requests[d].keymap;
+        const bool atom_error =
+            (atom_errors) ? atom_errors[d] : interner.had_error;
+        if (keymap && (requests[d].failed || atom_error)) {
+            xkb_keymap_unref(keymap);
+            keymaps[d] = NULL;
+        } else if (keymap) {
+            keymap_freeze(keymap);
+            keymaps[d] = keymap;
+            created++;
+        } else {
+            keymaps[d] = NULL;
+        }
+    }
+
+    free(atom_errors);
+    free(requests);
+    return created;
+}
+
+struct xkb_keymap *
+xkb_x11_keymap_new_from_device(struct xkb_context *ctx,
+                               xcb_connection_t *conn,
+                               int32_t device_id,
+                               enum xkb_keymap_compile_flags flags)
+{
+    struct xkb_keymap *keymap = NULL;
+    xkb_x11_keymap_new_from_devices(ctx, conn, 1, &device_id, flags, &keymap);
+    return keymap;
 }
@@ -109,6 +109,13 @@ xkb_x11_get_core_keyboard_device_id(xcb_connection_t *conn)
     return device_id;
 }
 
+/**
+ * X11 atom → xkb_atom_t hash table, with open addressing and linear probing.
+ *
+ * It is a single allocation, so that the context can free it without knowing
+ * its layout. Its size is a power of 2 and free slots have `from` set to
+ * `XCB_ATOM_NONE`, which is never cached.
+ */
 struct x11_atom_cache {
     /*
      * Invalidate the cache based on the XCB connection.
@@ -116,24 +123,100 @@ struct x11_atom_cache {
      * session. But better be safe just in case we survive an X server restart.
      */
     xcb_connection_t *conn;
+    size_t len;
+    size_t mask;
     struct {
         xcb_atom_t from;
         xkb_atom_t to;
-    } cache[256];
-    size_t len;
+    } cache[];
 };
 
+#define X11_ATOM_CACHE_MIN_SIZE 256
+
+static inline size_t
+x11_atom_cache_slot(xcb_atom_t atom, size_t mask)
+{
+    /*
+     * X11 atoms are mostly small consecutive integers: multiplying by an odd
+     * constant is a bijection on the low bits that keeps them in distinct slots.
+     */
+    return (size_t) (atom * UINT32_C(0x9E3779B1)) & mask;
+}
+
+static struct x11_atom_cache *
+x11_atom_cache_new(size_t size)
+{
+    struct x11_atom_cache * const cache =
+        calloc(1, sizeof(*cache) + size * sizeof(cache->cache[0]));
+    if (cache)
+        cache->mask = size - 1;
+    return cache;
+}
+
+static bool
+x11_atom_cache_lookup(const struct x11_atom_cache *cache, xcb_atom_t atom,
+                      xkb_atom_t *out)
+{
+    for (size_t slot = x11_atom_cache_slot(atom, cache->mask);;
+         slot = (slot + 1) & cache->mask) {
+        if (cache->cache[slot].from == atom) {
+            *out = cache->cache[slot].to;
+            return true;
+        }
+        if (cache->cache[slot].from == XCB_ATOM_NONE)
+            return false;
+    }
+}
+
+static void
+x11_atom_cache_insert_slot(struct x11_atom_cache *cache, xcb_atom_t from,
+                           xkb_atom_t to)
+{
+    size_t slot = x11_atom_cache_slot(from, cache->mask);
+    while (cache->cache[slot].from != XCB_ATOM_NONE &&
+           cache->cache[slot].from != from)
+        slot = (slot + 1) & cache->mask;
+    if (cache->cache[slot].from == XCB_ATOM_NONE)
+        cache->len++;
+    cache->cache[slot].from = from;
+    cache->cache[slot].to = to;
+}
+
+/* Insert an atom, growing the table to keep the load factor ≤ 0.5 */
+static void
+x11_atom_cache_insert(struct xkb_context *ctx, xcb_atom_t from, xkb_atom_t to)
+{
+    struct x11_atom_cache *cache = ctx->x11_atom_cache;
+    if (2 * (cache->len + 1) > cache->mask + 1) {
+        const size_t size = 2 * (cache->mask + 1);
+        struct x11_atom_cache * const new = x11_atom_cache_new(size);
+        /* Keep the current table if the allocation failed */
+        if (!new)
+            return;
+        new->conn = cache->conn;
+        for (size_t k = 0; k <= cache->mask; k++) {
+            if (cache->cache[k].from != XCB_ATOM_NONE)
+                x11_atom_cache_insert_slot(new, cache->cache[k].from,
+                                           cache->cache[k].to);
+        }
+        free(cache);
+        ctx->x11_atom_cache = cache = new;
+    }
+    x11_atom_cache_insert_slot(cache, from, to);
+}
+
 static struct x11_atom_cache *
 get_cache(struct xkb_context *ctx, xcb_connection_t *conn)
 {
     if (!ctx->x11_atom_cache) {
-        ctx->x11_atom_cache = calloc(1, sizeof(struct x11_atom_cache));
+        ctx->x11_atom_cache = x11_atom_cache_new(X11_ATOM_CACHE_MIN_SIZE);
     }
     /* Can be NULL in case the malloc failed. */
     struct x11_atom_cache *cache = ctx->x11_atom_cache;
     if (cache && cache->conn != conn) {
         cache->conn = conn;
         cache->len = 0;
+        memset(cache->cache, 0, (cache->mask + 1) * sizeof(cache->cache[0]));
     }
     return cache;
 }
@@ -143,11 +226,81 @@ x11_atom_interner_init(struct x11_atom_interner *interner,
                        struct xkb_context *ctx, xcb_connection_t *conn)
 {
     interner->had_error = false;
+    interner->owner = 0;
+    interner->owner_errors = NULL;
     interner->ctx = ctx;
     interner->conn = conn;
-    interner->num_pending = 0;
-    interner->num_copies = 0;
-    interner->num_escaped = 0;
+    darray_init(interner->pending);
+    darray_init(interner->pending_index);
+    darray_init(interner->copies);
+    darray_init(interner->escaped);
+}
+
+void
+x11_atom_interner_finish(struct x11_atom_interner *interner)
+{
+    assert(darray_empty(interner->pending) &&
+           darray_empty(interner->escaped));
+    darray_free(interner->pending);
+    darray_free(interner->pending_index);
+    darray_free(interner->copies);
+    darray_free(interner->escaped);
+}
+
+/** Get the pending request of an atom, or NULL */
+static struct x11_pending_atom *
+x11_atom_interner_find_pending(struct x11_atom_interner *interner,
+                               xcb_atom_t atom)
+{
+    const darray_size_t size = darray_size(interner->pending_index);
+    if (size == 0)
+        return NULL;
+    for (size_t slot = x11_atom_cache_slot(atom, size - 1);;
+         slot = (slot + 1) & (size - 1)) {
+        const darray_size_t idx = darray_item(interner->pending_index, slot);
+        if (idx == 0)
+            return NULL;
+        if (darray_item(interner->pending, idx - 1).from == atom)
+            return &darray_item(interner->pending, idx - 1);
+    }
+}
+
+static void
+x11_atom_interner_index_slot(struct x11_atom_interner *interner,
+                             darray_size_t idx)
+{
+    const size_t mask = darray_size(interner->pending_index) - 1;
+    const xcb_atom_t atom = darray_item(interner->pending, idx - 1).from;
+    size_t slot = x11_atom_cache_slot(atom, mask);
+    while (darray_item(interner->pending_index, slot) != 0)
+        slot = (slot + 1) & mask;
+    darray_item(interner->pending_index, slot) = idx;
+}
+
+/* Index the last pending atom, growing the table to keep the load factor ≤ 0.5 */
+static void
+x11_atom_interner_index_pending(struct x11_atom_interner *interner)
+{
+    const darray_size_t count = darray_size(interner->pending);
+    darray_size_t size = darray_size(interner->pending_index);
+    if (2 * count > size) {
+        size = (size) ? 2 * size : 64;
+        darray_resize0(interner->pending_index, 0);
+        darray_resize0(interner->pending_index, size);
+        for (darray_size_t idx = 1; idx <= count; idx++)
+            x11_atom_interner_index_slot(interner, idx);
+    } else {
+        x11_atom_interner_index_slot(interner, count);
+    }
+}
+
+static void
+x11_atom_interner_set_error(struct x11_atom_interner *interner,
+                            darray_size_t owner)
+{
+    interner->had_error = true;
+    if (interner->owner_errors)
+        interner->owner_errors[owner] = true;
 }
 
 void
@@ -162,42 +315,32 @@ x11_atom_interner_adopt_atom(struct x11_atom_interner *interner,
     /* Can be NULL in case the malloc failed. */
     struct x11_atom_cache *cache = get_cache(interner->ctx, interner->conn);
 
-retry:
-
     /* Already in the cache? */
-    if (cache) {
-        for (size_t c = 0; c < cache->len; c++) {
-            if (cache->cache[c].from == atom) {
-                *out = cache->cache[c].to;
-                return;
-            }
-        }
-    }
-
-    /* Already pending? */
-    for (size_t i = 0; i < interner->num_pending; i++) {
-        if (interner->pending[i].from == atom) {
-            if (interner->num_copies == ARRAY_SIZE(interner->copies)) {
-                x11_atom_interner_round_trip(interner);
-                goto retry;
-            }
+    if (cache && x11_atom_cache_lookup(cache, atom, out))
+        return;
 
-            size_t idx = interner->num_copies++;
-            interner->copies[idx].from = atom;
-            interner->copies[idx].out = out;
-            return;
-        }
+    /* Already pending? Chain the copy to the pending request */
+    struct x11_pending_atom * const pending =
+        x11_atom_interner_find_pending(interner, atom);
+    if (pending) {
+        darray_append(interner->copies, (struct x11_copied_atom) {
+            .out = out,
+            .owner = interner->owner,
+            .next = pending->copies,
+        });
+        pending->copies = darray_size(interner->copies);
+        return;
     }
 
     /* We have to send a GetAtomName request */
-    if (interner->num_pending == ARRAY_SIZE(interner->pending)) {
-        x11_atom_interner_round_trip(interner);
-        assert(interner->num_pending < ARRAY_SIZE(interner->pending));
-    }
-    size_t idx = interner->num_pending++;
-    interner->pending[idx].from = atom;
-    interner->pending[idx].out = out;
-    interner->pending[idx].cookie = xcb_get_atom_name(interner->conn, atom);
+    darray_append(interner->pending, (struct x11_pending_atom) {
+        .from = atom,
+        .out = out,
+        .cookie = xcb_get_atom_name(interner->conn, atom),
+        .owner = interner->owner,
+        .copies = 0,
+    });
+    x11_atom_interner_index_pending(interner);
 }
 
 void
@@ -208,44 +351,49 @@ x11_atom_interner_round_trip(struct x11_atom_interner *interner) {
     /* Can be NULL in case the malloc failed. */
     struct x11_atom_cache *cache = get_cache(ctx, conn);
 
-    for (size_t i = 0; i < interner->num_pending; i++) {
+    const struct x11_pending_atom *pending;
+    darray_foreach(pending, interner->pending) {
         xcb_get_atom_name_reply_t *reply;
 
-        reply = xcb_get_atom_name_reply(conn, interner->pending[i].cookie, NULL);
+        reply = xcb_get_atom_name_reply(conn, pending->cookie, NULL);
         if (!reply) {
-            interner->had_error = true;
+            x11_atom_interner_set_error(interner, pending->owner);
+            for (darray_size_t c = pending->copies; c != 0;
+                 c = darray_item(interner->copies, c - 1).next)
+                x11_atom_interner_set_error(
+                    interner, darray_item(interner->copies, c - 1).owner
+                );
             continue;
         }
-        xcb_atom_t x11_atom = interner->pending[i].from;
+        xcb_atom_t x11_atom = pending->from;
         xkb_atom_t atom = xkb_atom_intern(ctx,
                                           xcb_get_atom_name_name(reply),
                                           xcb_get_atom_name_name_length(reply));
         free(reply);
 
-        if (cache && cache->len < ARRAY_SIZE(cache->cache)) {
-            size_t idx = cache->len++;
-            cache->cache[idx].from = x11_atom;
-            cache->cache[idx].to = atom;
+        if (cache) {
+            x11_atom_cache_insert(ctx, x11_atom, atom);
+            cache = ctx->x11_atom_cache;
         }
 
-        *interner->pending[i].out = atom;
+        *pending->out = atom;
 
-        for (size_t j = 0; j < interner->num_copies; j++) {
-            if (interner->copies[j].from == x11_atom)
-                *interner->copies[j].out = atom;
-        }
+        for (darray_size_t c = pending->copies; c != 0;
+             c = darray_item(interner->copies, c - 1).next)
+            *darray_item(interner->copies, c - 1).out = atom;
     }
 
-    for (size_t i = 0; i < interner->num_escaped; i++) {
+    const struct x11_escaped_atom *escaped;
+    darray_foreach(escaped, interner->escaped) {
         xcb_get_atom_name_reply_t *reply;
         int length;
         char *name;
-        char **out = interner->escaped[i].out;
+        char **out = escaped->out;
 
-        reply = xcb_get_atom_name_reply(conn, interner->escaped[i].cookie, NULL);
-        *interner->escaped[i].out = NULL;
+        reply = xcb_get_atom_name_reply(conn, escaped->cookie, NULL);
+        *out = NULL;
         if (!reply) {
-            interner->had_error = true;
+            x11_atom_interner_set_error(interner, escaped->owner);
         } else {
             length = xcb_get_atom_name_name_length(reply);
             name = xcb_get_atom_name_name(reply);
@@ -253,16 +401,20 @@ x11_atom_interner_round_trip(struct x11_atom_interner *interner) {
             *out = strndup(name, length);
             free(reply);
             if (*out == NULL) {
-                interner->had_error = true;
+                x11_atom_interner_set_error(interner, escaped->owner);
             } else {
                 XkbEscapeMapName(*out);
             }
         }
     }
 
-    interner->num_pending = 0;
-    interner->num_copies = 0;
-    interner->num_escaped = 0;
+    darray_size(interner->pending) = 0;
+    if (!darray_empty(interner->pending_index))
+        memset(darray_items(interner->pending_index), 0,
+               darray_size(interner->pending_index) *
+               sizeof(*darray_items(interner->pending_index)));
+    darray_size(interner->copies) = 0;
+    darray_size(interner->escaped) = 0;
 }
 
 void
@@ -273,11 +425,9 @@ x11_atom_interner_get_escaped_atom_name(struct x11_atom_interner *interner,
         *out = NULL;
         return;
     }
-    size_t idx = interner->num_escaped++;
-    /* There can only be a fixed number of calls to this function "in-flight",
-     * thus we assert this number. Increase the array size if this assert fails.
-     */
-    assert(idx < ARRAY_SIZE(interner->escaped));
-    interner->escaped[idx].out = out;
-    interner->escaped[idx].cookie = xcb_get_atom_name(interner->conn, atom);
+    darray_append(interner->escaped, (struct x11_escaped_atom) {
+        .cookie = xcb_get_atom_name(interner->conn, atom),
+        .out = out,
+        .owner = interner->owner,
+    });
 }
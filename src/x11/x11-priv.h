@@ -15,25 +15,41 @@ struct x11_atom_interner {
     struct xkb_context *ctx;
     xcb_connection_t *conn;
     bool had_error;
+    /* Owner of the next requests, e.g. a device, to attribute the errors */
+    darray_size_t owner;
+    /* Optional array of errors per owner, updated by the round trip */
+    bool *owner_errors;
+    /*
+     * The following arrays are growable, so that the atoms of several keymaps
+     * can be resolved in a single round trip.
+     */
     /* Atoms for which we send a GetAtomName request */
-    struct {
+    darray(struct x11_pending_atom {
         xcb_atom_t from;
         xkb_atom_t *out;
         xcb_get_atom_name_cookie_t cookie;
-    } pending[128];
-    size_t num_pending;
+        darray_size_t owner;
+        /* Index + 1 of the first copy in `copies`, or 0 if none */
+        darray_size_t copies;
+    }) pending;
+    /*
+     * X11 atom → index + 1 in `pending`, or 0 for free slots: hash table
+     * with linear probing. Its size is 0 or a power of 2.
+     */
+    darray(darray_size_t) pending_index;
     /* Atoms which were already pending but queried again */
-    struct {
-        xcb_atom_t from;
+    darray(struct x11_copied_atom {
         xkb_atom_t *out;
-    } copies[128];
-    size_t num_copies;
+        darray_size_t owner;
+        /* Index + 1 of the next copy of the same atom, or 0 if none */
+        darray_size_t next;
+    }) copies;
     /* These are not interned, but saved directly (after XkbEscapeMapName) */
-    struct {
+    darray(struct x11_escaped_atom {
         xcb_get_atom_name_cookie_t cookie;
         char **out;
-    } escaped[4];
-    size_t num_escaped;
+        darray_size_t owner;
+    }) escaped;
 };
 
 void
@@ -43,9 +59,13 @@ x11_atom_interner_init(struct x11_atom_interner *interner,
 void
 x11_atom_interner_round_trip(struct x11_atom_interner *interner);
 
+/* Free the interner arrays. Pending requests must have been round-tripped. */
+void
+x11_atom_interner_finish(struct x11_atom_interner *interner);
+
 /*
  * Make a xkb_atom_t's from X atoms. The actual write is delayed until the next
- * call to x11_atom_interner_round_trip() or when too many atoms are pending.
+ * call to x11_atom_interner_round_trip().
  */
 void
 x11_atom_interner_adopt_atom(struct x11_atom_interner *interner,
@@ -61,3 +81,22 @@ x11_atom_interner_get_escaped_atom_name(struct x11_atom_interner *interner,
 
 enum xkb_action_controls
 translate_controls_mask(uint32_t wire);
+
+/*
+ * Create the keymaps of several devices, as xkb_x11_keymap_new_from_device()
+ * would, but send the requests of all the devices up front and resolve the
+ * atoms of all the keymaps together, so that the number of round trips does
+ * not depend on the number of devices. A failure for a device does not affect
+ * the other ones: its keymap is set to NULL.
+ *
+ * Returns the number of keymaps successfully created.
+ *
+ * Not part of the public API yet: it has not been exercised against a real
+ * X server.
+ */
+XKB_EXPORT_PRIVATE size_t
+xkb_x11_keymap_new_from_devices(struct xkb_context *ctx,
+                                xcb_connection_t *conn,
+                                size_t count, const int32_t *device_ids,
+                                enum xkb_keymap_compile_flags flags,
+                                struct xkb_keymap **keymaps);
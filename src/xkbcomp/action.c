@@ -398,17 +398,20 @@ CheckGroupField(const struct xkb_keymap_info *keymap_info,
 
     if (pending) {
         flags |= ACTION_PENDING_COMPUTATION;
+        /* The expression is evaluated after the AST is released */
+        ExprDef * const expr = ExprDup(keymap_info->arena, *value_ptr);
+        if (!expr)
+            return PARSER_FATAL_ERROR;
         const darray_size_t pending_index =
             darray_size(*keymap_info->pending_computations);
         darray_append(
             *keymap_info->pending_computations,
             (struct pending_computation) {
-                .expr = *value_ptr,
+                .expr = expr,
                 .computed = false,
                 .value = 0,
             }
         );
-        *value_ptr = NULL;
         static_assert(sizeof(pending_index) == sizeof(*group_rtrn),
                       "Cannot save pending computation");
         *group_rtrn = (int32_t) pending_index;
@@ -27,9 +27,9 @@
 #include "utf8-decoding.h"
 
 static ExprDef *
-ExprCreate(enum stmt_type op)
+ExprCreate(struct arena *arena, enum stmt_type op)
 {
-    ExprDef *expr = malloc(sizeof(*expr));
+    ExprDef *expr = arena_alloc(arena, sizeof(*expr));
     if (!expr)
         return NULL;
 
@@ -40,9 +40,9 @@ ExprCreate(enum stmt_type op)
 }
 
 ExprDef *
-ExprCreateString(xkb_atom_t str)
+ExprCreateString(struct arena *arena, xkb_atom_t str)
 {
-    ExprDef *expr = ExprCreate(STMT_EXPR_STRING_LITERAL);
+    ExprDef *expr = ExprCreate(arena, STMT_EXPR_STRING_LITERAL);
     if (!expr)
         return NULL;
     expr->string.str = str;
@@ -50,9 +50,9 @@ ExprCreateString(xkb_atom_t str)
 }
 
 ExprDef *
-ExprCreateInteger(int64_t ival)
+ExprCreateInteger(struct arena *arena, int64_t ival)
 {
-    ExprDef *expr = ExprCreate(STMT_EXPR_INTEGER_LITERAL);
+    ExprDef *expr = ExprCreate(arena, STMT_EXPR_INTEGER_LITERAL);
     if (!expr)
         return NULL;
     expr->integer.ival = ival;
@@ -60,18 +60,18 @@ ExprCreateInteger(int64_t ival)
 }
 
 ExprDef *
-ExprCreateFloat(void)
+ExprCreateFloat(struct arena *arena)
 {
-    ExprDef *expr = ExprCreate(STMT_EXPR_FLOAT_LITERAL);
+    ExprDef *expr = ExprCreate(arena, STMT_EXPR_FLOAT_LITERAL);
     if (!expr)
         return NULL;
     return expr;
 }
 
 ExprDef *
-ExprCreateBoolean(bool set)
+ExprCreateBoolean(struct arena *arena, bool set)
 {
-    ExprDef *expr = ExprCreate(STMT_EXPR_BOOLEAN_LITERAL);
+    ExprDef *expr = ExprCreate(arena, STMT_EXPR_BOOLEAN_LITERAL);
     if (!expr)
         return NULL;
     expr->boolean.set = set;
@@ -79,9 +79,9 @@ ExprCreateBoolean(bool set)
 }
 
 ExprDef *
-ExprCreateKeyName(xkb_atom_t key_name)
+ExprCreateKeyName(struct arena *arena, xkb_atom_t key_name)
 {
-    ExprDef *expr = ExprCreate(STMT_EXPR_KEYNAME_LITERAL);
+    ExprDef *expr = ExprCreate(arena, STMT_EXPR_KEYNAME_LITERAL);
     if (!expr)
         return NULL;
     expr->key_name.key_name = key_name;
@@ -89,9 +89,9 @@ ExprCreateKeyName(xkb_atom_t key_name)
 }
 
 ExprDef *
-ExprCreateKeySym(xkb_keysym_t keysym)
+ExprCreateKeySym(struct arena *arena, xkb_keysym_t keysym)
 {
-    ExprDef *expr = ExprCreate(STMT_EXPR_KEYSYM_LITERAL);
+    ExprDef *expr = ExprCreate(arena, STMT_EXPR_KEYSYM_LITERAL);
     if (!expr)
         return NULL;
     expr->keysym.keysym = keysym;
@@ -99,9 +99,9 @@ ExprCreateKeySym(xkb_keysym_t keysym)
 }
 
 ExprDef *
-ExprCreateIdent(xkb_atom_t ident)
+ExprCreateIdent(struct arena *arena, xkb_atom_t ident)
 {
-    ExprDef *expr = ExprCreate(STMT_EXPR_IDENT);
+    ExprDef *expr = ExprCreate(arena, STMT_EXPR_IDENT);
     if (!expr)
         return NULL;
     expr->ident.ident = ident;
@@ -109,9 +109,9 @@ ExprCreateIdent(xkb_atom_t ident)
 }
 
 ExprDef *
-ExprCreateUnary(enum stmt_type op, ExprDef *child)
+ExprCreateUnary(struct arena *arena, enum stmt_type op, ExprDef *child)
 {
-    ExprDef *expr = ExprCreate(op);
+    ExprDef *expr = ExprCreate(arena, op);
     if (!expr)
         return NULL;
     expr->unary.child = child;
@@ -119,9 +119,10 @@ ExprCreateUnary(enum stmt_type op, ExprDef *child)
 }
 
 ExprDef *
-ExprCreateBinary(enum stmt_type op, ExprDef *left, ExprDef *right)
+ExprCreateBinary(struct arena *arena, enum stmt_type op,
+                 ExprDef *left, ExprDef *right)
 {
-    ExprDef *expr = ExprCreate(op);
+    ExprDef *expr = ExprCreate(arena, op);
     if (!expr)
         return NULL;
 
@@ -132,9 +133,9 @@ ExprCreateBinary(enum stmt_type op, ExprDef *left, ExprDef *right)
 }
 
 ExprDef *
-ExprCreateFieldRef(xkb_atom_t element, xkb_atom_t field)
+ExprCreateFieldRef(struct arena *arena, xkb_atom_t element, xkb_atom_t field)
 {
-    ExprDef *expr = ExprCreate(STMT_EXPR_FIELD_REF);
+    ExprDef *expr = ExprCreate(arena, STMT_EXPR_FIELD_REF);
     if (!expr)
         return NULL;
     expr->field_ref.element = element;
@@ -143,9 +144,10 @@ ExprCreateFieldRef(xkb_atom_t element, xkb_atom_t field)
 }
 
 ExprDef *
-ExprCreateArrayRef(xkb_atom_t element, xkb_atom_t field, ExprDef *entry)
+ExprCreateArrayRef(struct arena *arena, xkb_atom_t element, xkb_atom_t field,
+                   ExprDef *entry)
 {
-    ExprDef *expr = ExprCreate(STMT_EXPR_ARRAY_REF);
+    ExprDef *expr = ExprCreate(arena, STMT_EXPR_ARRAY_REF);
     if (!expr)
         return NULL;
     expr->array_ref.element = element;
@@ -155,15 +157,15 @@ ExprCreateArrayRef(xkb_atom_t element, xkb_atom_t field, ExprDef *entry)
 }
 
 ExprDef *
-ExprEmptyList(void)
+ExprEmptyList(struct arena *arena)
 {
-    return ExprCreate(STMT_EXPR_EMPTY_LIST);
+    return ExprCreate(arena, STMT_EXPR_EMPTY_LIST);
 }
 
 ExprDef *
-ExprCreateAction(xkb_atom_t name, ExprDef *args)
+ExprCreateAction(struct arena *arena, xkb_atom_t name, ExprDef *args)
 {
-    ExprDef *expr = ExprCreate(STMT_EXPR_ACTION_DECL);
+    ExprDef *expr = ExprCreate(arena, STMT_EXPR_ACTION_DECL);
     if (!expr)
         return NULL;
     expr->action.name = name;
@@ -172,43 +174,66 @@ ExprCreateAction(xkb_atom_t name, ExprDef *args)
 }
 
 ExprDef *
-ExprCreateActionList(ExprDef *actions)
+ExprCreateActionList(struct arena *arena, ExprDef *actions)
 {
-    ExprDef *expr = ExprCreate(STMT_EXPR_ACTION_LIST);
+    ExprDef *expr = ExprCreate(arena, STMT_EXPR_ACTION_LIST);
     if (!expr)
         return NULL;
     expr->actions.actions = actions;
     return expr;
 }
 
+/*
+ * Keysym lists are allocated in the arena, so they are grown in place as long
+ * as no other node is allocated in between, which is the common case.
+ */
+static bool
+KeySymListAppend(struct arena *arena, ExprKeysymList *list, xkb_keysym_t sym)
+{
+    if (list->syms.size >= list->syms.alloc) {
+        const darray_size_t alloc =
+            (list->syms.alloc ? 2 * list->syms.alloc : 4);
+        xkb_keysym_t * const syms =
+            arena_realloc(arena, list->syms.item,
+                          list->syms.alloc * sizeof(*syms),
+                          alloc * sizeof(*syms));
+        if (!syms)
+            return false;
+        list->syms.item = syms;
+        list->syms.alloc = alloc;
+    }
+    list->syms.item[list->syms.size++] = sym;
+    return true;
+}
+
 ExprDef *
-ExprCreateKeySymList(xkb_keysym_t sym)
+ExprCreateKeySymList(struct arena *arena, xkb_keysym_t sym)
 {
-    ExprDef *expr = ExprCreate(STMT_EXPR_KEYSYM_LIST);
+    ExprDef *expr = ExprCreate(arena, STMT_EXPR_KEYSYM_LIST);
     if (!expr)
         return NULL;
     darray_init(expr->keysym_list.syms);
     if (sym == XKB_KEY_NoSymbol) {
         /* Discard NoSymbol */
-    } else {
-        darray_append(expr->keysym_list.syms, sym);
+    } else if (!KeySymListAppend(arena, &expr->keysym_list, sym)) {
+        return NULL;
     }
     return expr;
 }
 
 ExprDef *
-ExprAppendKeySymList(ExprDef *expr, xkb_keysym_t sym)
+ExprAppendKeySymList(struct arena *arena, ExprDef *expr, xkb_keysym_t sym)
 {
     if (sym == XKB_KEY_NoSymbol) {
         /* Discard NoSymbol */
-    } else {
-        darray_append(expr->keysym_list.syms, sym);
+    } else if (!KeySymListAppend(arena, &expr->keysym_list, sym)) {
+        return NULL;
     }
     return expr;
 }
 
 ExprDef *
-ExprKeySymListAppendString(struct scanner *scanner,
+ExprKeySymListAppendString(struct arena *arena, struct scanner *scanner,
                            ExprDef *expr, const char *string)
 {
     /* TODO: use strnlen with max len = 4 * MAX_KEYSYMS_LIST_LENGTH */
@@ -224,7 +249,7 @@ ExprKeySymListAppendString(struct scanner *scanner,
                         "Invalid UTF-8 encoding starting at byte position %zu "
                         "(code point position: %zu).",
                         idx + 1, idx_cp);
-            goto error;
+            return NULL;
         }
         const xkb_keysym_t sym = xkb_utf32_to_keysym(cp);
         if (sym == XKB_KEY_NoSymbol) {
@@ -233,17 +258,15 @@ ExprKeySymListAppendString(struct scanner *scanner,
                         "U+04%"PRIX32" has no keysym equivalent"
                         "(byte position: %zu, code point position: %zu).",
                         cp, idx + 1, idx_cp);
-            goto error;
+            return NULL;
         }
-        darray_append(expr->keysym_list.syms, sym);
+        if (!KeySymListAppend(arena, &expr->keysym_list, sym))
+            return NULL;
         idx += count;
         idx_cp++;
     }
     assert(string[idx] == '\0');
     return expr;
-error:
-    FreeStmt((ParseCommon*) expr);
-    return NULL;
 }
 
 xkb_keysym_t
@@ -280,9 +303,9 @@ KeysymParseString(struct scanner *scanner, const char *string)
 }
 
 KeycodeDef *
-KeycodeCreate(xkb_atom_t name, int64_t value)
+KeycodeCreate(struct arena *arena, xkb_atom_t name, int64_t value)
 {
-    KeycodeDef *def = malloc(sizeof(*def));
+    KeycodeDef *def = arena_alloc(arena, sizeof(*def));
     if (!def)
         return NULL;
 
@@ -295,9 +318,9 @@ KeycodeCreate(xkb_atom_t name, int64_t value)
 }
 
 KeyAliasDef *
-KeyAliasCreate(xkb_atom_t alias, xkb_atom_t real)
+KeyAliasCreate(struct arena *arena, xkb_atom_t alias, xkb_atom_t real)
 {
-    KeyAliasDef *def = malloc(sizeof(*def));
+    KeyAliasDef *def = arena_alloc(arena, sizeof(*def));
     if (!def)
         return NULL;
 
@@ -310,9 +333,9 @@ KeyAliasCreate(xkb_atom_t alias, xkb_atom_t real)
 }
 
 VModDef *
-VModCreate(xkb_atom_t name, ExprDef *value)
+VModCreate(struct arena *arena, xkb_atom_t name, ExprDef *value)
 {
-    VModDef *def = malloc(sizeof(*def));
+    VModDef *def = arena_alloc(arena, sizeof(*def));
     if (!def)
         return NULL;
 
@@ -325,9 +348,9 @@ VModCreate(xkb_atom_t name, ExprDef *value)
 }
 
 VarDef *
-VarCreate(ExprDef *name, ExprDef *value)
+VarCreate(struct arena *arena, ExprDef *name, ExprDef *value)
 {
-    VarDef *def = malloc(sizeof(*def));
+    VarDef *def = arena_alloc(arena, sizeof(*def));
     if (!def)
         return NULL;
 
@@ -340,29 +363,20 @@ VarCreate(ExprDef *name, ExprDef *value)
 }
 
 VarDef *
-BoolVarCreate(xkb_atom_t ident, bool set)
+BoolVarCreate(struct arena *arena, xkb_atom_t ident, bool set)
 {
     ExprDef *name, *value;
-    VarDef *def;
-    if (!(name = ExprCreateIdent(ident))) {
-        return NULL;
-    }
-    if (!(value = ExprCreateBoolean(set))) {
-        FreeStmt((ParseCommon *) name);
+    if (!(name = ExprCreateIdent(arena, ident)) ||
+        !(value = ExprCreateBoolean(arena, set))) {
         return NULL;
     }
-    if (!(def = VarCreate(name, value))) {
-        FreeStmt((ParseCommon *) name);
-        FreeStmt((ParseCommon *) value);
-        return NULL;
-    }
-    return def;
+    return VarCreate(arena, name, value);
 }
 
 InterpDef *
-InterpCreate(xkb_keysym_t sym, ExprDef *match)
+InterpCreate(struct arena *arena, xkb_keysym_t sym, ExprDef *match)
 {
-    InterpDef *def = malloc(sizeof(*def));
+    InterpDef *def = arena_alloc(arena, sizeof(*def));
     if (!def)
         return NULL;
 
@@ -376,9 +390,9 @@ InterpCreate(xkb_keysym_t sym, ExprDef *match)
 }
 
 KeyTypeDef *
-KeyTypeCreate(xkb_atom_t name, VarDef *body)
+KeyTypeCreate(struct arena *arena, xkb_atom_t name, VarDef *body)
 {
-    KeyTypeDef *def = malloc(sizeof(*def));
+    KeyTypeDef *def = arena_alloc(arena, sizeof(*def));
     if (!def)
         return NULL;
 
@@ -392,9 +406,9 @@ KeyTypeCreate(xkb_atom_t name, VarDef *body)
 }
 
 SymbolsDef *
-SymbolsCreate(xkb_atom_t keyName, VarDef *symbols)
+SymbolsCreate(struct arena *arena, xkb_atom_t keyName, VarDef *symbols)
 {
-    SymbolsDef *def = malloc(sizeof(*def));
+    SymbolsDef *def = arena_alloc(arena, sizeof(*def));
     if (!def)
         return NULL;
 
@@ -408,9 +422,9 @@ SymbolsCreate(xkb_atom_t keyName, VarDef *symbols)
 }
 
 GroupCompatDef *
-GroupCompatCreate(int64_t group, ExprDef *val)
+GroupCompatCreate(struct arena *arena, int64_t group, ExprDef *val)
 {
-    GroupCompatDef *def = malloc(sizeof(*def));
+    GroupCompatDef *def = arena_alloc(arena, sizeof(*def));
     if (!def)
         return NULL;
 
@@ -424,9 +438,9 @@ GroupCompatCreate(int64_t group, ExprDef *val)
 }
 
 ModMapDef *
-ModMapCreate(xkb_atom_t modifier, ExprDef *keys)
+ModMapCreate(struct arena *arena, xkb_atom_t modifier, ExprDef *keys)
 {
-    ModMapDef *def = malloc(sizeof(*def));
+    ModMapDef *def = arena_alloc(arena, sizeof(*def));
     if (!def)
         return NULL;
 
@@ -440,9 +454,9 @@ ModMapCreate(xkb_atom_t modifier, ExprDef *keys)
 }
 
 LedMapDef *
-LedMapCreate(xkb_atom_t name, VarDef *body)
+LedMapCreate(struct arena *arena, xkb_atom_t name, VarDef *body)
 {
-    LedMapDef *def = malloc(sizeof(*def));
+    LedMapDef *def = arena_alloc(arena, sizeof(*def));
     if (!def)
         return NULL;
 
@@ -456,9 +470,9 @@ LedMapCreate(xkb_atom_t name, VarDef *body)
 }
 
 LedNameDef *
-LedNameCreate(int64_t ndx, ExprDef *name, bool virtual)
+LedNameCreate(struct arena *arena, int64_t ndx, ExprDef *name, bool virtual)
 {
-    LedNameDef *def = malloc(sizeof(*def));
+    LedNameDef *def = arena_alloc(arena, sizeof(*def));
     if (!def)
         return NULL;
 
@@ -473,36 +487,36 @@ LedNameCreate(int64_t ndx, ExprDef *name, bool virtual)
 }
 
 UnknownStatement *
-UnknownStatementCreate(enum stmt_type type, struct sval name)
+UnknownStatementCreate(struct arena *arena, enum stmt_type type,
+                       struct sval name)
 {
-    UnknownStatement *def = malloc(sizeof(*def));
+    UnknownStatement *def = arena_alloc(arena, sizeof(*def));
     if (!def)
         return NULL;
 
     def->common.type = type;
     def->common.next = NULL;
-    def->name = strndup(name.start, name.len);
-    if (!def->name) {
-        free(def);
+    def->name = arena_strndup(arena, name.start, name.len);
+    if (!def->name)
         return NULL;
-    }
 
     return def;
 }
 
-static void
-FreeInclude(IncludeStmt *incl);
-
 IncludeStmt *
-IncludeCreate(struct xkb_context *ctx, char *str, enum merge_mode merge)
+IncludeCreate(struct xkb_context *ctx, struct arena *arena, const char *str,
+              enum merge_mode merge)
 {
     IncludeStmt *incl, *first;
     char *stmt, *tmp;
     char nextop;
 
     incl = first = NULL;
-    tmp = str;
-    stmt = strdup_safe(str);
+    stmt = arena_strdup(arena, str);
+    /* Working copy, split in place */
+    tmp = arena_strdup(arena, str);
+    if (!stmt || !tmp)
+        return NULL;
     while (tmp && *tmp)
     {
         char *file = NULL, *map = NULL, *extra_data = NULL;
@@ -516,26 +530,17 @@ IncludeCreate(struct xkb_context *ctx, char *str, enum merge_mode merge)
          * We should just skip the ':2' in this case and leave it to the
          * appropriate section to deal with the empty group.
          */
-        if (isempty(file)) {
-            free(file);
-            free(map);
-            free(extra_data);
+        if (isempty(file))
             continue;
-        }
 
-        if (first == NULL) {
-            first = incl = malloc(sizeof(*first));
-        } else {
-            incl->next_incl = malloc(sizeof(*first));
-            incl = incl->next_incl;
-        }
-
-        if (!incl) {
-            free(file);
-            free(map);
-            free(extra_data);
+        IncludeStmt * const next = arena_alloc(arena, sizeof(*next));
+        if (!next)
             break;
-        }
+        if (first == NULL)
+            first = next;
+        else
+            incl->next_incl = next;
+        incl = next;
 
         incl->common.type = STMT_INCLUDE;
         incl->common.next = NULL;
@@ -560,32 +565,35 @@ IncludeCreate(struct xkb_context *ctx, char *str, enum merge_mode merge)
 
     if (first)
         first->stmt = stmt;
-    else
-        free(stmt);
 
     return first;
 
 err:
     log_err(ctx, XKB_ERROR_INVALID_INCLUDE_STATEMENT,
             "Illegal include statement \"%s\"; Ignored\n", stmt);
-    FreeInclude(first);
-    free(stmt);
     return NULL;
 }
 
 XkbFile *
-XkbFileCreate(enum xkb_file_type type, char *name, ParseCommon *defs,
-              enum xkb_map_flags flags)
+XkbFileCreate(struct arena *arena, enum xkb_file_type type, char *name,
+              ParseCommon *defs, enum xkb_map_flags flags)
 {
     XkbFile *file;
 
-    file = calloc(1, sizeof(*file));
-    if (!file)
+    file = arena_calloc(arena, 1, sizeof(*file));
+    if (!file) {
+        free(name);
         return NULL;
+    }
 
-    XkbEscapeMapName(name);
+    if (name) {
+        XkbEscapeMapName(name);
+        file->name = arena_strdup(arena, name);
+        free(name);
+        if (!file->name)
+            return NULL;
+    }
     file->file_type = type;
-    file->name = name;
     file->defs = defs;
     file->flags = flags;
 
@@ -596,7 +604,7 @@ XkbFile *
 XkbFileFromComponents(struct xkb_context *ctx,
                       const struct xkb_component_names *kkctgs)
 {
-    char *const components[] = {
+    const char *const components[] = {
         kkctgs->keycodes, kkctgs->types,
         kkctgs->compatibility, kkctgs->symbols,
     };
@@ -604,17 +612,16 @@ XkbFileFromComponents(struct xkb_context *ctx,
     IncludeStmt *include = NULL;
     XkbFile *file = NULL;
     ParseCommon *defs = NULL, *defsLast = NULL;
+    struct arena arena = ARENA_INIT;
 
     for (type = FIRST_KEYMAP_FILE_TYPE; type <= LAST_KEYMAP_FILE_TYPE; type++) {
-        include = IncludeCreate(ctx, components[type], MERGE_DEFAULT);
+        include = IncludeCreate(ctx, &arena, components[type], MERGE_DEFAULT);
         if (!include)
             goto err;
 
-        file = XkbFileCreate(type, NULL, (ParseCommon *) include, 0);
-        if (!file) {
-            FreeInclude(include);
+        file = XkbFileCreate(&arena, type, NULL, (ParseCommon *) include, 0);
+        if (!file)
             goto err;
-        }
 
         if (!defs)
             defsLast = defs = &file->common;
@@ -622,159 +629,25 @@ XkbFileFromComponents(struct xkb_context *ctx,
             defsLast = defsLast->next = &file->common;
     }
 
-    file = XkbFileCreate(FILE_TYPE_KEYMAP, NULL, defs, 0);
+    file = XkbFileCreate(&arena, FILE_TYPE_KEYMAP, NULL, defs, 0);
     if (!file)
         goto err;
 
+    file->arena = arena;
     return file;
 
 err:
-    FreeXkbFile((XkbFile *) defs);
+    arena_release(&arena);
     return NULL;
 }
 
-static void
-FreeInclude(IncludeStmt *incl)
-{
-    IncludeStmt *next;
-
-    while (incl)
-    {
-        next = incl->next_incl;
-
-        free(incl->file);
-        free(incl->map);
-        free(incl->modifier);
-        free(incl->stmt);
-
-        free(incl);
-        incl = next;
-    }
-}
-
-void
-FreeStmt(ParseCommon *stmt)
-{
-    ParseCommon *next;
-
-    while (stmt)
-    {
-        next = stmt->next;
-
-        switch (stmt->type) {
-        case STMT_INCLUDE:
-            FreeInclude((IncludeStmt *) stmt);
-            /* stmt is already free'd here. */
-            stmt = NULL;
-            break;
-
-        case STMT_EXPR_NEGATE:
-        case STMT_EXPR_UNARY_PLUS:
-        case STMT_EXPR_NOT:
-        case STMT_EXPR_INVERT:
-            FreeStmt((ParseCommon *) ((ExprUnary *) stmt)->child);
-            break;
-
-        case STMT_EXPR_DIVIDE:
-        case STMT_EXPR_ADD:
-        case STMT_EXPR_SUBTRACT:
-        case STMT_EXPR_MULTIPLY:
-        case STMT_EXPR_ASSIGN:
-            FreeStmt((ParseCommon *) ((ExprBinary *) stmt)->left);
-            FreeStmt((ParseCommon *) ((ExprBinary *) stmt)->right);
-            break;
-
-        case STMT_EXPR_ACTION_DECL:
-            FreeStmt((ParseCommon *) ((ExprAction *) stmt)->args);
-            break;
-
-        case STMT_EXPR_ACTION_LIST:
-            FreeStmt((ParseCommon *) ((ExprActionList *) stmt)->actions);
-            break;
-
-        case STMT_EXPR_ARRAY_REF:
-            FreeStmt((ParseCommon *) ((ExprArrayRef *) stmt)->entry);
-            break;
-
-        case STMT_EXPR_KEYSYM_LIST:
-            darray_free(((ExprKeysymList *) stmt)->syms);
-            break;
-
-        case STMT_VAR:
-            FreeStmt((ParseCommon *) ((VarDef *) stmt)->name);
-            FreeStmt((ParseCommon *) ((VarDef *) stmt)->value);
-            break;
-        case STMT_TYPE:
-            FreeStmt((ParseCommon *) ((KeyTypeDef *) stmt)->body);
-            break;
-        case STMT_INTERP:
-            FreeStmt((ParseCommon *) ((InterpDef *) stmt)->match);
-            FreeStmt((ParseCommon *) ((InterpDef *) stmt)->def);
-            break;
-        case STMT_VMOD:
-            FreeStmt((ParseCommon *) ((VModDef *) stmt)->value);
-            break;
-        case STMT_SYMBOLS:
-            FreeStmt((ParseCommon *) ((SymbolsDef *) stmt)->symbols);
-            break;
-        case STMT_MODMAP:
-            FreeStmt((ParseCommon *) ((ModMapDef *) stmt)->keys);
-            break;
-        case STMT_GROUP_COMPAT:
-            FreeStmt((ParseCommon *) ((GroupCompatDef *) stmt)->def);
-            break;
-        case STMT_LED_MAP:
-            FreeStmt((ParseCommon *) ((LedMapDef *) stmt)->body);
-            break;
-        case STMT_LED_NAME:
-            FreeStmt((ParseCommon *) ((LedNameDef *) stmt)->name);
-            break;
-        case STMT_UNKNOWN_DECLARATION:
-        case STMT_UNKNOWN_COMPOUND:
-            free(((UnknownStatement *) stmt)->name);
-            break;
-        default:
-            {} /* Label followed by declaration requires C23 */
-            static_assert(_STMT_NUM_VALUES == 37 &&
-                          _STMT_NUM_VALUES == STMT_UNKNOWN_COMPOUND + 1,
-                          "Missing statement type");
-            break;
-        }
-
-        free(stmt);
-        stmt = next;
-    }
-}
-
 void
 FreeXkbFile(XkbFile *file)
 {
-    XkbFile *next;
-
-    while (file)
-    {
-        next = (XkbFile *) file->common.next;
-
-        switch (file->file_type) {
-        case FILE_TYPE_KEYMAP:
-            FreeXkbFile((XkbFile *) file->defs);
-            break;
-
-        case FILE_TYPE_TYPES:
-        case FILE_TYPE_COMPAT:
-        case FILE_TYPE_SYMBOLS:
-        case FILE_TYPE_KEYCODES:
-        case FILE_TYPE_GEOMETRY:
-            FreeStmt(file->defs);
-            break;
-
-        default:
-            break;
-        }
-
-        free(file->name);
-        free(file);
-        file = next;
+    /* The whole tree is allocated in the arena of the root file */
+    if (file) {
+        struct arena arena = file->arena;
+        arena_release(&arena);
     }
 }
 
@@ -871,3 +744,267 @@ stmt_type_to_operator_char(enum stmt_type type)
         return '\0';
     }
 }
+
+static IncludeStmt *
+DupInclude(struct arena *arena, const IncludeStmt *incl)
+{
+    IncludeStmt *first = NULL;
+    IncludeStmt **last = &first;
+
+    for (; incl; incl = incl->next_incl) {
+        IncludeStmt *copy = arena_alloc(arena, sizeof(*copy));
+        if (!copy)
+            return NULL;
+
+        *copy = *incl;
+        copy->common.next = NULL;
+        copy->next_incl = NULL;
+        copy->stmt = copy->file = copy->map = copy->modifier = NULL;
+        *last = copy;
+        last = &copy->next_incl;
+
+        if ((incl->stmt && !(copy->stmt = arena_strdup(arena, incl->stmt))) ||
+            (incl->file && !(copy->file = arena_strdup(arena, incl->file))) ||
+            (incl->map && !(copy->map = arena_strdup(arena, incl->map))) ||
+            (incl->modifier &&
+             !(copy->modifier = arena_strdup(arena, incl->modifier))))
+            return NULL;
+    }
+
+    return first;
+}
+
+/** Size of the allocation of a statement; STMT_INCLUDE is handled apart */
+static size_t
+StmtSize(enum stmt_type type)
+{
+    switch (type) {
+    case STMT_EXPR_STRING_LITERAL:
+    case STMT_EXPR_INTEGER_LITERAL:
+    case STMT_EXPR_FLOAT_LITERAL:
+    case STMT_EXPR_BOOLEAN_LITERAL:
+    case STMT_EXPR_KEYNAME_LITERAL:
+    case STMT_EXPR_KEYSYM_LITERAL:
+    case STMT_EXPR_IDENT:
+    case STMT_EXPR_ACTION_DECL:
+    case STMT_EXPR_FIELD_REF:
+    case STMT_EXPR_ARRAY_REF:
+    case STMT_EXPR_EMPTY_LIST:
+    case STMT_EXPR_KEYSYM_LIST:
+    case STMT_EXPR_ACTION_LIST:
+    case STMT_EXPR_ADD:
+    case STMT_EXPR_SUBTRACT:
+    case STMT_EXPR_MULTIPLY:
+    case STMT_EXPR_DIVIDE:
+    case STMT_EXPR_ASSIGN:
+    case STMT_EXPR_NOT:
+    case STMT_EXPR_NEGATE:
+    case STMT_EXPR_INVERT:
+    case STMT_EXPR_UNARY_PLUS:
+        return sizeof(ExprDef);
+    case STMT_KEYCODE:
+        return sizeof(KeycodeDef);
+    case STMT_ALIAS:
+        return sizeof(KeyAliasDef);
+    case STMT_VAR:
+        return sizeof(VarDef);
+    case STMT_TYPE:
+        return sizeof(KeyTypeDef);
+    case STMT_INTERP:
+        return sizeof(InterpDef);
+    case STMT_VMOD:
+        return sizeof(VModDef);
+    case STMT_SYMBOLS:
+        return sizeof(SymbolsDef);
+    case STMT_MODMAP:
+        return sizeof(ModMapDef);
+    case STMT_GROUP_COMPAT:
+        return sizeof(GroupCompatDef);
+    case STMT_LED_MAP:
+        return sizeof(LedMapDef);
+    case STMT_LED_NAME:
+        return sizeof(LedNameDef);
+    case STMT_UNKNOWN_DECLARATION:
+    case STMT_UNKNOWN_COMPOUND:
+        return sizeof(UnknownStatement);
+    default:
+        return 0;
+    }
+}
+
+static ParseCommon *
+DupStmt(struct arena *arena, const ParseCommon *stmt);
+
+/* Duplicate a child statement list */
+#define DupChild(type, copy, stmt, field) \
+    (!((const type *) (stmt))->field || \
+     (((type *) (copy))->field = (void *) \
+        DupStmt(arena, (const ParseCommon *) ((const type *) (stmt))->field)))
+
+/** Duplicate a single statement, without its successors */
+static ParseCommon *
+DupSingleStmt(struct arena *arena, const ParseCommon *stmt)
+{
+    if (stmt->type == STMT_INCLUDE)
+        return (ParseCommon *) DupInclude(arena, (const IncludeStmt *) stmt);
+
+    const size_t size = StmtSize(stmt->type);
+    if (!size)
+        return NULL;
+    ParseCommon *copy = arena_alloc(arena, size);
+    if (!copy)
+        return NULL;
+    memcpy(copy, stmt, size);
+    copy->next = NULL;
+
+    bool ok = true;
+    switch (stmt->type) {
+    case STMT_EXPR_NEGATE:
+    case STMT_EXPR_UNARY_PLUS:
+    case STMT_EXPR_NOT:
+    case STMT_EXPR_INVERT:
+        ok = DupChild(ExprUnary, copy, stmt, child);
+        break;
+    case STMT_EXPR_DIVIDE:
+    case STMT_EXPR_ADD:
+    case STMT_EXPR_SUBTRACT:
+    case STMT_EXPR_MULTIPLY:
+    case STMT_EXPR_ASSIGN:
+        ok = DupChild(ExprBinary, copy, stmt, left) &&
+             DupChild(ExprBinary, copy, stmt, right);
+        break;
+    case STMT_EXPR_ACTION_DECL:
+        ok = DupChild(ExprAction, copy, stmt, args);
+        break;
+    case STMT_EXPR_ACTION_LIST:
+        ok = DupChild(ExprActionList, copy, stmt, actions);
+        break;
+    case STMT_EXPR_ARRAY_REF:
+        ok = DupChild(ExprArrayRef, copy, stmt, entry);
+        break;
+    case STMT_EXPR_KEYSYM_LIST: {
+        const ExprKeysymList * const list = (const ExprKeysymList *) stmt;
+        ExprKeysymList * const list_copy = (ExprKeysymList *) copy;
+        darray_init(list_copy->syms);
+        if (darray_size(list->syms)) {
+            const size_t syms_size =
+                darray_size(list->syms) * sizeof(*list->syms.item);
+            list_copy->syms.item = arena_alloc(arena, syms_size);
+            if (!list_copy->syms.item)
+                return NULL;
+            memcpy(list_copy->syms.item, list->syms.item, syms_size);
+            list_copy->syms.size = list_copy->syms.alloc =
+                darray_size(list->syms);
+        }
+        break;
+    }
+    case STMT_VAR:
+        ok = DupChild(VarDef, copy, stmt, name) &&
+             DupChild(VarDef, copy, stmt, value);
+        break;
+    case STMT_TYPE:
+        ok = DupChild(KeyTypeDef, copy, stmt, body);
+        break;
+    case STMT_INTERP:
+        ok = DupChild(InterpDef, copy, stmt, match) &&
+             DupChild(InterpDef, copy, stmt, def);
+        break;
+    case STMT_VMOD:
+        ok = DupChild(VModDef, copy, stmt, value);
+        break;
+    case STMT_SYMBOLS:
+        ok = DupChild(SymbolsDef, copy, stmt, symbols);
+        break;
+    case STMT_MODMAP:
+        ok = DupChild(ModMapDef, copy, stmt, keys);
+        break;
+    case STMT_GROUP_COMPAT:
+        ok = DupChild(GroupCompatDef, copy, stmt, def);
+        break;
+    case STMT_LED_MAP:
+        ok = DupChild(LedMapDef, copy, stmt, body);
+        break;
+    case STMT_LED_NAME:
+        ok = DupChild(LedNameDef, copy, stmt, name);
+        break;
+    case STMT_UNKNOWN_DECLARATION:
+    case STMT_UNKNOWN_COMPOUND:
+        ((UnknownStatement *) copy)->name =
+            arena_strdup(arena, ((const UnknownStatement *) stmt)->name);
+        ok = ((UnknownStatement *) copy)->name != NULL;
+        break;
+    default:
+        break;
+    }
+
+    return (ok ? copy : NULL);
+}
+
+#undef DupChild
+
+static ParseCommon *
+DupStmt(struct arena *arena, const ParseCommon *stmt)
+{
+    ParseCommon *first = NULL;
+    ParseCommon **last = &first;
+
+    for (; stmt; stmt = stmt->next) {
+        ParseCommon * const copy = DupSingleStmt(arena, stmt);
+        if (!copy)
+            return NULL;
+        *last = copy;
+        last = &copy->next;
+    }
+
+    return first;
+}
+
+ExprDef *
+ExprDup(struct arena *arena, const ExprDef *expr)
+{
+    return (ExprDef *) DupSingleStmt(arena, &expr->common);
+}
+
+static XkbFile *
+DupXkbFile(struct arena *arena, const XkbFile *file)
+{
+    XkbFile *first = NULL;
+    XkbFile **last = &first;
+
+    for (; file; file = (const XkbFile *) file->common.next) {
+        XkbFile * const copy = arena_calloc(arena, 1, sizeof(*copy));
+        if (!copy)
+            return NULL;
+        copy->common.type = file->common.type;
+        copy->file_type = file->file_type;
+        copy->flags = file->flags;
+        *last = copy;
+        last = (XkbFile **) &copy->common.next;
+
+        if (file->name && !(copy->name = arena_strdup(arena, file->name)))
+            return NULL;
+
+        if (file->defs) {
+            copy->defs = (file->file_type == FILE_TYPE_KEYMAP)
+                ? (ParseCommon *) DupXkbFile(arena, (const XkbFile *) file->defs)
+                : DupStmt(arena, file->defs);
+            if (!copy->defs)
+                return NULL;
+        }
+    }
+
+    return first;
+}
+
+XkbFile *
+XkbFileDup(const XkbFile *file)
+{
+    struct arena arena = ARENA_INIT;
+    XkbFile * const copy = DupXkbFile(&arena, file);
+    if (!copy) {
+        arena_release(&arena);
+        return NULL;
+    }
+    copy->arena = arena;
+    return copy;
+}
@@ -9,106 +9,112 @@
 #include "ast.h"
 #include "scanner-utils.h"
 
+/*
+ * The nodes are allocated in the given arena and have no destructor: they are
+ * released with the arena, see `FreeXkbFile()`.
+ */
+
 ExprDef *
-ExprCreateString(xkb_atom_t str);
+ExprCreateString(struct arena *arena, xkb_atom_t str);
 
 ExprDef *
-ExprCreateInteger(int64_t ival);
+ExprCreateInteger(struct arena *arena, int64_t ival);
 
 ExprDef *
-ExprCreateFloat(void);
+ExprCreateFloat(struct arena *arena);
 
 ExprDef *
-ExprCreateBoolean(bool set);
+ExprCreateBoolean(struct arena *arena, bool set);
 
 ExprDef *
-ExprCreateKeyName(xkb_atom_t key_name);
+ExprCreateKeyName(struct arena *arena, xkb_atom_t key_name);
 
 ExprDef *
-ExprCreateKeySym(xkb_keysym_t keysym);
+ExprCreateKeySym(struct arena *arena, xkb_keysym_t keysym);
 
 ExprDef *
-ExprCreateIdent(xkb_atom_t ident);
+ExprCreateIdent(struct arena *arena, xkb_atom_t ident);
 
 ExprDef *
-ExprCreateUnary(enum stmt_type op, ExprDef *child);
+ExprCreateUnary(struct arena *arena, enum stmt_type op, ExprDef *child);
 
 ExprDef *
-ExprCreateBinary(enum stmt_type op, ExprDef *left, ExprDef *right);
+ExprCreateBinary(struct arena *arena, enum stmt_type op,
+                 ExprDef *left, ExprDef *right);
 
 ExprDef *
-ExprCreateFieldRef(xkb_atom_t element, xkb_atom_t field);
+ExprCreateFieldRef(struct arena *arena, xkb_atom_t element, xkb_atom_t field);
 
 ExprDef *
-ExprCreateArrayRef(xkb_atom_t element, xkb_atom_t field, ExprDef *entry);
+ExprCreateArrayRef(struct arena *arena, xkb_atom_t element, xkb_atom_t field,
+                   ExprDef *entry);
 
 ExprDef *
-ExprEmptyList(void);
+ExprEmptyList(struct arena *arena);
 
 ExprDef *
-ExprCreateAction(xkb_atom_t name, ExprDef *args);
+ExprCreateAction(struct arena *arena, xkb_atom_t name, ExprDef *args);
 
 ExprDef *
-ExprCreateActionList(ExprDef *actions);
+ExprCreateActionList(struct arena *arena, ExprDef *actions);
 
 ExprDef *
-ExprCreateKeySymList(xkb_keysym_t sym);
+ExprCreateKeySymList(struct arena *arena, xkb_keysym_t sym);
 
 ExprDef *
-ExprAppendKeySymList(ExprDef *list, xkb_keysym_t sym);
+ExprAppendKeySymList(struct arena *arena, ExprDef *list, xkb_keysym_t sym);
 
 ExprDef *
-ExprKeySymListAppendString(struct scanner *param,
+ExprKeySymListAppendString(struct arena *arena, struct scanner *scanner,
                            ExprDef *expr, const char *string);
 
 xkb_keysym_t
 KeysymParseString(struct scanner *scanner, const char *string);
 
 KeycodeDef *
-KeycodeCreate(xkb_atom_t name, int64_t value);
+KeycodeCreate(struct arena *arena, xkb_atom_t name, int64_t value);
 
 KeyAliasDef *
-KeyAliasCreate(xkb_atom_t alias, xkb_atom_t real);
+KeyAliasCreate(struct arena *arena, xkb_atom_t alias, xkb_atom_t real);
 
 VModDef *
-VModCreate(xkb_atom_t name, ExprDef *value);
+VModCreate(struct arena *arena, xkb_atom_t name, ExprDef *value);
 
 VarDef *
-VarCreate(ExprDef *name, ExprDef *value);
+VarCreate(struct arena *arena, ExprDef *name, ExprDef *value);
 
 VarDef *
-BoolVarCreate(xkb_atom_t ident, bool set);
+BoolVarCreate(struct arena *arena, xkb_atom_t ident, bool set);
 
 InterpDef *
-InterpCreate(xkb_keysym_t sym, ExprDef *match);
+InterpCreate(struct arena *arena, xkb_keysym_t sym, ExprDef *match);
 
 KeyTypeDef *
-KeyTypeCreate(xkb_atom_t name, VarDef *body);
+KeyTypeCreate(struct arena *arena, xkb_atom_t name, VarDef *body);
 
 SymbolsDef *
-SymbolsCreate(xkb_atom_t keyName, VarDef *symbols);
+SymbolsCreate(struct arena *arena, xkb_atom_t keyName, VarDef *symbols);
 
 GroupCompatDef *
-GroupCompatCreate(int64_t group, ExprDef *def);
+GroupCompatCreate(struct arena *arena, int64_t group, ExprDef *def);
 
 ModMapDef *
-ModMapCreate(xkb_atom_t modifier, ExprDef *keys);
+ModMapCreate(struct arena *arena, xkb_atom_t modifier, ExprDef *keys);
 
 LedMapDef *
-LedMapCreate(xkb_atom_t name, VarDef *body);
+LedMapCreate(struct arena *arena, xkb_atom_t name, VarDef *body);
 
 LedNameDef *
-LedNameCreate(int64_t ndx, ExprDef *name, bool virtual);
+LedNameCreate(struct arena *arena, int64_t ndx, ExprDef *name, bool virtual);
 
 UnknownStatement *
-UnknownStatementCreate(enum stmt_type, struct sval name);
+UnknownStatementCreate(struct arena *arena, enum stmt_type type,
+                       struct sval name);
 
 IncludeStmt *
-IncludeCreate(struct xkb_context *ctx, char *str, enum merge_mode merge);
+IncludeCreate(struct xkb_context *ctx, struct arena *arena, const char *str,
+              enum merge_mode merge);
 
 XkbFile *
-XkbFileCreate(enum xkb_file_type type, char *name, ParseCommon *defs,
-              enum xkb_map_flags flags);
-
-void
-FreeStmt(ParseCommon *stmt);
+XkbFileCreate(struct arena *arena, enum xkb_file_type type, char *name,
+              ParseCommon *defs, enum xkb_map_flags flags);
@@ -15,6 +15,7 @@
 
 #include "atom.h"
 #include "darray.h"
+#include "utils-arena.h"
 
 enum xkb_file_type {
     /* Component files, by order of compilation. */
@@ -197,7 +198,7 @@ typedef struct {
 
 typedef struct {
     ParseCommon common;
-    /* List of keysym for a single level. */
+    /* List of keysym for a single level; allocated in the arena of the AST. */
     darray(xkb_keysym_t) syms;
 } ExprKeysymList;
 
@@ -320,4 +321,9 @@ typedef struct {
     ParseCommon *defs;
     enum xkb_file_type file_type;
     enum xkb_map_flags flags;
+    /**
+     * Allocator of the whole tree, including this file. Only the root file
+     * owns it; it is empty for the nested files.
+     */
+    struct arena arena;
 } XkbFile;
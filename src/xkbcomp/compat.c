@@ -160,7 +160,6 @@ InitCompatInfo(CompatInfo *info, const struct xkb_keymap_info *keymap_info,
 static void
 ClearCompatInfo(CompatInfo *info)
 {
-    free(info->name);
     darray_free(info->interps);
 }
 
@@ -464,7 +463,7 @@ HandleIncludeCompatMap(CompatInfo *info, IncludeStmt *include)
 
     InitCompatInfo(&included, info->keymap_info, info->include_depth + 1,
                    &info->mods);
-    included.name = steal(&include->stmt);
+    included.name = arena_strdup(info->keymap_info->arena, include->stmt);
 
     for (IncludeStmt *stmt = include; stmt; stmt = stmt->next_incl) {
         CompatInfo next_incl;
@@ -665,17 +664,21 @@ SetLedMapField(CompatInfo *info, LedInfo *ledi, const char *field,
         if (!ExprResolveGroupMask(info->keymap_info, value, &mask, &pending)) {
             if (pending) {
                 ledi->led.pending_groups = true;
+                /* The expression is evaluated after the AST is released */
+                ExprDef * const expr =
+                    ExprDup(info->keymap_info->arena, *value_ptr);
+                if (!expr)
+                    return false;
                 const darray_size_t pending_index =
                     darray_size(*info->keymap_info->pending_computations);
                 darray_append(
                     *info->keymap_info->pending_computations,
                     (struct pending_computation) {
-                        .expr = *value_ptr,
+                        .expr = expr,
                         .computed = false,
                         .value = 0,
                     }
                 );
-                *value_ptr = NULL;
                 static_assert(sizeof(pending_index) == sizeof(mask),
                               "Cannot save pending computation");
                 mask = pending_index;
@@ -903,8 +906,7 @@ HandleCompatMapFile(CompatInfo *info, XkbFile *file)
 {
     bool ok;
 
-    free(info->name);
-    info->name = strdup_safe(file->name);
+    info->name = arena_strdup(info->keymap_info->arena, file->name);
 
     for (ParseCommon *stmt = file->defs; stmt; stmt = stmt->next) {
         switch (stmt->type) {
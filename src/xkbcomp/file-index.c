@@ -0,0 +1,432 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "context.h"
+#include "darray.h"
+#include "messages-codes.h"
+#include "scanner-utils.h"
+#include "utils.h"
+#include "xkbcomp-priv.h"
+#include "parser-priv.h"
+#include "file-index.h"
+
+/* Maximum number of parsed sections kept in memory, per context */
+#define MAX_CACHED_SECTIONS 128
+
+struct indexed_section {
+    /* Offset of the first token of the section, i.e. its flags or type */
+    size_t offset;
+    struct scanner_loc loc;
+    /* NULL if the section has no name */
+    char *name;
+    enum xkb_file_type file_type;
+    enum xkb_map_flags flags;
+    /* Cached AST, if any; consumers get a copy, because they modify it */
+    XkbFile *ast;
+    uint64_t last_use;
+};
+
+struct indexed_file {
+    char *path;
+    struct file_stamp stamp;
+    /* Files that cannot be pre-scanned are parsed entirely */
+    bool indexable;
+    darray(struct indexed_section) sections;
+};
+
+struct xkb_file_index {
+    darray(struct indexed_file) files;
+    unsigned int num_cached_sections;
+    uint64_t clock;
+};
+
+static void
+indexed_file_clear_sections(struct xkb_file_index *index,
+                            struct indexed_file *file)
+{
+    struct indexed_section *section;
+    darray_foreach(section, file->sections) {
+        free(section->name);
+        if (section->ast) {
+            FreeXkbFile(section->ast);
+            index->num_cached_sections--;
+        }
+    }
+    darray_free(file->sections);
+}
+
+static void
+file_index_free(struct xkb_file_index *index)
+{
+    struct indexed_file *file;
+    darray_foreach(file, index->files) {
+        indexed_file_clear_sections(index, file);
+        free(file->path);
+    }
+    darray_free(index->files);
+    free(index);
+}
+
+/***====================================================================***/
+
+/* Same as in the lexer */
+static void
+skip_whitespace_and_comments(struct scanner *s)
+{
+    while (true) {
+        while (is_space(scanner_peek(s)))
+            scanner_next(s);
+        if (scanner_lit(s, u8"\u200E") || scanner_lit(s, u8"\u200F"))
+            continue;
+        if (scanner_lit(s, "//") || scanner_chr(s, '#')) {
+            scanner_skip_to_eol(s);
+            continue;
+        }
+        break;
+    }
+}
+
+/** Skip a string literal, starting after its opening quote */
+static bool
+skip_string(struct scanner *s, bool *has_escape)
+{
+    while (!scanner_eof(s) && !scanner_eol(s) && scanner_peek(s) != '\"') {
+        if (scanner_chr(s, '\\')) {
+            *has_escape = true;
+            if (scanner_eof(s) || scanner_eol(s))
+                return false;
+        }
+        scanner_next(s);
+    }
+    return scanner_chr(s, '\"');
+}
+
+/** Skip the body of a section, starting after its opening brace */
+static bool
+skip_section_body(struct scanner *s)
+{
+    unsigned int depth = 1;
+    bool has_escape;
+    while (true) {
+        skip_whitespace_and_comments(s);
+        if (scanner_eof(s))
+            return false;
+        if (scanner_chr(s, '{')) {
+            depth++;
+        } else if (scanner_chr(s, '}')) {
+            if (--depth == 0)
+                return true;
+        } else if (scanner_chr(s, '\"')) {
+            if (!skip_string(s, &has_escape))
+                return false;
+        } else if (scanner_chr(s, '<')) {
+            /* Key name literals may contain braces */
+            while (is_graph(scanner_peek(s)) && scanner_peek(s) != '>')
+                scanner_next(s);
+            if (!scanner_chr(s, '>'))
+                return false;
+        } else {
+            scanner_next(s);
+        }
+    }
+}
+
+/** Scan an identifier and return its keyword token, or -1 */
+static int
+scan_keyword(struct scanner *s)
+{
+    if (!is_alpha(scanner_peek(s)) && scanner_peek(s) != '_')
+        return -1;
+    const size_t start = s->pos;
+    while (is_alnum(scanner_peek(s)) || scanner_peek(s) == '_')
+        scanner_next(s);
+    return keyword_to_token(s->s + start, s->pos - start);
+}
+
+/**
+ * Pre-scan the top-level sections of a file.
+ *
+ * Only files made of simple (i.e. non-composite) sections are supported.
+ * Returns false on any unexpected construct; the file is then parsed as
+ * usual, so that errors are reported by the parser.
+ */
+static bool
+scan_sections(struct xkb_context *ctx, const char *string, size_t size,
+              struct indexed_file *file)
+{
+    struct scanner s;
+    scanner_init(&s, ctx, string, size, file->path, NULL);
+
+    while (true) {
+        skip_whitespace_and_comments(&s);
+        if (scanner_eof(&s))
+            return true;
+
+        struct indexed_section section = {
+            .offset = s.pos,
+            .file_type = FILE_TYPE_INVALID,
+            .flags = 0,
+        };
+        s.token_pos = s.pos;
+        section.loc = scanner_token_location(&s);
+
+        /* Flags and type */
+        while (section.file_type == FILE_TYPE_INVALID) {
+            switch (scan_keyword(&s)) {
+            case PARTIAL:           section.flags |= MAP_IS_PARTIAL; break;
+            case DEFAULT:           section.flags |= MAP_IS_DEFAULT; break;
+            case HIDDEN:            section.flags |= MAP_IS_HIDDEN; break;
+            case ALPHANUMERIC_KEYS: section.flags |= MAP_HAS_ALPHANUMERIC; break;
+            case MODIFIER_KEYS:     section.flags |= MAP_HAS_MODIFIER; break;
+            case KEYPAD_KEYS:       section.flags |= MAP_HAS_KEYPAD; break;
+            case FUNCTION_KEYS:     section.flags |= MAP_HAS_FN; break;
+            case ALTERNATE_GROUP:   section.flags |= MAP_IS_ALTGR; break;
+            case XKB_KEYCODES:  section.file_type = FILE_TYPE_KEYCODES; break;
+            case XKB_TYPES:     section.file_type = FILE_TYPE_TYPES; break;
+            case XKB_COMPATMAP: section.file_type = FILE_TYPE_COMPAT; break;
+            case XKB_SYMBOLS:   section.file_type = FILE_TYPE_SYMBOLS; break;
+            case XKB_GEOMETRY:  section.file_type = FILE_TYPE_GEOMETRY; break;
+            default:
+                /* Composite section or syntax error */
+                return false;
+            }
+            skip_whitespace_and_comments(&s);
+        }
+
+        /* Optional name */
+        if (scanner_chr(&s, '\"')) {
+            const size_t start = s.pos;
+            bool has_escape = false;
+            if (!skip_string(&s, &has_escape) || has_escape)
+                return false;
+            section.name = strndup(s.s + start, s.pos - start - 1);
+            if (!section.name)
+                return false;
+            skip_whitespace_and_comments(&s);
+        }
+
+        /* Add the section before anything else, so that it is freed */
+        darray_append(file->sections, section);
+
+        /* Body */
+        if (!scanner_chr(&s, '{') || !skip_section_body(&s))
+            return false;
+        skip_whitespace_and_comments(&s);
+        if (!scanner_chr(&s, ';'))
+            return false;
+    }
+}
+
+static struct indexed_file *
+find_indexed_file(struct xkb_file_index *index, const char *path)
+{
+    struct indexed_file *file;
+    darray_foreach(file, index->files) {
+        if (streq(file->path, path))
+            return file;
+    }
+    return NULL;
+}
+
+static inline bool
+is_up_to_date(const struct indexed_file *file, const struct stat *st)
+{
+    struct file_stamp stamp;
+    file_stamp_from_stat(&stamp, st);
+    return file_stamp_eq(&file->stamp, &stamp);
+}
+
+/** (Re)build the index of a file */
+static struct indexed_file *
+update_indexed_file(struct xkb_context *ctx, struct indexed_file *file,
+                    const char *path, const struct stat *st,
+                    const char *string, size_t size)
+{
+    struct xkb_file_index * const index = ctx->file_index;
+    if (file) {
+        indexed_file_clear_sections(index, file);
+    } else {
+        char * const path_copy = strdup(path);
+        if (!path_copy)
+            return NULL;
+        darray_append(index->files,
+                      (struct indexed_file) { .path = path_copy });
+        file = &darray_item(index->files, darray_size(index->files) - 1);
+    }
+
+    file_stamp_from_stat(&file->stamp, st);
+    file->indexable = (size == (size_t) st->st_size) &&
+                      scan_sections(ctx, string, size, file);
+    if (!file->indexable)
+        indexed_file_clear_sections(index, file);
+    return file;
+}
+
+/**
+ * Same lookup as parse(): exact name match if a map is given, else the
+ * first explicit default map, else the first map.
+ */
+static struct indexed_section *
+find_section(struct indexed_file *file, const char *map)
+{
+    struct indexed_section *section;
+    darray_foreach(section, file->sections) {
+        if (map ? streq_not_null(map, section->name)
+                : (section->flags & MAP_IS_DEFAULT))
+            return section;
+    }
+    if (!map && !darray_empty(file->sections))
+        return &darray_item(file->sections, 0);
+    return NULL;
+}
+
+/** Keep a copy of a parsed section, evicting the least recently used one */
+static void
+cache_section(struct xkb_file_index *index, struct indexed_section *section,
+              const XkbFile *xkb_file)
+{
+    if (index->num_cached_sections >= MAX_CACHED_SECTIONS) {
+        struct indexed_section *lru = NULL;
+        struct indexed_file *file;
+        darray_foreach(file, index->files) {
+            struct indexed_section *candidate;
+            darray_foreach(candidate, file->sections) {
+                if (candidate->ast &&
+                    (!lru || candidate->last_use < lru->last_use))
+                    lru = candidate;
+            }
+        }
+        if (!lru)
+            return;
+        FreeXkbFile(lru->ast);
+        lru->ast = NULL;
+        index->num_cached_sections--;
+    }
+
+    section->ast = XkbFileDup(xkb_file);
+    if (section->ast)
+        index->num_cached_sections++;
+}
+
+/** Parse the single section at the given index */
+static XkbFile *
+parse_section(struct xkb_context *ctx, const char *string, size_t size,
+              const char *file_name, const struct indexed_section *section)
+{
+    struct scanner scanner;
+    if (!XkbParseStringInit(ctx, &scanner, string, size, file_name, NULL))
+        return NULL;
+
+    scanner.pos = scanner.token_pos = scanner.cached_pos = section->offset;
+    scanner.cached_loc = section->loc;
+
+    XkbFile *xkb_file = NULL;
+    if (!XkbParseStringNext(ctx, &scanner, NULL, &xkb_file) || !xkb_file)
+        return NULL;
+    return xkb_file;
+}
+
+static bool
+matches_section(const XkbFile *xkb_file, const struct indexed_section *section)
+{
+    return xkb_file->file_type == section->file_type &&
+           xkb_file->flags == section->flags &&
+           streq_null(xkb_file->name, section->name);
+}
+
+static void
+log_default_section(struct xkb_context *ctx, const char *file_name,
+                    const char *map, const struct indexed_section *section)
+{
+    if (!map && !(section->flags & MAP_IS_DEFAULT)) {
+        log_vrb(ctx, XKB_LOG_VERBOSITY_DETAILED,
+                XKB_WARNING_MISSING_DEFAULT_SECTION,
+                "No map in include statement, but \"%s\" contains several; "
+                "Using first defined map, \"%s\"\n",
+                file_name, section->name ? section->name : "(unnamed map)");
+    }
+}
+
+XkbFile *
+XkbParseIndexedFile(struct xkb_context *ctx, FILE *file, const char *path,
+                    const char *file_name, const char *map)
+{
+    struct stat st;
+    const bool has_stat = (fstat(fileno(file), &st) == 0);
+    if (has_stat && !ctx->file_index) {
+        ctx->file_index = calloc(1, sizeof(*ctx->file_index));
+        ctx->file_index_free = file_index_free;
+    }
+    struct xkb_file_index * const index = (has_stat) ? ctx->file_index : NULL;
+
+    /* Lookup the cached AST */
+    struct indexed_file *indexed = (index)
+        ? find_indexed_file(index, path)
+        : NULL;
+    const bool up_to_date = indexed && is_up_to_date(indexed, &st);
+    struct indexed_section *section = NULL;
+    if (up_to_date && indexed->indexable) {
+        section = find_section(indexed, map);
+        if (!section)
+            return NULL;
+        if (section->ast) {
+            XkbFile * const xkb_file = XkbFileDup(section->ast);
+            if (xkb_file) {
+                section->last_use = ++index->clock;
+                log_default_section(ctx, file_name, map, section);
+                return xkb_file;
+            }
+        }
+    }
+
+    char *string;
+    size_t size;
+    if (!map_file(file, &string, &size)) {
+        log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
+                "Couldn't read XKB file %s: %s\n",
+                file_name, strerror(errno));
+        return NULL;
+    }
+
+    XkbFile *xkb_file = NULL;
+    if (index && !up_to_date)
+        indexed = update_indexed_file(ctx, indexed, path, &st, string, size);
+    if (!indexed || !indexed->indexable)
+        goto full_parse;
+
+    section = find_section(indexed, map);
+    if (!section)
+        goto out;
+
+    xkb_file = parse_section(ctx, string, size, file_name, section);
+    if (!xkb_file)
+        goto out;
+    if (!matches_section(xkb_file, section)) {
+        /* Should not happen, but be safe: use the parser result */
+        FreeXkbFile(xkb_file);
+        goto full_parse;
+    }
+
+    section->last_use = ++index->clock;
+    cache_section(index, section, xkb_file);
+    log_default_section(ctx, file_name, map, section);
+    goto out;
+
+full_parse:
+    xkb_file = XkbParseString(ctx, string, size, file_name, map);
+out:
+    unmap_file(string, size);
+    return xkb_file;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "config.h"
+
+#include <stdio.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "ast.h"
+
+/*
+ * Index of the sections of XKB files
+ *
+ * Files such as symbols/us contain dozens of sections, while an include
+ * statement requires only one of them. In order to avoid parsing the whole
+ * file until the requested section is found, each file is pre-scanned once
+ * (keywords, strings and braces only: no AST) to record the name, flags and
+ * offset of its sections. The index is stored in the context and is refreshed
+ * whenever the file modification time or size changes.
+ *
+ * Since only the requested section is parsed, a syntax error in another
+ * section is not reported, unless it unbalances the braces: the pre-scan then
+ * fails and the whole file is parsed.
+ *
+ * The index also keeps the ASTs of the most recently parsed sections, so that
+ * repeated includes, within a keymap or across successive compilations with
+ * the same context, are not parsed again. Since the compilation consumes the
+ * AST, a copy is returned on each use.
+ */
+
+struct xkb_file_index;
+
+/**
+ * Parse the section `map` of the file at `path`, or its default section if
+ * `map` is NULL, using the section index of the context.
+ *
+ * The result is owned by the caller. Falls back to a regular parse if the
+ * file cannot be indexed.
+ */
+XkbFile *
+XkbParseIndexedFile(struct xkb_context *ctx, FILE *file, const char *path,
+                    const char *file_name, const char *map);
@@ -18,6 +18,7 @@
 #include "messages-codes.h"
 #include "utils.h"
 #include "xkbcomp-priv.h"
+#include "file-index.h"
 #include "include.h"
 #include "scanner-utils.h"
 #include "utils-paths.h"
@@ -28,7 +29,8 @@
  * the separator from the next file, used to determine the merge mode.
  *
  * @param str_inout Input statement, modified in-place. Should be passed in
- * repeatedly. If str_inout is NULL, the parsing has completed.
+ * repeatedly. If str_inout is NULL, the parsing has completed. The returned
+ * strings point into the input statement.
  *
  * @param file_rtrn Set to the name of the include file to be used. Combined
  * with an enum xkb_file_type, this determines which file to look for in the
@@ -97,7 +99,7 @@ ParseIncludeMap(char **str_inout, char **file_rtrn, char **map_rtrn,
     tmp = strchr(str, ':');
     if (tmp != NULL) {
         *tmp++ = '\0';
-        *extra_data = strdup(tmp);
+        *extra_data = tmp;
     }
     else {
         *extra_data = NULL;
@@ -107,27 +109,23 @@ ParseIncludeMap(char **str_inout, char **file_rtrn, char **map_rtrn,
     tmp = strchr(str, '(');
     if (tmp == NULL) {
         /* No map. */
-        *file_rtrn = strdup(str);
+        *file_rtrn = str;
         *map_rtrn = NULL;
     }
     else if (str[0] == '(') {
         /* Map without file - invalid. */
-        free(*extra_data);
         return false;
     }
     else {
-        /* Got a map; separate the file and the map for the strdup's. */
+        /* Got a map; separate the file and the map. */
         *tmp++ = '\0';
-        *file_rtrn = strdup(str);
+        *file_rtrn = str;
         str = tmp;
         tmp = strchr(str, ')');
-        if (tmp == NULL || tmp[1] != '\0') {
-            free(*file_rtrn);
-            free(*extra_data);
+        if (tmp == NULL || tmp[1] != '\0')
             return false;
-        }
         *tmp++ = '\0';
-        *map_rtrn = strdup(str);
+        *map_rtrn = str;
     }
 
     /* Set up the next file for the next call, if any. */
@@ -342,6 +340,7 @@ FindFileInXkbPath(struct xkb_context *ctx, const char* parent_file_name,
             continue;
         }
 
+        xkb_context_track_file(ctx, buf);
         file = fopen(buf, "rb");
         if (file) {
             *offset = i;
@@ -414,6 +413,7 @@ ProcessIncludeFile(struct xkb_context *ctx, const IncludeStmt *stmt,
     if (absolute_path) {
         /* Absolute path: no need for lookup in XKB paths */
         assert(stmt_file[stmt_file_len] == '\0');
+        xkb_context_track_file(ctx, stmt_file);
         file = fopen(stmt_file, "rb");
     } else {
         /* Relative path: lookup the first XKB path */
@@ -440,7 +440,9 @@ ProcessIncludeFile(struct xkb_context *ctx, const IncludeStmt *stmt,
     }
 
     while (file) {
-        xkb_file = XkbParseFile(ctx, file, stmt->file, stmt->map);
+        xkb_file = XkbParseIndexedFile(ctx, file,
+                                       (absolute_path ? stmt_file : path),
+                                       stmt->file, stmt->map);
         fclose(file);
 
         if (xkb_file) {
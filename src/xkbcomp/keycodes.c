@@ -446,7 +446,6 @@ AddLedName(KeyNamesInfo *info, bool same_file,
 static void
 ClearKeyNamesInfo(KeyNamesInfo *info)
 {
-    free(info->name);
     keycode_store_free(&info->keycodes);
 }
 
@@ -680,7 +679,7 @@ HandleIncludeKeycodes(KeyNamesInfo *info, IncludeStmt *include, bool report)
     }
 
     InitKeyNamesInfo(&included, info->keymap_info, 0 /* unused */);
-    included.name = steal(&include->stmt);
+    included.name = arena_strdup(info->keymap_info->arena, include->stmt);
 
     for (IncludeStmt *stmt = include; stmt; stmt = stmt->next_incl) {
         KeyNamesInfo next_incl;
@@ -872,8 +871,7 @@ HandleKeycodesFile(KeyNamesInfo *info, XkbFile *file)
     const bool report_same_file = verbosity > 0;
     const bool report_include   = verbosity > 7;
 
-    free(info->name);
-    info->name = strdup_safe(file->name);
+    info->name = arena_strdup(info->keymap_info->arena, file->name);
 
     for (ParseCommon *stmt = file->defs; stmt; stmt = stmt->next) {
         switch (stmt->type) {
@@ -22,16 +22,39 @@
 #include "action.h"
 #include "darray.h"
 #include "keymap.h"
+#include "keysym.h"
 #include "messages-codes.h"
 #include "text.h"
 #include "xkbcomp-priv.h"
 
 #define BUF_CHUNK_SIZE 4096
 
+/** Span of a text memoized in `struct atom_texts.text` */
+struct atom_text_span {
+    darray_size_t start;
+    /** 0 if not computed yet: memoized texts are never empty */
+    darray_size_t len;
+};
+
+typedef darray(struct atom_text_span) atom_text_spans;
+
+/**
+ * Memoized serializations of atoms, indexed by atom. Key names and string
+ * literals are written many times per keymap, so they are formatted and
+ * escaped only once per dump.
+ */
+struct atom_texts {
+    atom_text_spans key_names;
+    atom_text_spans literals;
+    darray_char text;
+};
+
 struct buf {
     char *buf;
     size_t size;
     size_t alloc;
+    /** Optional: shared by the buffers of a single dump */
+    struct atom_texts *atoms;
 };
 
 #define xkb_abs(n) _Generic((n),                \
@@ -42,18 +65,36 @@ struct buf {
 static bool
 do_realloc(struct buf *buf, size_t at_least)
 {
-    buf->alloc += BUF_CHUNK_SIZE;
-    if (at_least >= BUF_CHUNK_SIZE)
-        buf->alloc += at_least;
+    /* Geometric growth, so that appends are amortized constant time */
+    size_t alloc = MAX(buf->alloc, (size_t) BUF_CHUNK_SIZE);
+    while (alloc - buf->size < at_least) {
+        if (alloc > SIZE_MAX / 2)
+            return false;
+        alloc *= 2;
+    }
 
-    char *const new = realloc(buf->buf, buf->alloc);
+    char *const new = realloc(buf->buf, alloc);
     if (!new)
         return false;
 
     buf->buf = new;
+    buf->alloc = alloc;
     return true;
 }
 
+/** Ensure there is room for `len` more bytes and the terminating NULL */
+static inline bool
+check_reserve_buf(struct buf *buf, size_t len)
+{
+    if (likely(buf->alloc - buf->size > len))
+        return true;
+    if (do_realloc(buf, len + 1))
+        return true;
+    free(buf->buf);
+    buf->buf = NULL;
+    return false;
+}
+
 ATTR_PRINTF(2, 3) static bool
 check_write_buf(struct buf *buf, const char *fmt, ...)
 {
@@ -104,21 +145,14 @@ err:
         return false; \
 } while (0)
 
-static bool
+static inline bool
 check_copy_to_buf(struct buf *buf, const char* source, size_t len)
 {
     if (len == 0)
         return true;
 
-    const size_t available = buf->alloc - buf->size;
-    if (len >= available) {
-        /* len + 1 (terminating NULL) */
-        if (!do_realloc(buf, len + 1)) {
-            free(buf->buf);
-            buf->buf = NULL;
-            return false;
-        }
-    }
+    if (!check_reserve_buf(buf, len))
+        return false;
 
     memcpy(buf->buf + buf->size, source, len);
     buf->size += len;
@@ -135,6 +169,84 @@ check_copy_to_buf(struct buf *buf, const char* source, size_t len)
 #define copy_to_buf(buf, source) \
     copy_to_buf_len(buf, source, sizeof(source) - 1)
 
+#define copy_string_to_buf(buf, string) do { \
+    const char * const _s = (string); \
+    copy_to_buf_len(buf, _s, strlen(_s)); \
+} while (0)
+
+/** Append `count` spaces */
+static bool
+check_pad_buf(struct buf *buf, size_t count)
+{
+    if (count == 0)
+        return true;
+    if (!check_reserve_buf(buf, count))
+        return false;
+    memset(buf->buf + buf->size, ' ', count);
+    buf->size += count;
+    buf->buf[buf->size] = '\0';
+    return true;
+}
+
+/**
+ * Same as `printf("%*s", width, source)` (left = false) or
+ * `printf("%-*s", width, source)` (left = true).
+ */
+static bool
+check_copy_to_buf_padded(struct buf *buf, const char *source, size_t len,
+                         size_t width, bool left)
+{
+    const size_t padding = (len < width) ? width - len : 0;
+    return check_reserve_buf(buf, len + padding) &&
+           (left || check_pad_buf(buf, padding)) &&
+           check_copy_to_buf(buf, source, len) &&
+           (!left || check_pad_buf(buf, padding));
+}
+
+#define copy_to_buf_padded(buf, source, len, width, left) do { \
+    if (!check_copy_to_buf_padded(buf, source, len, width, left)) \
+        return false; \
+} while (0)
+
+/** Same as `printf("%"PRIu32, value)` */
+static bool
+check_write_uint(struct buf *buf, uint32_t value)
+{
+    char digits[10];
+    size_t k = sizeof(digits);
+    do {
+        digits[--k] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value);
+    return check_copy_to_buf(buf, digits + k, sizeof(digits) - k);
+}
+
+#define write_buf_uint(buf, value) do { \
+    if (!check_write_uint(buf, value)) \
+        return false; \
+} while (0)
+
+/** Same as `printf("0x%"PRIx32, value)` */
+static bool
+check_write_hex(struct buf *buf, uint32_t value)
+{
+    static const char hex[] = "0123456789abcdef";
+    char digits[2 + 8];
+    size_t k = sizeof(digits);
+    do {
+        digits[--k] = hex[value & 0xf];
+        value >>= 4;
+    } while (value);
+    digits[--k] = 'x';
+    digits[--k] = '0';
+    return check_copy_to_buf(buf, digits + k, sizeof(digits) - k);
+}
+
+#define write_buf_hex(buf, value) do { \
+    if (!check_write_hex(buf, value)) \
+        return false; \
+} while (0)
+
 static bool
 check_write_string_literal(struct buf *buf, const char* string)
 {
@@ -205,6 +317,108 @@ check_write_string_literal(struct buf *buf, const char* string)
         return false; \
 } while (0)
 
+static void
+atom_texts_free(struct atom_texts *atoms)
+{
+    darray_free(atoms->key_names);
+    darray_free(atoms->literals);
+    darray_free(atoms->text);
+}
+
+/**
+ * Get the memoized text of an atom, computing it with `write` on first use.
+ * `write` appends the text to a scratch buffer, which is then moved to the
+ * memo.
+ */
+static const char *
+atom_texts_get(struct xkb_context *ctx, struct atom_texts *atoms,
+               atom_text_spans *spans, xkb_atom_t atom,
+               bool (*write)(struct buf *, const char *), size_t *len_out)
+{
+    if (atom >= darray_size(*spans))
+        darray_resize0(*spans, atom + 1);
+
+    struct atom_text_span * const span = &darray_item(*spans, atom);
+    if (!span->len) {
+        struct buf scratch = { NULL, 0, 0, NULL };
+        if (!write(&scratch, strempty(xkb_atom_text(ctx, atom))))
+            return NULL;
+        assert(scratch.size > 0);
+        span->start = darray_size(atoms->text);
+        span->len = (darray_size_t) scratch.size;
+        darray_append_items(atoms->text, scratch.buf,
+                            (darray_size_t) scratch.size);
+        free(scratch.buf);
+    }
+
+    *len_out = span->len;
+    return &darray_item(atoms->text, span->start);
+}
+
+static bool
+check_write_key_name_text(struct buf *buf, const char *name)
+{
+    return check_copy_to_buf(buf, "<", 1) &&
+           check_copy_to_buf(buf, name, strlen(name)) &&
+           check_copy_to_buf(buf, ">", 1);
+}
+
+/** Same as `printf("%-*s", width, KeyNameText(ctx, name))` */
+static bool
+check_write_key_name(struct xkb_context *ctx, struct buf *buf,
+                     xkb_atom_t name, size_t width)
+{
+    if (!buf->atoms) {
+        const char * const text = KeyNameText(ctx, name);
+        return check_copy_to_buf_padded(buf, text, strlen(text), width, true);
+    }
+    size_t len;
+    const char * const text =
+        atom_texts_get(ctx, buf->atoms, &buf->atoms->key_names, name,
+                       check_write_key_name_text, &len);
+    return text && check_copy_to_buf_padded(buf, text, len, width, true);
+}
+
+#define write_buf_key_name(ctx, buf, name, width) do { \
+    if (!check_write_key_name(ctx, buf, name, width)) \
+        return false; \
+} while (0)
+
+/** Write an atom as an escaped string literal */
+static bool
+check_write_atom_literal(struct xkb_context *ctx, struct buf *buf,
+                         xkb_atom_t atom)
+{
+    if (!buf->atoms)
+        return check_write_string_literal(buf, xkb_atom_text(ctx, atom));
+    size_t len;
+    const char * const text =
+        atom_texts_get(ctx, buf->atoms, &buf->atoms->literals, atom,
+                       check_write_string_literal, &len);
+    return text && check_copy_to_buf(buf, text, len);
+}
+
+#define write_buf_atom_literal(ctx, buf, atom) do { \
+    if (!check_write_atom_literal(ctx, buf, atom)) \
+        return false; \
+} while (0)
+
+/** Same as `printf("%*s", width, KeysymText(sym))` */
+static bool
+check_write_keysym_name(struct buf *buf, xkb_keysym_t sym, size_t width)
+{
+    char name[XKB_KEYSYM_NAME_MAX_SIZE];
+    int len = xkb_keysym_get_name(sym, name, sizeof(name));
+    if (len < 0 || (size_t) len >= sizeof(name))
+        len = snprintf(name, sizeof(name), "0x%08"PRIx32, sym);
+    return check_copy_to_buf_padded(buf, name, (size_t) len, width, false);
+}
+
+#define write_buf_keysym_name(buf, sym, width) do { \
+    if (!check_write_keysym_name(buf, sym, width)) \
+        return false; \
+} while (0)
+
 static void
 delete_last_char(struct buf *buf, char c)
 {
@@ -515,17 +729,17 @@ write_keycodes(struct xkb_keymap *keymap,
         const xkb_atom_t name = (substitutions == NULL)
             ? key->name
             : substitute_name(substitutions, key->name);
-        if (pretty)
-            write_buf(buf, "\t%-20s", KeyNameText(keymap->ctx, name));
-        else
-            write_buf(buf, "\t%s", KeyNameText(keymap->ctx, name));
-        write_buf(buf, " = %"PRIu32";\n", key->keycode);
+        copy_to_buf(buf, "\t");
+        write_buf_key_name(keymap->ctx, buf, name, (pretty ? 20 : 0));
+        copy_to_buf(buf, " = ");
+        write_buf_uint(buf, key->keycode);
+        copy_to_buf(buf, ";\n");
     }
 
     xkb_leds_enumerate(idx, led, keymap)
         if (led->name != XKB_ATOM_NONE) {
             write_buf(buf, "\tindicator %"PRIu32" = ", idx + 1);
-            write_buf_string_literal(buf, xkb_atom_text(keymap->ctx, led->name));
+            write_buf_atom_literal(keymap->ctx, buf, led->name);
             copy_to_buf(buf, ";\n");
         }
 
@@ -537,14 +751,11 @@ write_keycodes(struct xkb_keymap *keymap,
             ? keymap->key_aliases[i].real
             : substitute_name(substitutions, keymap->key_aliases[i].real);
 
-        if (pretty)
-            write_buf(buf, "\talias %-14s",
-                      KeyNameText(keymap->ctx, alias));
-        else
-            write_buf(buf, "\talias %s",
-                      KeyNameText(keymap->ctx, alias));
-        write_buf(buf, " = %s;\n",
-                  KeyNameText(keymap->ctx, real));
+        copy_to_buf(buf, "\talias ");
+        write_buf_key_name(keymap->ctx, buf, alias, (pretty ? 14 : 0));
+        copy_to_buf(buf, " = ");
+        write_buf_key_name(keymap->ctx, buf, real, 0);
+        copy_to_buf(buf, ";\n");
     }
 
     copy_to_buf(buf, "};\n\n");
@@ -575,7 +786,7 @@ write_types(struct xkb_keymap *keymap, enum xkb_keymap_format format,
             continue;
 
         copy_to_buf(buf, "\ttype ");
-        write_buf_string_literal(buf, xkb_atom_text(keymap->ctx, type->name));
+        write_buf_atom_literal(keymap->ctx, buf, type->name);
         copy_to_buf(buf, " {\n");
 
         write_buf(buf, "\t\tmodifiers= %s;\n",
@@ -607,8 +818,7 @@ write_types(struct xkb_keymap *keymap, enum xkb_keymap_format format,
         for (xkb_level_index_t n = 0; n < type->num_level_names; n++)
             if (type->level_names[n]) {
                 write_buf(buf, "\t\tlevel_name[%"PRIu32"]= ", n + 1);
-                write_buf_string_literal(
-                    buf, xkb_atom_text(keymap->ctx, type->level_names[n]));
+                write_buf_atom_literal(keymap->ctx, buf, type->level_names[n]);
                 copy_to_buf(buf, ";\n");
             }
 
@@ -624,7 +834,7 @@ write_led_map(struct xkb_keymap *keymap, enum xkb_keymap_format format,
               bool explicit, struct buf *buf, const struct xkb_led *led)
 {
     copy_to_buf(buf, "\tindicator ");
-    write_buf_string_literal(buf, xkb_atom_text(keymap->ctx, led->name));
+    write_buf_atom_literal(keymap->ctx, buf, led->name);
     copy_to_buf(buf, " {\n");
 
     if (led->which_groups) {
@@ -812,8 +1022,10 @@ write_action(struct xkb_keymap *keymap, enum xkb_keymap_format format,
         write_buf(buf, "%s%s(", prefix, type);
         const struct xkb_key * const key = XkbKey(keymap, action->redirect.keycode);
         /* Can fail if the keycode was not initialized */
-        if (key)
-            write_buf(buf, "keycode=%s", KeyNameText(keymap->ctx, key->name));
+        if (key) {
+            copy_to_buf(buf, "keycode=");
+            write_buf_key_name(keymap->ctx, buf, key->name, 0);
+        }
         if (action->redirect.affect) {
             xkb_mod_mask_t mask;
             mask = (action->redirect.affect & action->redirect.mods);
@@ -908,13 +1120,15 @@ write_actions(struct xkb_keymap *keymap, enum xkb_keymap_format format,
             if (!write_action(keymap, format, max_groups,
                               buf2, &noAction, NULL, NULL))
                 return false;
-            write_buf(buf, "%*s", ACTION_PADDING, buf2->buf);
+            copy_to_buf_padded(buf, buf2->buf, buf2->size, ACTION_PADDING,
+                               false);
         }
         else if (count == 1) {
             if (!write_action(keymap, format, max_groups,
                               buf2, &(actions[0]), NULL, NULL))
                 return false;
-            write_buf(buf, "%*s", ACTION_PADDING, buf2->buf);
+            copy_to_buf_padded(buf, buf2->buf, buf2->size, ACTION_PADDING,
+                               false);
         }
         else {
             copy_to_buf(buf2, "{ ");
@@ -929,15 +1143,17 @@ write_actions(struct xkb_keymap *keymap, enum xkb_keymap_format format,
                 if (buf2->size >= old_size + ACTION_PADDING)
                     continue;
                 /* Compute and write padding, then write the action again */
-                const int padding = (int)(old_size + ACTION_PADDING - buf2->size);
+                const size_t padding = old_size + ACTION_PADDING - buf2->size;
                 buf2->size = old_size;
-                write_buf(buf2, "%*s", padding, "");
+                if (!check_pad_buf(buf2, padding))
+                    return false;
                 if (!write_action(keymap, format, max_groups,
                                   buf2, &(actions[k]), NULL, NULL))
                     return false;
             }
             copy_to_buf(buf2, " }");
-            write_buf(buf, "%*s", ACTION_PADDING, buf2->buf);
+            copy_to_buf_padded(buf, buf2->buf, buf2->size, ACTION_PADDING,
+                               false);
         }
     }
 
@@ -1132,9 +1348,9 @@ write_compat(struct xkb_keymap * restrict keymap,
         if (!si->sym) {
             copy_to_buf(buf, "Any");
         } else if (pretty) {
-            write_buf(buf, "%s", KeysymText(keymap->ctx, si->sym));
+            write_buf_keysym_name(buf, si->sym, 0);
         } else {
-            write_buf(buf, "0x%"PRIx32, si->sym);
+            write_buf_hex(buf, si->sym);
         }
         write_buf(buf, "+%s(%s) {",
                   SIMatchText(si->match),
@@ -1260,9 +1476,9 @@ write_keysyms(struct xkb_keymap *keymap, struct buf *buf, struct buf *buf2,
 
         if (num_syms == 1) {
             if (pretty || syms[0] == XKB_KEY_NoSymbol)
-                write_buf(buf, "%*s", padding, KeysymText(keymap->ctx, syms[0]));
+                write_buf_keysym_name(buf, syms[0], padding);
             else
-                write_buf(buf, "0x%"PRIx32, syms[0]);
+                write_buf_hex(buf, syms[0]);
         } else {
             if (pretty) {
                 buf2->size = 0;
@@ -1270,11 +1486,11 @@ write_keysyms(struct xkb_keymap *keymap, struct buf *buf, struct buf *buf2,
                 for (int s = 0; s < num_syms; s++) {
                     if (s != 0)
                         copy_to_buf(buf2, ", ");
-                    write_buf(buf2, "%*s", (show_actions ? padding : 0),
-                              KeysymText(keymap->ctx, syms[s]));
+                    write_buf_keysym_name(buf2, syms[s],
+                                          (show_actions ? padding : 0));
                 }
                 copy_to_buf(buf2, " }");
-                write_buf(buf, "%*s", padding, buf2->buf);
+                copy_to_buf_padded(buf, buf2->buf, buf2->size, padding, false);
             } else {
                 copy_to_buf(buf, "{");
                 for (int s = 0; s < num_syms; s++) {
@@ -1283,7 +1499,7 @@ write_keysyms(struct xkb_keymap *keymap, struct buf *buf, struct buf *buf2,
                     if (syms[s] == XKB_KEY_NoSymbol)
                         copy_to_buf(buf, "NoSymbol");
                     else
-                        write_buf(buf, "0x%"PRIx32, syms[s]);
+                        write_buf_hex(buf, syms[s]);
                 }
                 copy_to_buf(buf, "}");
             }
@@ -1308,10 +1524,9 @@ write_key(struct xkb_keymap *keymap, enum xkb_keymap_format format,
         ? key->name
         : substitute_name(substitutions, key->name);
 
-    if (pretty)
-        write_buf(buf, "\tkey %-20s {", KeyNameText(keymap->ctx, name));
-    else
-        write_buf(buf, "\tkey %s {", KeyNameText(keymap->ctx, name));
+    copy_to_buf(buf, "\tkey ");
+    write_buf_key_name(keymap->ctx, buf, name, (pretty ? 20 : 0));
+    copy_to_buf(buf, " {");
 
     if (key->explicit & EXPLICIT_TYPES || explicit) {
         simple = false;
@@ -1330,17 +1545,17 @@ write_key(struct xkb_keymap *keymap, enum xkb_keymap_format format,
                     continue;
 
                 const struct xkb_key_type * const type = key->groups[group].type;
-                write_buf(buf, "\n\t\ttype[%"PRIu32"]= ", group + 1);
-                write_buf_string_literal(
-                  buf, xkb_atom_text(keymap->ctx, type->name));
+                copy_to_buf(buf, "\n\t\ttype[");
+                write_buf_uint(buf, group + 1);
+                copy_to_buf(buf, "]= ");
+                write_buf_atom_literal(keymap->ctx, buf, type->name);
                 copy_to_buf(buf, ",");
             }
         }
         else {
             const struct xkb_key_type * const type = key->groups[0].type;
-            write_buf(buf, "\n\t\ttype= ");
-            write_buf_string_literal(
-                buf, xkb_atom_text(keymap->ctx, type->name));
+            copy_to_buf(buf, "\n\t\ttype= ");
+            write_buf_atom_literal(keymap->ctx, buf, type->name);
             copy_to_buf(buf, ",");
         }
     }
@@ -1481,8 +1696,11 @@ write_key(struct xkb_keymap *keymap, enum xkb_keymap_format format,
             const xkb_atom_t overlay_key_name = (substitutions == NULL)
                 ? overlay_key->name
                 : substitute_name(substitutions, overlay_key->name);
-            write_buf(buf, "\n\t\toverlay%u= %s,",
-                      overlay + 1, KeyNameText(keymap->ctx, overlay_key_name));
+            copy_to_buf(buf, "\n\t\toverlay");
+            write_buf_uint(buf, overlay + 1);
+            copy_to_buf(buf, "= ");
+            write_buf_key_name(keymap->ctx, buf, overlay_key_name, 0);
+            copy_to_buf(buf, ",");
         }
     }
 
@@ -1520,14 +1738,18 @@ write_key(struct xkb_keymap *keymap, enum xkb_keymap_format format,
 
             if (group != 0)
                 copy_to_buf(buf, ",");
-            write_buf(buf, "\n\t\tsymbols[%"PRIu32"]= [ ", group + 1);
+            copy_to_buf(buf, "\n\t\tsymbols[");
+            write_buf_uint(buf, group + 1);
+            copy_to_buf(buf, "]= [ ");
 
             if (!write_keysyms(keymap, buf, buf2, key, group,
                                pretty, print_actions))
                 return false;
             copy_to_buf(buf, " ]");
             if (print_actions) {
-                write_buf(buf, ",\n\t\tactions[%"PRIu32"]= [ ", group + 1);
+                copy_to_buf(buf, ",\n\t\tactions[");
+                write_buf_uint(buf, group + 1);
+                copy_to_buf(buf, "]= [ ");
                 if (!write_actions(keymap, format, max_groups,
                                    buf, buf2, key, group))
                     return false;
@@ -1567,8 +1789,7 @@ write_symbols(struct xkb_keymap *keymap, enum xkb_keymap_format format,
     for (xkb_layout_index_t group = 0; group < num_group_names; group++)
         if (keymap->group_names[group]) {
             write_buf(buf, "\tname[%"PRIu32"]=", group + 1);
-            write_buf_string_literal(
-                buf, xkb_atom_text(keymap->ctx, keymap->group_names[group]));
+            write_buf_atom_literal(keymap->ctx, buf, keymap->group_names[group]);
             copy_to_buf(buf, ";\n");
             has_group_names = true;
         }
@@ -1578,7 +1799,7 @@ write_symbols(struct xkb_keymap *keymap, enum xkb_keymap_format format,
     if (explicit && !write_actions_defaults(keymap, format, buf))
         return false;
 
-    struct buf buf2 = { NULL, 0, 0 };
+    struct buf buf2 = { NULL, 0, 0, buf->atoms };
     const struct xkb_key *key;
     xkb_keys_foreach(key, keymap) {
         /* Skip keys with no explicit values */
@@ -1605,9 +1826,9 @@ write_symbols(struct xkb_keymap *keymap, enum xkb_keymap_format format,
                 const xkb_atom_t name = (substitutions == NULL)
                     ? key->name
                     : substitute_name(substitutions, key->name);
-                write_buf(buf, "%s%s",
-                          had_any ? ", " : "",
-                          KeyNameText(keymap->ctx, name));
+                if (had_any)
+                    copy_to_buf(buf, ", ");
+                write_buf_key_name(keymap->ctx, buf, name, 0);
                 had_any = true;
             }
         }
@@ -1654,17 +1875,52 @@ write_keymap(struct xkb_keymap *keymap, enum xkb_keymap_format format,
     return ok;
 }
 
+/**
+ * Rough upper estimate of the size of the serialization, in order to avoid
+ * most reallocations while writing.
+ */
+static size_t
+estimate_keymap_size(const struct xkb_keymap *keymap,
+                     enum xkb_keymap_serialize_flags flags)
+{
+    const bool pretty = !!(flags & XKB_KEYMAP_SERIALIZE_PRETTY);
+    /* Section headers, vmods, action defaults */
+    size_t size = 2 * BUF_CHUNK_SIZE;
+    size += (size_t) keymap->num_types * 128;
+    size += (size_t) keymap->num_sym_interprets * 96;
+    size += (size_t) keymap->num_key_aliases * 32;
+
+    const struct xkb_key *key;
+    xkb_keys_foreach(key, keymap) {
+        /* Keycode entry, key header and modifier map */
+        size += 96;
+        for (xkb_layout_index_t group = 0; group < key->num_groups; group++) {
+            /* Group header, then symbols and possibly actions per level */
+            size += 32 + (size_t) XkbKeyNumLevels(key, group) *
+                         ((pretty) ? SYMBOL_PADDING + 2 : 12);
+        }
+    }
+    return size;
+}
+
 char *
 text_v1_keymap_get_as_string(struct xkb_keymap *keymap,
                              enum xkb_keymap_format format,
                              enum xkb_keymap_serialize_flags flags)
 {
-    struct buf buf = { NULL, 0, 0 };
+    struct atom_texts atoms = {
+        .key_names = darray_new(),
+        .literals = darray_new(),
+        .text = darray_new()
+    };
+    struct buf buf = { NULL, 0, 0, &atoms };
 
-    if (!write_keymap(keymap, format, flags, &buf)) {
+    if (!do_realloc(&buf, estimate_keymap_size(keymap, flags)) ||
+        !write_keymap(keymap, format, flags, &buf)) {
         free(buf.buf);
-        return NULL;
+        buf.buf = NULL;
     }
 
+    atom_texts_free(&atoms);
     return buf.buf;
 }
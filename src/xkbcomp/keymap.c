@@ -11,6 +11,7 @@
 
 #include "config.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 
@@ -76,6 +77,174 @@ static const struct xkb_sym_interpret default_interpret = {
 };
 
 typedef darray(const struct xkb_sym_interpret*) xkb_sym_interprets;
+typedef darray(union xkb_action) xkb_interp_actions;
+
+/** Interpretation with an explicit keysym */
+struct interp_entry {
+    xkb_keysym_t sym;
+    /** Index in keymap->sym_interprets */
+    darray_size_t index;
+};
+
+/** Range of the interpretations of a keysym; free if `count` is 0 */
+struct interp_bucket {
+    xkb_keysym_t sym;
+    darray_size_t start;
+    darray_size_t count;
+};
+
+/**
+ * Index of keymap->sym_interprets by keysym, to avoid scanning all the
+ * interpretations for each keysym of each level of each key.
+ *
+ * The interpretations with an explicit keysym are sorted by keysym and then
+ * by index, and each keysym is mapped to its range by a hash table with linear
+ * probing. The interpretations matching any keysym are kept in their original
+ * order. Since both lists are sorted by index, merging them for a keysym
+ * visits its candidates in the same order as a scan of the whole array, i.e.
+ * from the most specific to the least specific (see compat.c).
+ */
+struct interp_index {
+    darray(struct interp_entry) entries;
+    darray(darray_size_t) wildcards;
+    darray(struct interp_bucket) buckets;
+    darray_size_t mask;
+    /* Scratch buffers, reused for all the keys */
+    xkb_sym_interprets interprets;
+    xkb_interp_actions actions;
+};
+
+static inline darray_size_t
+interp_bucket_slot(xkb_keysym_t sym, darray_size_t mask)
+{
+    return (darray_size_t) (sym * UINT32_C(0x9E3779B1)) & mask;
+}
+
+static int
+cmp_interp_entries(const void *a, const void *b)
+{
+    const struct interp_entry * const ea = a;
+    const struct interp_entry * const eb = b;
+    if (ea->sym != eb->sym)
+        return (ea->sym < eb->sym) ? -1 : 1;
+    return (ea->index > eb->index) - (ea->index < eb->index);
+}
+
+static void
+InitInterpIndex(const struct xkb_keymap *keymap, struct interp_index *index)
+{
+    darray_init(index->entries);
+    darray_init(index->wildcards);
+    darray_init(index->buckets);
+    darray_init(index->interprets);
+    darray_init(index->actions);
+    index->mask = 0;
+
+    darray_size_t num_syms = 0;
+    for (darray_size_t i = 0; i < keymap->num_sym_interprets; i++) {
+        const xkb_keysym_t sym = keymap->sym_interprets[i].sym;
+        if (sym == XKB_KEY_NoSymbol) {
+            darray_append(index->wildcards, i);
+        } else {
+            darray_append(index->entries,
+                          (struct interp_entry) { .sym = sym, .index = i });
+        }
+    }
+    if (darray_empty(index->entries))
+        return;
+
+    qsort(darray_items(index->entries), darray_size(index->entries),
+          sizeof(*darray_items(index->entries)), cmp_interp_entries);
+
+    for (darray_size_t i = 0; i < darray_size(index->entries); i++) {
+        if (i == 0 || darray_item(index->entries, i).sym !=
+                      darray_item(index->entries, i - 1).sym)
+            num_syms++;
+    }
+
+    /* Keep the load factor ≤ 0.5 */
+    darray_size_t size = 16;
+    while (size < 2 * num_syms)
+        size *= 2;
+    darray_resize0(index->buckets, size);
+    index->mask = size - 1;
+
+    for (darray_size_t i = 0; i < darray_size(index->entries);) {
+        const xkb_keysym_t sym = darray_item(index->entries, i).sym;
+        darray_size_t end = i + 1;
+        while (end < darray_size(index->entries) &&
+               darray_item(index->entries, end).sym == sym)
+            end++;
+        darray_size_t slot = interp_bucket_slot(sym, index->mask);
+        while (darray_item(index->buckets, slot).count)
+            slot = (slot + 1) & index->mask;
+        darray_item(index->buckets, slot) = (struct interp_bucket) {
+            .sym = sym,
+            .start = i,
+            .count = end - i,
+        };
+        i = end;
+    }
+}
+
+static void
+ClearInterpIndex(struct interp_index *index)
+{
+    darray_free(index->entries);
+    darray_free(index->wildcards);
+    darray_free(index->buckets);
+    darray_free(index->interprets);
+    darray_free(index->actions);
+}
+
+/** Iterator over the candidate interpretations of a keysym */
+struct interp_iter {
+    const struct interp_index *index;
+    const struct interp_entry *entries;
+    darray_size_t count;
+    darray_size_t e;
+    darray_size_t w;
+};
+
+static void
+interp_iter_init(struct interp_iter *iter, const struct interp_index *index,
+                 xkb_keysym_t sym)
+{
+    *iter = (struct interp_iter) { .index = index };
+    if (darray_empty(index->buckets))
+        return;
+    for (darray_size_t slot = interp_bucket_slot(sym, index->mask);;
+         slot = (slot + 1) & index->mask) {
+        const struct interp_bucket * const bucket =
+            &darray_item(index->buckets, slot);
+        if (!bucket->count)
+            return;
+        if (bucket->sym == sym) {
+            iter->entries = &darray_item(index->entries, bucket->start);
+            iter->count = bucket->count;
+            return;
+        }
+    }
+}
+
+/* Get the index of the next candidate, in keymap->sym_interprets order */
+static inline bool
+interp_iter_next(struct interp_iter *iter, darray_size_t *index)
+{
+    const darray_size_t num_wildcards = darray_size(iter->index->wildcards);
+    if (iter->e < iter->count &&
+        (iter->w >= num_wildcards ||
+         iter->entries[iter->e].index <
+         darray_item(iter->index->wildcards, iter->w))) {
+        *index = iter->entries[iter->e++].index;
+        return true;
+    }
+    if (iter->w < num_wildcards) {
+        *index = darray_item(iter->index->wildcards, iter->w++);
+        return true;
+    }
+    return false;
+}
 
 /**
  * Find an interpretation which applies to this particular level, either by
@@ -83,7 +252,8 @@ typedef darray(const struct xkb_sym_interpret*) xkb_sym_interprets;
  * generic XKB_KEY_NoSymbol match.
  */
 static bool
-FindInterpForKey(struct xkb_keymap *keymap, const struct xkb_key *key,
+FindInterpForKey(struct xkb_keymap *keymap, const struct interp_index *index,
+                 const struct xkb_key *key,
                  xkb_layout_index_t group, xkb_level_index_t level,
                  xkb_sym_interprets *interprets)
 {
@@ -99,19 +269,20 @@ FindInterpForKey(struct xkb_keymap *keymap, const struct xkb_key *key,
      * There may be multiple matchings interprets; we should always return
      * the most specific. Here we rely on compat.c to set up the
      * sym_interprets array from the most specific to the least specific,
-     * such that when we find a match we return immediately.
+     * such that when we find a match we return immediately. The index only
+     * yields the interprets matching the keysym, in the same order.
      */
     for (int s = 0; s < num_syms; s++) {
         bool found = false;
-        for (darray_size_t i = 0; i < keymap->num_sym_interprets; i++) {
+        struct interp_iter iter;
+        darray_size_t i;
+        interp_iter_init(&iter, index, syms[s]);
+        while (interp_iter_next(&iter, &i)) {
             struct xkb_sym_interpret * const interp = &keymap->sym_interprets[i];
             xkb_mod_mask_t mods;
 
             found = false;
 
-            if (interp->sym != syms[s] && interp->sym != XKB_KEY_NoSymbol)
-                continue;
-
             if (interp->level_one_only && level != 0)
                 mods = 0;
             else
@@ -174,13 +345,14 @@ not_found:
 }
 
 static bool
-ApplyInterpsToKey(struct xkb_keymap *keymap, struct xkb_key *key)
+ApplyInterpsToKey(struct xkb_keymap *keymap, struct interp_index *index,
+                  struct xkb_key *key)
 {
     xkb_mod_mask_t vmodmap = 0;
     xkb_level_index_t level;
     // FIXME: do not use darray, add actions directly in FindInterpForKey
-    xkb_sym_interprets interprets = darray_new();
-    darray(union xkb_action) actions = darray_new();
+    xkb_sym_interprets * const interprets = &index->interprets;
+    xkb_interp_actions * const actions = &index->actions;
 
     for (xkb_layout_index_t group = 0; group < key->num_groups; group++) {
         /* Skip any interpretation for this group if it has explicit actions */
@@ -193,13 +365,14 @@ ApplyInterpsToKey(struct xkb_keymap *keymap, struct xkb_key *key)
             const struct xkb_sym_interpret **interp_iter;
             const struct xkb_sym_interpret *interp;
             size_t k;
-            darray_resize(interprets, 0);
+            darray_resize(*interprets, 0);
 
-            const bool found = FindInterpForKey(keymap, key, group, level, &interprets);
+            const bool found = FindInterpForKey(keymap, index, key, group, level,
+                                                interprets);
             if (!found)
                 continue;
 
-            darray_enumerate(k, interp_iter, interprets) {
+            darray_enumerate(k, interp_iter, *interprets) {
                 interp = *interp_iter;
                 /* Infer default key behaviours from the base level. */
                 if (group == 0 && level == 0)
@@ -217,62 +390,58 @@ ApplyInterpsToKey(struct xkb_keymap *keymap, struct xkb_key *key)
                 case 0:
                     break;
                 case 1:
-                    darray_append(actions, interp->a.action);
+                    darray_append(*actions, interp->a.action);
                     break;
                 default:
-                    darray_append_items(actions, interp->a.actions,
+                    darray_append_items(*actions, interp->a.actions,
                                         interp->num_actions);
                 }
             }
 
             /* Copy the actions */
-            if (unlikely(darray_size(actions)) > MAX_ACTIONS_PER_LEVEL) {
+            if (unlikely(darray_size(*actions)) > MAX_ACTIONS_PER_LEVEL) {
                 log_warn(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
                          "Could not append interpret actions to key %s: "
                          "maximum is %u, got: %u. Dropping excessive actions\n",
                          KeyNameText(keymap->ctx, key->name),
-                         MAX_ACTIONS_PER_LEVEL, darray_size(actions));
+                         MAX_ACTIONS_PER_LEVEL, darray_size(*actions));
                 key->groups[group].levels[level].num_actions =
                     MAX_ACTIONS_PER_LEVEL;
             } else {
                 key->groups[group].levels[level].num_actions =
-                    (xkb_action_count_t) darray_size(actions);
+                    (xkb_action_count_t) darray_size(*actions);
             }
-            switch (darray_size(actions)) {
+            switch (darray_size(*actions)) {
                 case 0:
                     key->groups[group].levels[level].a.action =
                         (union xkb_action) { .type = ACTION_TYPE_NONE };
                     break;
                 case 1:
                     key->groups[group].levels[level].a.action =
-                        darray_item(actions, 0);
+                        darray_item(*actions, 0);
                     break;
                 default:
                     key->groups[group].levels[level].a.actions =
-                        memdup(darray_items(actions),
+                        memdup(darray_items(*actions),
                                key->groups[group].levels[level].num_actions,
-                               sizeof(*darray_items(actions)));
+                               sizeof(*darray_items(*actions)));
                     if (!key->groups[group].levels[level].a.actions) {
                         log_err(keymap->ctx, XKB_ERROR_ALLOCATION_ERROR,
                                 "Could not allocate interpret actions\n");
-                        darray_free(actions);
-                        darray_free(interprets);
                         return false;
                     }
             }
 
-            if (!darray_empty(actions))
+            if (!darray_empty(*actions))
                 key->groups[group].implicit_actions = true;
 
             /* Do not free here */
-            darray_resize(actions, 0);
+            darray_resize(*actions, 0);
         }
 
         if (key->groups[group].implicit_actions)
             key->implicit_actions = true;
     }
-    darray_free(actions);
-    darray_free(interprets);
 
     if (!(key->explicit & EXPLICIT_VMODMAP))
         key->vmodmap = vmodmap;
@@ -620,11 +789,16 @@ UpdateDerivedKeymapFields(struct xkb_keymap_info *info)
 
     /* Find all the interprets for the key and bind them to actions,
      * which will also update the vmodmap. */
+    struct interp_index interp_index;
+    InitInterpIndex(keymap, &interp_index);
     xkb_keys_foreach(key, keymap) {
-        if (!ApplyInterpsToKey(keymap, key))
+        if (!ApplyInterpsToKey(keymap, &interp_index, key)) {
+            ClearInterpIndex(&interp_index);
             return false;
+        }
         CheckMultipleActionsCategories(keymap, key);
     }
+    ClearInterpIndex(&interp_index);
 
     /* Update keymap->mods, the virtual -> real mod mapping. */
     xkb_mod_index_t idx;
@@ -691,6 +865,9 @@ UpdateDerivedKeymapFields(struct xkb_keymap_info *info)
             ComputeEffectiveMask(keymap, &keymap->types[i].entries[j].mods);
             ComputeEffectiveMask(keymap, &keymap->types[i].entries[j].preserve);
         }
+
+        if (!XkbKeyTypeUpdateEntriesLUT(&keymap->types[i]))
+            return false;
     }
 
     /* Update action modifiers and fields with pending computations. */
@@ -745,15 +922,6 @@ static const compile_file_fn compile_file_fns[LAST_KEYMAP_FILE_TYPE + 1] = {
     [FILE_TYPE_SYMBOLS] = CompileSymbols,
 };
 
-static void
-pending_computations_array_free(pending_computation_array *p)
-{
-    struct pending_computation *pc;
-    darray_foreach(pc, *p)
-        FreeStmt((ParseCommon*) pc->expr);
-    darray_free(*p);
-}
-
 bool
 CompileKeymap(XkbFile *file, struct xkb_keymap *keymap)
 {
@@ -793,6 +961,7 @@ CompileKeymap(XkbFile *file, struct xkb_keymap *keymap)
      * Keymap augmented with compilation-specific data
      */
     pending_computation_array pending_computations = darray_new();
+    struct arena arena = ARENA_INIT;
     struct xkb_keymap_info info = {
         /* Copy the keymap */
         .keymap = *keymap,
@@ -861,6 +1030,7 @@ CompileKeymap(XkbFile *file, struct xkb_keymap *keymap)
             },
         },
         .pending_computations = &pending_computations,
+        .arena = &arena,
     };
 
     /*
@@ -889,7 +1059,8 @@ CompileKeymap(XkbFile *file, struct xkb_keymap *keymap)
                     xkb_file_type_to_string(type));
             /* Copy back to the keymap, so that all can be properly freed */
             *keymap = info.keymap;
-            pending_computations_array_free(&pending_computations);
+            darray_free(pending_computations);
+            arena_release(&arena);
             return false;
         }
     }
@@ -897,6 +1068,9 @@ CompileKeymap(XkbFile *file, struct xkb_keymap *keymap)
     const bool ok = UpdateDerivedKeymapFields(&info);
     /* Copy back the keymap */
     *keymap = info.keymap;
-    pending_computations_array_free(&pending_computations);
+    if (ok)
+        keymap_freeze(keymap);
+    darray_free(pending_computations);
+    arena_release(&arena);
     return ok;
 }
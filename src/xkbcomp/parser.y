@@ -31,6 +31,8 @@
 struct parser_param {
     struct xkb_context *ctx;
     struct scanner *scanner;
+    /** Allocator of the AST, owned by the returned file */
+    struct arena arena;
     XkbFile *rtrn;
     bool more_maps;
 };
@@ -240,15 +242,8 @@ resolve_keysym(struct parser_param *param, struct sval name, xkb_keysym_t *sym_r
 %type <fileList> XkbMapConfigList
 %type <file>    XkbCompositeMap
 
-%destructor { FreeStmt((ParseCommon *) $$); }
-    <any> <expr> <var> <vmod> <interp> <keyType> <syms> <modMask> <groupCompat>
-    <ledMap> <ledName> <keyCode> <keyAlias>
-%destructor { FreeStmt((ParseCommon *) $$.head); }
-    <anyList> <exprList> <varList> <vmodList>
-/* The destructor also runs on the start symbol when the parser *succeeds*.
- * The `if` here catches this case. */
-%destructor { if (!param->rtrn) FreeXkbFile($$); } <file>
-%destructor { FreeXkbFile($$.head); } <fileList>
+/* The AST nodes are allocated in the arena of the parser, so they need no
+ * destructor: the arena is released at once if the parsing fails. */
 %destructor { free($$); } <str>
 
 %%
@@ -276,7 +271,7 @@ XkbFile         :       XkbCompositeMap
 XkbCompositeMap :       OptFlags XkbCompositeType OptMapName OBRACE
                             XkbMapConfigList
                         CBRACE SEMI
-                        { $$ = XkbFileCreate($2, $3, (ParseCommon *) $5.head, $1); }
+                        { $$ = XkbFileCreate(&param->arena, $2, $3, (ParseCommon *) $5.head, $1); }
                 ;
 
 XkbCompositeType:       XKB_KEYMAP      { $$ = FILE_TYPE_KEYMAP; }
@@ -306,7 +301,7 @@ XkbMapConfig    :       OptFlags FileType OptMapName OBRACE
                             DeclList
                         CBRACE SEMI
                         {
-                            $$ = XkbFileCreate($2, $3, $5.head, $1);
+                            $$ = XkbFileCreate(&param->arena, $2, $3, $5.head, $1);
                         }
                 ;
 
@@ -423,25 +418,25 @@ Decl            :       OptMergeMode VarDecl
                             { $$ = (ParseCommon *) $2; }
                 |       MergeMode STRING
                         {
-                            $$ = (ParseCommon *) IncludeCreate(param->ctx, $2, $1);
+                            $$ = (ParseCommon *) IncludeCreate(param->ctx, &param->arena, $2, $1);
                             free($2);
                         }
                 ;
 
 VarDecl         :       Lhs EQUALS Expr SEMI
-                        { $$ = VarCreate($1, $3); }
+                        { $$ = VarCreate(&param->arena, $1, $3); }
                 |       Ident SEMI
-                        { $$ = BoolVarCreate($1, true); }
+                        { $$ = BoolVarCreate(&param->arena, $1, true); }
                 |       EXCLAM Ident SEMI
-                        { $$ = BoolVarCreate($2, false); }
+                        { $$ = BoolVarCreate(&param->arena, $2, false); }
                 ;
 
 KeyNameDecl     :       KEYNAME EQUALS KeyCode SEMI
-                        { $$ = KeycodeCreate($1, $3); }
+                        { $$ = KeycodeCreate(&param->arena, $1, $3); }
                 ;
 
 KeyAliasDecl    :       ALIAS KEYNAME EQUALS KEYNAME SEMI
-                        { $$ = KeyAliasCreate($2, $4); }
+                        { $$ = KeyAliasCreate(&param->arena, $2, $4); }
                 ;
 
 VModDecl        :       VIRTUAL_MODS VModDefList SEMI
@@ -455,9 +450,9 @@ VModDefList     :       VModDefList COMMA VModDef
                 ;
 
 VModDef         :       Ident
-                        { $$ = VModCreate($1, NULL); }
+                        { $$ = VModCreate(&param->arena, $1, NULL); }
                 |       Ident EQUALS Expr
-                        { $$ = VModCreate($1, $3); }
+                        { $$ = VModCreate(&param->arena, $1, $3); }
                 ;
 
 InterpretDecl   :       INTERPRET InterpretMatch OBRACE
@@ -467,9 +462,9 @@ InterpretDecl   :       INTERPRET InterpretMatch OBRACE
                 ;
 
 InterpretMatch  :       KeySym PLUS Expr
-                        { $$ = InterpCreate($1, $3); }
+                        { $$ = InterpCreate(&param->arena, $1, $3); }
                 |       KeySym
-                        { $$ = InterpCreate($1, NULL); }
+                        { $$ = InterpCreate(&param->arena, $1, NULL); }
                 ;
 
 VarDeclList     :       VarDeclList VarDecl
@@ -490,13 +485,13 @@ VarDeclList     :       VarDeclList VarDecl
 KeyTypeDecl     :       TYPE String OBRACE
                             VarDeclList
                         CBRACE SEMI
-                        { $$ = KeyTypeCreate($2, $4.head); }
+                        { $$ = KeyTypeCreate(&param->arena, $2, $4.head); }
                 ;
 
 SymbolsDecl     :       KEY KEYNAME OBRACE
                             OptSymbolsBody
                         CBRACE SEMI
-                        { $$ = SymbolsCreate($2, $4.head); }
+                        { $$ = SymbolsCreate(&param->arena, $2, $4.head); }
                 ;
 
 OptSymbolsBody  :       SymbolsBody { $$ = $1; }
@@ -509,11 +504,11 @@ SymbolsBody     :       SymbolsBody COMMA SymbolsVarDecl
                         { $$.head = $$.last = $1; }
                 ;
 
-SymbolsVarDecl  :       Lhs EQUALS Expr         { $$ = VarCreate($1, $3); }
-                |       Lhs EQUALS MultiKeySymOrActionList { $$ = VarCreate($1, $3); }
-                |       Ident                   { $$ = BoolVarCreate($1, true); }
-                |       EXCLAM Ident            { $$ = BoolVarCreate($2, false); }
-                |       MultiKeySymOrActionList { $$ = VarCreate(NULL, $1); }
+SymbolsVarDecl  :       Lhs EQUALS Expr         { $$ = VarCreate(&param->arena, $1, $3); }
+                |       Lhs EQUALS MultiKeySymOrActionList { $$ = VarCreate(&param->arena, $1, $3); }
+                |       Ident                   { $$ = BoolVarCreate(&param->arena, $1, true); }
+                |       EXCLAM Ident            { $$ = BoolVarCreate(&param->arena, $2, false); }
+                |       MultiKeySymOrActionList { $$ = VarCreate(&param->arena, NULL, $1); }
                 ;
 
 /*
@@ -538,7 +533,7 @@ MultiKeySymOrActionList
                             };
                             for (uint32_t k = 0; k < $2; k++) {
                                 ExprDef* const syms =
-                                    ExprCreateKeySymList(XKB_KEY_NoSymbol);
+                                    ExprCreateKeySymList(&param->arena, XKB_KEY_NoSymbol);
                                 if (!syms) {
                                     /* TODO: Use Bison’s more appropriate YYNOMEM */
                                     YYABORT;
@@ -557,7 +552,7 @@ MultiKeySymOrActionList
                                 .head = $4.head, .last = $4.last
                             };
                             for (uint32_t k = 0; k < $2; k++) {
-                                ExprDef* const acts = ExprCreateActionList(NULL);
+                                ExprDef* const acts = ExprCreateActionList(&param->arena, NULL);
                                 if (!acts) {
                                     /* TODO: Use Bison’s more appropriate YYNOMEM */
                                     YYABORT;
@@ -573,7 +568,7 @@ MultiKeySymOrActionList
                          * a `MultiKeySymList` or a `MultiActionList`.
                          */
                 |       OBRACKET NoSymbolOrActionList CBRACKET
-                        { $$ = ExprEmptyList(); }
+                        { $$ = ExprEmptyList(&param->arena); }
                 ;
 
 /* A list of `{}`, which remains ambiguous until reaching a keysym or action list */
@@ -586,11 +581,11 @@ NoSymbolOrActionList
                 ;
 
 GroupCompatDecl :       GROUP Integer EQUALS Expr SEMI
-                        { $$ = GroupCompatCreate($2, $4); }
+                        { $$ = GroupCompatCreate(&param->arena, $2, $4); }
                 ;
 
 ModMapDecl      :       MODIFIER_MAP Ident OBRACE KeyOrKeySymList CBRACE SEMI
-                        { $$ = ModMapCreate($2, $4.head); }
+                        { $$ = ModMapCreate(&param->arena, $2, $4.head); }
                 ;
 
 KeyOrKeySymList :       KeyOrKeySymList COMMA KeyOrKeySym
@@ -600,35 +595,33 @@ KeyOrKeySymList :       KeyOrKeySymList COMMA KeyOrKeySym
                 ;
 
 KeyOrKeySym     :       KEYNAME
-                        { $$ = ExprCreateKeyName($1); }
+                        { $$ = ExprCreateKeyName(&param->arena, $1); }
                 |       KeySym
-                        { $$ = ExprCreateKeySym($1); }
+                        { $$ = ExprCreateKeySym(&param->arena, $1); }
                 ;
 
 LedMapDecl:             INDICATOR String OBRACE VarDeclList CBRACE SEMI
-                        { $$ = LedMapCreate($2, $4.head); }
+                        { $$ = LedMapCreate(&param->arena, $2, $4.head); }
                 ;
 
 LedNameDecl:            INDICATOR Integer EQUALS Expr SEMI
-                        { $$ = LedNameCreate($2, $4, false); }
+                        { $$ = LedNameCreate(&param->arena, $2, $4, false); }
                 |       VIRTUAL INDICATOR Integer EQUALS Expr SEMI
-                        { $$ = LedNameCreate($3, $5, true); }
+                        { $$ = LedNameCreate(&param->arena, $3, $5, true); }
                 ;
 
 UnknownDecl     :       IDENT Terminal EQUALS Expr SEMI
                         {
-                            FreeStmt((ParseCommon *) $2);
-                            FreeStmt((ParseCommon *) $4);
-                            $$ = UnknownStatementCreate(STMT_UNKNOWN_DECLARATION, $1);
+                            (void) $2; (void) $4;
+                            $$ = UnknownStatementCreate(&param->arena, STMT_UNKNOWN_DECLARATION, $1);
                         }
                 ;
 
 UnknownCompoundStatementDecl:
                         IDENT OptTerminal OBRACE VarDeclList CBRACE SEMI
                         {
-                            FreeStmt((ParseCommon *) $2);
-                            FreeStmt((ParseCommon *) $4.head);
-                            $$ = UnknownStatementCreate(STMT_UNKNOWN_COMPOUND, $1);
+                            (void) $2; (void) $4;
+                            $$ = UnknownStatementCreate(&param->arena, STMT_UNKNOWN_COMPOUND, $1);
                         }
                 ;
 
@@ -649,11 +642,11 @@ SectionBody     :       SectionBody SectionBodyItem     { $$ = NULL;}
 SectionBodyItem :       ROW OBRACE RowBody CBRACE SEMI
                         { $$ = NULL; }
                 |       VarDecl
-                        { FreeStmt((ParseCommon *) $1); $$ = NULL; }
+                        { (void) $1; $$ = NULL; }
                 |       DoodadDecl
                         { $$ = NULL; }
                 |       LedMapDecl
-                        { FreeStmt((ParseCommon *) $1); $$ = NULL; }
+                        { (void) $1; $$ = NULL; }
                 |       OverlayDecl
                         { $$ = NULL; }
                 ;
@@ -664,7 +657,7 @@ RowBody         :       RowBody RowBodyItem     { $$ = NULL;}
 
 RowBodyItem     :       KEYS OBRACE Keys CBRACE SEMI { $$ = NULL; }
                 |       VarDecl
-                        { FreeStmt((ParseCommon *) $1); $$ = NULL; }
+                        { (void) $1; $$ = NULL; }
                 ;
 
 Keys            :       Keys COMMA Key          { $$ = NULL; }
@@ -674,7 +667,7 @@ Keys            :       Keys COMMA Key          { $$ = NULL; }
 Key             :       KEYNAME
                         { $$ = NULL; }
                 |       OBRACE ExprList CBRACE
-                        { FreeStmt((ParseCommon *) $2.head); $$ = NULL; }
+                        { (void) $2; $$ = NULL; }
                 ;
 
 OverlayDecl     :       OVERLAY String OBRACE OverlayKeyList CBRACE SEMI
@@ -699,7 +692,7 @@ OutlineInList   :       OBRACE CoordList CBRACE
                 |       Ident EQUALS OBRACE CoordList CBRACE
                         { (void) $4; $$ = NULL; }
                 |       Ident EQUALS Expr
-                        { FreeStmt((ParseCommon *) $3); $$ = NULL; }
+                        { (void) $3; $$ = NULL; }
                 ;
 
 CoordList       :       CoordList COMMA Coord
@@ -713,7 +706,7 @@ Coord           :       OBRACKET SignedNumber COMMA SignedNumber CBRACKET
                 ;
 
 DoodadDecl      :       DoodadType String OBRACE VarDeclList CBRACE SEMI
-                        { FreeStmt((ParseCommon *) $4.head); $$ = NULL; }
+                        { (void) $4; $$ = NULL; }
                 ;
 
 DoodadType      :       TEXT    { $$ = 0; }
@@ -788,31 +781,31 @@ ExprList        :       ExprList COMMA Expr
                 ;
 
 Expr            :       Expr DIVIDE Expr
-                        { $$ = ExprCreateBinary(STMT_EXPR_DIVIDE, $1, $3); }
+                        { $$ = ExprCreateBinary(&param->arena, STMT_EXPR_DIVIDE, $1, $3); }
                 |       Expr PLUS Expr
-                        { $$ = ExprCreateBinary(STMT_EXPR_ADD, $1, $3); }
+                        { $$ = ExprCreateBinary(&param->arena, STMT_EXPR_ADD, $1, $3); }
                 |       Expr MINUS Expr
-                        { $$ = ExprCreateBinary(STMT_EXPR_SUBTRACT, $1, $3); }
+                        { $$ = ExprCreateBinary(&param->arena, STMT_EXPR_SUBTRACT, $1, $3); }
                 |       Expr TIMES Expr
-                        { $$ = ExprCreateBinary(STMT_EXPR_MULTIPLY, $1, $3); }
+                        { $$ = ExprCreateBinary(&param->arena, STMT_EXPR_MULTIPLY, $1, $3); }
                 |       Lhs EQUALS Expr
-                        { $$ = ExprCreateBinary(STMT_EXPR_ASSIGN, $1, $3); }
+                        { $$ = ExprCreateBinary(&param->arena, STMT_EXPR_ASSIGN, $1, $3); }
                 |       Term
                         { $$ = $1; }
                 ;
 
 Term            :       MINUS Term
-                        { $$ = ExprCreateUnary(STMT_EXPR_NEGATE, $2); }
+                        { $$ = ExprCreateUnary(&param->arena, STMT_EXPR_NEGATE, $2); }
                 |       PLUS Term
-                        { $$ = ExprCreateUnary(STMT_EXPR_UNARY_PLUS, $2); }
+                        { $$ = ExprCreateUnary(&param->arena, STMT_EXPR_UNARY_PLUS, $2); }
                 |       EXCLAM Term
-                        { $$ = ExprCreateUnary(STMT_EXPR_NOT, $2); }
+                        { $$ = ExprCreateUnary(&param->arena, STMT_EXPR_NOT, $2); }
                 |       INVERT Term
-                        { $$ = ExprCreateUnary(STMT_EXPR_INVERT, $2); }
+                        { $$ = ExprCreateUnary(&param->arena, STMT_EXPR_INVERT, $2); }
                 |       Lhs
                         { $$ = $1; }
                 |       FieldSpec OPAREN ExprList CPAREN %prec OPAREN
-                        { $$ = ExprCreateAction($1, $3.head); }
+                        { $$ = ExprCreateAction(&param->arena, $1, $3.head); }
                 |       Actions
                         { $$ = $1; }
                 |       Terminal
@@ -823,14 +816,14 @@ Term            :       MINUS Term
 
 MultiActionList :       MultiActionList COMMA Action
                         {
-                            ExprDef *expr = ExprCreateActionList($3);
+                            ExprDef *expr = ExprCreateActionList(&param->arena, $3);
                             $$ = $1;
                             $$.last->common.next = &expr->common; $$.last = expr;
                         }
                 |       MultiActionList COMMA Actions
                         { $$ = $1; $$.last->common.next = &$3->common; $$.last = $3; }
                 |       Action
-                        { $$.head = $$.last = ExprCreateActionList($1); }
+                        { $$.head = $$.last = ExprCreateActionList(&param->arena, $1); }
                 |       NonEmptyActions
                         { $$.head = $$.last = $1; }
                 ;
@@ -842,27 +835,27 @@ ActionList      :       ActionList COMMA Action
                 ;
 
 NonEmptyActions :       OBRACE ActionList CBRACE
-                        { $$ = ExprCreateActionList($2.head); }
+                        { $$ = ExprCreateActionList(&param->arena, $2.head); }
                 ;
 
 Actions         :       NonEmptyActions
                         { $$ = $1; }
                 |       OBRACE CBRACE
-                        { $$ = ExprCreateActionList(NULL); }
+                        { $$ = ExprCreateActionList(&param->arena, NULL); }
                 ;
 
 Action          :       FieldSpec OPAREN ExprList CPAREN
-                        { $$ = ExprCreateAction($1, $3.head); }
+                        { $$ = ExprCreateAction(&param->arena, $1, $3.head); }
                 ;
 
 Lhs             :       FieldSpec
-                        { $$ = ExprCreateIdent($1); }
+                        { $$ = ExprCreateIdent(&param->arena, $1); }
                 |       FieldSpec DOT FieldSpec
-                        { $$ = ExprCreateFieldRef($1, $3); }
+                        { $$ = ExprCreateFieldRef(&param->arena, $1, $3); }
                 |       FieldSpec OBRACKET Expr CBRACKET
-                        { $$ = ExprCreateArrayRef(XKB_ATOM_NONE, $1, $3); }
+                        { $$ = ExprCreateArrayRef(&param->arena, XKB_ATOM_NONE, $1, $3); }
                 |       FieldSpec DOT FieldSpec OBRACKET Expr CBRACKET
-                        { $$ = ExprCreateArrayRef($1, $3, $5); }
+                        { $$ = ExprCreateArrayRef(&param->arena, $1, $3, $5); }
                 ;
 
 OptTerminal     :       Terminal
@@ -871,50 +864,54 @@ OptTerminal     :       Terminal
                 ;
 
 Terminal        :       String
-                        { $$ = ExprCreateString($1); }
+                        { $$ = ExprCreateString(&param->arena, $1); }
                 |       Integer
-                        { $$ = ExprCreateInteger($1); }
+                        { $$ = ExprCreateInteger(&param->arena, $1); }
                 |       Float
-                        { $$ = ExprCreateFloat(/* Discard $1 */); }
+                        { $$ = ExprCreateFloat(&param->arena /* Discard $1 */); }
                 |       KEYNAME
-                        { $$ = ExprCreateKeyName($1); }
+                        { $$ = ExprCreateKeyName(&param->arena, $1); }
                 ;
 
 MultiKeySymList :       MultiKeySymList COMMA KeySymLit
                         {
-                            ExprDef *expr = ExprCreateKeySymList($3);
+                            ExprDef *expr = ExprCreateKeySymList(&param->arena, $3);
                             $$ = $1;
                             $$.last->common.next = &expr->common; $$.last = expr;
                         }
                 |       MultiKeySymList COMMA KeySyms
                         { $$ = $1; $$.last->common.next = &$3->common; $$.last = $3; }
                 |       KeySymLit
-                        { $$.head = $$.last = ExprCreateKeySymList($1); }
+                        { $$.head = $$.last = ExprCreateKeySymList(&param->arena, $1); }
                 |       NonEmptyKeySyms
                         { $$.head = $$.last = $1; }
                 ;
 
 KeySymList      :       KeySymList COMMA KeySymLit
-                        { $$ = ExprAppendKeySymList($1, $3); }
+                        {
+                            $$ = ExprAppendKeySymList(&param->arena, $1, $3);
+                            if (!$$)
+                                YYERROR;
+                        }
                 |       KeySymList COMMA STRING
                         {
-                            $$ = ExprKeySymListAppendString(param->scanner, $1, $3);
+                            $$ = ExprKeySymListAppendString(&param->arena, param->scanner, $1, $3);
                             free($3);
                             if (!$$)
                                 YYERROR;
                         }
                 |       KeySymLit
                         {
-                            $$ = ExprCreateKeySymList($1);
+                            $$ = ExprCreateKeySymList(&param->arena, $1);
                             if (!$$)
                                 YYERROR;
                         }
                 |       STRING
                         {
-                            $$ = ExprCreateKeySymList(XKB_KEY_NoSymbol);
+                            $$ = ExprCreateKeySymList(&param->arena, XKB_KEY_NoSymbol);
                             if (!$$)
                                 YYERROR;
-                            $$ = ExprKeySymListAppendString(param->scanner, $$, $1);
+                            $$ = ExprKeySymListAppendString(&param->arena, param->scanner, $$, $1);
                             free($1);
                             if (!$$)
                                 YYERROR;
@@ -925,10 +922,10 @@ NonEmptyKeySyms :       OBRACE KeySymList CBRACE
                         { $$ = $2; }
                 |       STRING
                         {
-                            $$ = ExprCreateKeySymList(XKB_KEY_NoSymbol);
+                            $$ = ExprCreateKeySymList(&param->arena, XKB_KEY_NoSymbol);
                             if (!$$)
                                 YYERROR;
-                            $$ = ExprKeySymListAppendString(param->scanner, $$, $1);
+                            $$ = ExprKeySymListAppendString(&param->arena, param->scanner, $$, $1);
                             free($1);
                             if (!$$)
                                 YYERROR;
@@ -938,7 +935,7 @@ NonEmptyKeySyms :       OBRACE KeySymList CBRACE
 KeySyms         :       NonEmptyKeySyms
                         { $$ = $1; }
                 |       OBRACE CBRACE
-                        { $$ = ExprCreateKeySymList(XKB_KEY_NoSymbol); }
+                        { $$ = ExprCreateKeySymList(&param->arena, XKB_KEY_NoSymbol); }
                 ;
 
 KeySym          :       KeySymLit
@@ -1080,6 +1077,7 @@ parse(struct xkb_context *ctx, struct scanner *scanner, const char *map)
     struct parser_param param = {
         .scanner = scanner,
         .ctx = ctx,
+        .arena = ARENA_INIT,
         .rtrn = NULL,
         .more_maps = false,
     };
@@ -1090,9 +1088,14 @@ parse(struct xkb_context *ctx, struct scanner *scanner, const char *map)
      * default map. If we find a map marked as default, we return it
      * immediately. If there are no maps marked as default, we return
      * the first map in the file.
+     *
+     * Each map gets its own arena, so that the discarded maps are released
+     * immediately.
      */
 
     while ((ret = yyparse(&param)) == 0 && param.more_maps) {
+        param.rtrn->arena = param.arena;
+        param.arena = (struct arena) ARENA_INIT;
         if (map) {
             if (streq_not_null(map, param.rtrn->name))
                 return param.rtrn;
@@ -1114,10 +1117,12 @@ parse(struct xkb_context *ctx, struct scanner *scanner, const char *map)
         param.rtrn = NULL;
     }
 
+    /* Error or end of file: nothing in the arena is referenced */
+    arena_release(&param.arena);
+
     if (ret != 0) {
         /* Some error happend; clear the Xkbfiles parsed so far */
         FreeXkbFile(first);
-        FreeXkbFile(param.rtrn);
         return NULL;
     }
 
@@ -1139,15 +1144,17 @@ parse_next(struct xkb_context *ctx, struct scanner *scanner, XkbFile **xkb_file)
     struct parser_param param = {
         .scanner = scanner,
         .ctx = ctx,
+        .arena = ARENA_INIT,
         .rtrn = NULL,
         .more_maps = false,
     };
 
     if ((ret = yyparse(&param)) == 0 && param.more_maps) {
+        param.rtrn->arena = param.arena;
         *xkb_file = param.rtrn;
         return true;
     } else {
-        FreeXkbFile(param.rtrn);
+        arena_release(&param.arena);
         *xkb_file = NULL;
         return (ret == 0);
     }
@@ -12,7 +12,11 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <stdarg.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 
 #include "xkbcommon/xkbcommon.h"
 #include "xkbcomp-priv.h"
@@ -30,6 +34,52 @@
 
 #define MAX_INCLUDE_DEPTH 5
 
+/*
+ * Rules files are parsed once per context into a `struct rules_file`, which is
+ * then evaluated for each RMLVO to resolve (see `matcher_match()`). Parsing
+ * does not depend on the RMLVO, so its errors are recorded and replayed on each
+ * evaluation, at the position they would have been reported by a sequential
+ * parse-and-match.
+ */
+struct rules_diagnostic {
+    /* Position of the current token when the error occurred */
+    size_t pos;
+    enum xkb_message_code code;
+    /* NULL if there is no error */
+    char *message;
+};
+
+ATTR_PRINTF(4, 5) static void
+rules_diagnostic_set(struct rules_diagnostic *diagnostic, size_t pos,
+                     enum xkb_message_code code, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    free(diagnostic->message);
+    diagnostic->pos = pos;
+    diagnostic->code = code;
+    diagnostic->message = vasprintf_safe(fmt, args);
+    va_end(args);
+}
+
+#define rules_err(diagnostic, scanner, id, fmt, ...) \
+    rules_diagnostic_set((diagnostic), (scanner)->token_pos, (id), \
+                         fmt, ##__VA_ARGS__)
+
+static void
+rules_diagnostic_log(struct scanner *s,
+                     const struct rules_diagnostic *diagnostic)
+{
+    if (!diagnostic->message)
+        return;
+    s->token_pos = diagnostic->pos;
+    const enum xkb_message_code code = diagnostic->code;
+    if (code == XKB_LOG_MESSAGE_NO_ID)
+        scanner_err(s, XKB_LOG_MESSAGE_NO_ID, "%s", diagnostic->message);
+    else
+        scanner_err(s, code, "%s", diagnostic->message);
+}
+
 /* Scanner / Lexer */
 
 /* Values returned with some tokens, like yylval. */
@@ -81,8 +131,8 @@ skip_more_whitespace_and_comments:
         /* Optional \r. */
         scanner_chr(s, '\r');
         if (!scanner_eol(s)) {
-            scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                        "illegal new line escape; must appear at end of line");
+            rules_err(s->priv, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+                      "illegal new line escape; must appear at end of line");
             return TOK_ERROR;
         }
         scanner_next(s);
@@ -114,8 +164,8 @@ skip_more_whitespace_and_comments:
             val->string.len++;
         }
         if (val->string.len == 0) {
-            scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                        "unexpected character after \'$\'; expected name");
+            rules_err(s->priv, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+                      "unexpected character after \'$\'; expected name");
             return TOK_ERROR;
         }
         return TOK_GROUP_NAME;
@@ -140,8 +190,8 @@ skip_more_whitespace_and_comments:
         return TOK_IDENTIFIER;
     }
 
-    scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                "unrecognized token");
+    rules_err(s->priv, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+              "unrecognized token");
     return TOK_ERROR;
 }
 
@@ -289,28 +339,118 @@ struct kccgst_buffer {
     darray(struct kccgst_buffer_slice) slices;
 };
 
+/* A rule of a rule set, as parsed */
+struct rules_entry {
+    struct rule rule;
+    /* Position of the last token of the rule */
+    size_t pos;
+    /* Invalid rules have exactly one error and are skipped */
+    struct rules_diagnostic diagnostic;
+    /* Whether the end of the rule was reached */
+    bool complete;
+};
+
+/* Rules whose first MLVO value is `key` */
+struct rules_bucket {
+    struct sval key;
+    uint32_t hash;
+    /* Range in `rule_set::keyed` */
+    darray_size_t first;
+    darray_size_t count;
+};
+
+/*
+ * A rule set, i.e. a mapping line followed by its rules.
+ *
+ * A rule that does not match the first MLVO value of its mapping has no effect
+ * at all: it does not even mark the RMLVO values as matched. So the rules are
+ * indexed by their first value, and only the rules that may match the given
+ * RMLVO are evaluated, in file order. Wild cards, groups that cannot be
+ * resolved when parsing and invalid rules are always evaluated.
+ */
+struct rule_set {
+    /* Mapping after parsing the header line */
+    struct mapping mapping;
+    /* Position of the last token of the header line */
+    size_t pos;
+    struct rules_diagnostic diagnostic;
+    /* Whether the end of the header line was reached */
+    bool header_complete;
+    /* Whether the rule set was terminated by a new statement or the end of
+     * the file, i.e. not by an error */
+    bool complete;
+    darray(struct rules_entry) rules;
+    /* Rules that are always evaluated */
+    darray(darray_size_t) unconditional;
+    /* Rules with a plain value or a group, indexed by value */
+    darray(struct rules_bucket) buckets;
+    /* Open addressing hash table: bucket index + 1, or 0 if empty */
+    darray(darray_size_t) slots;
+    /* Rule indices, sorted by bucket, then by file order */
+    darray(darray_size_t) keyed;
+    /* Groups expanded in the buckets */
+    darray(const struct group *) groups;
+};
+
+enum rules_item_type {
+    RULES_ITEM_GROUP,
+    RULES_ITEM_INCLUDE,
+    RULES_ITEM_RULE_SET,
+};
+
+/* A statement of a rules file */
+struct rules_item {
+    enum rules_item_type type;
+    /* Position of the include file token */
+    size_t pos;
+    union {
+        struct group group;
+        struct sval include;
+        struct rule_set *rule_set;
+    };
+};
+
+/* A parsed rules file, shared by all the matchers of a context */
+struct rules_file {
+    unsigned int refcnt;
+    char *path;
+    struct file_stamp stamp;
+    /* Copy of the file content, referenced by the parsed values */
+    char *string;
+    size_t string_len;
+    darray(struct rules_item) items;
+    /* Parsing stops at the first syntax error */
+    bool ok;
+    struct rules_diagnostic error;
+};
+
+/* Parsed rules files of a context */
+struct xkb_rules_index {
+    darray(struct rules_file *) files;
+};
+
 /*
  * This is the main object used to match a given RMLVO against a rules
- * file and aggregate the results in a KcCGST. It goes through a simple
- * matching state machine, with tokens as transitions (see
- * matcher_match()).
+ * file and aggregate the results in a KcCGST. It evaluates the statements of
+ * the parsed rules files in order (see matcher_match()).
  */
 struct matcher {
     struct xkb_context *ctx;
     /* Input.*/
     struct rule_names rmlvo;
-    union lvalue val;
-    darray(struct group) groups;
+    darray(const struct group *) groups;
     /* Current mapping. */
     struct mapping mapping;
-    /* Current rule. */
-    struct rule rule;
+    /* Rules of the current rule set to evaluate */
+    darray(darray_size_t) candidates;
     /*
      * Buffers for pending KcCGST values. Required in case of using layout
      * index ranges, to ensure that the values are merged in the expected order.
      * See the note: “Layout index ranges and merging KcCGST values”.
      */
     struct kccgst_buffer pending_kccgst;
+    /* Rules files in use, referenced by the groups */
+    darray(struct rules_file *) files;
     /* Output. */
     darray_char kccgst[_KCCGST_NUM_ENTRIES];
 };
@@ -530,6 +670,9 @@ matcher_new_from_names(struct xkb_context *ctx,
     return m;
 }
 
+static void
+rules_file_unref(struct rules_file *file);
+
 static void
 matcher_free(struct matcher *m)
 {
@@ -538,32 +681,19 @@ matcher_free(struct matcher *m)
     darray_free(m->rmlvo.layouts);
     darray_free(m->rmlvo.variants);
     darray_free(m->rmlvo.options);
-    struct group *group;
-    darray_foreach(group, m->groups)
-        darray_free(group->elements);
+    darray_free(m->groups);
+    darray_free(m->candidates);
     darray_free(m->pending_kccgst.buffer);
     darray_free(m->pending_kccgst.slices);
+    struct rules_file **file;
+    darray_foreach(file, m->files)
+        rules_file_unref(*file);
+    darray_free(m->files);
     for (kccgst_index_t i = 0; i < (kccgst_index_t) _KCCGST_NUM_ENTRIES; i++)
         darray_free(m->kccgst[i]);
-    darray_free(m->groups);
     free(m);
 }
 
-static void
-matcher_group_start_new(struct matcher *m, struct sval name)
-{
-    struct group group = { .name = name, .elements = darray_new() };
-    darray_append(m->groups, group);
-}
-
-static void
-matcher_group_add_element(struct matcher *m, struct scanner *s,
-                          struct sval element)
-{
-    darray_append(darray_item(m->groups, darray_size(m->groups) - 1).elements,
-                  element);
-}
-
 static bool
 read_rules_file(struct xkb_context *ctx,
                 struct matcher *matcher,
@@ -626,6 +756,7 @@ matcher_include(struct matcher *m, struct scanner *parent_scanner,
             /* %-expansion is always NULL-terminated */
             assert(stmt_file[stmt_file_len] == '\0');
         }
+        xkb_context_track_file(m->ctx, stmt_file);
         file = fopen(stmt_file, "rb");
     } else {
         /* Relative path: lookup the first XKB path */
@@ -679,18 +810,18 @@ matcher_include(struct matcher *m, struct scanner *parent_scanner,
 }
 
 static void
-matcher_mapping_start_new(struct matcher *m)
+mapping_init(struct mapping *mapping)
 {
     for (mlvo_index_t i = 0; i < (mlvo_index_t) _MLVO_NUM_ENTRIES; i++)
-        m->mapping.mlvo_at_pos[i] = _MLVO_NUM_ENTRIES;
+        mapping->mlvo_at_pos[i] = _MLVO_NUM_ENTRIES;
     for (kccgst_index_t i = 0; i < (kccgst_index_t) _KCCGST_NUM_ENTRIES; i++)
-        m->mapping.kccgst_at_pos[i] = _KCCGST_NUM_ENTRIES;
-    m->mapping.has_layout_idx_range = false;
-    m->mapping.layout_idx = m->mapping.variant_idx = XKB_LAYOUT_INVALID;
-    m->mapping.num_mlvo = m->mapping.num_kccgst = 0;
-    m->mapping.defined_mlvo_mask = 0;
-    m->mapping.defined_kccgst_mask = 0;
-    m->mapping.active = true;
+        mapping->kccgst_at_pos[i] = _KCCGST_NUM_ENTRIES;
+    mapping->has_layout_idx_range = false;
+    mapping->layout_idx = mapping->variant_idx = XKB_LAYOUT_INVALID;
+    mapping->num_mlvo = mapping->num_kccgst = 0;
+    mapping->defined_mlvo_mask = 0;
+    mapping->defined_kccgst_mask = 0;
+    mapping->active = true;
 }
 
 static int
@@ -781,15 +912,15 @@ extract_mapping_layout_index(const char *s, size_t max_len,
 }
 
 static inline bool
-is_mlvo_mask_defined(struct matcher *m, enum rules_mlvo mlvo)
+is_mlvo_mask_defined(const struct mapping *mapping, enum rules_mlvo mlvo)
 {
-    return m->mapping.defined_mlvo_mask & (1u << mlvo);
+    return mapping->defined_mlvo_mask & (1u << mlvo);
 }
 
 static void
-matcher_mapping_set_mlvo(struct matcher *m, struct scanner *s,
-                         struct sval ident)
+rule_set_set_mlvo(struct rule_set *set, struct scanner *s, struct sval ident)
 {
+    struct mapping * const mapping = &set->mapping;
     enum rules_mlvo mlvo;
     struct sval mlvo_sval;
 
@@ -802,20 +933,20 @@ matcher_mapping_set_mlvo(struct matcher *m, struct scanner *s,
 
     /* Not found. */
     if (mlvo >= _MLVO_NUM_ENTRIES) {
-        scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                    "invalid mapping: \"%.*s\" is not a valid value here; "
-                    "ignoring rule set",
-                    (unsigned int) ident.len, ident.start);
-        m->mapping.active = false;
+        rules_err(&set->diagnostic, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+                  "invalid mapping: \"%.*s\" is not a valid value here; "
+                  "ignoring rule set",
+                  (unsigned int) ident.len, ident.start);
+        mapping->active = false;
         return;
     }
 
-    if (is_mlvo_mask_defined(m, mlvo)) {
-        scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                    "invalid mapping: \"%.*s\" appears twice on the same line; "
-                    "ignoring rule set",
-                    (unsigned int) mlvo_sval.len, mlvo_sval.start);
-        m->mapping.active = false;
+    if (is_mlvo_mask_defined(mapping, mlvo)) {
+        rules_err(&set->diagnostic, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+                  "invalid mapping: \"%.*s\" appears twice on the same line; "
+                  "ignoring rule set",
+                  (unsigned int) mlvo_sval.len, mlvo_sval.start);
+        mapping->active = false;
         return;
     }
 
@@ -826,49 +957,49 @@ matcher_mapping_set_mlvo(struct matcher *m, struct scanner *s,
                                                     ident.len - mlvo_sval.len,
                                                     &idx);
         if ((int) (ident.len - mlvo_sval.len) != consumed) {
-            scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                        "invalid mapping: \"%.*s\" may only be followed by a "
-                        "valid group index; ignoring rule set",
-                        (unsigned int) mlvo_sval.len, mlvo_sval.start);
-            m->mapping.active = false;
+            rules_err(&set->diagnostic, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+                      "invalid mapping: \"%.*s\" may only be followed by a "
+                      "valid group index; ignoring rule set",
+                      (unsigned int) mlvo_sval.len, mlvo_sval.start);
+            mapping->active = false;
             return;
         }
 
         if (mlvo == MLVO_LAYOUT) {
-            m->mapping.layout_idx = idx;
+            mapping->layout_idx = idx;
         }
         else if (mlvo == MLVO_VARIANT) {
-            m->mapping.variant_idx = idx;
+            mapping->variant_idx = idx;
         }
         else {
-            scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                        "invalid mapping: \"%.*s\" cannot be followed by a group "
-                        "index; ignoring rule set",
-                        (unsigned int) mlvo_sval.len, mlvo_sval.start);
-            m->mapping.active = false;
+            rules_err(&set->diagnostic, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+                      "invalid mapping: \"%.*s\" cannot be followed by a group "
+                      "index; ignoring rule set",
+                      (unsigned int) mlvo_sval.len, mlvo_sval.start);
+            mapping->active = false;
             return;
         }
     } else if (mlvo == MLVO_LAYOUT) {
-        m->mapping.layout_idx = (xkb_layout_index_t) LAYOUT_INDEX_SINGLE;
+        mapping->layout_idx = (xkb_layout_index_t) LAYOUT_INDEX_SINGLE;
     } else if (mlvo == MLVO_VARIANT) {
-        m->mapping.variant_idx = (xkb_layout_index_t) LAYOUT_INDEX_SINGLE;
+        mapping->variant_idx = (xkb_layout_index_t) LAYOUT_INDEX_SINGLE;
     }
 
     /* Check that if both layout and variant are defined, then they must have
      * the same index */
-    if (((mlvo == MLVO_LAYOUT && is_mlvo_mask_defined(m, MLVO_VARIANT)) ||
-         (mlvo == MLVO_VARIANT && is_mlvo_mask_defined(m, MLVO_LAYOUT))) &&
-        m->mapping.layout_idx != m->mapping.variant_idx) {
-        scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                    "invalid mapping: \"layout\" index must be the same as the "
-                    "\"variant\" index");
-        m->mapping.active = false;
+    if (((mlvo == MLVO_LAYOUT && is_mlvo_mask_defined(mapping, MLVO_VARIANT)) ||
+         (mlvo == MLVO_VARIANT && is_mlvo_mask_defined(mapping, MLVO_LAYOUT))) &&
+        mapping->layout_idx != mapping->variant_idx) {
+        rules_err(&set->diagnostic, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+                  "invalid mapping: \"layout\" index must be the same as the "
+                  "\"variant\" index");
+        mapping->active = false;
         return;
     }
 
-    m->mapping.mlvo_at_pos[m->mapping.num_mlvo] = mlvo;
-    m->mapping.defined_mlvo_mask |= (mlvo_mask_t) 1u << mlvo;
-    m->mapping.num_mlvo++;
+    mapping->mlvo_at_pos[mapping->num_mlvo] = mlvo;
+    mapping->defined_mlvo_mask |= (mlvo_mask_t) 1u << mlvo;
+    mapping->num_mlvo++;
 }
 
 static void
@@ -879,8 +1010,8 @@ matcher_mapping_set_layout_bounds(struct matcher *m)
     switch (idx) {
         case XKB_LAYOUT_INVALID:
             /* No layout nor variant */
-            assert(!is_mlvo_mask_defined(m, MLVO_LAYOUT) &&
-                   !is_mlvo_mask_defined(m, MLVO_VARIANT));
+            assert(!is_mlvo_mask_defined(&m->mapping, MLVO_LAYOUT) &&
+                   !is_mlvo_mask_defined(&m->mapping, MLVO_VARIANT));
             m->mapping.has_layout_idx_range = false;
             m->mapping.layout_idx_min = XKB_LAYOUT_INVALID;
             m->mapping.layout_idx_max = XKB_LAYOUT_INVALID;
@@ -920,8 +1051,10 @@ matcher_mapping_set_layout_bounds(struct matcher *m)
 }
 
 static void
-matcher_mapping_set_kccgst(struct matcher *m, struct scanner *s, struct sval ident)
+rule_set_set_kccgst(struct rule_set *set, struct scanner *s,
+                    struct sval ident)
 {
+    struct mapping * const mapping = &set->mapping;
     enum rules_kccgst kccgst;
     struct sval kccgst_sval;
 
@@ -934,26 +1067,26 @@ matcher_mapping_set_kccgst(struct matcher *m, struct scanner *s, struct sval ide
 
     /* Not found. */
     if (kccgst >= _KCCGST_NUM_ENTRIES) {
-        scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                    "invalid mapping: \"%.*s\" is not a valid value here; "
-                    "ignoring rule set",
-                    (unsigned int) ident.len, ident.start);
-        m->mapping.active = false;
+        rules_err(&set->diagnostic, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+                  "invalid mapping: \"%.*s\" is not a valid value here; "
+                  "ignoring rule set",
+                  (unsigned int) ident.len, ident.start);
+        mapping->active = false;
         return;
     }
 
-    if (m->mapping.defined_kccgst_mask & (1u << kccgst)) {
-        scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                    "invalid mapping: \"%.*s\" appears twice on the same line; "
-                    "ignoring rule set",
-                    (unsigned int) kccgst_sval.len, kccgst_sval.start);
-        m->mapping.active = false;
+    if (mapping->defined_kccgst_mask & (1u << kccgst)) {
+        rules_err(&set->diagnostic, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+                  "invalid mapping: \"%.*s\" appears twice on the same line; "
+                  "ignoring rule set",
+                  (unsigned int) kccgst_sval.len, kccgst_sval.start);
+        mapping->active = false;
         return;
     }
 
-    m->mapping.kccgst_at_pos[m->mapping.num_kccgst] = kccgst;
-    m->mapping.defined_kccgst_mask |= (kccgst_mask_t) 1u << kccgst;
-    m->mapping.num_kccgst++;
+    mapping->kccgst_at_pos[mapping->num_kccgst] = kccgst;
+    mapping->defined_kccgst_mask |= (kccgst_mask_t) 1u << kccgst;
+    mapping->num_kccgst++;
 }
 
 static bool
@@ -978,7 +1111,7 @@ matcher_mapping_verify(struct matcher *m, struct scanner *s)
      * See the "Notes" section in the overview above.
      */
 
-    if (is_mlvo_mask_defined(m, MLVO_LAYOUT)) {
+    if (is_mlvo_mask_defined(&m->mapping, MLVO_LAYOUT)) {
         assert(m->mapping.layout_idx != XKB_LAYOUT_INVALID);
         switch (m->mapping.layout_idx) {
             case LAYOUT_INDEX_SINGLE:
@@ -1001,7 +1134,7 @@ matcher_mapping_verify(struct matcher *m, struct scanner *s)
         }
     }
 
-    if (is_mlvo_mask_defined(m, MLVO_VARIANT)) {
+    if (is_mlvo_mask_defined(&m->mapping, MLVO_VARIANT)) {
         assert(m->mapping.variant_idx != XKB_LAYOUT_INVALID);
         switch (m->mapping.variant_idx) {
             case LAYOUT_INDEX_SINGLE:
@@ -1031,82 +1164,102 @@ skip:
     return false;
 }
 
-static void
-matcher_rule_start_new(struct matcher *m)
+static struct rules_entry *
+rule_set_add_rule(struct rule_set *set)
 {
-    memset(&m->rule, 0, sizeof(m->rule));
-    m->rule.skip = !m->mapping.active;
+    darray_append(set->rules, (struct rules_entry) { .complete = false });
+    return &darray_item(set->rules, darray_size(set->rules) - 1);
 }
 
 static void
-matcher_rule_set_mlvo_common(struct matcher *m, struct scanner *s,
-                             struct sval ident,
-                             enum mlvo_match_type match_type)
+rules_entry_set_mlvo_common(const struct rule_set *set,
+                            struct rules_entry *entry, struct scanner *s,
+                            struct sval ident,
+                            enum mlvo_match_type match_type)
 {
-    if (m->rule.num_mlvo_values >= m->mapping.num_mlvo) {
-        scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                    "invalid rule: has more values than the mapping line; "
-                    "ignoring rule");
-        m->rule.skip = true;
+    struct rule * const rule = &entry->rule;
+    if (rule->num_mlvo_values >= set->mapping.num_mlvo) {
+        rules_err(&entry->diagnostic, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+                  "invalid rule: has more values than the mapping line; "
+                  "ignoring rule");
+        rule->skip = true;
         return;
     }
-    m->rule.match_type_at_pos[m->rule.num_mlvo_values] = match_type;
-    m->rule.mlvo_value_at_pos[m->rule.num_mlvo_values] = ident;
-    m->rule.num_mlvo_values++;
+    rule->match_type_at_pos[rule->num_mlvo_values] = match_type;
+    rule->mlvo_value_at_pos[rule->num_mlvo_values] = ident;
+    rule->num_mlvo_values++;
 }
 
 static void
-matcher_rule_set_mlvo_wildcard(struct matcher *m, struct scanner *s,
-                               enum mlvo_match_type match_type)
+rules_entry_set_mlvo_wildcard(const struct rule_set *set,
+                              struct rules_entry *entry, struct scanner *s,
+                              enum mlvo_match_type match_type)
 {
     struct sval dummy = SVAL(NULL, 0);
-    matcher_rule_set_mlvo_common(m, s, dummy, match_type);
+    rules_entry_set_mlvo_common(set, entry, s, dummy, match_type);
 }
 
 static void
-matcher_rule_set_mlvo_group(struct matcher *m, struct scanner *s,
-                            struct sval ident)
+rules_entry_set_mlvo_group(const struct rule_set *set,
+                           struct rules_entry *entry, struct scanner *s,
+                           struct sval ident)
 {
-    matcher_rule_set_mlvo_common(m, s, ident, MLVO_MATCH_GROUP);
+    rules_entry_set_mlvo_common(set, entry, s, ident, MLVO_MATCH_GROUP);
 }
 
 static void
-matcher_rule_set_mlvo(struct matcher *m, struct scanner *s,
-                      struct sval ident)
+rules_entry_set_mlvo(const struct rule_set *set, struct rules_entry *entry,
+                     struct scanner *s, struct sval ident)
 {
-    matcher_rule_set_mlvo_common(m, s, ident, MLVO_MATCH_NORMAL);
+    rules_entry_set_mlvo_common(set, entry, s, ident, MLVO_MATCH_NORMAL);
 }
 
 static void
-matcher_rule_set_kccgst(struct matcher *m, struct scanner *s,
-                        struct sval ident)
+rules_entry_set_kccgst(const struct rule_set *set, struct rules_entry *entry,
+                       struct scanner *s, struct sval ident)
 {
-    if (m->rule.num_kccgst_values >= m->mapping.num_kccgst) {
-        scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                    "invalid rule: has more values than the mapping line; "
-                    "ignoring rule");
-        m->rule.skip = true;
+    struct rule * const rule = &entry->rule;
+    if (rule->num_kccgst_values >= set->mapping.num_kccgst) {
+        rules_err(&entry->diagnostic, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+                  "invalid rule: has more values than the mapping line; "
+                  "ignoring rule");
+        rule->skip = true;
         return;
     }
-    m->rule.kccgst_value_at_pos[m->rule.num_kccgst_values] = ident;
-    m->rule.num_kccgst_values++;
+    rule->kccgst_value_at_pos[rule->num_kccgst_values] = ident;
+    rule->num_kccgst_values++;
 }
 
-static bool
-match_group(struct matcher *m, struct sval group_name, struct sval to)
+static void
+rules_entry_verify(const struct rule_set *set, struct rules_entry *entry,
+                   struct scanner *s)
 {
-    struct group *group = NULL;
-    struct sval *element;
-    bool found = false;
+    struct rule * const rule = &entry->rule;
+    if (rule->num_mlvo_values != set->mapping.num_mlvo ||
+        rule->num_kccgst_values != set->mapping.num_kccgst) {
+        rules_err(&entry->diagnostic, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+                  "invalid rule: must have same number of values "
+                  "as mapping line; ignoring rule");
+        rule->skip = true;
+    }
+}
 
+static const struct group *
+matcher_find_group(const struct matcher *m, struct sval group_name)
+{
+    const struct group * const *group;
     darray_foreach(group, m->groups) {
-        if (svaleq(group->name, group_name)) {
-            found = true;
-            break;
-        }
+        if (svaleq((*group)->name, group_name))
+            return *group;
     }
+    return NULL;
+}
 
-    if (!found) {
+static bool
+match_group(struct matcher *m, struct sval group_name, struct sval to)
+{
+    const struct group * const group = matcher_find_group(m, group_name);
+    if (!group) {
         /*
          * rules/evdev intentionally uses some undeclared group names
          * in rules (e.g. commented group definitions which may be
@@ -1115,6 +1268,7 @@ match_group(struct matcher *m, struct sval group_name, struct sval to)
         return false;
     }
 
+    const struct sval *element;
     darray_foreach(element, group->elements)
         if (svaleq(to, *element))
             return true;
@@ -1468,19 +1622,8 @@ matcher_append_pending_kccgst(struct matcher *m)
 }
 
 static void
-matcher_rule_verify(struct matcher *m, struct scanner *s)
-{
-    if (m->rule.num_mlvo_values != m->mapping.num_mlvo ||
-        m->rule.num_kccgst_values != m->mapping.num_kccgst) {
-        scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                    "invalid rule: must have same number of values "
-                    "as mapping line; ignoring rule");
-        m->rule.skip = true;
-    }
-}
-
-static void
-matcher_rule_apply_if_matches(struct matcher *m, struct scanner *s)
+matcher_rule_apply_if_matches(struct matcher *m, struct scanner *s,
+                              const struct rule *rule)
 {
     /* Initial candidates (used if m->mapping.has_layout_idx_range == true) */
     xkb_layout_mask_t candidate_layouts = m->mapping.layouts_candidates_mask;
@@ -1488,8 +1631,8 @@ matcher_rule_apply_if_matches(struct matcher *m, struct scanner *s)
     /* Loop over MLVO pattern components */
     for (mlvo_index_t i = 0; i < m->mapping.num_mlvo; i++) {
         enum rules_mlvo mlvo = m->mapping.mlvo_at_pos[i];
-        struct sval value = m->rule.mlvo_value_at_pos[i];
-        enum mlvo_match_type match_type = m->rule.match_type_at_pos[i];
+        struct sval value = rule->mlvo_value_at_pos[i];
+        enum mlvo_match_type match_type = rule->match_type_at_pos[i];
         struct matched_sval *to;
         bool matched = false;
 
@@ -1606,7 +1749,7 @@ matcher_rule_apply_if_matches(struct matcher *m, struct scanner *s)
             if (candidate_layouts & (UINT32_C(1) << idx)) {
                 for (kccgst_index_t i = 0; i < m->mapping.num_kccgst; i++) {
                     const enum rules_kccgst kccgst = m->mapping.kccgst_at_pos[i];
-                    const struct sval value = m->rule.kccgst_value_at_pos[i];
+                    const struct sval value = rule->kccgst_value_at_pos[i];
                     /*
                      * [NOTE] Layout index ranges and merging KcCGST values
                      *
@@ -1665,7 +1808,7 @@ matcher_rule_apply_if_matches(struct matcher *m, struct scanner *s)
         /* Numeric index or no index */
         for (kccgst_index_t i = 0; i < m->mapping.num_kccgst; i++) {
             enum rules_kccgst kccgst = m->mapping.kccgst_at_pos[i];
-            struct sval value = m->rule.kccgst_value_at_pos[i];
+            struct sval value = rule->kccgst_value_at_pos[i];
             append_expanded_kccgst_value(m, s, true, &m->kccgst[kccgst], value,
                                          m->mapping.layout_idx_min);
         }
@@ -1676,30 +1819,198 @@ matcher_rule_apply_if_matches(struct matcher *m, struct scanner *s)
      * skipped. However, rule sets matching against options may contain
      * several legitimate rules, so they are processed entirely.
      */
-    if (!(is_mlvo_mask_defined(m, MLVO_OPTION))) {
+    if (!(is_mlvo_mask_defined(&m->mapping, MLVO_OPTION))) {
         m->mapping.layouts_candidates_mask &= ~candidate_layouts;
     }
 }
 
-static enum rules_token
-gettok(struct matcher *m, struct scanner *s)
+/***====================================================================***/
+
+/* Parsing */
+
+static inline uint32_t
+hash_sval(struct sval value)
 {
-    return lex(s, &m->val);
+    /* FNV-1a */
+    uint32_t hash = UINT32_C(2166136261);
+    for (size_t i = 0; i < value.len; i++) {
+        hash ^= (uint8_t) value.start[i];
+        hash *= UINT32_C(0x01000193);
+    }
+    return hash;
 }
 
-static bool
-matcher_match(struct matcher *m, struct scanner *s,
-              unsigned int include_depth,
-              const char *string, size_t len,
-              const char *file_name)
+static const struct rules_bucket *
+rule_set_lookup(const struct rule_set *set, struct sval key, uint32_t hash)
 {
-    enum rules_token tok;
+    if (darray_empty(set->slots))
+        return NULL;
+    const darray_size_t mask = darray_size(set->slots) - 1;
+    for (darray_size_t k = hash & mask; ; k = (k + 1) & mask) {
+        const darray_size_t slot = darray_item(set->slots, k);
+        if (slot == 0)
+            return NULL;
+        const struct rules_bucket * const bucket =
+            &darray_item(set->buckets, slot - 1);
+        if (bucket->hash == hash && svaleq(bucket->key, key))
+            return bucket;
+    }
+}
 
-    if (!m)
-        return false;
+static void
+rule_set_rehash(struct rule_set *set, darray_size_t size)
+{
+    darray_resize0(set->slots, 0);
+    darray_resize0(set->slots, size);
+    const darray_size_t mask = size - 1;
+    for (darray_size_t b = 0; b < darray_size(set->buckets); b++) {
+        darray_size_t k = darray_item(set->buckets, b).hash & mask;
+        while (darray_item(set->slots, k) != 0)
+            k = (k + 1) & mask;
+        darray_item(set->slots, k) = b + 1;
+    }
+}
+
+/** Get the index of the bucket of a key, adding it if necessary */
+static darray_size_t
+rule_set_get_bucket(struct rule_set *set, struct sval key)
+{
+    const uint32_t hash = hash_sval(key);
+    const struct rules_bucket * const bucket = rule_set_lookup(set, key, hash);
+    if (bucket)
+        return (darray_size_t) (bucket - darray_items(set->buckets));
+
+    /* Keep the load factor under 1/2 */
+    const darray_size_t b = darray_size(set->buckets);
+    darray_append(set->buckets, (struct rules_bucket) {
+        .key = key, .hash = hash, .first = 0, .count = 0
+    });
+    if (2 * darray_size(set->buckets) > darray_size(set->slots)) {
+        rule_set_rehash(set, (darray_empty(set->slots))
+                                ? 16
+                                : 2 * darray_size(set->slots));
+    } else {
+        const darray_size_t mask = darray_size(set->slots) - 1;
+        darray_size_t k = hash & mask;
+        while (darray_item(set->slots, k) != 0)
+            k = (k + 1) & mask;
+        darray_item(set->slots, k) = b + 1;
+    }
+    return b;
+}
+
+/**
+ * Index the rules of a rule set by their first MLVO value.
+ *
+ * Groups are expanded if they are defined previously in the same file; the
+ * matcher checks that they are not shadowed by a previous file.
+ */
+static void
+rule_set_build_index(struct rules_file *file, darray_size_t set_item,
+                     struct rule_set *set)
+{
+    struct key_rule { darray_size_t bucket; darray_size_t rule; };
+    darray(struct key_rule) keys = darray_new();
+
+    for (darray_size_t r = 0; r < darray_size(set->rules); r++) {
+        const struct rules_entry * const entry = &darray_item(set->rules, r);
+        const struct rule * const rule = &entry->rule;
+        if (!entry->complete || rule->skip || rule->num_mlvo_values == 0)
+            goto unconditional;
+
+        const struct sval value = rule->mlvo_value_at_pos[0];
+        switch (rule->match_type_at_pos[0]) {
+        case MLVO_MATCH_NORMAL:
+            darray_append(keys, (struct key_rule) {
+                .bucket = rule_set_get_bucket(set, value), .rule = r
+            });
+            continue;
+        case MLVO_MATCH_GROUP: {
+            darray_size_t g;
+            for (g = 0; g < set_item; g++) {
+                const struct rules_item * const item =
+                    &darray_item(file->items, g);
+                if (item->type == RULES_ITEM_GROUP &&
+                    svaleq(item->group.name, value))
+                    break;
+            }
+            if (g >= set_item)
+                goto unconditional;
+            const struct group * const group = &darray_item(file->items, g).group;
+            const struct sval *element;
+            darray_foreach(element, group->elements) {
+                darray_append(keys, (struct key_rule) {
+                    .bucket = rule_set_get_bucket(set, *element), .rule = r
+                });
+            }
+            darray_size_t k;
+            for (k = 0; k < darray_size(set->groups); k++) {
+                if (darray_item(set->groups, k) == group)
+                    break;
+            }
+            if (k >= darray_size(set->groups))
+                darray_append(set->groups, group);
+            continue;
+        }
+        default:
+            break;
+        }
+
+unconditional:
+        darray_append(set->unconditional, r);
+    }
+
+    /* Group the rules by bucket, keeping the file order */
+    struct rules_bucket *bucket;
+    const struct key_rule *key;
+    darray_foreach(key, keys)
+        darray_item(set->buckets, key->bucket).count++;
+    darray_size_t first = 0;
+    darray_foreach(bucket, set->buckets) {
+        bucket->first = first;
+        first += bucket->count;
+        bucket->count = 0;
+    }
+    darray_resize(set->keyed, darray_size(keys));
+    darray_foreach(key, keys) {
+        bucket = &darray_item(set->buckets, key->bucket);
+        darray_item(set->keyed, bucket->first + bucket->count++) = key->rule;
+    }
+    darray_free(keys);
+}
+
+static struct rule_set *
+rules_file_add_rule_set(struct rules_file *file)
+{
+    struct rule_set * const set = calloc(1, sizeof(*set));
+    if (!set)
+        return NULL;
+    mapping_init(&set->mapping);
+    darray_append(file->items, (struct rules_item) {
+        .type = RULES_ITEM_RULE_SET,
+        .rule_set = set
+    });
+    return set;
+}
+
+static void
+rules_file_parse(struct rules_file *file, struct xkb_context *ctx, size_t pos)
+{
+    struct scanner scanner;
+    struct scanner * const s = &scanner;
+    /* Lexer errors are fatal */
+    scanner_init(s, ctx, file->string, file->string_len, file->path,
+                 &file->error);
+    /* Skip the BOM, if any */
+    s->pos = pos;
+
+    union lvalue val;
+    enum rules_token tok;
+    struct rule_set *set = NULL;
+    struct rules_entry *entry = NULL;
 
 initial:
-    switch (tok = gettok(m, s)) {
+    switch (tok = lex(s, &val)) {
     case TOK_BANG:
         goto bang;
     case TOK_END_OF_LINE:
@@ -1711,22 +2022,27 @@ initial:
     }
 
 bang:
-    switch (tok = gettok(m, s)) {
+    switch (tok = lex(s, &val)) {
     case TOK_GROUP_NAME:
-        matcher_group_start_new(m, m->val.string);
+        darray_append(file->items, (struct rules_item) {
+            .type = RULES_ITEM_GROUP,
+            .group = { .name = val.string, .elements = darray_new() }
+        });
         goto group_name;
     case TOK_INCLUDE:
         goto include_statement;
     case TOK_IDENTIFIER:
-        matcher_mapping_start_new(m);
-        matcher_mapping_set_mlvo(m, s, m->val.string);
+        set = rules_file_add_rule_set(file);
+        if (!set)
+            goto error;
+        rule_set_set_mlvo(set, s, val.string);
         goto mapping_mlvo;
     default:
         goto unexpected;
     }
 
 group_name:
-    switch (tok = gettok(m, s)) {
+    switch (tok = lex(s, &val)) {
     case TOK_EQUALS:
         goto group_element;
     default:
@@ -1734,9 +2050,11 @@ group_name:
     }
 
 group_element:
-    switch (tok = gettok(m, s)) {
+    switch (tok = lex(s, &val)) {
     case TOK_IDENTIFIER:
-        matcher_group_add_element(m, s, m->val.string);
+        darray_append(darray_item(file->items,
+                                  darray_size(file->items) - 1).group.elements,
+                      val.string);
         goto group_element;
     case TOK_END_OF_LINE:
         goto initial;
@@ -1745,16 +2063,20 @@ group_element:
     }
 
 include_statement:
-    switch (tok = gettok(m, s)) {
+    switch (tok = lex(s, &val)) {
     case TOK_IDENTIFIER:
-        matcher_include(m, s, include_depth, m->val.string);
+        darray_append(file->items, (struct rules_item) {
+            .type = RULES_ITEM_INCLUDE,
+            .pos = s->token_pos,
+            .include = val.string
+        });
         goto include_statement_end;
     default:
         goto unexpected;
     }
 
 include_statement_end:
-    switch (tok = gettok(m, s)) {
+    switch (tok = lex(s, &val)) {
     case TOK_END_OF_LINE:
         goto initial;
     default:
@@ -1762,10 +2084,10 @@ include_statement_end:
     }
 
 mapping_mlvo:
-    switch (tok = gettok(m, s)) {
+    switch (tok = lex(s, &val)) {
     case TOK_IDENTIFIER:
-        if (m->mapping.active)
-            matcher_mapping_set_mlvo(m, s, m->val.string);
+        if (set->mapping.active)
+            rule_set_set_mlvo(set, s, val.string);
         goto mapping_mlvo;
     case TOK_EQUALS:
         goto mapping_kccgst;
@@ -1774,72 +2096,70 @@ mapping_mlvo:
     }
 
 mapping_kccgst:
-    switch (tok = gettok(m, s)) {
+    switch (tok = lex(s, &val)) {
     case TOK_IDENTIFIER:
-        if (m->mapping.active)
-            matcher_mapping_set_kccgst(m, s, m->val.string);
+        if (set->mapping.active)
+            rule_set_set_kccgst(set, s, val.string);
         goto mapping_kccgst;
     case TOK_END_OF_LINE:
-        if (m->mapping.active && matcher_mapping_verify(m, s)) {
-            matcher_mapping_set_layout_bounds(m);
-            if (m->mapping.has_layout_idx_range) {
-                /* Lazily reset buffers for layout index ranges.
-                 * We’ll reuse the allocations. */
-                darray_size(m->pending_kccgst.buffer) = 0;
-                darray_size(m->pending_kccgst.slices) = 0;
-            }
-        }
+        set->pos = s->token_pos;
+        set->header_complete = true;
         goto rule_mlvo_first;
     default:
         goto unexpected;
     }
 
 rule_mlvo_first:
-    switch (tok = gettok(m, s)) {
+    switch (tok = lex(s, &val)) {
     case TOK_BANG:
-        matcher_append_pending_kccgst(m);
+        set->complete = true;
         goto bang;
     case TOK_END_OF_LINE:
         goto rule_mlvo_first;
     case TOK_END_OF_FILE:
-        matcher_append_pending_kccgst(m);
+        set->complete = true;
         goto finish;
     default:
-        matcher_rule_start_new(m);
+        entry = rule_set_add_rule(set);
         goto rule_mlvo_no_tok;
     }
 
 rule_mlvo:
-    tok = gettok(m, s);
+    tok = lex(s, &val);
 rule_mlvo_no_tok:
     switch (tok) {
     case TOK_IDENTIFIER:
-        if (!m->rule.skip) {
-            if (m->val.string.len == 1 && m->val.string.start[0] == '+')
-                matcher_rule_set_mlvo_wildcard(m, s, MLVO_MATCH_WILDCARD_SOME);
+        if (!entry->rule.skip) {
+            if (val.string.len == 1 && val.string.start[0] == '+')
+                rules_entry_set_mlvo_wildcard(set, entry, s,
+                                              MLVO_MATCH_WILDCARD_SOME);
             else
-                matcher_rule_set_mlvo(m, s, m->val.string);
+                rules_entry_set_mlvo(set, entry, s, val.string);
         }
         goto rule_mlvo;
     case TOK_WILD_CARD_STAR:
-        if (!m->rule.skip)
-            matcher_rule_set_mlvo_wildcard(m, s, MLVO_MATCH_WILDCARD_LEGACY);
+        if (!entry->rule.skip)
+            rules_entry_set_mlvo_wildcard(set, entry, s,
+                                          MLVO_MATCH_WILDCARD_LEGACY);
         goto rule_mlvo;
     case TOK_WILD_CARD_NONE:
-        if (!m->rule.skip)
-            matcher_rule_set_mlvo_wildcard(m, s, MLVO_MATCH_WILDCARD_NONE);
+        if (!entry->rule.skip)
+            rules_entry_set_mlvo_wildcard(set, entry, s,
+                                          MLVO_MATCH_WILDCARD_NONE);
         goto rule_mlvo;
     case TOK_WILD_CARD_SOME:
-        if (!m->rule.skip)
-            matcher_rule_set_mlvo_wildcard(m, s, MLVO_MATCH_WILDCARD_SOME);
+        if (!entry->rule.skip)
+            rules_entry_set_mlvo_wildcard(set, entry, s,
+                                          MLVO_MATCH_WILDCARD_SOME);
         goto rule_mlvo;
     case TOK_WILD_CARD_ANY:
-        if (!m->rule.skip)
-            matcher_rule_set_mlvo_wildcard(m, s, MLVO_MATCH_WILDCARD_ANY);
+        if (!entry->rule.skip)
+            rules_entry_set_mlvo_wildcard(set, entry, s,
+                                          MLVO_MATCH_WILDCARD_ANY);
         goto rule_mlvo;
     case TOK_GROUP_NAME:
-        if (!m->rule.skip)
-            matcher_rule_set_mlvo_group(m, s, m->val.string);
+        if (!entry->rule.skip)
+            rules_entry_set_mlvo_group(set, entry, s, val.string);
         goto rule_mlvo;
     case TOK_EQUALS:
         goto rule_kccgst;
@@ -1848,16 +2168,16 @@ rule_mlvo_no_tok:
     }
 
 rule_kccgst:
-    switch (tok = gettok(m, s)) {
+    switch (tok = lex(s, &val)) {
     case TOK_IDENTIFIER:
-        if (!m->rule.skip)
-            matcher_rule_set_kccgst(m, s, m->val.string);
+        if (!entry->rule.skip)
+            rules_entry_set_kccgst(set, entry, s, val.string);
         goto rule_kccgst;
     case TOK_END_OF_LINE:
-        if (!m->rule.skip)
-            matcher_rule_verify(m, s);
-        if (!m->rule.skip)
-            matcher_rule_apply_if_matches(m, s);
+        entry->pos = s->token_pos;
+        entry->complete = true;
+        if (!entry->rule.skip)
+            rules_entry_verify(set, entry, s);
         goto rule_mlvo_first;
     default:
         goto unexpected;
@@ -1872,35 +2192,152 @@ unexpected:
     }
 
 finish:
-    return true;
+    file->ok = true;
+    goto build_index;
 
 state_error:
-    scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
-                "unexpected token");
+    rules_err(&file->error, s, XKB_ERROR_INVALID_RULES_SYNTAX,
+              "unexpected token");
 error:
-    return false;
+    file->ok = false;
+
+build_index:
+    for (darray_size_t i = 0; i < darray_size(file->items); i++) {
+        const struct rules_item * const item = &darray_item(file->items, i);
+        if (item->type == RULES_ITEM_RULE_SET)
+            rule_set_build_index(file, i, item->rule_set);
+    }
 }
 
-static bool
-read_rules_file(struct xkb_context *ctx,
-                struct matcher *matcher,
-                unsigned int include_depth,
-                FILE *file,
-                const char *path)
+static void
+rule_set_free(struct rule_set *set)
+{
+    struct rules_entry *entry;
+    darray_foreach(entry, set->rules)
+        free(entry->diagnostic.message);
+    darray_free(set->rules);
+    darray_free(set->unconditional);
+    darray_free(set->buckets);
+    darray_free(set->slots);
+    darray_free(set->keyed);
+    darray_free(set->groups);
+    free(set->diagnostic.message);
+    free(set);
+}
+
+static struct rules_file *
+rules_file_ref(struct rules_file *file)
+{
+    assert(file->refcnt > 0);
+    file->refcnt++;
+    return file;
+}
+
+static void
+rules_file_unref(struct rules_file *file)
 {
-    bool ret;
+    assert(!file || file->refcnt > 0);
+    if (!file || --file->refcnt > 0)
+        return;
+
+    struct rules_item *item;
+    darray_foreach(item, file->items) {
+        switch (item->type) {
+        case RULES_ITEM_GROUP:
+            darray_free(item->group.elements);
+            break;
+        case RULES_ITEM_RULE_SET:
+            rule_set_free(item->rule_set);
+            break;
+        default:
+            break;
+        }
+    }
+    darray_free(file->items);
+    free(file->error.message);
+    free(file->string);
+    free(file->path);
+    free(file);
+}
+
+static struct rules_file *
+rules_file_new(struct xkb_context *ctx, const char *path,
+               const char *string, size_t size, size_t pos,
+               const struct stat *st)
+{
+    struct rules_file * const file = calloc(1, sizeof(*file));
+    if (!file)
+        return NULL;
+
+    file->refcnt = 1;
+    file->path = strdup(path);
+    file->string = malloc(size + 1);
+    if (!file->path || !file->string) {
+        rules_file_unref(file);
+        return NULL;
+    }
+    memcpy(file->string, string, size);
+    file->string[size] = '\0';
+    file->string_len = size;
+    if (st)
+        file_stamp_from_stat(&file->stamp, st);
+
+    rules_file_parse(file, ctx, pos);
+    return file;
+}
+
+static void
+rules_index_free(struct xkb_rules_index *index)
+{
+    struct rules_file **file;
+    darray_foreach(file, index->files)
+        rules_file_unref(*file);
+    darray_free(index->files);
+    free(index);
+}
+
+/**
+ * Get the parsed rules file, using the index of the context if the file was
+ * not modified since it was parsed.
+ */
+static struct rules_file *
+rules_index_get_file(struct xkb_context *ctx, FILE *file, const char *path)
+{
+    struct stat st;
+    const bool has_stat = (fstat(fileno(file), &st) == 0);
+    if (has_stat && !ctx->rules_index) {
+        ctx->rules_index = calloc(1, sizeof(*ctx->rules_index));
+        ctx->rules_index_free = rules_index_free;
+    }
+    struct xkb_rules_index * const index = (has_stat) ? ctx->rules_index : NULL;
+
+    struct file_stamp stamp;
+    if (has_stat)
+        file_stamp_from_stat(&stamp, &st);
+
+    darray_size_t idx = 0;
+    if (index) {
+        for (; idx < darray_size(index->files); idx++) {
+            struct rules_file * const rules = darray_item(index->files, idx);
+            if (!streq(rules->path, path))
+                continue;
+            if (file_stamp_eq(&rules->stamp, &stamp))
+                return rules_file_ref(rules);
+            break;
+        }
+    }
+
     char *string;
     size_t size;
-    struct scanner scanner;
-
     if (!map_file(file, &string, &size)) {
         log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
                 "Couldn't read rules file \"%s\": %s\n",
                 path, strerror(errno));
-        return false;
+        return NULL;
     }
 
-    scanner_init(&scanner, matcher->ctx, string, size, path, NULL);
+    struct scanner scanner;
+    scanner_init(&scanner, ctx, string, size, path, NULL);
 
     /* Basic detection of wrong character encoding.
        The first character relevant to the grammar must be ASCII:
@@ -1913,12 +2350,206 @@ read_rules_file(struct xkb_context *ctx,
                     "E.g. ISO/CEI 8859 and UTF-8 are supported "
                     "but UTF-16, UTF-32 and CP1026 are not.");
         unmap_file(string, size);
-        return false;
+        return NULL;
     }
 
-    ret = matcher_match(matcher, &scanner, include_depth, string, size, path);
+    struct rules_file * const rules =
+        rules_file_new(ctx, path, string, size, scanner.pos,
+                       (has_stat) ? &st : NULL);
     unmap_file(string, size);
-    return ret;
+    if (!rules || !index)
+        return rules;
+
+    if (idx < darray_size(index->files)) {
+        /* Outdated: matchers may still use it */
+        rules_file_unref(darray_item(index->files, idx));
+        darray_item(index->files, idx) = rules_file_ref(rules);
+    } else {
+        darray_append(index->files, rules_file_ref(rules));
+    }
+    return rules;
+}
+
+/***====================================================================***/
+
+/* Matching */
+
+static int
+compare_rule_index(const void *a, const void *b)
+{
+    const darray_size_t x = *(const darray_size_t *) a;
+    const darray_size_t y = *(const darray_size_t *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Gather the rules of a rule set that may match, in file order.
+ * Returns false if the index cannot be used.
+ */
+static bool
+matcher_get_candidates(struct matcher *m, const struct rule_set *set)
+{
+    /* Check that the expanded groups are not shadowed */
+    const struct group * const *group;
+    darray_foreach(group, set->groups) {
+        if (matcher_find_group(m, (*group)->name) != *group)
+            return false;
+    }
+
+    darray_size(m->candidates) = 0;
+    darray_concat(m->candidates, set->unconditional);
+
+    const struct matched_sval *values;
+    darray_size_t count;
+    const enum rules_mlvo mlvo = set->mapping.mlvo_at_pos[0];
+    switch (mlvo) {
+    case MLVO_MODEL:
+        values = &m->rmlvo.model;
+        count = 1;
+        break;
+    case MLVO_LAYOUT:
+        values = darray_items(m->rmlvo.layouts);
+        count = darray_size(m->rmlvo.layouts);
+        break;
+    case MLVO_VARIANT:
+        values = darray_items(m->rmlvo.variants);
+        count = darray_size(m->rmlvo.variants);
+        break;
+    default:
+        assert(mlvo == MLVO_OPTION);
+        values = darray_items(m->rmlvo.options);
+        count = darray_size(m->rmlvo.options);
+    }
+
+    unsigned int sources = !darray_empty(set->unconditional);
+    for (darray_size_t k = 0; k < count; k++) {
+        const struct sval value = values[k].sval;
+        if (value.len == 0)
+            continue;
+        const struct rules_bucket * const bucket =
+            rule_set_lookup(set, value, hash_sval(value));
+        if (!bucket)
+            continue;
+        darray_append_items(m->candidates,
+                            &darray_item(set->keyed, bucket->first),
+                            bucket->count);
+        sources++;
+    }
+
+    if (sources > 1) {
+        /* Restore the file order and remove duplicates */
+        qsort(darray_items(m->candidates), darray_size(m->candidates),
+              sizeof(darray_item(m->candidates, 0)), compare_rule_index);
+        darray_size_t n = 0;
+        for (darray_size_t k = 0; k < darray_size(m->candidates); k++) {
+            if (n == 0 || darray_item(m->candidates, n - 1) !=
+                          darray_item(m->candidates, k))
+                darray_item(m->candidates, n++) = darray_item(m->candidates, k);
+        }
+        darray_size(m->candidates) = n;
+    }
+    return true;
+}
+
+static void
+matcher_rule_apply(struct matcher *m, struct scanner *s,
+                   const struct rules_entry *entry)
+{
+    if (entry->rule.skip) {
+        rules_diagnostic_log(s, &entry->diagnostic);
+    } else if (entry->complete) {
+        s->token_pos = entry->pos;
+        matcher_rule_apply_if_matches(m, s, &entry->rule);
+    }
+}
+
+static void
+matcher_rule_set_apply(struct matcher *m, struct scanner *s,
+                       const struct rule_set *set)
+{
+    m->mapping = set->mapping;
+    rules_diagnostic_log(s, &set->diagnostic);
+    if (!set->header_complete)
+        return;
+
+    s->token_pos = set->pos;
+    if (m->mapping.active && matcher_mapping_verify(m, s)) {
+        matcher_mapping_set_layout_bounds(m);
+        if (m->mapping.has_layout_idx_range) {
+            /* Lazily reset buffers for layout index ranges.
+             * We’ll reuse the allocations. */
+            darray_size(m->pending_kccgst.buffer) = 0;
+            darray_size(m->pending_kccgst.slices) = 0;
+        }
+
+        /*
+         * Rules are skipped once the mapping is inactive, i.e. when there is
+         * no more layout to match.
+         */
+        if (matcher_get_candidates(m, set)) {
+            const darray_size_t *r;
+            darray_foreach(r, m->candidates) {
+                if (!m->mapping.active)
+                    break;
+                matcher_rule_apply(m, s, &darray_item(set->rules, *r));
+            }
+        } else {
+            const struct rules_entry *entry;
+            darray_foreach(entry, set->rules) {
+                if (!m->mapping.active)
+                    break;
+                matcher_rule_apply(m, s, entry);
+            }
+        }
+    }
+
+    if (set->complete)
+        matcher_append_pending_kccgst(m);
+}
+
+static bool
+matcher_match(struct matcher *m, struct rules_file *file,
+              unsigned int include_depth)
+{
+    struct scanner s;
+    scanner_init(&s, m->ctx, file->string, file->string_len, file->path, NULL);
+
+    const struct rules_item *item;
+    darray_foreach(item, file->items) {
+        switch (item->type) {
+        case RULES_ITEM_GROUP:
+            darray_append(m->groups, &item->group);
+            break;
+        case RULES_ITEM_INCLUDE:
+            s.token_pos = item->pos;
+            matcher_include(m, &s, include_depth, item->include);
+            break;
+        default:
+            assert(item->type == RULES_ITEM_RULE_SET);
+            matcher_rule_set_apply(m, &s, item->rule_set);
+        }
+    }
+
+    if (!file->ok) {
+        rules_diagnostic_log(&s, &file->error);
+        return false;
+    }
+    return true;
+}
+
+static bool
+read_rules_file(struct xkb_context *ctx,
+                struct matcher *matcher,
+                unsigned int include_depth,
+                FILE *file,
+                const char *path)
+{
+    struct rules_file * const rules = rules_index_get_file(ctx, file, path);
+    if (!rules)
+        return false;
+    /* Keep it alive as long as its groups may be used */
+    darray_append(matcher->files, rules);
+    return matcher_match(matcher, rules, include_depth);
 }
 
 /**
@@ -11,6 +11,9 @@
 #include "xkbcomp-priv.h"
 #include "rmlvo.h"
 
+/* Index of the parsed rules files of a context */
+struct xkb_rules_index;
+
 XKB_EXPORT_PRIVATE bool
 xkb_components_from_rmlvo_builder(const struct xkb_rmlvo_builder *rmlvo,
                                   struct xkb_component_names *out,
@@ -16,6 +16,7 @@
 
 #include <limits.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "xkbcommon/xkbcommon.h"
@@ -247,6 +248,8 @@ typedef struct {
     xkb_layout_index_t explicit_group;
     xkb_layout_index_t max_groups;
     darray(KeyInfo) keys;
+    /** key name -> index in `keys` + 1, or 0 if there is no such key */
+    darray(darray_size_t) key_index;
     KeyInfo default_key;
     ActionsInfo default_actions;
     darray(xkb_atom_t) group_names;
@@ -277,10 +280,10 @@ static void
 ClearSymbolsInfo(SymbolsInfo *info)
 {
     KeyInfo *keyi;
-    free(info->name);
     darray_foreach(keyi, info->keys)
         ClearKeyInfo(keyi);
     darray_free(info->keys);
+    darray_free(info->key_index);
     darray_free(info->group_names);
     darray_free(info->modmaps);
     ClearKeyInfo(&info->default_key);
@@ -914,17 +917,23 @@ AddKeySymbols(SymbolsInfo *info, KeyInfo *keyi, bool same_file)
     /*
      * Don't keep aliases in the keys array; this guarantees that
      * searching for keys to merge with by straight comparison (see the
-     * following loop) is enough, and we won't get multiple KeyInfo's
+     * following lookup) is enough, and we won't get multiple KeyInfo's
      * for the same key because of aliases.
      */
     keyi->name = XkbResolveKeyAlias(&info->keymap_info->keymap, keyi->name);
 
-    KeyInfo *iter;
-    darray_foreach(iter, info->keys)
-        if (iter->name == keyi->name)
-            return MergeKeys(info, iter, keyi, same_file);
+    if (keyi->name < darray_size(info->key_index)) {
+        const darray_size_t index = darray_item(info->key_index, keyi->name);
+        if (index > 0) {
+            return MergeKeys(info, &darray_item(info->keys, index - 1),
+                             keyi, same_file);
+        }
+    } else {
+        darray_resize0(info->key_index, keyi->name + 1);
+    }
 
     darray_append(info->keys, *keyi);
+    darray_item(info->key_index, keyi->name) = darray_size(info->keys);
     InitKeyInfo(info->ctx, keyi);
     return true;
 }
@@ -1010,6 +1019,9 @@ MergeIncludedSymbols(SymbolsInfo *into, SymbolsInfo *from,
     if (darray_empty(into->keys)) {
         into->keys = from->keys;
         darray_init(from->keys);
+        darray_free(into->key_index);
+        into->key_index = from->key_index;
+        darray_init(from->key_index);
     }
     else {
         KeyInfo *keyi;
@@ -1049,7 +1061,7 @@ HandleIncludeSymbols(SymbolsInfo *info, IncludeStmt *include)
 
     InitSymbolsInfo(&included, info->keymap_info, info->include_depth + 1,
                     &info->mods);
-    included.name = steal(&include->stmt);
+    included.name = arena_strdup(info->keymap_info->arena, include->stmt);
 
     for (IncludeStmt *stmt = include; stmt; stmt = stmt->next_incl) {
         SymbolsInfo next_incl;
@@ -1236,8 +1248,13 @@ AddSymbolsToKey(SymbolsInfo *info, KeyInfo *keyi, ExprDef *arrayNdx,
             assert(leveli->s.sym != XKB_KEY_NoSymbol);
             break;
         default:
-            darray_shrink(keysymList->syms);
-            darray_steal(keysymList->syms, &leveli->s.syms, NULL);
+            /* The list is allocated in the arena of the AST */
+            leveli->s.syms = memdup(keysymList->syms.item, leveli->num_syms,
+                                    sizeof(*leveli->s.syms));
+            if (!leveli->s.syms) {
+                leveli->num_syms = 0;
+                return false;
+            }
 #ifndef NDEBUG
             /* Canonical list: all NoSymbol were dropped */
             for (xkb_keysym_count_t k = 0; k < leveli->num_syms; k++)
@@ -1701,17 +1718,21 @@ SetSymbolsField(SymbolsInfo *info, KeyInfo *keyi, const char *field,
 
         if (pending) {
             keyi->out_of_range_pending_group = true;
+            /* The expression is evaluated after the AST is released */
+            ExprDef * const expr =
+                ExprDup(info->keymap_info->arena, *value_ptr);
+            if (!expr)
+                return false;
             const darray_size_t pending_index =
                 darray_size(*info->keymap_info->pending_computations);
             darray_append(
                 *info->keymap_info->pending_computations,
                 (struct pending_computation) {
-                    .expr = *value_ptr,
+                    .expr = expr,
                     .computed = false,
                     .value = 0,
                 }
             );
-            *value_ptr = NULL;
             static_assert(sizeof(keyi->out_of_range_group_number) ==
                           sizeof(pending_index),
                           "Cannot save pending computation");
@@ -2034,8 +2055,7 @@ HandleSymbolsFile(SymbolsInfo *info, XkbFile *file)
 {
     bool ok;
 
-    free(info->name);
-    info->name = strdup_safe(file->name);
+    info->name = arena_strdup(info->keymap_info->arena, file->name);
 
     for (ParseCommon *stmt = file->defs; stmt; stmt = stmt->next) {
         switch (stmt->type) {
@@ -2083,19 +2103,79 @@ HandleSymbolsFile(SymbolsInfo *info, XkbFile *file)
     }
 }
 
+/** Keysym of a modifier map entry and the key it resolves to */
+struct modmap_key {
+    xkb_keysym_t sym;
+    struct xkb_key *key;
+};
+
+typedef darray(struct modmap_key) modmap_keys;
+
+static int
+cmp_modmap_keys(const void *a, const void *b)
+{
+    const xkb_keysym_t sa = ((const struct modmap_key *) a)->sym;
+    const xkb_keysym_t sb = ((const struct modmap_key *) b)->sym;
+    return (sa > sb) - (sa < sb);
+}
+
+static struct modmap_key *
+FindModMapKey(const modmap_keys *index, xkb_keysym_t sym)
+{
+    /* Binary search */
+    darray_size_t lower = 0;
+    darray_size_t upper = darray_size(*index);
+    while (lower < upper) {
+        const darray_size_t mid = lower + (upper - lower) / 2;
+        if (darray_item(*index, mid).sym < sym)
+            lower = mid + 1;
+        else
+            upper = mid;
+    }
+    if (lower < darray_size(*index) && darray_item(*index, lower).sym == sym)
+        return &darray_item(*index, lower);
+    return NULL;
+}
+
 /**
- * Given a keysym @sym, return a key which generates it, or NULL.
- * This is used for example in a modifier map definition, such as:
+ * Resolve the keysyms of the modifier map entries to keys, e.g.:
  *      modifier_map Lock           { Caps_Lock };
  * where we want to add the Lock modifier to the modmap of the key
  * which matches the keysym Caps_Lock.
  * Since there can be many keys which generates the keysym, the key
  * is chosen first by lowest group in which the keysym appears, than
  * by lowest level and than by lowest key code.
+ *
+ * The keymap is swept only once for all the entries, stopping as soon as
+ * every keysym is resolved.
  */
-static struct xkb_key *
-FindKeyForSymbol(struct xkb_keymap *keymap, xkb_keysym_t sym)
+static void
+InitModMapKeys(struct xkb_keymap *keymap, const SymbolsInfo *info,
+               modmap_keys *index)
 {
+    darray_init(*index);
+
+    const ModMapEntry *mm;
+    darray_foreach(mm, info->modmaps) {
+        if (mm->haveSymbol) {
+            const struct modmap_key entry = { .sym = mm->u.keySym, .key = NULL };
+            darray_append(*index, entry);
+        }
+    }
+    if (darray_empty(*index))
+        return;
+
+    /* Sort and remove duplicates */
+    qsort(darray_items(*index), darray_size(*index),
+          sizeof(*darray_items(*index)), cmp_modmap_keys);
+    darray_size_t count = 1;
+    for (darray_size_t k = 1; k < darray_size(*index); k++) {
+        if (darray_item(*index, k).sym != darray_item(*index, count - 1).sym)
+            darray_item(*index, count++) = darray_item(*index, k);
+    }
+    darray_resize(*index, count);
+
+    darray_size_t unresolved = count;
     bool got_one_group;
     xkb_layout_index_t group = 0;
     do {
@@ -2106,19 +2186,22 @@ FindKeyForSymbol(struct xkb_keymap *keymap, xkb_keysym_t sym)
             got_one_level = false;
             struct xkb_key *key;
             xkb_keys_foreach(key, keymap) {
-                if (group < key->num_groups &&
-                    level < XkbKeyNumLevels(key, group)) {
-                    got_one_group = got_one_level = true;
-                    const xkb_keysym_count_t num_syms =
-                        key->groups[group].levels[level].num_syms;
-                    if (num_syms > 1) {
-                        for (xkb_keysym_count_t k = 0; k < num_syms; k++) {
-                            if (key->groups[group].levels[level].s.syms[k] == sym)
-                                return key;
-                        }
-                    } else if (num_syms &&
-                               key->groups[group].levels[level].s.sym == sym) {
-                        return key;
+                if (group >= key->num_groups ||
+                    level >= XkbKeyNumLevels(key, group))
+                    continue;
+                got_one_group = got_one_level = true;
+                const struct xkb_level * const leveli =
+                    &key->groups[group].levels[level];
+                const xkb_keysym_t * const syms = (leveli->num_syms > 1)
+                    ? leveli->s.syms
+                    : &leveli->s.sym;
+                for (xkb_keysym_count_t k = 0; k < leveli->num_syms; k++) {
+                    struct modmap_key * const entry =
+                        FindModMapKey(index, syms[k]);
+                    if (entry && !entry->key) {
+                        entry->key = key;
+                        if (--unresolved == 0)
+                            return;
                     }
                 }
             }
@@ -2126,8 +2209,6 @@ FindKeyForSymbol(struct xkb_keymap *keymap, xkb_keysym_t sym)
         } while (got_one_level);
         group++;
     } while (got_one_group);
-
-    return NULL;
 }
 
 /*
@@ -2463,7 +2544,7 @@ key_fields:
 
 static bool
 CopyModMapDefToKeymap(struct xkb_keymap *keymap, SymbolsInfo *info,
-                      ModMapEntry *entry)
+                      const modmap_keys *index, ModMapEntry *entry)
 {
     struct xkb_key *key;
 
@@ -2480,7 +2561,9 @@ CopyModMapDefToKeymap(struct xkb_keymap *keymap, SymbolsInfo *info,
         }
     }
     else {
-        key = FindKeyForSymbol(keymap, entry->u.keySym);
+        const struct modmap_key * const found =
+            FindModMapKey(index, entry->u.keySym);
+        key = (found ? found->key : NULL);
         if (!key) {
             log_vrb(info->ctx, XKB_LOG_VERBOSITY_DETAILED,
                     XKB_WARNING_UNRESOLVED_KEYMAP_SYMBOL,
@@ -2533,9 +2616,12 @@ CopySymbolsToKeymap(struct xkb_keymap *keymap, SymbolsInfo *info)
         }
     }
 
+    modmap_keys index;
+    InitModMapKeys(keymap, info, &index);
     darray_foreach(mm, info->modmaps)
-        if (!CopyModMapDefToKeymap(keymap, info, mm))
+        if (!CopyModMapDefToKeymap(keymap, info, &index, mm))
             info->errorCount++;
+    darray_free(index);
 
     /* XXX: If we don't ignore errorCount, things break. */
     return true;
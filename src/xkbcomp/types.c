@@ -107,7 +107,6 @@ ClearKeyTypeInfo(KeyTypeInfo *type)
 static void
 ClearKeyTypesInfo(KeyTypesInfo *info)
 {
-    free(info->name);
     KeyTypeInfo *type;
     darray_foreach(type, info->types)
         ClearKeyTypeInfo(type);
@@ -215,7 +214,7 @@ HandleIncludeKeyTypes(KeyTypesInfo *info, IncludeStmt *include)
 
     InitKeyTypesInfo(&included, info->keymap_info, info->include_depth + 1,
                      &info->mods);
-    included.name = steal(&include->stmt);
+    included.name = arena_strdup(info->keymap_info->arena, include->stmt);
 
     for (IncludeStmt *stmt = include; stmt; stmt = stmt->next_incl) {
         KeyTypesInfo next_incl;
@@ -694,8 +693,7 @@ HandleKeyTypesFile(KeyTypesInfo *info, XkbFile *file)
 {
     bool ok;
 
-    free(info->name);
-    info->name = strdup_safe(file->name);
+    info->name = arena_strdup(info->keymap_info->arena, file->name);
 
     for (ParseCommon *stmt = file->defs; stmt; stmt = stmt->next) {
         switch (stmt->type) {
@@ -96,9 +96,12 @@ struct xkb_keymap_info {
 
     /** Pending computations */
     pending_computation_array *pending_computations;
+
+    /** Scratch memory of the compilation, released at once at the end */
+    struct arena *arena;
 };
 
-char *
+XKB_EXPORT_PRIVATE char *
 text_v1_keymap_get_as_string(struct xkb_keymap *keymap,
                              enum xkb_keymap_format format,
                              enum xkb_keymap_serialize_flags flags);
@@ -123,6 +126,14 @@ XkbParseStringNext(struct xkb_context *ctx, struct scanner *scanner,
 void
 FreeXkbFile(XkbFile *file);
 
+/** Deep copy of a parsed file, e.g. to reuse a cached AST */
+XkbFile *
+XkbFileDup(const XkbFile *file);
+
+/** Deep copy of an expression, without its successors */
+ExprDef *
+ExprDup(struct arena *arena, const ExprDef *expr);
+
 XkbFile *
 XkbFileFromComponents(struct xkb_context *ctx,
                       const struct xkb_component_names *kkctgs);
@@ -319,6 +319,24 @@ test_makedir(const char *parent, const char *path)
     return dirname;
 }
 
+bool
+test_set_mtime(const char *path, int64_t sec, long nsec)
+{
+#if defined(_WIN32) || \
+    !(HAVE_STRUCT_STAT_ST_MTIM || HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    (void) path;
+    (void) sec;
+    (void) nsec;
+    return false;
+#else
+    const struct timespec times[2] = {
+        { .tv_sec = 0, .tv_nsec = UTIME_OMIT },
+        { .tv_sec = (time_t) sec, .tv_nsec = nsec },
+    };
+    return utimensat(AT_FDCWD, path, times, 0) == 0;
+#endif
+}
+
 char *
 test_maketempdir(const char *template)
 {
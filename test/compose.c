@@ -11,6 +11,10 @@
 #include <errno.h>
 #include <locale.h>
 #include <stdio.h>
+#if HAVE_MKOSTEMP
+#include <dirent.h>
+#include <unistd.h>
+#endif
 
 #include "xkbcommon/xkbcommon-compose.h"
 #include "xkbcommon/xkbcommon-keysyms.h"
@@ -1118,6 +1122,119 @@ test_roundtrip(struct xkb_context *ctx)
 #endif
 }
 
+#if HAVE_MKOSTEMP
+/* Get the path of the single file in the cache directory, if any */
+static char *
+get_compose_cache_file(const char *dir)
+{
+    char *path = NULL;
+    DIR * const d = opendir(dir);
+    assert(d);
+    struct dirent *entry;
+    while ((entry = readdir(d))) {
+        if (entry->d_name[0] == '.')
+            continue;
+        assert(!path);
+        path = asprintf_safe("%s/%s", dir, entry->d_name);
+    }
+    closedir(d);
+    return path;
+}
+
+static struct xkb_compose_table *
+compose_cache_roundtrip(struct xkb_context *ctx,
+                        const struct xkb_compose_table *ref_table)
+{
+    struct xkb_compose_table * const table =
+        xkb_compose_table_new_from_locale(ctx, "en_US.UTF-8",
+                                          XKB_COMPOSE_COMPILE_NO_FLAGS);
+    assert(table);
+    if (ref_table) {
+        struct xkb_compose_table_iterator * const iter =
+            xkb_compose_table_iterator_new(table);
+        xkb_compose_table_for_each((struct xkb_compose_table *) ref_table,
+                                   compose_traverse_fn, iter);
+        assert(xkb_compose_table_iterator_next(iter) == NULL);
+        xkb_compose_table_iterator_free(iter);
+    }
+    return table;
+}
+#endif
+
+static void
+test_cache(struct xkb_context *ctx)
+{
+#if HAVE_MKOSTEMP
+    char * const tmpdir = test_maketempdir("xkbcommon-compose-cache.XXXXXX");
+    char * const cache_dir = asprintf_safe("%s/cache", tmpdir);
+    char * const compose_path = asprintf_safe("%s/Compose", tmpdir);
+    char * const include_path = test_get_path("locale/en_US.UTF-8/Compose");
+    assert(cache_dir && compose_path && include_path);
+
+    FILE *file = fopen(compose_path, "wb");
+    assert(file);
+    fprintf(file, "include \"%s\"\n", include_path);
+    fclose(file);
+
+    setenv("XCOMPOSEFILE", compose_path, 1);
+    setenv("XKB_COMPOSE_CACHE_DIR", cache_dir, 1);
+
+    /* Cache miss: compile and create the cache directory and file */
+    struct xkb_compose_table * const ref_table =
+        compose_cache_roundtrip(ctx, NULL);
+    char * const cache_path = get_compose_cache_file(cache_dir);
+    assert(cache_path);
+
+    /* Cache hit */
+    struct xkb_compose_table *table = compose_cache_roundtrip(ctx, ref_table);
+    assert(test_compose_seq(table,
+        XKB_KEY_dead_tilde,     XKB_COMPOSE_FEED_ACCEPTED,  XKB_COMPOSE_COMPOSING,  "",     XKB_KEY_NoSymbol,
+        XKB_KEY_space,          XKB_COMPOSE_FEED_ACCEPTED,  XKB_COMPOSE_COMPOSED,   "~",    XKB_KEY_asciitilde,
+        XKB_KEY_NoSymbol));
+    xkb_compose_table_unref(table);
+
+    /* Invalid cache file: fallback to compilation */
+    file = fopen(cache_path, "wb");
+    assert(file);
+    fprintf(file, "XKBCMPS garbage");
+    fclose(file);
+    table = compose_cache_roundtrip(ctx, ref_table);
+    xkb_compose_table_unref(table);
+    table = compose_cache_roundtrip(ctx, ref_table);
+    xkb_compose_table_unref(table);
+
+    /* Outdated cache: the Compose file changed */
+    file = fopen(compose_path, "ab");
+    assert(file);
+    fprintf(file, "<dead_tilde> <dead_tilde> : \"bar\" Y\n");
+    fclose(file);
+    for (int k = 0; k < 2; k++) {
+        table = compose_cache_roundtrip(ctx, NULL);
+        assert(test_compose_seq(table,
+            XKB_KEY_dead_tilde, XKB_COMPOSE_FEED_ACCEPTED,  XKB_COMPOSE_COMPOSING,  "",     XKB_KEY_NoSymbol,
+            XKB_KEY_dead_tilde, XKB_COMPOSE_FEED_ACCEPTED,  XKB_COMPOSE_COMPOSED,   "bar",  XKB_KEY_Y,
+            XKB_KEY_NoSymbol));
+        xkb_compose_table_unref(table);
+    }
+
+    unsetenv("XCOMPOSEFILE");
+    unsetenv("XKB_COMPOSE_CACHE_DIR");
+
+    xkb_compose_table_unref(ref_table);
+    unlink(cache_path);
+    rmdir(cache_dir);
+    unlink(compose_path);
+    rmdir(tmpdir);
+    free(cache_path);
+    free(include_path);
+    free(compose_path);
+    free(cache_dir);
+    free(tmpdir);
+#else
+    (void) ctx;
+#endif
+}
+
 /* CLI positional arguments:
  * 1. Seed for the pseudo-random generator:
  *    - Leave it unset or set it to “-” to use current time.
@@ -1189,6 +1306,7 @@ main(int argc, char *argv[])
     test_decode_escape_sequences(ctx);
     test_encode_escape_sequences(ctx);
     test_roundtrip(ctx);
+    test_cache(ctx);
 
     xkb_context_unref(ctx);
     return EXIT_SUCCESS;
@@ -0,0 +1,336 @@
+/*
+ * Copyright © 2026 Pierre Le Marre <dev@wismill.eu>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+#include "test-config.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "xkbcommon/xkbcommon.h"
+
+#include "evdev-scancodes.h"
+#include "keymap-compare.h"
+#include "test.h"
+#include "utils.h"
+
+/* Remove all the files of a directory and the directory itself */
+static void
+remove_dir(const char *path)
+{
+    DIR * const dir = opendir(path);
+    if (!dir)
+        return;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (streq(entry->d_name, ".") || streq(entry->d_name, ".."))
+            continue;
+        char * const file = asprintf_safe("%s/%s", path, entry->d_name);
+        assert(file);
+        if (unlink(file) != 0)
+            remove_dir(file);
+        free(file);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+static unsigned int
+count_files(const char *path)
+{
+    unsigned int count = 0;
+    DIR * const dir = opendir(path);
+    if (!dir)
+        return 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] != '.')
+            count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+/** Count the cache hits, reported in the debug log */
+ATTR_PRINTF(3, 0) static void
+log_fn(struct xkb_context *ctx, enum xkb_log_level level,
+       const char *fmt, va_list args)
+{
+    unsigned int * const hits = xkb_context_get_user_data(ctx);
+    char *s = NULL;
+    const int size = vasprintf(&s, fmt, args);
+    assert(size != -1);
+    if (strstr(s, "Loaded keymap from cache"))
+        (*hits)++;
+    free(s);
+}
+
+static struct xkb_context *
+get_context(unsigned int *hits)
+{
+    struct xkb_context * const ctx = test_get_context(CONTEXT_NO_FLAG);
+    assert(ctx);
+    xkb_context_set_user_data(ctx, hits);
+    xkb_context_set_log_fn(ctx, log_fn);
+    xkb_context_set_log_level(ctx, XKB_LOG_LEVEL_DEBUG);
+    return ctx;
+}
+
+/** Check that 2 keymaps are identical, including their serialization */
+static void
+assert_same_keymaps(struct xkb_context *ctx, struct xkb_keymap *keymap1,
+                    struct xkb_keymap *keymap2,
+                    enum xkb_keymap_format format)
+{
+    assert(xkb_keymap_compare(ctx, keymap1, keymap2, XKB_KEYMAP_CMP_ALL));
+
+    static const enum xkb_keymap_serialize_flags flags =
+        XKB_KEYMAP_SERIALIZE_KEEP_UNUSED | XKB_KEYMAP_SERIALIZE_EXPLICIT;
+    char * const string1 = xkb_keymap_get_as_string2(keymap1, format, flags);
+    char * const string2 = xkb_keymap_get_as_string2(keymap2, format, flags);
+    assert(string1 && string2);
+    assert(streq(string1, string2));
+    free(string1);
+    free(string2);
+}
+
+static void
+test_cache_hit(const char *cache_dir)
+{
+    unsigned int hits = 0;
+    struct xkb_context * const ctx = get_context(&hits);
+
+    static const struct {
+        enum xkb_keymap_format format;
+        struct xkb_rule_names rmlvo;
+    } tests[] = {
+        {
+            .format = XKB_KEYMAP_FORMAT_TEXT_V1,
+            .rmlvo = { "evdev", "pc105", "us", "", "" },
+        },
+        {
+            .format = XKB_KEYMAP_FORMAT_TEXT_V2,
+            .rmlvo = { "evdev", "pc105", "us", "", "" },
+        },
+        {
+            .format = XKB_KEYMAP_FORMAT_TEXT_V2,
+            .rmlvo = { "evdev", "pc104", "us,de,ru", ",neo,",
+                       "grp:alt_shift_toggle,ctrl:nocaps,lv3:ralt_switch" },
+        },
+        {
+            .format = XKB_KEYMAP_FORMAT_TEXT_V1,
+            .rmlvo = { "evdev", "pc105", "ch,ca,cz", "fr,multix,",
+                       "grp:menu_toggle,compose:ralt" },
+        },
+    };
+
+    for (size_t t = 0; t < ARRAY_SIZE(tests); t++) {
+        fprintf(stderr, "------\n*** %s: #%zu ***\n", __func__, t);
+
+        /* Reference: no cache */
+        assert(xkb_context_set_keymap_cache_dir(ctx, NULL));
+        struct xkb_keymap * const ref = xkb_keymap_new_from_names2(
+            ctx, &tests[t].rmlvo, tests[t].format, XKB_KEYMAP_COMPILE_NO_FLAGS
+        );
+        assert(ref);
+
+        assert(xkb_context_set_keymap_cache_dir(ctx, cache_dir));
+        const unsigned int count = count_files(cache_dir);
+
+        /* Cache miss */
+        struct xkb_keymap *keymap = xkb_keymap_new_from_names2(
+            ctx, &tests[t].rmlvo, tests[t].format, XKB_KEYMAP_COMPILE_NO_FLAGS
+        );
+        assert(keymap);
+        assert_same_keymaps(ctx, ref, keymap, tests[t].format);
+        xkb_keymap_unref(keymap);
+        assert(count_files(cache_dir) == count + 1);
+        assert(hits == 0);
+
+        /* Cache hit */
+        keymap = xkb_keymap_new_from_names2(
+            ctx, &tests[t].rmlvo, tests[t].format, XKB_KEYMAP_COMPILE_NO_FLAGS
+        );
+        assert(keymap);
+        assert_same_keymaps(ctx, ref, keymap, tests[t].format);
+        assert(count_files(cache_dir) == count + 1);
+        assert(hits == 1);
+        hits = 0;
+
+        /* The keymap must be usable */
+        struct xkb_state * const state = xkb_state_new(keymap);
+        assert(state);
+        xkb_state_update_key(state, KEY_LEFTSHIFT + EVDEV_OFFSET, XKB_KEY_DOWN);
+        assert(xkb_state_key_get_one_sym(state, KEY_Q + EVDEV_OFFSET) != 0);
+        xkb_state_unref(state);
+
+        xkb_keymap_unref(keymap);
+        xkb_keymap_unref(ref);
+    }
+
+    xkb_context_unref(ctx);
+}
+
+static xkb_keysym_t
+get_sym(struct xkb_keymap *keymap, xkb_keycode_t kc)
+{
+    const xkb_keysym_t *syms;
+    const int count = xkb_keymap_key_get_syms_by_level(keymap, kc, 0, 0, &syms);
+    return (count == 1) ? syms[0] : XKB_KEY_NoSymbol;
+}
+
+static void
+write_file(const char *path, const char *content)
+{
+    FILE * const file = fopen(path, "wb");
+    assert(file);
+    fputs(content, file);
+    fclose(file);
+}
+
+static void
+test_cache_invalidation(const char *tmpdir, const char *cache_dir)
+{
+    unsigned int hits = 0;
+    struct xkb_context * const ctx = get_context(&hits);
+
+    /* Custom include path with higher priority than the test data */
+    char * const include_dir = test_makedir(tmpdir, "xkb");
+    char * const symbols_dir = test_makedir(include_dir, "symbols");
+    char * const symbols_path = asprintf_safe("%s/us", symbols_dir);
+    assert(symbols_path);
+    xkb_context_include_path_clear(ctx);
+    assert(xkb_context_include_path_append(ctx, include_dir));
+    char * const data_path = test_get_path("");
+    assert(xkb_context_include_path_append(ctx, data_path));
+    free(data_path);
+
+    assert(xkb_context_set_keymap_cache_dir(ctx, cache_dir));
+    const struct xkb_rule_names rmlvo = { "evdev", "pc105", "us", "", "" };
+    const xkb_keycode_t kc = KEY_A + EVDEV_OFFSET;
+
+    /* Cache miss, then hit */
+    for (int k = 0; k < 2; k++) {
+        struct xkb_keymap * const keymap = xkb_keymap_new_from_names(
+            ctx, &rmlvo, XKB_KEYMAP_COMPILE_NO_FLAGS
+        );
+        assert(keymap);
+        assert(get_sym(keymap, kc) == XKB_KEY_a);
+        xkb_keymap_unref(keymap);
+        assert(hits == (unsigned int) k);
+    }
+    hits = 0;
+
+    /* Create a file with higher priority: invalidates the cache */
+    write_file(symbols_path,
+               "default xkb_symbols \"basic\" { key <AC01> { [b, B] }; };\n");
+    for (int k = 0; k < 2; k++) {
+        struct xkb_keymap * const keymap = xkb_keymap_new_from_names(
+            ctx, &rmlvo, XKB_KEYMAP_COMPILE_NO_FLAGS
+        );
+        assert(keymap);
+        assert(get_sym(keymap, kc) == XKB_KEY_b);
+        xkb_keymap_unref(keymap);
+        assert(hits == (unsigned int) k);
+    }
+    hits = 0;
+
+    /* Modify a dependency: invalidates the cache */
+    write_file(symbols_path,
+               "default xkb_symbols \"basic\" { key <AC01> { [c, C] }; };\n"
+               "// Change the file size\n");
+    for (int k = 0; k < 2; k++) {
+        struct xkb_keymap * const keymap = xkb_keymap_new_from_names(
+            ctx, &rmlvo, XKB_KEYMAP_COMPILE_NO_FLAGS
+        );
+        assert(keymap);
+        assert(get_sym(keymap, kc) == XKB_KEY_c);
+        xkb_keymap_unref(keymap);
+        assert(hits == (unsigned int) k);
+    }
+    hits = 0;
+
+    xkb_keysym_t expected = XKB_KEY_c;
+#if HAVE_STRUCT_STAT_ST_MTIM || HAVE_STRUCT_STAT_ST_MTIMESPEC
+    /* Same-size rewrite within the same second: invalidates the cache */
+    struct stat st;
+    assert(stat(symbols_path, &st) == 0);
+    struct file_stamp stamp;
+    file_stamp_from_stat(&stamp, &st);
+    write_file(symbols_path,
+               "default xkb_symbols \"basic\" { key <AC01> { [d, D] }; };\n"
+               "// Change the file size\n");
+    assert(test_set_mtime(symbols_path, stamp.mtime,
+                          (long) ((stamp.mtime_nsec + 1) % 1000000000)));
+    expected = XKB_KEY_d;
+    for (int k = 0; k < 2; k++) {
+        struct xkb_keymap * const keymap = xkb_keymap_new_from_names(
+            ctx, &rmlvo, XKB_KEYMAP_COMPILE_NO_FLAGS
+        );
+        assert(keymap);
+        assert(get_sym(keymap, kc) == expected);
+        xkb_keymap_unref(keymap);
+        assert(hits == (unsigned int) k);
+    }
+    hits = 0;
+#endif
+
+    /* Invalid cache file: fallback to compilation */
+    DIR * const dir = opendir(cache_dir);
+    assert(dir);
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] == '.')
+            continue;
+        char * const path = asprintf_safe("%s/%s", cache_dir, entry->d_name);
+        assert(path);
+        write_file(path, "XKBCACH garbage");
+        free(path);
+    }
+    closedir(dir);
+    for (int k = 0; k < 2; k++) {
+        struct xkb_keymap * const keymap = xkb_keymap_new_from_names(
+            ctx, &rmlvo, XKB_KEYMAP_COMPILE_NO_FLAGS
+        );
+        assert(keymap);
+        assert(get_sym(keymap, kc) == expected);
+        xkb_keymap_unref(keymap);
+        assert(hits == (unsigned int) k);
+    }
+    hits = 0;
+
+    free(symbols_path);
+    free(symbols_dir);
+    free(include_dir);
+    xkb_context_unref(ctx);
+}
+
+int
+main(void)
+{
+    test_init();
+
+#if HAVE_MKOSTEMP
+    char * const tmpdir = test_maketempdir("xkbcommon-keymap-cache.XXXXXX");
+    char * const cache_dir = asprintf_safe("%s/cache", tmpdir);
+    assert(cache_dir);
+
+    test_cache_hit(cache_dir);
+
+    test_cache_invalidation(tmpdir, cache_dir);
+
+    remove_dir(tmpdir);
+    free(cache_dir);
+    free(tmpdir);
+    return EXIT_SUCCESS;
+#else
+    return SKIP_TEST;
+#endif
+}
@@ -11,6 +11,10 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#if HAVE_MEMFD_CREATE
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "xkbcommon/xkbcommon.h"
 #include "xkbcommon/xkbcommon-keysyms.h"
@@ -648,14 +652,14 @@ test_keynames_atoms(void)
             .rules = "base",
             .max_keycode = 255,
             .num_aliases = 63,
-            .num_atoms = 484,
+            .num_atoms = 471,
             .num_key_names = 325,
         },
         {
             .rules = "evdev",
             .max_keycode = 569,
             .num_aliases = 33,
-            .num_atoms = 501,
+            .num_atoms = 461,
             .num_key_names = 305,
         },
     };
@@ -718,11 +722,56 @@ test_keynames_atoms(void)
                       "No enough valid entries; expected: %f <= %f < %f\n",
                       valid_entries_min, valid_entries, valid_entries_max);
 
+        /* The key name index resolves the aliases to their real key */
+        assert(keymap->key_name_index);
+        for (darray_size_t i = 0; i < keymap->num_key_aliases; i++) {
+            const struct xkb_key_alias * const alias = &keymap->key_aliases[i];
+            const xkb_keycode_t kc = xkb_keymap_key_by_name(
+                keymap, xkb_atom_text(context, alias->alias)
+            );
+            assert(kc != XKB_KEYCODE_INVALID);
+            assert(kc == xkb_keymap_key_by_name(
+                keymap, xkb_atom_text(context, alias->real)
+            ));
+        }
+
         xkb_keymap_unref(keymap);
         xkb_context_unref(context);
     }
 }
 
+/* Keymaps from X11 may have duplicate key names: the first key wins */
+static void
+test_key_name_duplicates(void)
+{
+    /* Stub keymap: only the fields used by the key name index */
+    enum { A = 1, B, C, X };
+    struct xkb_key keys[13] = { 0 };
+    for (xkb_keycode_t kc = 0; kc < ARRAY_SIZE(keys); kc++)
+        keys[kc].keycode = kc;
+    keys[10].name = A;
+    keys[11].name = B;
+    keys[12].name = B; /* Duplicate */
+    struct xkb_key_alias aliases[] = { { .real = B, .alias = X } };
+    struct xkb_keymap keymap = {
+        .min_key_code = 10,
+        .max_key_code = 12,
+        .num_keys = ARRAY_SIZE(keys),
+        .num_keys_low = ARRAY_SIZE(keys),
+        .keys = keys,
+        .key_aliases = aliases,
+        .num_key_aliases = ARRAY_SIZE(aliases),
+    };
+
+    keymap_build_key_name_index(&keymap);
+    assert(keymap.key_name_index);
+    assert(key_name_index_lookup(&keymap, A) == 10);
+    assert(key_name_index_lookup(&keymap, B) == 11);
+    assert(key_name_index_lookup(&keymap, X) == 11);
+    assert(key_name_index_lookup(&keymap, C) == XKB_KEYCODE_INVALID);
+    free(keymap.key_name_index);
+}
+
 static void
 test_key_iterator(void)
 {
@@ -872,6 +921,135 @@ test_key_iterator(void)
  * Github issue 934: commit b09aa7c6d8440e1690619239fe57e5f12374af0d introduced
  * a segfault while trying to optimize key aliases allocation.
  */
+/** Count the positions of a keysym by scanning the whole keymap */
+static size_t
+count_keysym_positions(struct xkb_keymap *keymap, xkb_keysym_t keysym,
+                       uint32_t cp)
+{
+    size_t count = 0;
+    for (xkb_keycode_t kc = xkb_keymap_min_keycode(keymap);
+         kc <= xkb_keymap_max_keycode(keymap); kc++) {
+        if (!xkb_keymap_key_get_name(keymap, kc))
+            continue;
+        const xkb_layout_index_t num_layouts =
+            xkb_keymap_num_layouts_for_key(keymap, kc);
+        for (xkb_layout_index_t layout = 0; layout < num_layouts; layout++) {
+            const xkb_level_index_t num_levels =
+                xkb_keymap_num_levels_for_key(keymap, kc, layout);
+            for (xkb_level_index_t level = 0; level < num_levels; level++) {
+                const xkb_keysym_t *syms;
+                if (xkb_keymap_key_get_syms_by_level(keymap, kc, layout,
+                                                     level, &syms) != 1)
+                    continue;
+                if ((cp && xkb_keysym_to_utf32(syms[0]) != cp) ||
+                    (!cp && syms[0] != keysym))
+                    continue;
+                xkb_mod_mask_t masks[16];
+                count += xkb_keymap_key_get_mods_for_level(
+                    keymap, kc, layout, level, masks, ARRAY_SIZE(masks)
+                );
+            }
+        }
+    }
+    return count;
+}
+
+static void
+test_keysym_iterator(void)
+{
+    struct xkb_context *context = test_get_context(CONTEXT_NO_FLAG);
+    assert(context);
+
+    struct xkb_keymap *keymap =
+        test_compile_rules(context, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev",
+                           "pc104", "us,ru", NULL, NULL);
+    assert(keymap);
+
+    const xkb_mod_mask_t shift_mask =
+        UINT32_C(1) << xkb_keymap_mod_get_index(keymap, XKB_MOD_NAME_SHIFT);
+    const xkb_mod_mask_t lock_mask =
+        UINT32_C(1) << xkb_keymap_mod_get_index(keymap, XKB_MOD_NAME_CAPS);
+    const xkb_keycode_t ac01 = xkb_keymap_key_by_name(keymap, "AC01");
+    const xkb_keycode_t kp1 = xkb_keymap_key_by_name(keymap, "KP1");
+    const xkb_keycode_t ae01 = xkb_keymap_key_by_name(keymap, "AE01");
+
+    xkb_keycode_t kc;
+    xkb_layout_index_t layout;
+    xkb_level_index_t level;
+    xkb_mod_mask_t mask;
+
+    /* ‘A’ is on the second level of AC01, selected by either Shift or Lock */
+    struct xkb_keymap_keysym_iterator *iter =
+        xkb_keymap_keysym_iterator_new(keymap, XKB_KEY_A);
+    assert(iter);
+    assert(xkb_keymap_keysym_iterator_next(iter, &kc, &layout, &level, &mask));
+    assert(kc == ac01 && layout == 0 && level == 1 && mask == shift_mask);
+    assert(xkb_keymap_keysym_iterator_next(iter, &kc, &layout, &level, &mask));
+    assert(kc == ac01 && layout == 0 && level == 1 && mask == lock_mask);
+    assert(!xkb_keymap_keysym_iterator_next(iter, &kc, &layout, &level, &mask));
+    assert(!xkb_keymap_keysym_iterator_next(iter, &kc, &layout, &level, &mask));
+    xkb_keymap_keysym_iterator_destroy(iter);
+
+    /* U+0031 “1” is produced by both `1` and `KP_1`: main row first */
+    iter = xkb_keymap_keysym_iterator_new_from_utf32(keymap, 0x31);
+    assert(iter);
+    assert(xkb_keymap_keysym_iterator_next(iter, &kc, &layout, &level, &mask));
+    assert(kc == ae01 && layout == 0 && level == 0 && mask == 0);
+    bool has_kp1 = false;
+    while (xkb_keymap_keysym_iterator_next(iter, &kc, &layout, &level, &mask))
+        has_kp1 |= (kc == kp1);
+    assert(has_kp1);
+    xkb_keymap_keysym_iterator_destroy(iter);
+
+    /* Cyrillic on the second layout */
+    iter = xkb_keymap_keysym_iterator_new_from_utf32(keymap, 0x0444);
+    assert(iter);
+    assert(xkb_keymap_keysym_iterator_next(iter, &kc, &layout, &level, &mask));
+    assert(kc == ac01 && layout == 1 && level == 0 && mask == 0);
+    xkb_keymap_keysym_iterator_destroy(iter);
+
+    /* Not in the keymap */
+    iter = xkb_keymap_keysym_iterator_new(keymap, XKB_KEY_Greek_alpha);
+    assert(iter);
+    assert(!xkb_keymap_keysym_iterator_next(iter, &kc, &layout, &level, &mask));
+    xkb_keymap_keysym_iterator_destroy(iter);
+    assert(!xkb_keymap_keysym_iterator_new_from_utf32(keymap, 0));
+
+    /* The index matches a brute-force scan */
+    for (xkb_keysym_t ks = 0x20; ks < 0x800; ks++) {
+        const uint32_t cp = xkb_keysym_to_utf32(ks);
+        struct {
+            struct xkb_keymap_keysym_iterator *iter;
+            size_t expected;
+        } iters[] = {
+            { xkb_keymap_keysym_iterator_new(keymap, ks),
+              count_keysym_positions(keymap, ks, 0) },
+            { (cp ? xkb_keymap_keysym_iterator_new_from_utf32(keymap, cp)
+                  : NULL),
+              (cp ? count_keysym_positions(keymap, ks, cp) : 0) },
+        };
+        for (size_t i = 0; i < ARRAY_SIZE(iters); i++) {
+            if (!iters[i].iter)
+                continue;
+            size_t count = 0;
+            const xkb_keysym_t *syms;
+            while (xkb_keymap_keysym_iterator_next(iters[i].iter, &kc, &layout,
+                                                   &level, &mask)) {
+                assert(xkb_keymap_key_get_syms_by_level(keymap, kc, layout,
+                                                        level, &syms) == 1);
+                assert(i ? xkb_keysym_to_utf32(syms[0]) == cp
+                         : syms[0] == ks);
+                count++;
+            }
+            assert(count == iters[i].expected);
+            xkb_keymap_keysym_iterator_destroy(iters[i].iter);
+        }
+    }
+
+    xkb_keymap_unref(keymap);
+    xkb_context_unref(context);
+}
+
 static void
 test_issue_934(void)
 {
@@ -893,6 +1071,131 @@ test_issue_934(void)
     xkb_context_unref(context);
 }
 
+/* The key data of a compiled keymap is packed in keycode order */
+static void
+test_frozen_layout(void)
+{
+    struct xkb_context *context = test_get_context(CONTEXT_NO_FLAG);
+    assert(context);
+
+    struct xkb_keymap *keymap =
+        test_compile_rules(context, XKB_KEYMAP_FORMAT_TEXT_V2, "evdev", "pc104",
+                           "us,de,ru", ",neo,", "grp:alt_shift_toggle");
+    assert(keymap);
+    assert(keymap->key_data);
+
+    const struct xkb_group *next_group = keymap->key_data;
+    const struct xkb_level *next_level = NULL;
+    const struct xkb_key *key;
+    xkb_keys_foreach(key, keymap) {
+        if (key->num_groups == 0) {
+            assert(!key->groups);
+            continue;
+        }
+        assert(key->groups == next_group);
+        next_group += key->num_groups;
+        for (xkb_layout_index_t g = 0; g < key->num_groups; g++) {
+            const struct xkb_group * const group = &key->groups[g];
+            assert(!next_level || group->levels == next_level);
+            next_level = group->levels + group->type->num_levels;
+            assert((const void *) next_level > (const void *) next_group);
+        }
+    }
+
+    /* Lookups are unchanged */
+    const xkb_keysym_t *syms;
+    assert(xkb_keymap_key_get_syms_by_level(keymap, KEY_Q + EVDEV_OFFSET,
+                                            0, 1, &syms) == 1);
+    assert(syms[0] == XKB_KEY_Q);
+    assert(xkb_keymap_key_get_syms_by_level(keymap, KEY_Q + EVDEV_OFFSET,
+                                            2, 0, &syms) == 1);
+    assert(syms[0] == XKB_KEY_Cyrillic_shorti);
+
+    xkb_keymap_unref(keymap);
+    xkb_context_unref(context);
+}
+
+static void
+test_serialization(void)
+{
+    struct xkb_context *context = test_get_context(CONTEXT_NO_FLAG);
+    assert(context);
+
+    struct xkb_keymap *keymap =
+        test_compile_rules(context, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev", "pc104",
+                           "us,de", NULL, NULL);
+    assert(keymap);
+
+    /* Memoized strings are returned as copies */
+    char *ref = xkb_keymap_get_as_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1);
+    assert(ref);
+    char *string = xkb_keymap_get_as_string2(keymap, XKB_KEYMAP_USE_ORIGINAL_FORMAT,
+                                             XKB_KEYMAP_SERIALIZE_NO_FLAGS);
+    assert(string && string != ref);
+    assert(streq(string, ref));
+    free(string);
+    string = xkb_keymap_get_as_string2(keymap, XKB_KEYMAP_FORMAT_TEXT_V1,
+                                       XKB_KEYMAP_SERIALIZE_PRETTY);
+    assert(string && !streq(string, ref));
+    free(string);
+
+    /* Invalid flags */
+    size_t size = 0;
+    assert(xkb_keymap_get_as_fd(keymap, XKB_KEYMAP_FORMAT_TEXT_V1,
+                                (enum xkb_keymap_serialize_flags) 0xff00,
+                                &size) == -1);
+
+#if HAVE_MEMFD_CREATE
+    int fds[2];
+    for (size_t k = 0; k < ARRAY_SIZE(fds); k++) {
+        size = 0;
+        fds[k] = xkb_keymap_get_as_fd(keymap, XKB_KEYMAP_FORMAT_TEXT_V1,
+                                      XKB_KEYMAP_SERIALIZE_NO_FLAGS, &size);
+        assert(fds[k] >= 0);
+        assert(size == strlen(ref) + 1);
+    }
+    assert(fds[0] != fds[1]);
+
+    /* Same content, including the terminating NULL byte */
+    char * const buffer = malloc(size + 1);
+    assert(buffer);
+    assert(pread(fds[0], buffer, size + 1, 0) == (ssize_t) size);
+    assert(buffer[size - 1] == '\0');
+    assert(streq(buffer, ref));
+    free(buffer);
+
+    /* Each descriptor has its own offset, starting at the beginning */
+    char head[2][16] = { { 0 }, { 0 } };
+    assert(read(fds[0], head[0], sizeof(head[0]) - 1) ==
+           (ssize_t) sizeof(head[0]) - 1);
+    assert(lseek(fds[1], 0, SEEK_CUR) == 0);
+    assert(read(fds[1], head[1], sizeof(head[1]) - 1) ==
+           (ssize_t) sizeof(head[1]) - 1);
+    assert(streq(head[0], head[1]));
+    assert(strncmp(head[0], ref, sizeof(head[0]) - 1) == 0);
+    const int fd = xkb_keymap_get_as_fd(keymap, XKB_KEYMAP_FORMAT_TEXT_V1,
+                                        XKB_KEYMAP_SERIALIZE_NO_FLAGS, &size);
+    assert(fd >= 0);
+    assert(lseek(fd, 0, SEEK_CUR) == 0);
+    close(fd);
+
+    /* The file is sealed and the descriptors are read-only */
+    const int seals = fcntl(fds[1], F_GET_SEALS);
+    assert(seals >= 0);
+    assert((seals & (F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW)) ==
+           (F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW));
+    assert((fcntl(fds[1], F_GETFL) & O_ACCMODE) == O_RDONLY);
+    assert(write(fds[1], "x", 1) == -1);
+    assert(ftruncate(fds[1], 0) == -1);
+    close(fds[0]);
+    close(fds[1]);
+#endif
+
+    free(ref);
+    xkb_keymap_unref(keymap);
+    xkb_context_unref(context);
+}
+
 int
 main(void)
 {
@@ -906,8 +1209,12 @@ main(void)
     test_multiple_keysyms_per_level();
     test_multiple_actions_per_level();
     test_keynames_atoms();
+    test_key_name_duplicates();
     test_key_iterator();
+    test_keysym_iterator();
     test_issue_934();
+    test_frozen_layout();
+    test_serialization();
 
     return EXIT_SUCCESS;
 }
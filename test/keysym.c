@@ -24,6 +24,8 @@
 #include "src/keysym.h" /* For unexported is_lower/upper/keypad() */
 #include "test.h"
 #include "test/keysym.h"
+#include "utf8.h"
+#include "utf8-decoding.h"
 #include "utils.h"
 #include "utils-numbers.h"
 
@@ -409,6 +411,129 @@ test_utf32_to_keysym(uint32_t ucs, xkb_keysym_t expected)
     return expected == actual;
 }
 
+static void
+test_utf8_keysyms_batch(void)
+{
+    xkb_keysym_t keysyms[64] = {0};
+    char buffer[4 * ARRAY_SIZE(keysyms) + 1] = {0};
+    size_t offset = SIZE_MAX;
+
+    /* Empty input */
+    assert(xkb_utf8_to_keysyms(NULL, 0, keysyms, ARRAY_SIZE(keysyms), &offset) == 0);
+    assert(offset == 0);
+    assert(xkb_utf8_to_keysyms("a", 1, NULL, 0, &offset) == 0);
+    assert(offset == 0);
+    assert(xkb_keysyms_to_utf8(NULL, 0, buffer, sizeof(buffer), &offset) == 0);
+    assert(offset == 0 && buffer[0] == '\0');
+    assert(xkb_keysyms_to_utf8(keysyms, 1, buffer, 0, &offset) == 0);
+    assert(offset == 0);
+
+    /* Mixed scripts, with ASCII runs of various lengths around the fast path */
+    static const char *const strings[] = {
+        "a",
+        "abcdefg",
+        "abcdefgh",
+        "abcdefghijklmnopq",
+        "Hello, world! Привет, мир! שלום עולם ₩ 😉",
+        "tab\there, newline\n and DEL\x7f and US\x1f in a run",
+        "\xc3\xa9t\xc3\xa9 \xe2\x82\xac 0123456789 ~ \xc2\xa0 \xc3\xbf",
+    };
+    for (size_t s = 0; s < ARRAY_SIZE(strings); s++) {
+        const char * const string = strings[s];
+        const size_t size = strlen(string);
+        const size_t count = xkb_utf8_to_keysyms(string, size, keysyms,
+                                                 ARRAY_SIZE(keysyms), &offset);
+        assert(offset == size);
+        /* Compare with the single code point API */
+        size_t k = 0;
+        for (size_t c = 0; c < count; c++) {
+            const xkb_keysym_t keysym = xkb_utf8_to_keysym(&string[k], size - k);
+            assert_printf(keysyms[c] == keysym,
+                          "String #%zu, keysym #%zu: expected 0x%04"PRIx32", "
+                          "got: 0x%04"PRIx32"\n", s, c, keysym, keysyms[c]);
+            k += (size_t) utf8_sequence_length(&string[k]);
+        }
+        assert(k == size);
+        /* Round trip */
+        const size_t length = xkb_keysyms_to_utf8(keysyms, count, buffer,
+                                                  sizeof(buffer), &offset);
+        assert(offset == count);
+        assert(length == size);
+        assert_streq_not_null("UTF-8 round trip", string, buffer);
+    }
+
+    /* Invalid sequences are reported by offset */
+    static const struct {
+        const char *string;
+        size_t size;
+        size_t offset;
+    } invalid[] = {
+        { "abcdefghij\xffxyz", 14, 10 },  /* invalid byte */
+        { "abcdefgh\x80", 9, 8 },         /* unexpected continuation byte */
+        { "abc\xd0", 4, 3 },              /* truncated sequence */
+        { "abc\xe2\x82z", 6, 3 },         /* invalid continuation byte */
+        { "ab\0cd", 5, 2 },                /* NULL */
+        { "\xed\xa0\x80", 3, 0 },          /* surrogate */
+        { "abcdefgh\xf4\x90\x80\x80", 12, 8 }, /* out of Unicode range */
+    };
+    for (size_t s = 0; s < ARRAY_SIZE(invalid); s++) {
+        const size_t count =
+            xkb_utf8_to_keysyms(invalid[s].string, invalid[s].size, keysyms,
+                                ARRAY_SIZE(keysyms), &offset);
+        assert_printf(offset == invalid[s].offset,
+                      "Invalid #%zu: expected offset %zu, got: %zu\n",
+                      s, invalid[s].offset, offset);
+        assert(count == invalid[s].offset);
+    }
+
+    /* Output array too small */
+    assert(xkb_utf8_to_keysyms("abcdefghijkl", 12, keysyms, 9, &offset) == 9);
+    assert(offset == 9 && keysyms[8] == XKB_KEY_i);
+    assert(xkb_utf8_to_keysyms("aмb", 4, keysyms, 2, &offset) == 2);
+    assert(offset == 3 && keysyms[1] == XKB_KEY_Cyrillic_em);
+
+    /* Keysyms without Unicode representation are reported by index */
+    const xkb_keysym_t syms[] = {
+        XKB_KEY_H, XKB_KEY_i, XKB_KEY_space, XKB_KEY_Cyrillic_em,
+        XKB_KEY_EuroSign, XKB_KEYSYM_UNICODE_OFFSET + 0x1F609,
+        XKB_KEY_Shift_L, XKB_KEY_a
+    };
+    size_t length = xkb_keysyms_to_utf8(syms, ARRAY_SIZE(syms), buffer,
+                                        sizeof(buffer), &offset);
+    assert(offset == 6);
+    assert(length == 3 + 2 + 3 + 4);
+    assert_streq_not_null("Keysyms to UTF-8", "Hi м€😉", buffer);
+
+    /* Output buffer too small: never split a character */
+    length = xkb_keysyms_to_utf8(syms, ARRAY_SIZE(syms), buffer, 5, &offset);
+    assert(offset == 3 && length == 3);
+    assert_streq_not_null("Keysyms to UTF-8", "Hi ", buffer);
+    length = xkb_keysyms_to_utf8(syms, ARRAY_SIZE(syms), buffer, 2, &offset);
+    assert(offset == 1 && length == 1);
+    assert_streq_not_null("Keysyms to UTF-8", "H", buffer);
+
+    /* All valid code points, in chunks */
+    char utf8[4 * ARRAY_SIZE(keysyms) + 1];
+    uint32_t cp = 1;
+    while (cp <= 0x10ffff) {
+        size_t size = 0;
+        size_t count = 0;
+        for (; count < ARRAY_SIZE(keysyms) && cp <= 0x10ffff; cp++) {
+            if (cp >= 0xd800 && cp <= 0xdfff)
+                continue;
+            size += (size_t) utf32_to_utf8(cp, &utf8[size]) - 1;
+            count++;
+        }
+        assert(xkb_utf8_to_keysyms(utf8, size, keysyms, ARRAY_SIZE(keysyms),
+                                   &offset) == count);
+        assert(offset == size);
+        assert(xkb_keysyms_to_utf8(keysyms, count, buffer, sizeof(buffer),
+                                   &offset) == size);
+        assert(offset == count);
+        assert(memcmp(utf8, buffer, size) == 0);
+    }
+}
+
 int
 main(void)
 {
@@ -997,6 +1122,28 @@ main(void)
     assert(test_utf32_to_keysym(0x110000, XKB_KEY_NoSymbol));
     assert(test_utf32_to_keysym(0xdeadbeef, XKB_KEY_NoSymbol));
 
+    // Lookup table: deprecated keysyms and bounds
+    assert(test_utf32_to_keysym(0x20a9, XKB_KEY_WonSign)); // not Korean_Won
+    assert(test_utf32_to_keysym(0x0104, XKB_KEY_Aogonek));
+    assert(test_utf32_to_keysym(0x318e, XKB_KEY_Hangul_AraeAE));
+    assert(test_utf32_to_keysym(0x318f, 0x100318f));
+
+    // All code points: the keysym must round-trip and not be deprecated
+    for (uint32_t cp = 0; cp <= 0x10ffff; cp++) {
+        const xkb_keysym_t ks = xkb_utf32_to_keysym(cp);
+        if (ks == XKB_KEY_NoSymbol) {
+            assert(cp == 0 || (cp >= 0xd800 && cp <= 0xdfff));
+            continue;
+        }
+        assert_printf(xkb_keysym_to_utf32(ks) == cp,
+                      "Unexpected keysym 0x%04"PRIx32" for U+%04"PRIX32"\n",
+                      ks, cp);
+        const char *ref;
+        assert_printf(!xkb_keysym_is_deprecated(ks, NULL, &ref),
+                      "Unexpected deprecated keysym 0x%04"PRIx32
+                      " for U+%04"PRIX32"\n", ks, cp);
+    }
+
     assert(xkb_keysym_is_lower(XKB_KEY_a));
     assert(xkb_keysym_is_lower(XKB_KEY_Greek_lambda));
     assert(xkb_keysym_is_lower(xkb_keysym_from_name("U03b1", 0))); /* GREEK SMALL LETTER ALPHA */
@@ -1098,5 +1245,7 @@ main(void)
 
     test_github_issue_42();
 
+    test_utf8_keysyms_batch();
+
     return 0;
 }
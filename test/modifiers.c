@@ -151,6 +151,61 @@ test_modmap_none(struct xkb_context *context)
     xkb_keymap_unref(keymap);
 }
 
+static void
+test_modmap_keysyms(struct xkb_context *context)
+{
+    /*
+     * Keysym entries resolve to the key with the lowest group, then the
+     * lowest level, then the lowest keycode.
+     */
+    const char keymap_str[] =
+        "xkb_keymap {\n"
+        "  xkb_keycodes { <A> = 10; <B> = 11; <C> = 12; <D> = 13; <E> = 14; };\n"
+        "  xkb_types { include \"complete\" };\n"
+        "  xkb_compat { include \"complete\" };\n"
+        "  xkb_symbols {\n"
+        "    key <A> { [ a, b ], [ c, d ] };\n"
+        "    key <B> { [ b, a ] };\n"
+        "    key <C> { [ e ], [ x ] };\n"
+        "    key <D> { [ x ] };\n"
+        "    key <E> { [ {z, y}, e ] };\n"
+        "    modifier_map Mod1 { a };\n"
+        "    modifier_map Mod2 { b };\n"
+        "    modifier_map Mod3 { c };\n"
+        "    modifier_map Mod4 { x };\n"
+        "    modifier_map Mod5 { y };\n"
+        "    modifier_map Lock { e, Greek_alpha };\n"
+        "    modifier_map Control { d };\n"
+        "  };\n"
+        "};";
+    struct xkb_keymap * const keymap =
+        test_compile_string(context, XKB_KEYMAP_FORMAT_TEXT_V1, keymap_str);
+    assert(keymap);
+
+    static const struct {
+        const char *key_name;
+        enum real_mod_mask modmap;
+    } tests[] = {
+        { "A", (Mod1Mask | Mod3Mask | ControlMask) },
+        { "B", Mod2Mask },
+        { "C", LockMask },
+        { "D", Mod4Mask },
+        { "E", Mod5Mask },
+    };
+
+    for (size_t t = 0; t < ARRAY_SIZE(tests); t++) {
+        const xkb_keycode_t keycode =
+            xkb_keymap_key_by_name(keymap, tests[t].key_name);
+        assert(keycode != XKB_KEYCODE_INVALID);
+        const struct xkb_key * const key = XkbKey(keymap, keycode);
+        assert(key);
+        assert_eq("Modmap", (xkb_mod_mask_t) tests[t].modmap, key->modmap,
+                  "%#"PRIx32);
+    }
+
+    xkb_keymap_unref(keymap);
+}
+
 static void
 test_explicit_virtual_modifiers(struct xkb_context *context)
 {
@@ -747,6 +802,7 @@ main(void)
     assert(context);
 
     test_modmap_none(context);
+    test_modmap_keysyms(context);
     test_modifiers_names(context);
     test_explicit_virtual_modifiers(context);
     test_virtual_modifiers_mapping_hack(context);
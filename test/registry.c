@@ -7,6 +7,7 @@
 #include "test-config.h"
 
 #include <assert.h>
+#include <dirent.h>
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -1122,6 +1123,420 @@ test_xml_error_handler(void)
     xmlCleanupParser();
 }
 
+/* Check the indexed lookups against a linear scan */
+static void
+test_lookups(void)
+{
+    struct rxkb_context *ctx =
+        rxkb_context_new(RXKB_CONTEXT_NO_DEFAULT_INCLUDES |
+                         RXKB_CONTEXT_LOAD_EXOTIC_RULES);
+    assert(ctx);
+    char * const include_path = test_get_path("");
+    assert(include_path);
+    assert(rxkb_context_include_path_append(ctx, include_path));
+    free(include_path);
+
+    /* Not parsed yet */
+    assert(!rxkb_model_find(ctx, "pc105"));
+    assert(!rxkb_layout_first_by_iso639(ctx, "eng"));
+
+    assert(rxkb_context_parse(ctx, "evdev"));
+
+    for (struct rxkb_model *m = rxkb_model_first(ctx); m;
+         m = rxkb_model_next(m)) {
+        assert(rxkb_model_find(ctx, rxkb_model_get_name(m)) == m);
+    }
+    for (struct rxkb_layout *l = rxkb_layout_first(ctx); l;
+         l = rxkb_layout_next(l)) {
+        assert(rxkb_layout_find(ctx, rxkb_layout_get_name(l),
+                                rxkb_layout_get_variant(l)) == l);
+    }
+    for (struct rxkb_option_group *g = rxkb_option_group_first(ctx); g;
+         g = rxkb_option_group_next(g)) {
+        assert(rxkb_option_group_find(ctx, rxkb_option_group_get_name(g)) == g);
+        for (struct rxkb_option *o = rxkb_option_first(g); o;
+             o = rxkb_option_next(o)) {
+            struct rxkb_option * const found =
+                rxkb_option_find(ctx, rxkb_option_get_name(o));
+            assert(found);
+            assert(streq(rxkb_option_get_name(found), rxkb_option_get_name(o)));
+        }
+    }
+
+    /* ISO codes: same layouts as a scan, in the same order */
+    static const struct {
+        const char *iso639;
+        const char *iso3166;
+    } codes[] = { {"eng", "US"}, {"fra", "MA"}, {"deu", "JP"}, {"ara", "SA"} };
+    for (size_t c = 0; c < ARRAY_SIZE(codes); c++) {
+        unsigned int count = 0;
+        struct rxkb_layout *found =
+            rxkb_layout_first_by_iso639(ctx, codes[c].iso639);
+        for (struct rxkb_layout *l = rxkb_layout_first(ctx); l;
+             l = rxkb_layout_next(l)) {
+            bool match = false;
+            for (struct rxkb_iso639_code *iso = rxkb_layout_get_iso639_first(l);
+                 iso; iso = rxkb_iso639_code_next(iso)) {
+                match |= streq(rxkb_iso639_code_get_code(iso), codes[c].iso639);
+            }
+            if (!match)
+                continue;
+            assert(found == l);
+            found = rxkb_layout_next_by_iso639(found, codes[c].iso639);
+            count++;
+        }
+        assert(!found);
+        assert(count > 0);
+
+        count = 0;
+        found = rxkb_layout_first_by_iso3166(ctx, codes[c].iso3166);
+        for (struct rxkb_layout *l = rxkb_layout_first(ctx); l;
+             l = rxkb_layout_next(l)) {
+            bool match = false;
+            for (struct rxkb_iso3166_code *iso =
+                    rxkb_layout_get_iso3166_first(l);
+                 iso; iso = rxkb_iso3166_code_next(iso)) {
+                match |= streq(rxkb_iso3166_code_get_code(iso),
+                               codes[c].iso3166);
+            }
+            if (!match)
+                continue;
+            assert(found == l);
+            found = rxkb_layout_next_by_iso3166(found, codes[c].iso3166);
+            count++;
+        }
+        assert(!found);
+        assert(count > 0);
+    }
+
+    /* Codes are case-insensitive */
+    assert(rxkb_layout_first_by_iso639(ctx, "FRA") ==
+           rxkb_layout_first_by_iso639(ctx, "fra"));
+    assert(rxkb_layout_first_by_iso3166(ctx, "us") ==
+           rxkb_layout_first_by_iso3166(ctx, "US"));
+
+    /* Empty variant */
+    struct rxkb_layout * const us = rxkb_layout_find(ctx, "us", NULL);
+    assert(us);
+    assert(!rxkb_layout_get_variant(us));
+    assert(rxkb_layout_find(ctx, "us", "") == us);
+    assert(streq(rxkb_layout_get_variant(rxkb_layout_find(ctx, "us", "intl")),
+                 "intl"));
+
+    /* Unknown items */
+    assert(!rxkb_model_find(ctx, "xxx"));
+    assert(!rxkb_model_find(ctx, NULL));
+    assert(!rxkb_layout_find(ctx, "us", "xxx"));
+    assert(!rxkb_layout_find(ctx, "xxx", NULL));
+    assert(!rxkb_option_group_find(ctx, "xxx"));
+    assert(!rxkb_option_find(ctx, "grp"));
+    assert(!rxkb_layout_first_by_iso639(ctx, "xxx"));
+    assert(!rxkb_layout_first_by_iso3166(ctx, "XX"));
+    assert(!rxkb_layout_first_by_iso3166(ctx, NULL));
+
+    rxkb_context_unref(ctx);
+}
+
+/* Count the cache hits, reported in the debug log */
+ATTR_PRINTF(3, 0) static void
+cache_log_fn(struct rxkb_context *ctx, enum rxkb_log_level level,
+             const char *fmt, va_list args)
+{
+    unsigned int * const hits = rxkb_context_get_user_data(ctx);
+    char *s = NULL;
+    const int size = vasprintf(&s, fmt, args);
+    assert(size != -1);
+    if (strstr(s, "Loaded registry from cache"))
+        (*hits)++;
+    free(s);
+}
+
+static struct rxkb_context *
+test_setup_cache_context(const char *include_path, const char *ruleset,
+                         enum rxkb_context_flags flags, const char *cache_dir,
+                         unsigned int *hits)
+{
+    struct rxkb_context * const ctx =
+        rxkb_context_new(RXKB_CONTEXT_NO_DEFAULT_INCLUDES | flags);
+    assert(ctx);
+    rxkb_context_set_user_data(ctx, hits);
+    rxkb_context_set_log_fn(ctx, cache_log_fn);
+    rxkb_context_set_log_level(ctx, RXKB_LOG_LEVEL_DEBUG);
+    assert(rxkb_context_set_cache_dir(ctx, cache_dir));
+    assert(rxkb_context_include_path_append(ctx, include_path));
+    assert(rxkb_context_parse(ctx, ruleset));
+    /* Too late */
+    assert(!rxkb_context_set_cache_dir(ctx, NULL));
+    return ctx;
+}
+
+/** Check that 2 contexts have the same items, in the same order */
+static void
+assert_same_registry(struct rxkb_context *ctx1, struct rxkb_context *ctx2)
+{
+    struct rxkb_model *m1 = rxkb_model_first(ctx1);
+    struct rxkb_model *m2 = rxkb_model_first(ctx2);
+    for (; m1 && m2; m1 = rxkb_model_next(m1), m2 = rxkb_model_next(m2)) {
+        assert(streq(rxkb_model_get_name(m1), rxkb_model_get_name(m2)));
+        assert(streq_null(rxkb_model_get_vendor(m1),
+                          rxkb_model_get_vendor(m2)));
+        assert(streq_null(rxkb_model_get_description(m1),
+                          rxkb_model_get_description(m2)));
+        assert(rxkb_model_get_popularity(m1) ==
+               rxkb_model_get_popularity(m2));
+    }
+    assert(!m1 && !m2);
+
+    struct rxkb_layout *l1 = rxkb_layout_first(ctx1);
+    struct rxkb_layout *l2 = rxkb_layout_first(ctx2);
+    for (; l1 && l2; l1 = rxkb_layout_next(l1), l2 = rxkb_layout_next(l2)) {
+        assert(streq(rxkb_layout_get_name(l1), rxkb_layout_get_name(l2)));
+        assert(streq_null(rxkb_layout_get_variant(l1),
+                          rxkb_layout_get_variant(l2)));
+        assert(streq_null(rxkb_layout_get_brief(l1),
+                          rxkb_layout_get_brief(l2)));
+        assert(streq_null(rxkb_layout_get_description(l1),
+                          rxkb_layout_get_description(l2)));
+        assert(rxkb_layout_get_popularity(l1) ==
+               rxkb_layout_get_popularity(l2));
+
+        struct rxkb_iso639_code *a1 = rxkb_layout_get_iso639_first(l1);
+        struct rxkb_iso639_code *a2 = rxkb_layout_get_iso639_first(l2);
+        for (; a1 && a2;
+             a1 = rxkb_iso639_code_next(a1), a2 = rxkb_iso639_code_next(a2)) {
+            assert(streq(rxkb_iso639_code_get_code(a1),
+                         rxkb_iso639_code_get_code(a2)));
+        }
+        assert(!a1 && !a2);
+
+        struct rxkb_iso3166_code *c1 = rxkb_layout_get_iso3166_first(l1);
+        struct rxkb_iso3166_code *c2 = rxkb_layout_get_iso3166_first(l2);
+        for (; c1 && c2;
+             c1 = rxkb_iso3166_code_next(c1), c2 = rxkb_iso3166_code_next(c2)) {
+            assert(streq(rxkb_iso3166_code_get_code(c1),
+                         rxkb_iso3166_code_get_code(c2)));
+        }
+        assert(!c1 && !c2);
+    }
+    assert(!l1 && !l2);
+
+    struct rxkb_option_group *g1 = rxkb_option_group_first(ctx1);
+    struct rxkb_option_group *g2 = rxkb_option_group_first(ctx2);
+    for (; g1 && g2;
+         g1 = rxkb_option_group_next(g1), g2 = rxkb_option_group_next(g2)) {
+        assert(streq(rxkb_option_group_get_name(g1),
+                     rxkb_option_group_get_name(g2)));
+        assert(streq_null(rxkb_option_group_get_description(g1),
+                          rxkb_option_group_get_description(g2)));
+        assert(rxkb_option_group_allows_multiple(g1) ==
+               rxkb_option_group_allows_multiple(g2));
+        assert(rxkb_option_group_get_popularity(g1) ==
+               rxkb_option_group_get_popularity(g2));
+
+        struct rxkb_option *o1 = rxkb_option_first(g1);
+        struct rxkb_option *o2 = rxkb_option_first(g2);
+        for (; o1 && o2; o1 = rxkb_option_next(o1), o2 = rxkb_option_next(o2)) {
+            assert(streq(rxkb_option_get_name(o1), rxkb_option_get_name(o2)));
+            assert(streq_null(rxkb_option_get_brief(o1),
+                              rxkb_option_get_brief(o2)));
+            assert(streq_null(rxkb_option_get_description(o1),
+                              rxkb_option_get_description(o2)));
+            assert(rxkb_option_get_popularity(o1) ==
+                   rxkb_option_get_popularity(o2));
+            assert(rxkb_option_is_layout_specific(o1) ==
+                   rxkb_option_is_layout_specific(o2));
+        }
+        assert(!o1 && !o2);
+    }
+    assert(!g1 && !g2);
+}
+
+static void
+test_cache_hit(const char *cache_dir)
+{
+    char * const include_path = test_get_path("");
+    assert(include_path);
+
+    /* Reference: no cache */
+    struct rxkb_context * const ref =
+        rxkb_context_new(RXKB_CONTEXT_NO_DEFAULT_INCLUDES |
+                         RXKB_CONTEXT_LOAD_EXOTIC_RULES);
+    assert(ref);
+    assert(rxkb_context_set_cache_dir(ref, NULL));
+    assert(rxkb_context_include_path_append(ref, include_path));
+    assert(rxkb_context_parse(ref, "evdev"));
+
+    /* Cache miss, then hit */
+    for (unsigned int k = 0; k < 2; k++) {
+        unsigned int hits = 0;
+        struct rxkb_context * const ctx =
+            test_setup_cache_context(include_path, "evdev",
+                                     RXKB_CONTEXT_LOAD_EXOTIC_RULES,
+                                     cache_dir, &hits);
+        assert(hits == k);
+        assert_same_registry(ref, ctx);
+        rxkb_context_unref(ctx);
+    }
+
+    /* Different flags: different cache entry */
+    unsigned int hits = 0;
+    struct rxkb_context * const ctx =
+        test_setup_cache_context(include_path, "evdev",
+                                 RXKB_CONTEXT_NO_FLAGS, cache_dir, &hits);
+    assert(hits == 0);
+    assert(find_layout(ctx, "us", "intl"));
+    rxkb_context_unref(ctx);
+
+    rxkb_context_unref(ref);
+    free(include_path);
+}
+
+static void
+test_cache_invalidation(const char *cache_dir)
+{
+    struct test_model models[] =  {
+        {"m1", "vendor1", "desc1"},
+        {NULL},
+    };
+    struct test_layout layouts[] =  {
+        {"l1", NO_VARIANT, "lbrief1", "ldesc1", {"eng"}, {"US"}},
+        {"l1", "v1", "vbrief1", "vdesc1"},
+        {NULL},
+    };
+    struct test_option_group groups[] = {
+        {"grp1", "gdesc1", true,
+          { {"grp1:1", "odesc11"}, {"grp1:2", "odesc12"} } },
+        { NULL },
+    };
+    const char *ruleset = "xkbtests";
+    char *basedir = test_create_rules(ruleset, models, layouts, groups);
+    char * const rules = asprintf_safe("%s/rules/%s.xml", basedir, ruleset);
+    char * const extras = asprintf_safe("%s/rules/%s.extras.xml",
+                                        basedir, ruleset);
+    assert(rules && extras);
+    struct rxkb_context *ctx;
+    unsigned int hits = 0;
+
+    /* Cache miss, then hit */
+    for (unsigned int k = 0; k < 2; k++) {
+        ctx = test_setup_cache_context(basedir, ruleset,
+                                       RXKB_CONTEXT_LOAD_EXOTIC_RULES,
+                                       cache_dir, &hits);
+        assert(hits == k);
+        struct rxkb_layout * const l = fetch_layout(ctx, "l1", NO_VARIANT);
+        assert(cmp_layouts(&layouts[0], l));
+        rxkb_layout_unref(l);
+        rxkb_context_unref(ctx);
+    }
+    hits = 0;
+
+    /* Modify a rules file: invalidates the cache */
+    FILE *file = fopen(rules, "a");
+    assert(file);
+    fputs("<!-- Change the file size -->\n", file);
+    fclose(file);
+    for (unsigned int k = 0; k < 2; k++) {
+        ctx = test_setup_cache_context(basedir, ruleset,
+                                       RXKB_CONTEXT_LOAD_EXOTIC_RULES,
+                                       cache_dir, &hits);
+        assert(hits == k);
+        assert(find_model(ctx, "m1"));
+        assert(!find_model(ctx, "m2"));
+        rxkb_context_unref(ctx);
+    }
+    hits = 0;
+
+    /* Create a missing rules file: invalidates the cache */
+    file = fopen(extras, "w");
+    assert(file);
+    fputs("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+          "<xkbConfigRegistry version=\"1.1\">\n"
+          "<modelList><model><configItem><name>m2</name></configItem>"
+          "</model></modelList>\n"
+          "</xkbConfigRegistry>\n", file);
+    fclose(file);
+    for (unsigned int k = 0; k < 2; k++) {
+        ctx = test_setup_cache_context(basedir, ruleset,
+                                       RXKB_CONTEXT_LOAD_EXOTIC_RULES,
+                                       cache_dir, &hits);
+        assert(hits == k);
+        struct rxkb_model * const m = fetch_model(ctx, "m2");
+        assert(m);
+        assert(rxkb_model_get_popularity(m) == RXKB_POPULARITY_EXOTIC);
+        rxkb_model_unref(m);
+        rxkb_context_unref(ctx);
+    }
+    hits = 0;
+
+    /* Invalid cache file: fallback to parsing */
+    DIR * const dir = opendir(cache_dir);
+    assert(dir);
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] == '.')
+            continue;
+        char * const path = asprintf_safe("%s/%s", cache_dir, entry->d_name);
+        assert(path);
+        file = fopen(path, "wb");
+        assert(file);
+        fputs("XKBCACH garbage", file);
+        fclose(file);
+        free(path);
+    }
+    closedir(dir);
+    for (unsigned int k = 0; k < 2; k++) {
+        ctx = test_setup_cache_context(basedir, ruleset,
+                                       RXKB_CONTEXT_LOAD_EXOTIC_RULES,
+                                       cache_dir, &hits);
+        assert(hits == k);
+        assert(find_models(ctx, "m1", "m2", NULL));
+        rxkb_context_unref(ctx);
+    }
+
+    unlink(extras);
+    free(extras);
+    free(rules);
+    test_remove_rules(basedir, ruleset);
+}
+
+/* Remove all the files of a directory and the directory itself */
+static void
+remove_dir(const char *path)
+{
+    DIR * const dir = opendir(path);
+    if (!dir)
+        return;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (streq(entry->d_name, ".") || streq(entry->d_name, ".."))
+            continue;
+        char * const file = asprintf_safe("%s/%s", path, entry->d_name);
+        assert(file);
+        if (unlink(file) != 0)
+            remove_dir(file);
+        free(file);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+static void
+test_cache(void)
+{
+#if HAVE_MKOSTEMP
+    char * const tmpdir = test_maketempdir("xkbregistry-cache.XXXXXX");
+    char * const cache_dir = asprintf_safe("%s/cache", tmpdir);
+    assert(cache_dir);
+
+    test_cache_hit(cache_dir);
+    test_cache_invalidation(cache_dir);
+
+    remove_dir(tmpdir);
+    free(cache_dir);
+    free(tmpdir);
+#endif
+}
+
 int
 main(void)
 {
@@ -1141,6 +1556,8 @@ main(void)
     test_load_languages();
     test_load_invalid_languages();
     test_popularity();
+    test_lookups();
+    test_cache();
 
     return 0;
 }
@@ -6,8 +6,11 @@
 #include "config.h"
 #include "test-config.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "xkbcommon/xkbcommon.h"
 
@@ -840,6 +843,119 @@ test_partial_rules(struct xkb_context *ctx)
     xkb_context_unref(ctx);
 }
 
+static void
+write_file(const char *path, const char *content)
+{
+    FILE * const file = fopen(path, "wb");
+    assert(file);
+    fputs(content, file);
+    fclose(file);
+}
+
+/* Rules files are parsed once per context, until they are modified */
+static void
+test_rules_index(void)
+{
+#if HAVE_MKOSTEMP
+    char * const tmpdir = test_maketempdir("xkbcommon-rules-index.XXXXXX");
+    char * const rules_dir = test_makedir(tmpdir, "rules");
+    char * const rules_path = asprintf_safe("%s/custom", rules_dir);
+    char * const pre_path = asprintf_safe("%s/custom.pre", rules_dir);
+    assert(rules_path && pre_path);
+
+    struct xkb_context * const ctx = test_get_context(CONTEXT_NO_FLAG);
+    assert(ctx);
+    xkb_context_include_path_clear(ctx);
+    assert(xkb_context_include_path_append(ctx, tmpdir));
+
+    write_file(rules_path,
+               "! $grp = a b\n"
+               "! model = keycodes types compat symbols\n"
+               "  *     = k        t     c      s\n"
+               "! layout = symbols\n"
+               "  $grp   = +g\n"
+               "  other  = +o\n");
+
+    struct test_data tests[] = {
+        {
+            .rules = "custom", .model = "pc", .layout = "a",
+            .keycodes = "k", .types = "t", .compat = "c", .symbols = "s+g",
+            .explicit_layouts = 1
+        },
+        {
+            .rules = "custom", .model = "pc", .layout = "other",
+            .keycodes = "k", .types = "t", .compat = "c", .symbols = "s+o",
+            .explicit_layouts = 1
+        },
+        {
+            .rules = "custom", .model = "pc", .layout = "c",
+            .keycodes = "k", .types = "t", .compat = "c", .symbols = "s",
+            .explicit_layouts = 1
+        },
+    };
+    for (unsigned int k = 0; k < ARRAY_SIZE(tests); k++) {
+        fprintf(stderr, "------\n*** %s: #%u ***\n", __func__, k);
+        /* Twice: parse, then reuse */
+        assert(test_rules(ctx, &tests[k]));
+        assert(test_rules(ctx, &tests[k]));
+    }
+
+    /* A group defined previously takes precedence */
+    write_file(pre_path, "! $grp = c\n");
+    tests[0].symbols = "s";
+    tests[2].symbols = "s+g";
+    for (unsigned int k = 0; k < ARRAY_SIZE(tests); k++) {
+        fprintf(stderr, "------\n*** %s: #%u (shadowed group) ***\n",
+                __func__, k);
+        assert(test_rules(ctx, &tests[k]));
+    }
+    unlink(pre_path);
+
+    /* Modified file */
+    write_file(rules_path,
+               "! model = keycodes types compat symbols\n"
+               "  *     = k        t     c      s\n"
+               "! layout = symbols\n"
+               "  other  = +modified\n");
+    tests[0].symbols = "s";
+    tests[1].symbols = "s+modified";
+    tests[2].symbols = "s";
+    for (unsigned int k = 0; k < ARRAY_SIZE(tests); k++) {
+        fprintf(stderr, "------\n*** %s: #%u (modified) ***\n", __func__, k);
+        assert(test_rules(ctx, &tests[k]));
+    }
+
+    /* Same-size rewrite within the same second */
+    struct stat st;
+    assert(stat(rules_path, &st) == 0);
+    struct file_stamp stamp;
+    file_stamp_from_stat(&stamp, &st);
+    write_file(rules_path,
+               "! model = keycodes types compat symbols\n"
+               "  *     = k        t     c      s\n"
+               "! layout = symbols\n"
+               "  other  = +reworked\n");
+    if (test_set_mtime(rules_path, stamp.mtime,
+                       (long) ((stamp.mtime_nsec + 1) % 1000000000))) {
+        tests[1].symbols = "s+reworked";
+        for (unsigned int k = 0; k < ARRAY_SIZE(tests); k++) {
+            fprintf(stderr, "------\n*** %s: #%u (same size) ***\n",
+                    __func__, k);
+            assert(test_rules(ctx, &tests[k]));
+        }
+    }
+
+    xkb_context_unref(ctx);
+    unlink(rules_path);
+    rmdir(rules_dir);
+    rmdir(tmpdir);
+    free(pre_path);
+    free(rules_path);
+    free(rules_dir);
+    free(tmpdir);
+#endif
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -877,6 +993,7 @@ main(int argc, char *argv[])
     test_all_qualifier(ctx, too_much_layouts, too_much_symbols);
     test_layout_specific_options(ctx);
     test_partial_rules(ctx);
+    test_rules_index();
 
     xkb_context_unref(ctx);
     return EXIT_SUCCESS;
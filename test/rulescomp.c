@@ -7,11 +7,15 @@
 #include "test-config.h"
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "xkbcommon/xkbcommon.h"
 
 #include "evdev-scancodes.h"
+#include "keymap-compare.h"
 #include "src/keymap.h"
 #include "src/keysym.h"
 #include "test.h"
@@ -198,6 +202,169 @@ test_extended_groups(struct xkb_context *ctx)
 #undef U
 }
 
+static void
+write_symbols(const char *path, const char *keysym)
+{
+    FILE * const file = fopen(path, "wb");
+    assert(file);
+    fprintf(file,
+            "default partial alphanumeric_keys\n"
+            "xkb_symbols \"basic\" { key <AC01> { [%s] }; };\n"
+            "xkb_symbols \"other\" {\n"
+            "  include \"custom(basic)\"\n"
+            "  key <AC02> { [x, X] };\n"
+            "};\n", keysym);
+    fclose(file);
+}
+
+static struct xkb_keymap *
+compile_custom(struct xkb_context *ctx)
+{
+    return test_compile_rules(ctx, XKB_KEYMAP_FORMAT_TEXT_V2, "evdev",
+                              "pc105", "us,custom,custom", ",,other", NULL);
+}
+
+/* Included sections are cached in the context: check reuse and invalidation */
+static void
+test_included_sections_cache(void)
+{
+    char * const tmpdir = test_maketempdir("xkbcommon-rulescomp.XXXXXX");
+    char * const symbols_dir = test_makedir(tmpdir, "symbols");
+    char * const symbols_path = asprintf_safe("%s/custom", symbols_dir);
+    assert(symbols_path);
+    write_symbols(symbols_path, "b");
+
+    struct xkb_context * const ctx = test_get_context(CONTEXT_NO_FLAG);
+    assert(ctx);
+    assert(xkb_context_include_path_append(ctx, tmpdir));
+    struct xkb_context * const ctx_ref = test_get_context(CONTEXT_NO_FLAG);
+    assert(ctx_ref);
+    assert(xkb_context_include_path_append(ctx_ref, tmpdir));
+
+    /* Successive compilations with the same context */
+    struct xkb_keymap * const ref = compile_custom(ctx_ref);
+    assert(ref);
+    for (int k = 0; k < 3; k++) {
+        struct xkb_keymap * const keymap = compile_custom(ctx);
+        assert(keymap);
+        assert(xkb_keymap_compare(ctx, ref, keymap, XKB_KEYMAP_CMP_ALL));
+        xkb_keymap_unref(keymap);
+    }
+    xkb_keymap_unref(ref);
+
+    /* Modified file: cache invalidated */
+    write_symbols(symbols_path, "c, C");
+    struct xkb_keymap * const keymap = compile_custom(ctx);
+    assert(keymap);
+    const xkb_keysym_t *syms;
+    for (xkb_layout_index_t layout = 1; layout < 3; layout++) {
+        assert(xkb_keymap_key_get_syms_by_level(keymap, KEY_A + EVDEV_OFFSET,
+                                                layout, 0, &syms) == 1);
+        assert(syms[0] == XKB_KEY_c);
+    }
+    assert(xkb_keymap_key_get_syms_by_level(keymap, KEY_S + EVDEV_OFFSET,
+                                            2, 0, &syms) == 1);
+    assert(syms[0] == XKB_KEY_x);
+    xkb_keymap_unref(keymap);
+
+    /* Same-size rewrite within the same second: cache invalidated */
+    struct stat st;
+    assert(stat(symbols_path, &st) == 0);
+    struct file_stamp stamp;
+    file_stamp_from_stat(&stamp, &st);
+    const long nsec = (long) ((stamp.mtime_nsec + 1) % 1000000000);
+    write_symbols(symbols_path, "d, D");
+    if (test_set_mtime(symbols_path, stamp.mtime, nsec)) {
+        struct xkb_keymap * const keymap2 = compile_custom(ctx);
+        assert(keymap2);
+        assert(xkb_keymap_key_get_syms_by_level(keymap2, KEY_A + EVDEV_OFFSET,
+                                                1, 0, &syms) == 1);
+        assert(syms[0] == XKB_KEY_d);
+        xkb_keymap_unref(keymap2);
+
+        /* File replaced by renaming, with the same size and time */
+        char * const tmp_path = asprintf_safe("%s.tmp", symbols_path);
+        assert(tmp_path);
+        write_symbols(tmp_path, "e, E");
+        assert(test_set_mtime(tmp_path, stamp.mtime, nsec));
+        assert(rename(tmp_path, symbols_path) == 0);
+        free(tmp_path);
+        struct xkb_keymap * const keymap3 = compile_custom(ctx);
+        assert(keymap3);
+        assert(xkb_keymap_key_get_syms_by_level(keymap3, KEY_A + EVDEV_OFFSET,
+                                                1, 0, &syms) == 1);
+        assert(syms[0] == XKB_KEY_e);
+        xkb_keymap_unref(keymap3);
+    }
+
+    xkb_context_unref(ctx);
+    xkb_context_unref(ctx_ref);
+
+    unlink(symbols_path);
+    rmdir(symbols_dir);
+    rmdir(tmpdir);
+    free(symbols_path);
+    free(symbols_dir);
+    free(tmpdir);
+}
+
+/*
+ * Only the included section is parsed: check the errors in the other sections
+ * of the file.
+ */
+static void
+test_included_sections_errors(void)
+{
+    char * const tmpdir = test_maketempdir("xkbcommon-rulescomp.XXXXXX");
+    char * const symbols_dir = test_makedir(tmpdir, "symbols");
+    char * const symbols_path = asprintf_safe("%s/custom", symbols_dir);
+    assert(symbols_path);
+
+    struct xkb_context * const ctx = test_get_context(CONTEXT_NO_FLAG);
+    assert(ctx);
+    assert(xkb_context_include_path_append(ctx, tmpdir));
+
+    /* Syntax error in a section with balanced braces: only it fails */
+    FILE *file = fopen(symbols_path, "wb");
+    assert(file);
+    fprintf(file,
+            "xkb_symbols \"broken\" { key <AC01> { [a b] }; };\n"
+            "xkb_symbols \"valid\" { key <AC01> { [c] }; };\n");
+    fclose(file);
+    struct xkb_keymap *keymap =
+        test_compile_rules(ctx, XKB_KEYMAP_FORMAT_TEXT_V2, "evdev",
+                           "pc105", "us,custom", ",valid", NULL);
+    assert(keymap);
+    const xkb_keysym_t *syms;
+    assert(xkb_keymap_key_get_syms_by_level(keymap, KEY_A + EVDEV_OFFSET,
+                                            1, 0, &syms) == 1);
+    assert(syms[0] == XKB_KEY_c);
+    xkb_keymap_unref(keymap);
+    keymap = test_compile_rules(ctx, XKB_KEYMAP_FORMAT_TEXT_V2, "evdev",
+                                "pc105", "us,custom", ",broken", NULL);
+    assert(!keymap);
+
+    /* Unbalanced braces: the whole file is parsed and the error reported */
+    file = fopen(symbols_path, "wb");
+    assert(file);
+    fprintf(file,
+            "xkb_symbols \"broken\" { key <AC01> { [a] ; };\n"
+            "xkb_symbols \"valid\" { key <AC01> { [c] }; };\n");
+    fclose(file);
+    keymap = test_compile_rules(ctx, XKB_KEYMAP_FORMAT_TEXT_V2, "evdev",
+                                "pc105", "us,custom", ",valid", NULL);
+    assert(!keymap);
+
+    xkb_context_unref(ctx);
+
+    unlink(symbols_path);
+    rmdir(symbols_dir);
+    rmdir(tmpdir);
+    free(symbols_path);
+    free(symbols_dir);
+    free(tmpdir);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -351,6 +518,8 @@ main(int argc, char *argv[])
                           KEY_A,          BOTH, XKB_KEY_a,                FINISH));
 
     test_extended_groups(ctx);
+    test_included_sections_cache();
+    test_included_sections_errors();
 
     xkb_context_unref(ctx);
 
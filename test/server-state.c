@@ -3288,6 +3288,272 @@ test_modifiers_tweak(struct xkb_context *context)
     xkb_keymap_unref(keymap);
 }
 
+static bool
+check_event_eq(const struct xkb_event *a, const struct xkb_event *b)
+{
+    if (a->type != b->type)
+        return false;
+    switch (a->type) {
+    case XKB_EVENT_TYPE_KEY_DOWN:
+    case XKB_EVENT_TYPE_KEY_REPEATED:
+    case XKB_EVENT_TYPE_KEY_UP:
+        return a->keycode == b->keycode;
+    default:
+        return a->components.changed == b->components.changed &&
+               a->components.components.base_group ==
+                    b->components.components.base_group &&
+               a->components.components.latched_group ==
+                    b->components.components.latched_group &&
+               a->components.components.locked_group ==
+                    b->components.components.locked_group &&
+               a->components.components.group ==
+                    b->components.components.group &&
+               a->components.components.base_mods ==
+                    b->components.components.base_mods &&
+               a->components.components.latched_mods ==
+                    b->components.components.latched_mods &&
+               a->components.components.locked_mods ==
+                    b->components.components.locked_mods &&
+               a->components.components.mods ==
+                    b->components.components.mods &&
+               a->components.components.leds ==
+                    b->components.components.leds &&
+               a->components.components.controls ==
+                    b->components.components.controls;
+    }
+}
+
+/*
+ * Check that processing keys in a single batch produces the same events as
+ * processing them one by one.
+ */
+static void
+check_process_keys(struct xkb_machine_builder *builder,
+                   struct xkb_events *events,
+                   const struct xkb_key_input *keys, size_t count)
+{
+    struct xkb_machine * const sm1 = xkb_machine_new(builder);
+    struct xkb_machine * const sm2 = xkb_machine_new(builder);
+    assert(sm1 && sm2);
+
+    darray(struct xkb_event) expected = darray_new();
+    size_t *expected_offsets = calloc(count, sizeof(*expected_offsets));
+    size_t *offsets = calloc(count, sizeof(*offsets));
+    assert(expected_offsets && offsets);
+
+    const struct xkb_event *event;
+    for (size_t k = 0; k < count; k++) {
+        assert(xkb_machine_process_key(sm1, keys[k].keycode, keys[k].direction,
+                                       events) == XKB_SUCCESS);
+        expected_offsets[k] = darray_size(expected);
+        while ((event = xkb_events_next(events)))
+            darray_append(expected, *event);
+    }
+
+    assert(xkb_machine_process_keys(sm2, count, keys, events, offsets) ==
+           XKB_SUCCESS);
+    darray_size_t e = 0;
+    while ((event = xkb_events_next(events))) {
+        assert(e < darray_size(expected));
+        assert(check_event_eq(event, &darray_item(expected, e)));
+        e++;
+    }
+    assert(e == darray_size(expected));
+    for (size_t k = 0; k < count; k++)
+        assert_eq("offset", expected_offsets[k], offsets[k], "%zu");
+
+    /* Offsets are optional */
+    assert(xkb_machine_process_keys(sm1, count, keys, events, NULL) ==
+           XKB_SUCCESS);
+
+    /* Empty batch */
+    assert(xkb_machine_process_keys(sm2, 0, NULL, events, NULL) ==
+           XKB_SUCCESS);
+    assert(!xkb_events_next(events));
+
+    free(offsets);
+    free(expected_offsets);
+    darray_free(expected);
+    xkb_machine_unref(sm2);
+    xkb_machine_unref(sm1);
+}
+
+static void
+test_process_keys(struct xkb_context *context)
+{
+#define K(key, dir) { .keycode = EVDEV_OFFSET + (key), .direction = (dir) }
+    struct xkb_events * const events =
+        xkb_events_new_batch(context, XKB_EVENTS_NO_FLAGS);
+    assert(events);
+
+    /* Redirect key: refers to the last components event of its frame */
+    struct xkb_keymap *keymap = test_compile_file(
+        context, XKB_KEYMAP_FORMAT_TEXT_V1, "keymaps/redirect-key-1.xkb"
+    );
+    assert(keymap);
+    struct xkb_machine_builder *builder =
+        xkb_machine_builder_new(keymap, XKB_MACHINE_BUILDER_NO_FLAGS);
+    assert(builder);
+    const struct xkb_key_input redirect[] = {
+        K(KEY_A, XKB_KEY_DOWN), K(KEY_A, XKB_KEY_REPEATED),
+        K(KEY_A, XKB_KEY_UP),
+        K(KEY_LEFTSHIFT, XKB_KEY_DOWN),
+        K(KEY_S, XKB_KEY_DOWN), K(KEY_S, XKB_KEY_UP),
+        K(KEY_LEFTCTRL, XKB_KEY_DOWN),
+        K(KEY_D, XKB_KEY_DOWN), K(KEY_D, XKB_KEY_REPEATED),
+        K(KEY_D, XKB_KEY_UP),
+        K(KEY_LEFTSHIFT, XKB_KEY_UP),
+        K(KEY_S, XKB_KEY_DOWN), K(KEY_S, XKB_KEY_UP),
+        K(KEY_LEFTCTRL, XKB_KEY_UP),
+        /* Unknown key: no events */
+        { .keycode = 0, .direction = XKB_KEY_DOWN },
+        K(KEY_D, XKB_KEY_DOWN), K(KEY_D, XKB_KEY_UP),
+    };
+    check_process_keys(builder, events, redirect, ARRAY_SIZE(redirect));
+    xkb_machine_builder_destroy(builder);
+    xkb_keymap_unref(keymap);
+
+    /* Shortcuts tweak: undone at the end of each frame */
+    keymap = test_compile_rules(context, XKB_KEYMAP_FORMAT_TEXT_V2,
+                                "evdev", "pc104", "us,il,de,ru", ",,neo,",
+                                "grp:menu_toggle,grp:win_switch");
+    assert(keymap);
+    builder = xkb_machine_builder_new(keymap, XKB_MACHINE_BUILDER_NO_FLAGS);
+    assert(builder);
+    const xkb_mod_mask_t ctrl = UINT32_C(1) << XKB_MOD_INDEX_CTRL;
+    assert(xkb_machine_builder_update_shortcut_mods(builder, ctrl, ctrl) ==
+           XKB_SUCCESS);
+    assert(xkb_machine_builder_remap_shortcut_layout(builder, 1, 2) ==
+           XKB_SUCCESS);
+    const struct xkb_key_input shortcuts[] = {
+        K(KEY_Q, XKB_KEY_DOWN), K(KEY_Q, XKB_KEY_UP),
+        K(KEY_LEFTMETA, XKB_KEY_DOWN),
+        K(KEY_Q, XKB_KEY_DOWN), K(KEY_Q, XKB_KEY_UP),
+        K(KEY_LEFTCTRL, XKB_KEY_DOWN),
+        K(KEY_Q, XKB_KEY_DOWN), K(KEY_Q, XKB_KEY_REPEATED),
+        K(KEY_Z, XKB_KEY_DOWN), K(KEY_Q, XKB_KEY_UP), K(KEY_Z, XKB_KEY_UP),
+        K(KEY_LEFTCTRL, XKB_KEY_UP),
+        K(KEY_LEFTMETA, XKB_KEY_UP),
+        K(KEY_COMPOSE, XKB_KEY_DOWN), K(KEY_COMPOSE, XKB_KEY_UP),
+        K(KEY_CAPSLOCK, XKB_KEY_DOWN), K(KEY_CAPSLOCK, XKB_KEY_UP),
+        K(KEY_RIGHTCTRL, XKB_KEY_DOWN),
+        K(KEY_Q, XKB_KEY_DOWN), K(KEY_Q, XKB_KEY_UP),
+        K(KEY_RIGHTCTRL, XKB_KEY_UP),
+    };
+    check_process_keys(builder, events, shortcuts, ARRAY_SIZE(shortcuts));
+    xkb_machine_builder_destroy(builder);
+    xkb_keymap_unref(keymap);
+
+    xkb_events_destroy(events);
+#undef K
+}
+
+static void
+test_events_queue(struct xkb_context *context)
+{
+    /* Invalid parameters */
+    assert(!xkb_events_new_queue(context, 0, XKB_EVENTS_NO_FLAGS));
+    assert(!xkb_events_new_queue(context, 4, -1));
+    assert(!xkb_events_new_batch(context, XKB_EVENTS_QUEUE_DROP_ON_OVERFLOW));
+
+    struct xkb_events *queue = xkb_events_new_queue(context, 3,
+                                                    XKB_EVENTS_NO_FLAGS);
+    if (!queue) {
+        fprintf(stderr, "Events queues are not supported; skipping\n");
+        return;
+    }
+
+    struct xkb_keymap * const keymap =
+        test_compile_rules(context, XKB_KEYMAP_FORMAT_TEXT_V1,
+                           "evdev", "pc104", "us", NULL, NULL);
+    assert(keymap);
+    struct xkb_machine_builder * const builder =
+        xkb_machine_builder_new(keymap, XKB_MACHINE_BUILDER_NO_FLAGS);
+    assert(builder);
+    struct xkb_machine *sm = xkb_machine_new(builder);
+    assert(sm);
+    struct xkb_machine *ref = xkb_machine_new(builder);
+    assert(ref);
+    struct xkb_events * const batch =
+        xkb_events_new_batch(context, XKB_EVENTS_NO_FLAGS);
+    assert(batch);
+
+    const struct xkb_key_input keys[] = {
+        { EVDEV_OFFSET + KEY_LEFTSHIFT, XKB_KEY_DOWN },
+        { EVDEV_OFFSET + KEY_A, XKB_KEY_DOWN },
+        { EVDEV_OFFSET + KEY_A, XKB_KEY_UP },
+        { EVDEV_OFFSET + KEY_LEFTSHIFT, XKB_KEY_UP },
+    };
+    const struct xkb_event *event;
+
+    /* Reference events */
+    darray(struct xkb_event) expected = darray_new();
+    for (size_t k = 0; k < ARRAY_SIZE(keys); k++) {
+        assert(xkb_machine_process_key(ref, keys[k].keycode, keys[k].direction,
+                                       batch) == XKB_SUCCESS);
+        while ((event = xkb_events_next(batch)))
+            darray_append(expected, *event);
+    }
+    assert(darray_size(expected) == 6);
+
+    /* Overflow: keep events in the backlog */
+    for (size_t k = 0; k < ARRAY_SIZE(keys); k++) {
+        assert(xkb_machine_process_key(sm, keys[k].keycode, keys[k].direction,
+                                       queue) == XKB_SUCCESS);
+    }
+    assert(xkb_events_flush(queue) == 2);
+    darray_size_t e = 0;
+    while ((event = xkb_events_next(queue)))
+        assert(check_event_eq(event, &darray_item(expected, e++)));
+    assert(e == 4);
+    assert(xkb_events_flush(queue) == 0);
+    while ((event = xkb_events_next(queue)))
+        assert(check_event_eq(event, &darray_item(expected, e++)));
+    assert(e == darray_size(expected));
+    assert(xkb_events_get_dropped(queue) == 0);
+    xkb_events_destroy(queue);
+    xkb_machine_unref(sm);
+
+    /* Overflow: drop events, but keep the state changes */
+    queue = xkb_events_new_queue(context, 2, XKB_EVENTS_QUEUE_DROP_ON_OVERFLOW);
+    assert(queue);
+    sm = xkb_machine_new(builder);
+    assert(sm);
+    assert(xkb_machine_process_key(sm, EVDEV_OFFSET + KEY_A, XKB_KEY_DOWN,
+                                   queue) == XKB_SUCCESS);
+    /* Shift down: 2 events, dropped */
+    assert(xkb_machine_process_key(sm, EVDEV_OFFSET + KEY_LEFTSHIFT,
+                                   XKB_KEY_DOWN, queue) == XKB_SUCCESS);
+    assert(xkb_events_get_dropped(queue) == 2);
+    event = xkb_events_next(queue);
+    assert(event && event->type == XKB_EVENT_TYPE_KEY_DOWN);
+    assert(xkb_events_next(queue) == NULL);
+    /* The merged state change is published before the next events */
+    assert(xkb_machine_process_key(sm, EVDEV_OFFSET + KEY_A, XKB_KEY_UP,
+                                   queue) == XKB_SUCCESS);
+    assert(xkb_events_flush(queue) == 0);
+    event = xkb_events_next(queue);
+    assert(event && event->type == XKB_EVENT_TYPE_COMPONENTS_CHANGE);
+    assert(xkb_event_serialize_mods(event, XKB_STATE_MODS_EFFECTIVE) ==
+           (UINT32_C(1) << XKB_MOD_INDEX_SHIFT));
+    event = xkb_events_next(queue);
+    assert(event && event->type == XKB_EVENT_TYPE_KEY_UP);
+    assert(xkb_events_next(queue) == NULL);
+    assert(xkb_events_get_dropped(queue) == 2);
+
+    /* Batches have neither backlog nor dropped events */
+    assert(xkb_events_flush(batch) == 0);
+    assert(xkb_events_get_dropped(batch) == 0);
+
+    darray_free(expected);
+    xkb_events_destroy(batch);
+    xkb_events_destroy(queue);
+    xkb_machine_unref(ref);
+    xkb_machine_unref(sm);
+    xkb_machine_builder_destroy(builder);
+    xkb_keymap_unref(keymap);
+}
+
 int
 main(void)
 {
@@ -3316,6 +3582,8 @@ main(void)
     test_overlays(context);
     test_modifiers_tweak(context);
     test_shortcuts_tweak(context);
+    test_process_keys(context);
+    test_events_queue(context);
 
     xkb_context_unref(context);
     return EXIT_SUCCESS;
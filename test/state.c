@@ -3126,6 +3126,73 @@ test_ctrl_string_transformation(struct xkb_keymap *keymap)
     xkb_state_unref(state);
 }
 
+/* Repeated queries for the same key must follow the state updates */
+static void
+test_key_lookup_burst(struct xkb_keymap *keymap)
+{
+    struct xkb_state *state = xkb_state_new(keymap);
+    assert(state);
+
+    /* Invalid keycode on a fresh state: must not hit the initial cache */
+    assert(xkb_state_key_get_layout(state, XKB_KEYCODE_INVALID) ==
+           XKB_LAYOUT_INVALID);
+    assert(xkb_state_key_get_level(state, XKB_KEYCODE_INVALID, 0) ==
+           XKB_LEVEL_INVALID);
+    assert(xkb_state_key_get_one_sym(state, XKB_KEYCODE_INVALID) ==
+           XKB_KEY_NoSymbol);
+    assert(xkb_state_key_get_consumed_mods(state, XKB_KEYCODE_INVALID) == 0);
+    xkb_state_unref(state);
+    state = xkb_state_new(keymap);
+    assert(state);
+    assert(xkb_state_key_get_level(state, XKB_KEYCODE_INVALID, 0) ==
+           XKB_LEVEL_INVALID);
+
+    const xkb_mod_mask_t shift =
+        _xkb_keymap_mod_get_mask(keymap, XKB_MOD_NAME_SHIFT);
+    const xkb_keycode_t kc_a = KEY_A + EVDEV_OFFSET;
+    const xkb_keycode_t kc_1 = KEY_1 + EVDEV_OFFSET;
+
+    for (int k = 0; k < 2; k++) {
+        assert(xkb_state_key_get_one_sym(state, kc_a) == XKB_KEY_a);
+        assert(xkb_state_key_get_utf32(state, kc_a) == 0x61);
+        assert(xkb_state_key_get_consumed_mods(state, kc_a) & shift);
+        assert(xkb_state_key_get_level(state, kc_a, 0) == 0);
+    }
+
+    /* Interleave another key */
+    assert(xkb_state_key_get_one_sym(state, kc_1) == XKB_KEY_1);
+    assert(xkb_state_key_get_one_sym(state, kc_a) == XKB_KEY_a);
+
+    /* Effective mods change */
+    xkb_state_update_mask(state, shift, 0, 0, 0, 0, 0);
+    for (int k = 0; k < 2; k++) {
+        assert(xkb_state_key_get_one_sym(state, kc_a) == XKB_KEY_A);
+        assert(xkb_state_key_get_utf32(state, kc_a) == 0x41);
+        assert(xkb_state_key_get_level(state, kc_a, 0) == 1);
+        assert(xkb_state_key_get_level(state, kc_a, 1) == 1);
+        assert(xkb_state_key_get_one_sym(state, kc_1) == XKB_KEY_exclam);
+    }
+
+    /* Effective group change */
+    xkb_state_update_mask(state, shift, 0, 0, 0, 0, 1);
+    assert(xkb_state_key_get_layout(state, kc_a) == 1);
+    assert(xkb_state_key_get_one_sym(state, kc_a) == XKB_KEY_Cyrillic_EF);
+    xkb_state_update_mask(state, 0, 0, 0, 0, 0, 1);
+    assert(xkb_state_key_get_one_sym(state, kc_a) == XKB_KEY_Cyrillic_ef);
+    xkb_state_update_mask(state, 0, 0, 0, 0, 0, 0);
+    assert(xkb_state_key_get_layout(state, kc_a) == 0);
+    assert(xkb_state_key_get_one_sym(state, kc_a) == XKB_KEY_a);
+
+    /* Unknown key */
+    assert(xkb_state_key_get_layout(state, XKB_KEYCODE_MAX) ==
+           XKB_LAYOUT_INVALID);
+    assert(xkb_state_key_get_one_sym(state, XKB_KEYCODE_MAX) ==
+           XKB_KEY_NoSymbol);
+    assert(xkb_state_key_get_consumed_mods(state, XKB_KEYCODE_MAX) == 0);
+
+    xkb_state_unref(state);
+}
+
 static bool
 test_active_leds(struct xkb_state *state, xkb_led_mask_t leds_expected)
 {
@@ -3247,6 +3314,52 @@ test_leds(struct xkb_context *ctx)
     xkb_keymap_unref(keymap);
 }
 
+/* Only LEDs whose inputs changed are updated: check the fast path */
+static void
+test_leds_incremental(struct xkb_context *ctx)
+{
+    struct xkb_keymap *keymap = test_compile_rules(
+        ctx, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev", "pc104", "us,de", NULL,
+        "grp_led:scroll"
+    );
+    assert(keymap);
+
+    const xkb_led_mask_t caps =
+        UINT32_C(1) << _xkb_keymap_led_get_index(keymap, XKB_LED_NAME_CAPS);
+    const xkb_led_mask_t num =
+        UINT32_C(1) << _xkb_keymap_led_get_index(keymap, XKB_LED_NAME_NUM);
+    const xkb_led_mask_t scroll =
+        UINT32_C(1) << _xkb_keymap_led_get_index(keymap, XKB_LED_NAME_SCROLL);
+    const xkb_led_mask_t group2 =
+        UINT32_C(1) << _xkb_keymap_led_get_index(keymap, "Group 2");
+    const xkb_mod_mask_t shift = UINT32_C(1) << XKB_MOD_INDEX_SHIFT;
+    const xkb_mod_mask_t lock = UINT32_C(1) << XKB_MOD_INDEX_CAPS;
+    const xkb_mod_mask_t num_lock = _xkb_keymap_mod_get_mask(keymap, XKB_VMOD_NAME_NUM);
+
+    struct xkb_state *state = xkb_state_new(keymap);
+    assert(state);
+    assert(test_active_leds(state, 0));
+
+    /* Unobserved inputs */
+    xkb_state_update_mask(state, shift | lock, 0, 0, 0, 0, 0);
+    assert(test_active_leds(state, 0));
+    xkb_state_update_mask(state, shift, shift, 0, 0, 0, 0);
+    assert(test_active_leds(state, 0));
+
+    /* Observed inputs */
+    xkb_state_update_mask(state, 0, 0, lock | num_lock, 0, 0, 1);
+    assert(test_active_leds(state, caps | num | scroll | group2));
+    xkb_state_update_mask(state, shift, 0, lock | num_lock, 0, 0, 1);
+    assert(test_active_leds(state, caps | num | scroll | group2));
+    xkb_state_update_mask(state, shift, 0, num_lock, 0, 0, 1);
+    assert(test_active_leds(state, num | scroll | group2));
+    xkb_state_update_mask(state, 0, 0, 0, 0, 0, 0);
+    assert(test_active_leds(state, 0));
+
+    xkb_state_unref(state);
+    xkb_keymap_unref(keymap);
+}
+
 static void
 test_multiple_actions(struct xkb_context *ctx)
 {
@@ -3687,6 +3800,7 @@ main(void)
         test_keycode_range(keymap);
         test_get_utf8_utf32(keymap);
         test_ctrl_string_transformation(keymap);
+        test_key_lookup_burst(keymap);
 
         xkb_keymap_unref(keymap);
     }
@@ -3695,6 +3809,7 @@ main(void)
     test_overlapping_mods(context);
     test_caps_keysym_transformation(context);
     test_leds(context);
+    test_leds_incremental(context);
     test_multiple_actions(context);
     test_void_action(context);
     test_extended_layout_indices(context);
@@ -133,6 +133,14 @@ test_makedir(const char *parent, const char *path);
 char *
 test_maketempdir(const char *template);
 
+/**
+ * Set the modification time of a file, with nanoseconds precision.
+ *
+ * @returns false if not supported on the platform.
+ */
+bool
+test_set_mtime(const char *path, int64_t sec, long nsec);
+
 char *
 test_get_path(const char *path_rel);
 
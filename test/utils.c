@@ -7,6 +7,8 @@
 #include "test-config.h"
 
 #include <assert.h>
+#include <stdalign.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -15,6 +17,7 @@
 
 #include "test.h"
 #include "utils.h"
+#include "utils-arena.h"
 #include "utils-numbers.h"
 #include "utils-paths.h"
 #include "test/utils-text.h"
@@ -136,6 +139,63 @@ rand_uint64(void)
     return result;
 }
 
+static void
+test_arena(void)
+{
+    struct arena arena = ARENA_INIT;
+
+    /* Alignment and zero-initialization */
+    for (size_t k = 0; k < 1000; k++) {
+        const size_t size = 1 + (size_t) rand() % 64;
+        unsigned char * const p = arena_calloc(&arena, 1, size);
+        assert(p);
+        assert((uintptr_t) p % alignof(max_align_t) == 0);
+        for (size_t i = 0; i < size; i++)
+            assert(p[i] == 0);
+        memset(p, 0xff, size);
+    }
+
+    /* Large allocations do not prevent further in-place growth */
+    int *array = arena_alloc(&arena, sizeof(*array));
+    assert(array);
+    array[0] = 0;
+    void * const large = arena_alloc(&arena, 1 << 16);
+    assert(large);
+    memset(large, 0xff, 1 << 16);
+    array = arena_realloc(&arena, array, sizeof(*array), 2 * sizeof(*array));
+    assert(array && array[0] == 0);
+    array[1] = 1;
+
+    /* Growth, in place or not */
+    int *last = NULL;
+    size_t count = 0;
+    for (size_t n = 1; n <= 4096; n *= 2) {
+        int * const resized = arena_realloc(&arena, last, count * sizeof(*last),
+                                            n * sizeof(*last));
+        assert(resized);
+        for (size_t i = 0; i < count; i++)
+            assert(resized[i] == (int) i);
+        for (size_t i = count; i < n; i++)
+            resized[i] = (int) i;
+        last = resized;
+        count = n;
+    }
+    assert(array[0] == 0 && array[1] == 1);
+
+    /* Strings */
+    const char * const s = arena_strdup(&arena, "xkb_symbols");
+    assert(s && streq(s, "xkb_symbols"));
+    const char * const s2 = arena_strndup(&arena, "pc+us", 2);
+    assert(s2 && streq(s2, "pc"));
+    assert(!arena_strdup(&arena, NULL));
+
+    arena_release(&arena);
+    assert(arena.chunks == NULL);
+    /* Reusable after release */
+    assert(arena_alloc(&arena, 10));
+    arena_release(&arena);
+}
+
 /* NOLINTBEGIN(google-readability-function-size) */
 static void
 test_number_parsers(void)
@@ -481,6 +541,7 @@ main(int argc, char *argv[])
 
     test_string_functions();
     test_path_functions();
+    test_arena();
     test_number_parsers();
 
     return EXIT_SUCCESS;
@@ -11,6 +11,7 @@
 #include "test.h"
 #include "xvfb-wrapper.h"
 #include "xkbcommon/xkbcommon-x11.h"
+#include "x11/x11-priv.h"
 
 X11_TEST(test_basic)
 {
@@ -80,6 +81,71 @@ err_conn:
     return exit_code;
 }
 
+X11_TEST(test_multiple_devices)
+{
+    struct xkb_context *ctx = test_get_context(CONTEXT_NO_FLAG);
+    xcb_connection_t *conn;
+    int exit_code = EXIT_SUCCESS;
+
+    conn = xcb_connect(display, NULL);
+    if (!conn || xcb_connection_has_error(conn)) {
+        exit_code = TEST_SETUP_FAILURE;
+        goto err_conn;
+    }
+
+    if (!xkb_x11_setup_xkb_extension(conn,
+                                     XKB_X11_MIN_MAJOR_XKB_VERSION,
+                                     XKB_X11_MIN_MINOR_XKB_VERSION,
+                                     XKB_X11_SETUP_XKB_EXTENSION_NO_FLAGS,
+                                     NULL, NULL, NULL, NULL)) {
+        exit_code = TEST_SETUP_FAILURE;
+        goto err_conn;
+    }
+
+    const int32_t device_id = xkb_x11_get_core_keyboard_device_id(conn);
+    assert(device_id != -1);
+
+    struct xkb_keymap *keymap =
+        xkb_x11_keymap_new_from_device(ctx, conn, device_id,
+                                       TEST_KEYMAP_COMPILE_FLAGS);
+    assert(keymap);
+    char *expected =
+        xkb_keymap_get_as_string(keymap, XKB_KEYMAP_USE_ORIGINAL_FORMAT);
+    assert(expected);
+    xkb_keymap_unref(keymap);
+
+    /* Invalid device IDs do not prevent the other keymaps to be created */
+    const int32_t device_ids[] = { device_id, -1, device_id, 128, device_id };
+    struct xkb_keymap *keymaps[ARRAY_SIZE(device_ids)];
+    const size_t count =
+        xkb_x11_keymap_new_from_devices(ctx, conn, ARRAY_SIZE(device_ids),
+                                        device_ids, TEST_KEYMAP_COMPILE_FLAGS,
+                                        keymaps);
+    assert(count == 3);
+    assert(!keymaps[1] && !keymaps[3]);
+    for (size_t k = 0; k < ARRAY_SIZE(keymaps); k++) {
+        if (!keymaps[k])
+            continue;
+        char * const got =
+            xkb_keymap_get_as_string(keymaps[k], XKB_KEYMAP_USE_ORIGINAL_FORMAT);
+        assert(got);
+        assert_streq_not_null("keymap", expected, got);
+        free(got);
+        xkb_keymap_unref(keymaps[k]);
+    }
+
+    assert(xkb_x11_keymap_new_from_devices(ctx, conn, 0, NULL,
+                                           TEST_KEYMAP_COMPILE_FLAGS,
+                                           NULL) == 0);
+
+    free(expected);
+err_conn:
+    xcb_disconnect(conn);
+    xkb_context_unref(ctx);
+
+    return exit_code;
+}
+
 int main(void) {
     test_init();
 